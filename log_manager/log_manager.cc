@@ -26,6 +26,10 @@
 #include <stdarg.h>
 #include <errno.h>
 #include <syslog.h>
+#include <pthread.h>
+#include <sched.h>
+#include <limits.h>
+#include <sys/uio.h>
 
 #include <skygw_debug.h>
 #include <skygw_types.h>
@@ -35,7 +39,6 @@
 #define MAX_PREFIXLEN 250
 #define MAX_SUFFIXLEN 250
 #define MAX_PATHLEN   512
-#define MAXNBLOCKBUFS 10
 
 /** for procname */
 #if !defined(_GNU_SOURCE)
@@ -47,7 +50,6 @@ extern char *program_invocation_short_name;
 
 #if defined(SS_DEBUG) 
 static int write_index;
-static int block_start_index;
 static int prevval;
 static simple_mutex_t msg_mutex;
 #endif
@@ -55,6 +57,7 @@ static int highprec = 0;
 static int do_syslog = 1;
 static int do_maxscalelog = 1;
 static int use_stdout = 0;
+static int block_on_full = 1;
 /**
  * Variable holding the enabled logfiles information.
  * Used from log users to check enabled logs prior calling
@@ -80,6 +83,17 @@ ssize_t log_ses_count[LOGFILE_LAST] = {0};
  */
 #define MAX_LOGSTRLEN BUFSIZ
 
+/**
+ * Size of the per-thread log buffers, must be a power of two. The file
+ * writer is woken up when a buffer has LOGBUF_WAKEUP bytes in it or when
+ * the log string is flushed.
+ */
+#define LOGBUF_SIZE   (16*MAX_LOGSTRLEN)
+#define LOGBUF_WAKEUP MAX_LOGSTRLEN
+
+/** Maximum number of buffers in one writev call */
+#define LOGBUF_IOVMAX (IOV_MAX < 256 ? IOV_MAX : 256)
+
 /** Use the skygw_ prefix, only for 1.1 compatible builds*/
 #define OLD_LOGNAMES
 
@@ -125,26 +139,35 @@ struct filewriter_st {
 };
 
 /**
- * Log client's string is copied to block-sized log buffer, which is passed
- * to file writer thread.
+ * Per-thread log buffer. Every thread that writes to a log file copies the
+ * log strings to a ring buffer of its own, from where the file writer thread
+ * writes them to disk. Only the owning thread moves lb_head and only the file
+ * writer moves lb_tail so the buffer can be used without locking.
+ *
+ * The lines of one thread are written in the order they were logged, but
+ * the writer drains the buffers one at a time, so the lines of different
+ * threads are not in timestamp order in the file.
  */
-typedef struct blockbuf_st {
-#if defined(SS_DEBUG)
-        skygw_chk_t    bb_chk_top;
-#endif
-        logfile_id_t   bb_fileid;
-  blockbuf_state_t bb_state; /**State of the block buffer*/
-        simple_mutex_t bb_mutex;    /**< bb_buf_used, bb_isfull */
-        int            bb_refcount; /**< protected by list mutex. #of clients */
-//        int            bb_blankcount; /**< # of blanks used btw strings */
-        size_t         bb_buf_size;
-        size_t         bb_buf_left;
-        size_t         bb_buf_used;
-        char           bb_buf[MAX_LOGSTRLEN];
-#if defined(SS_DEBUG)
-        skygw_chk_t    bb_chk_tail;
-#endif
-} blockbuf_t;
+typedef struct logbuf_st {
+        logfile_id_t      lb_fileid;
+        volatile size_t   lb_head;   /**< Bytes written by the owner */
+        volatile size_t   lb_tail;   /**< Bytes written to disk */
+        volatile bool     lb_orphan; /**< The owning thread has exited */
+        struct logbuf_st* lb_next;   /**< Next buffer of the logfile */
+        char              lb_buf[LOGBUF_SIZE];
+} logbuf_t;
+
+/**
+ * Log buffers of the current thread, indexed by logfile id. The buffers
+ * belong to the log manager instance whose generation is tls_logbuf_gen,
+ * they are forgotten if the log manager has been restarted since.
+ */
+static __thread logbuf_t* tls_logbufs[LOGFILE_LAST+1];
+static __thread size_t    tls_logbuf_gen;
+static __thread bool      tls_is_filewriter;
+static size_t             logbuf_gen;
+static pthread_key_t      logbuf_key;
+static pthread_once_t     logbuf_key_once = PTHREAD_ONCE_INIT;
 
 /**
  * logfile object corresponds to physical file(s) where
@@ -172,8 +195,10 @@ struct logfile_st {
         char*            lf_full_link_name; /**< complete symlink name */
         int              lf_nfiles_max;
         size_t           lf_file_size;
-        /** list of block-sized log buffers */
-        mlist_t          lf_blockbuf_list;
+        /** list of per-thread log buffers */
+        logbuf_t*        lf_logbufs;
+        simple_mutex_t   lf_logbuf_mutex; /**< lf_logbufs list */
+        int              lf_ndropped; /**< strings lost to full buffers */
         size_t           lf_buf_size;
         bool             lf_flushflag;
 	bool		 lf_rotateflag;
@@ -280,16 +305,18 @@ static int  logmanager_write_log(
         const char*	str,
         va_list      	valist);
 
-static blockbuf_t* blockbuf_init(logfile_id_t id);
-static void        blockbuf_node_done(void* bb_data);
-static char*       blockbuf_get_writepos(
-        blockbuf_t** p_bb,
-        logfile_id_t id,
-        size_t       str_len,
-        bool         flush);
-
-static void  blockbuf_register(blockbuf_t* bb);
-static void  blockbuf_unregister(blockbuf_t* bb);
+static logbuf_t* logbuf_get(logfile_t* lf);
+static void      logbuf_write(
+        logfile_t*  lf,
+        const char* str,
+        size_t      len,
+        bool        flush);
+static void      logbuf_key_init(void);
+static void      logbufs_release(void* data);
+static int       logfile_write_logbufs(
+        logfile_t*    lf,
+        skygw_file_t* file,
+        bool          flush);
 static bool  logfile_set_enabled(logfile_id_t id, bool val);
 static char* add_slash(char* str);
 
@@ -390,7 +417,6 @@ static bool logmanager_init_nomutex(
         lm->lm_chk_top   = CHK_NUM_LOGMANAGER;
         lm->lm_chk_tail  = CHK_NUM_LOGMANAGER;
 	write_index = 0;
-	block_start_index = 0;
 	prevval = -1;
 	simple_mutex_init(&msg_mutex, "Message mutex");
 #endif
@@ -410,6 +436,8 @@ static bool logmanager_init_nomutex(
         lm->lm_enabled_logfiles |= LOGFILE_TRACE;
         lm->lm_enabled_logfiles |= LOGFILE_DEBUG;
 #endif
+        /** Invalidate per-thread buffers of any previous log manager */
+        logbuf_gen += 1;
         fn = &lm->lm_fnames_conf;
         fw = &lm->lm_filewriter;
         fn->fn_state  = UNINIT;
@@ -627,7 +655,7 @@ static logfile_t* logmanager_get_logfile(
 
 
 /** 
- * Finds write position from block buffer for log string and writes there.
+ * Formats the log string and copies it to the calling thread's log buffer.
  * 
  * Parameters:
  *
@@ -659,11 +687,9 @@ static int logmanager_write_log(
 {
         logfile_t*   lf;
         char*        wp;
+        char         logstr[MAX_LOGSTRLEN];
         int          err = 0;
-        blockbuf_t*  bb;
-        blockbuf_t*  bb_c;
         size_t       timestamp_len;
-        int          i;
 
         CHK_LOGMANAGER(lm);
         
@@ -770,19 +796,11 @@ static int logmanager_write_log(
 			simple_mutex_unlock(&msg_mutex);
 		}
 #endif
-		/** Book space for log string from buffer */
-                if(do_maxscalelog)
-                {
-                wp = blockbuf_get_writepos(&bb,
-                                           id,
-                                           safe_str_len,
-                                           flush);
-                }
-                else
-                {
-                    wp = (char*)malloc(sizeof(char)*(timestamp_len-sizeof(char)+cmplen+str_len + 1));
-                }
-
+                /**
+                 * The string is formatted on the stack and copied to the
+                 * thread's log buffer once it is complete.
+                 */
+                wp = logstr;
 
 #if defined (SS_LOG_DEBUG)
 		{
@@ -850,69 +868,10 @@ static int logmanager_write_log(
 		}
 		wp[safe_str_len-1] = '\n';
 
-                if(do_maxscalelog)
-                {
-                    blockbuf_unregister(bb);
-                }
-                else
+                if (do_maxscalelog)
                 {
-                free(wp);
+                        logbuf_write(lf, logstr, wp-logstr+safe_str_len, flush);
                 }
-                /**
-                 * disable because cross-blockbuffer locking either causes deadlock
-                 * or run out of memory blocks.
-                 */
-                if (spread_down && false) {
-                        /**
-                         * Write to target log. If spread_down == true, then
-                         * write also to all logs with greater logfile id.
-                         * LOGFILE_ERROR   = 1,
-                         * LOGFILE_MESSAGE = 2,
-                         * LOGFILE_TRACE   = 4,
-                         * LOGFILE_DEBUG   = 8
-                         *
-                         * So everything written to error log will appear in
-                         * message, trace and debuglog. Messages will be
-                         * written in trace and debug log.
-                         */
-                        for (i=(id<<1); i<=LOGFILE_LAST; i<<=1)
-                        {
-                                /** pointer to write buffer of larger-id log */
-                                char* wp_c;
-                            
-                                /**< Check if particular log is enabled */
-                                if (!(lm->lm_enabled_logfiles & i))
-                                {
-                                        continue;
-                                }
-                                /**
-                                 * Seek write position and register to block
-                                 * buffer. Then print formatted string to
-                                 * write position.
-                                 */
-                                wp_c = blockbuf_get_writepos(
-                                        &bb_c,
-                                        (logfile_id_t)i,
-                                        timestamp_len-1+str_len,
-                                        flush);
-                                /**
-                                 * Copy original string from block buffer to
-                                 * other logs' block buffers.
-                                 */
-                                snprintf(wp_c, timestamp_len+str_len, "%s", wp);
-                            
-                                /** remove double line feed */
-                                if (wp_c[timestamp_len-1+str_len-2] == '\n')
-                                {
-                                        wp_c[timestamp_len-1+str_len-2]=' ';
-                                }
-                                wp_c[timestamp_len-1+str_len-1]='\n';
-                            
-                                /** lock-free unregistration, includes flush if
-                                 * bb_state == BB_FULL */
-                                blockbuf_unregister(bb_c);
-                        }
-                } /* if (spread_down) */
         } /* if (str == NULL) */
         
 return_err:
@@ -920,337 +879,269 @@ return_err:
 }
 
 /**
- * Register writer to a block buffer. When reference counter is non-zero the
- * flusher thread doesn't write the block to disk.
- * 
- * @param bb	block buffer
+ * Return the calling thread's log buffer for a logfile, creating and
+ * registering it to the logfile if this is the first time the thread writes
+ * to it.
+ *
+ * @param lf	logfile pointer
+ *
+ * @return log buffer or NULL if memory allocation failed
  */
-static void blockbuf_register(
-        blockbuf_t* bb)
+static logbuf_t* logbuf_get(
+        logfile_t* lf)
 {
-        CHK_BLOCKBUF(bb);
-        ss_dassert(bb->bb_refcount >= 0);
-        atomic_add(&bb->bb_refcount, 1);
+        logbuf_t* lb;
+
+        if (tls_logbuf_gen != logbuf_gen)
+        {
+                /** Buffers of a previous log manager are already freed */
+                memset(tls_logbufs, 0, sizeof(tls_logbufs));
+                tls_logbuf_gen = logbuf_gen;
+        }
+
+        if ((lb = tls_logbufs[lf->lf_id]) != NULL)
+        {
+                return lb;
+        }
+
+        if ((lb = (logbuf_t *)calloc(1, sizeof(logbuf_t))) == NULL)
+        {
+                return NULL;
+        }
+        lb->lb_fileid = lf->lf_id;
+        /** Mark the thread's buffers orphaned when the thread exits */
+        pthread_once(&logbuf_key_once, logbuf_key_init);
+        pthread_setspecific(logbuf_key, tls_logbufs);
+
+        simple_mutex_lock(&lf->lf_logbuf_mutex, true);
+        lb->lb_next = lf->lf_logbufs;
+        lf->lf_logbufs = lb;
+        simple_mutex_unlock(&lf->lf_logbuf_mutex);
+
+        tls_logbufs[lf->lf_id] = lb;
+        return lb;
 }
 
 /**
- * Unregister writer from block buffer. If the buffer got filled up and there
- * are no other registered writers anymore, notify the flusher thread.
- * 
- * @param bb	block buffer
+ * Copy a formatted log string to the calling thread's log buffer. If the
+ * buffer is full the string is either dropped or the caller waits until the
+ * file writer has made room for it, depending on the full buffer policy.
+ *
+ * @param lf	logfile pointer
+ * @param str	formatted log string
+ * @param len	length of the string
+ * @param flush	whether the file writer should write the string immediately
  */
-static void blockbuf_unregister(
-        blockbuf_t* bb)
+static void logbuf_write(
+        logfile_t*  lf,
+        const char* str,
+        size_t      len,
+        bool        flush)
 {
-        logfile_t* lf;
-        
-        CHK_BLOCKBUF(bb);
-        ss_dassert(bb->bb_refcount >= 1);
-        lf = &lm->lm_logfile[bb->bb_fileid];
-        CHK_LOGFILE(lf);
-        /**
-         * if this is the last client in a full buffer, send write request.
-         */
-        if (atomic_add(&bb->bb_refcount, -1) == 1 && bb->bb_state == BB_FULL) {
-            skygw_message_send(lf->lf_logmes);
+        logbuf_t* lb;
+        size_t    head;
+        size_t    used;
+        size_t    offset;
+        size_t    n;
+
+        ss_dassert(len <= LOGBUF_SIZE);
+
+        if ((lb = logbuf_get(lf)) == NULL)
+        {
+                atomic_add(&lf->lf_ndropped, 1);
+                return;
+        }
+        head = lb->lb_head;
+
+        while ((used = head - lb->lb_tail) + len > LOGBUF_SIZE)
+        {
+                /** The file writer can't wait for itself */
+                if (!block_on_full || tls_is_filewriter)
+                {
+                        atomic_add(&lf->lf_ndropped, 1);
+                        return;
+                }
+                skygw_message_send(lf->lf_logmes);
+                sched_yield();
+        }
+        offset = head & (LOGBUF_SIZE - 1);
+        n = MIN(len, LOGBUF_SIZE - offset);
+        memcpy(&lb->lb_buf[offset], str, n);
+        memcpy(&lb->lb_buf[0], str + n, len - n);
+
+        /** The string must be complete before the file writer can see it */
+        __sync_synchronize();
+        lb->lb_head = head + len;
+
+        if (flush || (used < LOGBUF_WAKEUP && used + len >= LOGBUF_WAKEUP))
+        {
+                skygw_message_send(lf->lf_logmes);
         }
-        ss_dassert(bb->bb_refcount >= 0);
 }
 
+/**
+ * Create the key whose destructor releases the log buffers of an exiting
+ * thread.
+ */
+static void logbuf_key_init(void)
+{
+        pthread_key_create(&logbuf_key, logbufs_release);
+}
 
-/** 
- * @node (write brief function description here) 
- *
- * Parameters:
- * @param id - <usage>
- *          <description>
+/**
+ * Thread-specific data destructor. Marks the log buffers of the exiting
+ * thread orphaned so that the file writer frees them once their contents
+ * are on disk.
  *
- * @param str_len - <usage>
- *          <description>
+ * @param data	the thread's tls_logbufs array
+ */
+static void logbufs_release(
+        void* data)
+{
+        logbuf_t** lbs = (logbuf_t **)data;
+        int        i;
+
+        acquire_lock(&lmlock);
+
+        if (lm != NULL && tls_logbuf_gen == logbuf_gen)
+        {
+                for (i = LOGFILE_FIRST; i <= LOGFILE_LAST; i <<= 1)
+                {
+                        if (lbs[i] != NULL)
+                        {
+                                lbs[i]->lb_orphan = true;
+                        }
+                }
+        }
+        release_lock(&lmlock);
+}
+
+/**
+ * Write the contents of all per-thread log buffers of a logfile to the
+ * file. The buffers are gathered to as few writev calls as possible, and
+ * buffers of exited threads are freed once they are empty.
  *
- * @return 
+ * Called only by the file writer thread.
  *
- * 
- * @details List mutex now protects both the list and the contents of it.
- * TODO : It should be so that adding and removing nodes of the list is protected
- * by the list mutex. Buffer modifications should be protected by buffer
- * mutex.
+ * @param lf	logfile pointer
+ * @param file	file to write to
+ * @param flush	whether the file is synced to disk
  *
+ * @return 0 on success, errno of the failed write otherwise
  */
-static char* blockbuf_get_writepos(
-        blockbuf_t** p_bb,
-        logfile_id_t id,
-        size_t       str_len,
-        bool         flush)
+static int logfile_write_logbufs(
+        logfile_t*    lf,
+        skygw_file_t* file,
+        bool          flush)
 {
-  logfile_t*     lf;
-  mlist_t*       bb_list;
-  char*          pos = NULL;
-  mlist_node_t*  node;
-  blockbuf_t*    bb;
-  ss_debug(bool  succp;)
-
-            
-        CHK_LOGMANAGER(lm);
-        lf = &lm->lm_logfile[id];
-        CHK_LOGFILE(lf);
-        bb_list = &lf->lf_blockbuf_list;
+        struct iovec iov[LOGBUF_IOVMAX];
+        logbuf_t*    bufs[LOGBUF_IOVMAX];
+        size_t       heads[LOGBUF_IOVMAX];
+        char         note[MAX_LOGSTRLEN];
+        logbuf_t*    lb;
+        logbuf_t**   prev;
+        int          niov = 0;
+        int          nbufs = 0;
+        int          ndropped;
+        int          err = 0;
+        int          i;
 
-        /** Lock list */
-        simple_mutex_lock(&bb_list->mlist_mutex, true);
-        CHK_MLIST(bb_list);
+        /** Report the strings which didn't fit into the buffers */
+        if ((ndropped = lf->lf_ndropped) > 0)
+        {
+                size_t len;
+
+                atomic_add(&lf->lf_ndropped, -ndropped);
+                len = highprec ? snprint_timestamp_hp(note, sizeof(note)) :
+                        snprint_timestamp(note, sizeof(note));
+                len += snprintf(note + len,
+                                sizeof(note) - len,
+                                "Warning : %d log messages were dropped because "
+                                "the log buffer was full.\n",
+                                ndropped);
+                iov[niov].iov_base = note;
+                iov[niov].iov_len = MIN(len, sizeof(note) - 1);
+                niov += 1;
+        }
 
-        if (bb_list->mlist_nodecount > 0) {
-            /**
-             * At least block buffer exists on the list. 
-             */
-            node = bb_list->mlist_first;
-	    
-            
-            /** Loop over blockbuf list to find write position */
-            while (true) {
-                CHK_MLIST_NODE(node);
+        simple_mutex_lock(&lf->lf_logbuf_mutex, true);
+        lb = lf->lf_logbufs;
+        simple_mutex_unlock(&lf->lf_logbuf_mutex);
 
-                /** Unlock list */
-                simple_mutex_unlock(&bb_list->mlist_mutex);
-                
-                bb = (blockbuf_t *)node->mlnode_data;
-                CHK_BLOCKBUF(bb);
+        /**
+         * Buffers are only added to the head of the list and only this
+         * thread removes them, so the list can be traversed without locking.
+         */
+        while (lb != NULL || nbufs > 0 || niov > 0)
+        {
+                if (lb != NULL && niov + 2 <= LOGBUF_IOVMAX)
+                {
+                        size_t head = lb->lb_head;
+                        size_t tail = lb->lb_tail;
 
-                /** Lock buffer */
-                simple_mutex_lock(&bb->bb_mutex, true);
-                
-                if (bb->bb_state == BB_FULL || bb->bb_buf_left < str_len) {
-                    /**
-                     * This block buffer is too full.
-                     * Send flush request to file writer thread. This causes
-                     * flushing all buffers, and (eventually) frees buffer space.
-                     */
-		  blockbuf_register(bb);
-		  
-		  bb->bb_state = BB_FULL;
-
-		  blockbuf_unregister(bb);
-		  
-		  /** Unlock buffer */
-		  simple_mutex_unlock(&bb->bb_mutex);
-
-		  /** Lock list */
-		    simple_mutex_lock(&bb_list->mlist_mutex, true);
-
-
-                    /**
-                     * If next node exists move forward. Else check if there is
-                     * space for a new block buffer on the list.
-                     */
-                    if (node != bb_list->mlist_last) {
-                        node = node->mlnode_next;
-                        continue;
-                    }
-                    /**
-                     * All buffers on the list are full.
-                     */
-                    if (bb_list->mlist_nodecount <
-                        bb_list->mlist_nodecount_max)
-                    {
-                        /**
-                         * New node is created
-                         */
-                        bb = blockbuf_init(id);
-                        CHK_BLOCKBUF(bb);
+                        /** Read the contents only after reading the head */
+                        __sync_synchronize();
 
-                        /**
-                         * Increase version to odd to mark list update active
-                         * update.
-                         */
-                        bb_list->mlist_versno += 1;
-                        ss_dassert(bb_list->mlist_versno%2 == 1);
-                        
-                        ss_debug(succp =)
-                            mlist_add_data_nomutex(bb_list, bb);
-                        ss_dassert(succp);
+                        if (head != tail)
+                        {
+                                size_t offset = tail & (LOGBUF_SIZE - 1);
+                                size_t len = head - tail;
+                                size_t n = MIN(len, LOGBUF_SIZE - offset);
 
-                        /**
-                         * Increase version to even to mark completion of update.
-                         */
-                        bb_list->mlist_versno += 1;
-                        ss_dassert(bb_list->mlist_versno%2 == 0);
-                    } else {
-                        /**
-                         * List and buffers are full.
-                         * Reset to the beginning of the list, and wait until
-                         * there is a block buffer with enough space.
-                         */
-                        simple_mutex_unlock(&bb_list->mlist_mutex);
-                        simple_mutex_lock(&bb_list->mlist_mutex, true);
+                                iov[niov].iov_base = &lb->lb_buf[offset];
+                                iov[niov].iov_len = n;
+                                niov += 1;
 
-                        node = bb_list->mlist_first;
+                                if (len > n)
+                                {
+                                        iov[niov].iov_base = &lb->lb_buf[0];
+                                        iov[niov].iov_len = len - n;
+                                        niov += 1;
+                                }
+                                bufs[nbufs] = lb;
+                                heads[nbufs] = head;
+                                nbufs += 1;
+                        }
+                        lb = lb->lb_next;
                         continue;
-                    }
-		 
-
-		}else if(bb->bb_state == BB_CLEARED){
-
-		  /**
-		   *Move the cleared buffer to the end of the list if it is the first one in the list
-		   */
-
-		      simple_mutex_unlock(&bb->bb_mutex);
-		      simple_mutex_lock(&bb_list->mlist_mutex, true);
-		      
-		      if(node == bb_list->mlist_first)
-				  {
-
-					  if(bb_list->mlist_nodecount > 1 &&
-						 node != bb_list->mlist_last){
-						  bb_list->mlist_last->mlnode_next = bb_list->mlist_first;
-						  bb_list->mlist_first = bb_list->mlist_first->mlnode_next;
-						  bb_list->mlist_last->mlnode_next->mlnode_next = NULL;
-						  bb_list->mlist_last = bb_list->mlist_last->mlnode_next;
-					  }
-
-					  ss_dassert(node == bb_list->mlist_last);
-
-					  simple_mutex_unlock(&bb_list->mlist_mutex);
-					  simple_mutex_lock(&bb->bb_mutex, true);
-
-					  bb->bb_state = BB_READY;
-
-					  simple_mutex_unlock(&bb->bb_mutex);
-					  simple_mutex_lock(&bb_list->mlist_mutex, true);
-					  node = bb_list->mlist_first;
-				  }
-			  else
-				  {
-					  if(node->mlnode_next){
-						  node = node->mlnode_next;
-					  }else{
-						  node = bb_list->mlist_first;
-					  }
-					  continue;
-				  }
-
-
-			  
-
-		    }else if (bb->bb_state == BB_READY){
-                    /**
-                     * There is space for new log string.
-                     */
-                    break;
                 }
-            } /** while (true) */
-        } else {
-
-            /**
-             * Create the first block buffer to logfile's blockbuf list.
-             */
-
-            bb = blockbuf_init(id);
-            CHK_BLOCKBUF(bb);
-
-            /** Lock buffer */
-            simple_mutex_lock(&bb->bb_mutex, true);
-            /**
-             * Increase version to odd to mark list update active update.
-             */
-            bb_list->mlist_versno += 1;
-            ss_dassert(bb_list->mlist_versno%2 == 1);
-
-            ss_debug(succp =)mlist_add_data_nomutex(bb_list, bb);
-            ss_dassert(succp);
-
-            /**
-             * Increase version to even to mark completion of update.
-             */
-            bb_list->mlist_versno += 1;
-            ss_dassert(bb_list->mlist_versno%2 == 0);
-            
-            /** Unlock list */
-            simple_mutex_unlock(&bb_list->mlist_mutex);
-        } /* if (bb_list->mlist_nodecount > 0) */
-        
-        ss_dassert(pos == NULL);
-        ss_dassert(!(bb->bb_state == BB_FULL || bb->bb_buf_left < str_len));
-        ss_dassert(bb_list->mlist_nodecount <= bb_list->mlist_nodecount_max);
-
-        /**
-         * Registration to blockbuf adds reference for the write operation.
-         * It indicates that client has allocated space from the buffer,
-         * but not written yet. As long as refcount > 0 buffer can't be
-         * written to disk.
-         */
-        blockbuf_register(bb);
-        *p_bb = bb;
-        /**
-         * At this point list mutex is held and bb points to a node with
-         * enough space available. pos is not yet set.
-         */
-        pos = &bb->bb_buf[bb->bb_buf_used];
-        bb->bb_buf_used += str_len;
-        bb->bb_buf_left -= str_len;
-        
-        ss_dassert(pos >= &bb->bb_buf[0] &&
-                   pos <= &bb->bb_buf[MAX_LOGSTRLEN-str_len]);
-        
-        /** read checkmark */
-        /** TODO: add buffer overflow checkmark
-        chk_val = (int)bb->bb_buf[bb->bb_buf_used-count_len];
-        ss_dassert(chk_val == bb->bb_strcount);
-        */
-        
-        /** TODO : write next checkmark
-        bb->bb_strcount += 1;
-        memcpy(&bb->bb_buf[bb->bb_buf_used], &bb->bb_strcount, count_len);
-        bb->bb_buf_used += count_len;
-        bb->bb_buf_left -= count_len;
-        */
-        
-        /**
-         * If flush flag is set, set buffer full. As a consequence, no-one
-         * can write to it before it is flushed to disk.
-         */
-        bb->bb_state = (flush == true ? BB_FULL : bb->bb_state);
-        
-        /** Unlock buffer */
-        simple_mutex_unlock(&bb->bb_mutex);
-        return pos;
-}
-
-static void blockbuf_node_done(
-        void* bb_data)
-{
-        blockbuf_t* bb = (blockbuf_t *)bb_data;
-        simple_mutex_done(&bb->bb_mutex);
-}
+                /** Either the vector is full or all buffers were gathered */
+                if (err == 0)
+                {
+                        err = skygw_file_writev(file, iov, niov, flush);
+                }
+                /** Space is released even if the write failed */
+                __sync_synchronize();
 
+                for (i = 0; i < nbufs; i++)
+                {
+                        bufs[i]->lb_tail = heads[i];
+                }
+                niov = 0;
+                nbufs = 0;
+        }
 
-static blockbuf_t* blockbuf_init(
-        logfile_id_t id)
-{
-        blockbuf_t* bb;
+        /** Free the empty buffers of exited threads */
+        simple_mutex_lock(&lf->lf_logbuf_mutex, true);
+        prev = &lf->lf_logbufs;
 
-        bb = (blockbuf_t *)calloc(1, sizeof(blockbuf_t));
-        bb->bb_fileid = id;
-#if defined(SS_DEBUG)
-        bb->bb_chk_top = CHK_NUM_BLOCKBUF;
-        bb->bb_chk_tail = CHK_NUM_BLOCKBUF;
-#endif
-        simple_mutex_init(&bb->bb_mutex, "Blockbuf mutex");
-        bb->bb_buf_left = MAX_LOGSTRLEN;
-        bb->bb_buf_size = MAX_LOGSTRLEN;
-
-#if defined(SS_LOG_DEBUG)
-	sprintf(bb->bb_buf,"[block:%d]",atomic_add(&block_start_index,1));
-	bb->bb_buf_used += strlen(bb->bb_buf);
-	bb->bb_buf_left -= strlen(bb->bb_buf);
-#endif
+        while ((lb = *prev) != NULL)
+        {
+                if (lb->lb_orphan && lb->lb_head == lb->lb_tail)
+                {
+                        *prev = lb->lb_next;
+                        free(lb);
+                }
+                else
+                {
+                        prev = &lb->lb_next;
+                }
+        }
+        simple_mutex_unlock(&lf->lf_logbuf_mutex);
 
-        CHK_BLOCKBUF(bb);
-        return bb;
+        return err;
 }
 
-
 int skygw_log_enable(
         logfile_id_t id)
 {
@@ -2583,14 +2474,14 @@ static bool logfile_init(
 		goto return_with_succp;
 	}
         /**
-         * Create a block buffer list for log file. Clients' writes go to buffers
-         * from where separate log flusher thread writes them to disk.
+         * Clients' writes go to per-thread buffers which are added to the
+         * logfile's buffer list. The file writer thread writes them to disk.
          */
-        if (mlist_init(&logfile->lf_blockbuf_list,
-                       NULL,
-                       strdup("logfile block buffer list"),
-                       blockbuf_node_done,
-                       MAXNBLOCKBUFS) == NULL)
+        logfile->lf_logbufs = NULL;
+        logfile->lf_ndropped = 0;
+
+        if (simple_mutex_init(&logfile->lf_logbuf_mutex,
+                              "Logfile buffer list mutex") == NULL)
         {
                 ss_dfprintf(stderr,
                             "*\n* Error : Initializing buffers for log files "
@@ -2655,10 +2546,17 @@ static void logfile_done(
 		    ss_dassert(lf->lf_npending_writes == 0);
 		    /** fallthrough */
             case INIT:
-		    /** Test if list is initialized before freeing it */
-		    if (lf->lf_blockbuf_list.mlist_versno != 0)
+		    /** Test if buffer list is initialized before freeing it */
+		    if (lf->lf_logbuf_mutex.sm_enabled)
 		    {
-			mlist_done(&lf->lf_blockbuf_list);
+			logbuf_t* lb;
+
+			while ((lb = lf->lf_logbufs) != NULL)
+			{
+			    lf->lf_logbufs = lb->lb_next;
+			    free(lb);
+			}
+			simple_mutex_done(&lf->lf_logbuf_mutex);
 		    }
 		    logfile_free_memory(lf);
 		    lf->lf_state = DONE;
@@ -2785,38 +2683,24 @@ static void filewriter_done(
  * @return 
  *
  * 
- * @details Waits until receives wake-up message. Scans through block buffer
- * lists of each logfile object.
- *
- * Block buffer is written to log file if
- * 1. bb_state == true,
- * 2. logfile object's lf_flushflag == true, or
- * 3. skygw_thread_must_exit returns true.
- * 
- * Log file is flushed (fsync'd) in cases #2 and #3.
- *
- * Concurrency control : block buffer is accessed by file writer (this) and
- * log clients. File writer reads and sets each logfile object's flushflag
- * with spinlock. Another protected section is when block buffer's metadata is
- * read, and optionally the write operation.
- *
- * When block buffer is marked full, logfile's flushflag is set, other
- * log clients don't try to access buffer(s). There may, however, be
- * active writes, on the block in parallel with file writer operations.
- * Each active write corresponds to bb_refcounter values.
- * On the other hand, file writer doesn't process the block buffer before
- * its refcount is zero.
- *
- * Every log file obj. has its own block buffer (linked) list.
- * List is accessed by log clients, which add nodes if necessary, and
- * by file writer which traverses the list and accesses block buffers
- * included in list nodes.
- * List modifications are protected with version numbers.
- * Before
- modification, version is increased by one to be odd. After the
- * completion, it is increased again to even. List can be read only when
- * version is even and read is consistent only if version hasn't changed
- * during the read.
+ * @details Waits until receives wake-up message. Writes the contents of
+ * the per-thread log buffers of each logfile object to disk.
+ *
+ * Log clients wake the file writer up when a buffer has filled up past
+ * LOGBUF_WAKEUP bytes, when a string is written with flush, when a buffer
+ * is full and when the log file is flushed or rotated. Log file is flushed
+ * (fsync'd) when logfile object's lf_flushflag is set or when all logs are
+ * flushed, including when the thread exits.
+ *
+ * Concurrency control : each log buffer has exactly one writing client, the
+ * thread that owns it, and the file writer is the only reader. The client
+ * publishes a string by moving the buffer's head after copying the string
+ * and the file writer releases space by moving the tail after the write.
+ * File writer reads and sets each logfile object's flushflag with spinlock.
+ *
+ * Every log file obj. has its own list of per-thread buffers. Clients add
+ * their buffers to the head of the list with the list mutex held and the
+ * file writer frees the buffers of exited threads once they are empty.
  */
 static void* thr_filewriter_fun(
         void* data)
@@ -2825,18 +2709,13 @@ static void* thr_filewriter_fun(
         filewriter_t*   fwr;
         skygw_file_t*   file;
         logfile_t*      lf;
-            
-        mlist_t*      bb_list;
-        blockbuf_t*   bb;
-        mlist_node_t* node;
         int           i;
-        blockbuf_state_t          flush_blockbuf;   /**< flush single block buffer. */
+        int           err;
         bool          flush_logfile;    /**< flush logfile */
 		bool		  do_flushall = false;
         bool          rotate_logfile;   /*< close current and open new file */
-        size_t        vn1;
-        size_t        vn2;
 
+        tls_is_filewriter = true;
         thr = (skygw_thread_t *)data;
         fwr = (filewriter_t *)skygw_thread_get_data(thr);
 		flushall_logfiles(false);
@@ -2915,92 +2794,25 @@ static void* thr_filewriter_fun(
 				continue;
 			}
                         /**
-                         * get logfile's block buffer list
+                         * Write the contents of all threads' buffers
                          */
-                        bb_list = &lf->lf_blockbuf_list;
-#if defined(SS_DEBUG)
-                        simple_mutex_lock(&bb_list->mlist_mutex, true);
-                        CHK_MLIST(bb_list);
-                        simple_mutex_unlock(&bb_list->mlist_mutex);
-#endif
-                        node = bb_list->mlist_first;
-                
-                        while (node != NULL) 
-			{
-				int err = 0;
-				
-                                CHK_MLIST_NODE(node);
-                                bb = (blockbuf_t *)node->mlnode_data;
-                                CHK_BLOCKBUF(bb);
-
-                                /** Lock block buffer */
-                                simple_mutex_lock(&bb->bb_mutex, true);
-
-                                flush_blockbuf = bb->bb_state;
-                    
-                                if (bb->bb_buf_used != 0 &&
-                                    (flush_blockbuf == BB_FULL ||
-                                     flush_logfile ||
-                                     do_flushall))
-                                {
-                                        /**
-                                         * buffer is at least half-full
-                                         * -> write to disk
-                                         */
-                                        while(bb->bb_refcount > 0) 
-					{
-                                                simple_mutex_unlock(
-                                                        &bb->bb_mutex);
-                                                simple_mutex_lock(
-                                                        &bb->bb_mutex,
-                                                        true);
-                                        }
-                                        err = skygw_file_write(
-						file,
-						(void *)bb->bb_buf,
-						bb->bb_buf_used,
-						(flush_logfile || 
-						    do_flushall));
-					if (err)
-					{
-						fprintf(stderr,
-							"Error : Write to %s log "
-							": %s failed due to %d, "
-							"%s. Disabling the log.",
-							STRLOGNAME((logfile_id_t)i),
-							lf->lf_full_file_name,
-							err,
-							strerror(err));
-						/** Force log off */
-						skygw_log_disable_raw((logfile_id_t)i, true);
-					}
-                                        /**
-                                         * Reset buffer's counters and mark
-                                         * not full.
-                                         */
-                                        bb->bb_buf_left = bb->bb_buf_size;
-                                        bb->bb_buf_used = 0;
-                                        memset(bb->bb_buf, 0, bb->bb_buf_size);
-                                        bb->bb_state = BB_CLEARED;
-#if defined(SS_LOG_DEBUG)
-					sprintf(bb->bb_buf,"[block:%d]",atomic_add(&block_start_index,1));
-					bb->bb_buf_used += strlen(bb->bb_buf);
-					bb->bb_buf_left -= strlen(bb->bb_buf);
-#endif
-
-                                }
-                                /** Release lock to block buffer */
-                                simple_mutex_unlock(&bb->bb_mutex);
-                    
-                                /** Consistent lock-free read on the list */
-                                do {
-                                        while ((vn1 = bb_list->mlist_versno)%2
-                                               != 0);
-                                        node = node->mlnode_next;
-                                        vn2 = bb_list->mlist_versno;
-                                } while (vn1 != vn2);
-                    
-                        } /* while (node != NULL) */
+                        err = logfile_write_logbufs(lf,
+                                                    file,
+                                                    (flush_logfile ||
+                                                     do_flushall));
+                        if (err)
+                        {
+                                fprintf(stderr,
+                                        "Error : Write to %s log "
+                                        ": %s failed due to %d, "
+                                        "%s. Disabling the log.",
+                                        STRLOGNAME((logfile_id_t)i),
+                                        lf->lf_full_file_name,
+                                        err,
+                                        strerror(err));
+                                /** Force log off */
+                                skygw_log_disable_raw((logfile_id_t)i, true);
+                        }
 
                         /**
                          * Writer's exit flag was set after checking it.
@@ -3187,3 +2999,12 @@ void logmanager_enable_maxscalelog(int val)
 {
     do_maxscalelog = val;
 }
+
+/**
+ * Toggle waiting for space when the thread's log buffer is full
+ * @param val 0 for dropping the log message, 1 for waiting
+ */
+void logmanager_enable_block_on_full(int val)
+{
+    block_on_full = val;
+}
@@ -23,12 +23,6 @@ typedef struct logfile_st     logfile_t;
 typedef struct fnames_conf_st fnames_conf_t;
 typedef struct logmanager_st  logmanager_t;
 
-typedef enum {
-  BB_READY = 0x00,
-  BB_FULL,
-  BB_CLEARED
-} blockbuf_state_t;
-
 typedef enum {
     LOGFILE_ERROR = 1,
     LOGFILE_FIRST = LOGFILE_ERROR,
@@ -122,6 +116,7 @@ void skygw_log_sync_all(void);
 void skygw_set_highp(int);
 void logmanager_enable_syslog(int);
 void logmanager_enable_maxscalelog(int);
+void logmanager_enable_block_on_full(int);
 
 EXTERN_C_BLOCK_END
 
@@ -0,0 +1,122 @@
+/*
+ * This file is distributed as part of the MariaDB Corporation MaxScale.  It is free
+ * software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation,
+ * version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Copyright MariaDB Corporation Ab 2013-2014
+ */
+
+/**
+ * Log manager throughput benchmark
+ *
+ * Writes messages to the error log from 1, 2, 4, ... threads in parallel and
+ * reports the number of messages written per second for each thread count.
+ *
+ * Usage: logbench [messages per thread] [max threads] [drop]
+ */
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <skygw_utils.h>
+#include <log_manager.h>
+
+static int nmessages;
+
+static void* write_messages(void* data)
+{
+	long	id = (long)data;
+	int	i;
+
+	for (i = 0; i < nmessages; i++)
+	{
+		skygw_log_write(LOGFILE_ERROR,
+				"logbench|%ld|%d thread %ld writes message %d "
+				"of %d to the log",
+				id, i, id, i, nmessages);
+	}
+	return NULL;
+}
+
+static double
+elapsed(struct timespec *start, struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) +
+		(end->tv_nsec - start->tv_nsec) / 1000000000.0;
+}
+
+int main(int argc, char** argv)
+{
+	int		maxthreads;
+	int		nthr;
+	long		i;
+	bool		succp;
+	char		cwd[1024];
+	char*		optstr[4];
+	pthread_t*	threads;
+	struct timespec	start, end;
+	double		t;
+
+	nmessages = argc > 1 ? atoi(argv[1]) : 100000;
+	maxthreads = argc > 2 ? atoi(argv[2]) : 64;
+
+	if (nmessages <= 0 || maxthreads <= 0 || getcwd(cwd, sizeof(cwd)) == NULL)
+	{
+		fprintf(stderr,
+			"Usage: logbench [messages per thread] [max threads] [drop]\n");
+		return 1;
+	}
+	threads = (pthread_t *)malloc(sizeof(pthread_t) * maxthreads);
+	optstr[0] = "log_manager";
+	optstr[1] = "-j";
+	optstr[2] = cwd;
+	optstr[3] = NULL;
+
+	/** Drop messages instead of waiting when the buffers are full */
+	logmanager_enable_block_on_full(argc > 3 && strcmp(argv[3], "drop") == 0 ? 0 : 1);
+
+	succp = skygw_logmanager_init(3, optstr);
+	ss_dassert(succp);
+
+	skygw_log_disable(LOGFILE_TRACE);
+	skygw_log_disable(LOGFILE_MESSAGE);
+	skygw_log_disable(LOGFILE_DEBUG);
+
+	printf("%8s %12s %16s\n", "threads", "messages", "messages/second");
+
+	for (nthr = 1; nthr <= maxthreads; nthr *= 2)
+	{
+		clock_gettime(CLOCK_MONOTONIC, &start);
+
+		for (i = 0; i < nthr; i++)
+		{
+			pthread_create(&threads[i], NULL, write_messages, (void *)i);
+		}
+		for (i = 0; i < nthr; i++)
+		{
+			pthread_join(threads[i], NULL);
+		}
+		skygw_log_sync_all();
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		t = elapsed(&start, &end);
+
+		printf("%8d %12ld %16.0f\n", nthr, (long)nthr * nmessages,
+		       nthr * nmessages / t);
+	}
+
+	skygw_logmanager_done();
+	free(threads);
+	return 0;
+}
@@ -60,10 +60,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <pthread.h>
 
 extern int            lm_enabled_logfiles_bitmask;
 extern size_t         log_ses_count[];
 extern __thread log_info_t tls_log_info;
+extern "C" int             config_qc_cache_size();
 
 #define QTYPE_LESS_RESTRICTIVE_THAN_WRITE(t) (t<QUERY_TYPE_WRITE ? true : false)
 
@@ -78,6 +80,106 @@ static bool skygw_stmt_causes_implicit_commit(
 static int is_autocommit_stmt(LEX* lex);
 static void parsing_info_set_plain_str(void* ptr, char* str);
 static void* skygw_get_affected_tables(void* lexptr);
+static MYSQL* qc_pool_get(void);
+static bool qc_pool_put(MYSQL* mysql);
+static MYSQL* qc_mysql_init(void);
+static parsing_info_t* parsing_info_alloc(void (*donefun)(void *));
+static THD* parsing_info_get_thd(parsing_info_t* pi);
+static bool qc_cache_enabled(void);
+static unsigned int qc_cache_hash(const char* key, size_t keylen);
+static struct qc_cache_entry_st* qc_cache_lookup(
+        const char*  key,
+        size_t       keylen,
+        unsigned int hash);
+static struct qc_cache_entry_st* qc_cache_add(
+        GWBUF*       querybuf,
+        THD*         thd,
+        const char*  key,
+        size_t       keylen,
+        unsigned int hash);
+static void qc_cache_entry_release(struct qc_cache_entry_st* entry);
+static char** qc_copy_names(char** names, int n);
+static void qc_free_names(char** names, int n);
+static struct qc_cache_entry_st* get_cache_entry(GWBUF* querybuf);
+
+/**
+ * The parsing context pool
+ *
+ * Creating the THD and connecting it to the embedded server costs more than
+ * parsing a typical statement. Every thread therefore keeps a number of
+ * parsing contexts, MYSQL handles with their THDs attached, which are reset
+ * after use instead of being closed. A context is returned to the pool of
+ * the thread that frees the parsing information, which is normally the one
+ * that parsed the query.
+ */
+#define QC_POOL_MAX_FREE 32 /*< Maximum number of free contexts per thread */
+
+typedef struct qc_pool_st {
+        MYSQL*             qp_free[QC_POOL_MAX_FREE]; /*< Free contexts */
+        int                qp_nfree;    /*< Number of free contexts */
+        int                qp_reused;   /*< Contexts taken from the pool */
+        int                qp_created;  /*< Contexts created */
+        int                qp_released; /*< Contexts closed, pool full */
+        bool               qp_closed;   /*< The thread has ended, don't pool */
+        struct qc_pool_st* qp_next;     /*< All pools, for the statistics */
+} qc_pool_t;
+
+static __thread qc_pool_t* qc_thread_pool = NULL;
+static qc_pool_t*          qc_all_pools = NULL;
+static pthread_mutex_t     qc_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * The query classification cache
+ *
+ * Most of the statements that are classified differ from an earlier
+ * statement only in their literal values. The results of the classification
+ * are stored in a cache keyed by the canonical form of the query, in which
+ * the literals are replaced with question marks, and a query whose canonical
+ * form is found is not parsed at all. The parse tree is still built on demand
+ * if a function that needs it and is not served from the cache is called.
+ *
+ * The cache is divided into stripes with a lock of their own. Each stripe
+ * holds a fixed number of entries and when it is full an entry is evicted
+ * with the CLOCK algorithm. Entries are reference counted because the buffers
+ * classified with an entry may outlive its eviction.
+ */
+#define QC_CACHE_NSTRIPES       16
+#define QC_CACHE_MAX_QUERY_LEN  4096 /*< Longer queries are not cached */
+
+typedef struct qc_cache_entry_st {
+        char*              qce_key;        /*< Canonical query */
+        size_t             qce_keylen;
+        unsigned int       qce_hash;
+        int                qce_refcount;   /*< The cache and the buffers */
+        bool               qce_referenced; /*< Used since the clock hand passed */
+        skygw_query_type_t qce_type;
+        skygw_query_op_t   qce_op;
+        bool               qce_is_real;
+        bool               qce_is_drop_table;
+        bool               qce_has_clause;
+        int                qce_ntables;
+        char**             qce_tables;     /*< Table names */
+        char**             qce_fulltables; /*< Table names with database names */
+        char*              qce_fields;     /*< Affected fields or NULL */
+        int                qce_ndatabases;
+        char**             qce_databases;  /*< Database names */
+        struct qc_cache_entry_st* qce_next; /*< Next entry in the hash chain */
+} qc_cache_entry_t;
+
+typedef struct qc_cache_stripe_st {
+        pthread_mutex_t    qcs_lock;
+        qc_cache_entry_t** qcs_buckets;    /*< Hash chains, qcs_nslots of them */
+        qc_cache_entry_t** qcs_slots;      /*< The entries in clock order */
+        int                qcs_nslots;
+        int                qcs_nentries;
+        int                qcs_hand;       /*< The clock hand */
+        int                qcs_hits;
+        int                qcs_misses;
+        int                qcs_evictions;
+} qc_cache_stripe_t;
+
+static qc_cache_stripe_t* qc_cache = NULL; /*< NULL if the cache is disabled */
+static pthread_once_t     qc_cache_once = PTHREAD_ONCE_INIT;
 
 
 /**
@@ -91,7 +193,7 @@ static void* skygw_get_affected_tables(void* lexptr);
 skygw_query_type_t query_classifier_get_type(
         GWBUF* querybuf)
 {
-        MYSQL*             mysql;
+        THD*               thd;
         skygw_query_type_t qtype = QUERY_TYPE_UNKNOWN;
         bool               succp;
         
@@ -109,7 +211,7 @@ skygw_query_type_t query_classifier_get_type(
         {
                 succp = parse_query(querybuf);
         }
-        /** Read thd pointer and resolve the query type with it. */
+        /** Use the cached type or resolve the query type with thd. */
         if (succp)
         {
                 parsing_info_t* pi;
@@ -117,14 +219,18 @@ skygw_query_type_t query_classifier_get_type(
                 pi = (parsing_info_t*)gwbuf_get_buffer_object_data(querybuf, 
                                                                    GWBUF_PARSING_INFO);
                 
-                if (pi != NULL)
+                if (pi != NULL && pi->pi_cache != NULL)
+                {
+                        qtype = ((qc_cache_entry_t *)pi->pi_cache)->qce_type;
+                }
+                else if (pi != NULL)
                 {
-                        mysql = (MYSQL *)pi->pi_handle;
+                        thd = parsing_info_get_thd(pi);
 
                         /** Find out the query type */
-                        if (mysql != NULL)
+                        if (thd != NULL)
                         {
-                                qtype = resolve_query_type((THD *)mysql->thd);
+                                qtype = resolve_query_type(thd);
                         }
                 }
         }
@@ -144,10 +250,14 @@ bool parse_query (
         GWBUF* querybuf)
 {
         bool            succp;
+        bool            failp;
         THD*            thd;
         uint8_t*        data;
         size_t          len;
         char*           query_str = NULL;
+        char*           key = NULL;
+        size_t          keylen = 0;
+        unsigned int    hash = 0;
         parsing_info_t* pi;
         
         CHK_GWBUF(querybuf);
@@ -159,7 +269,7 @@ bool parse_query (
                 return false;
         }
         /** Create parsing info */
-        pi = parsing_info_init(parsing_info_done);
+        pi = parsing_info_alloc(parsing_info_done);
         
         if (pi == NULL)
         {
@@ -181,11 +291,31 @@ bool parse_query (
         memcpy(query_str, &data[5], len);
         memset(&query_str[len], 0, 1);
         parsing_info_set_plain_str(pi, query_str);
+
+        /** Use the cached classification of a query of the same form */
+        if (data[4] == MYSQL_COM_QUERY &&
+                len <= QC_CACHE_MAX_QUERY_LEN &&
+                qc_cache_enabled() &&
+                (key = (char *)malloc(CANONICAL_BUFSIZE(len))) != NULL)
+        {
+                keylen = skygw_canonicalize_query(query_str, len, key);
+                hash = qc_cache_hash(key, keylen);
+                
+                if ((pi->pi_cache = qc_cache_lookup(key, keylen, hash)) != NULL)
+                {
+                        gwbuf_add_buffer_object(querybuf, 
+                                                GWBUF_PARSING_INFO, 
+                                                (void *)pi, 
+                                                parsing_info_done);
+                        succp = true;
+                        goto retblock;
+                }
+        }
         
         /** Get one or create new THD object to be use in parsing */
-        thd = get_or_create_thd_for_parsing((MYSQL *)pi->pi_handle, query_str);
-        
-        if (thd == NULL)
+        if ((pi->pi_handle = qc_mysql_init()) == NULL ||
+                (thd = get_or_create_thd_for_parsing((MYSQL *)pi->pi_handle, 
+                                                     query_str)) == NULL)
         {
                 /** Free parsing info data */
                 parsing_info_done(pi);
@@ -196,15 +326,20 @@ bool parse_query (
          * Create parse_tree inside thd.
          * thd and lex are readable even if creating parse tree fails.
          */
-        create_parse_tree(thd);
+        failp = create_parse_tree(thd);
         /** Add complete parsing info struct to the query buffer */
         gwbuf_add_buffer_object(querybuf, 
                                 GWBUF_PARSING_INFO, 
                                 (void *)pi, 
                                 parsing_info_done);
-        
+
+        if (key != NULL && !failp)
+        {
+                pi->pi_cache = qc_cache_add(querybuf, thd, key, keylen, hash);
+        }
         succp = true;
 retblock:
+        free(key);
         return succp;
 }
 
@@ -251,12 +386,22 @@ static THD* get_or_create_thd_for_parsing(
         ss_info_dassert(query_str != NULL, ("query_str is NULL"));
 
         query_len = strlen(query_str);
+
+        if (mysql->thd != NULL)
+        {
+                /**
+                 * The handle came from the pool and is already connected.
+                 * It may have been created by another thread, the stack
+                 * checks must use the stack of this thread.
+                 */
+                thd = (THD *)mysql->thd;
+                thd->thread_stack = (char *)&thd;
+                thd->store_globals();
+                goto prepare_query;
+        }
         client_flags = set_client_flags(mysql);
         
-        /** Get THD.
-         * NOTE: Instead of creating new every time, THD instance could
-         * be get from a pool of them.
-         */
+        /** Get THD */
         thd = (THD *)create_embedded_thd(client_flags);
 
         if (thd == NULL) {
@@ -277,6 +422,8 @@ static THD* get_or_create_thd_for_parsing(
                         "Exiting.")));
                 goto return_err_with_thd;
         }
+
+prepare_query:
         thd->clear_data_list();
 
         /** Check that we are calling the client functions in right order */
@@ -970,7 +1117,6 @@ LEX* get_lex(GWBUF* querybuf)
 {
 
 	parsing_info_t* pi;
-	MYSQL*          mysql;
 	THD*            thd;
 		
 	if (querybuf == NULL || !GWBUF_IS_PARSED(querybuf))
@@ -985,10 +1131,9 @@ LEX* get_lex(GWBUF* querybuf)
 		return NULL;
 	}
 		
-	if ((mysql = (MYSQL *)pi->pi_handle) == NULL || 
-		(thd = (THD *)mysql->thd) == NULL)
+	if ((thd = parsing_info_get_thd(pi)) == NULL)
 	{
-		ss_dassert(mysql != NULL && thd != NULL);
+		ss_dassert(thd != NULL);
 		return NULL;
 	}
 	return thd->lex;
@@ -1034,6 +1179,15 @@ char** skygw_get_table_names(GWBUF* querybuf, int* tblsize, bool fullnames)
 			currtblsz = 0;
 	char		**tables = NULL,
 			**tmp = NULL;
+	qc_cache_entry_t* entry;
+
+	if (tblsize != NULL && (entry = get_cache_entry(querybuf)) != NULL)
+	{
+		tables = qc_copy_names(fullnames ? entry->qce_fulltables : entry->qce_tables,
+				       entry->qce_ntables);
+		i = (tables != NULL ? entry->qce_ntables : 0);
+		goto retblock;
+	}
 
 	if(querybuf == NULL || 
 		tblsize == NULL || 
@@ -1149,6 +1303,13 @@ bool skygw_is_real_query(GWBUF* querybuf)
 {
 	bool succp;
 	LEX* lex;
+	qc_cache_entry_t* entry;
+	
+	if ((entry = get_cache_entry(querybuf)) != NULL)
+	{
+		succp = entry->qce_is_real;
+		goto retblock;
+	}
 	
 	if (querybuf == NULL ||
 		(lex = get_lex(querybuf)) == NULL)
@@ -1191,7 +1352,12 @@ retblock:
 bool is_drop_table_query(GWBUF* querybuf)
 {
 	LEX* lex;
-        
+	qc_cache_entry_t* entry;
+	
+	if ((entry = get_cache_entry(querybuf)) != NULL)
+	{
+		return entry->qce_is_drop_table;
+	}
 	return (querybuf != NULL &&
 		(lex = get_lex(querybuf)) != NULL &&
 		lex->sql_command == SQLCOM_DROP_TABLE);
@@ -1239,10 +1405,16 @@ char* skygw_get_affected_fields(GWBUF* buf)
 	Item* item;
 	Item::Type itype;	
 
+	qc_cache_entry_t* entry;
+
 	if(!query_is_parsed(buf)){
 		parse_query(buf);
 	}
 
+	if((entry = get_cache_entry(buf)) != NULL){
+		return entry->qce_fields ? strdup(entry->qce_fields) : NULL;
+	}
+
 	if((lex = get_lex(buf)) == NULL){
 		return NULL;
 	}
@@ -1301,11 +1473,16 @@ bool skygw_query_has_clause(GWBUF* buf)
 	LEX* lex;
 	SELECT_LEX* current;
 	bool clause = false;
+	qc_cache_entry_t* entry;
 	
 	if(!query_is_parsed(buf)){
 		parse_query(buf);
 	}
 
+	if((entry = get_cache_entry(buf)) != NULL){
+		return entry->qce_has_clause;
+	}
+
 	if((lex = get_lex(buf)) == NULL){
 		return false;
 	}
@@ -1330,108 +1507,61 @@ bool skygw_query_has_clause(GWBUF* buf)
  * @param querybuf      GWBUF buffer including necessary parsing info
  * 
  * @return Copy of querystr where literals are replaces with question marks or
- * NULL if querystr is NULL, thread context or lex are NULL or if replacement
- * function fails.
+ * NULL if querystr is NULL or if memory allocation fails.
  * 
- * Replaced literal types are STRING_ITEM,INT_ITEM,DECIMAL_ITEM,REAL_ITEM,
- * VARBIN_ITEM,NULL_ITEM
+ * The query is canonicalized in a single pass over the query text with
+ * skygw_canonicalize_query, the parse tree is not used. Replaced literals
+ * are strings, numbers, hexadecimal and bit values and NULL values.
  */
 char* skygw_get_canonical(
         GWBUF* querybuf)
 {
         parsing_info_t* pi;
-        MYSQL*          mysql;
-        THD*            thd;
-        LEX*            lex;
-        Item*           item;
-        char*           querystr;
+        char*           querystr = NULL;
+        size_t          len;
         
         if (querybuf == NULL ||
 		!GWBUF_IS_PARSED(querybuf))
         {
-                querystr = NULL;
                 goto retblock;
         }
         pi = (parsing_info_t *)gwbuf_get_buffer_object_data(querybuf, 
                                                             GWBUF_PARSING_INFO);
 	CHK_PARSING_INFO(pi);
 	
-        if (pi == NULL)
+        if (pi == NULL || pi->pi_query_plain_str == NULL)
         {
-                querystr = NULL;
+                ss_dassert(pi != NULL && pi->pi_query_plain_str != NULL);
                 goto retblock;                
         }
+        len = strlen(pi->pi_query_plain_str);
         
-        if (pi->pi_query_plain_str == NULL || 
-                (mysql = (MYSQL *)pi->pi_handle) == NULL || 
-                (thd = (THD *)mysql->thd) == NULL ||
-                (lex = thd->lex) == NULL)
+        if ((querystr = (char *)malloc(CANONICAL_BUFSIZE(len))) != NULL)
         {
-                ss_dassert(pi->pi_query_plain_str != NULL &&
-                        mysql != NULL && 
-                        thd != NULL && 
-                        lex != NULL);
-                querystr = NULL;
-                goto retblock;
+                skygw_canonicalize_query(pi->pi_query_plain_str, len, querystr);
         }
-        querystr = strdup(pi->pi_query_plain_str);
-
-	for (item=thd->free_list; item != NULL; item=item->next) 
-        {
-                Item::Type itype;
-                
-		if (item->name == NULL)
-		{
-			continue;
-		}
-		itype = item->type();
-
-		if (itype == Item::STRING_ITEM)
-		{
-			String tokenstr;
-			String* res = item->val_str_ascii(&tokenstr);
-			
-			if (res->is_empty()) /*< empty string */
-			{
-				querystr = replace_literal(querystr, "\"\"", "\"?\"");
-			}
-			else
-			{
-				querystr = replace_literal(querystr, res->ptr(), "?");
-			}
-		}
-		else if (itype == Item::INT_ITEM ||
-			itype == Item::DECIMAL_ITEM ||
-			itype == Item::REAL_ITEM ||
-			itype == Item::VARBIN_ITEM ||
-			itype == Item::NULL_ITEM)
-		{
-			querystr = replace_literal(querystr, item->name, "?");
-		}
-        } /*< for */
 retblock:
         return querystr;
 }
 
 
 /**
- * Create parsing information; initialize mysql handle, allocate parsing info 
- * struct and set handle and free function pointer to it.
- * 
- * @param donefun       pointer to free function
+ * Get a MYSQL handle for parsing, either a connected one from the pool of
+ * the calling thread or a new one.
  * 
- * @return pointer to parsing information
+ * @return MYSQL handle or NULL if it could not be created
  */
-parsing_info_t* parsing_info_init(
-        void (*donefun)(void *))
+static MYSQL* qc_mysql_init(void)
 {
-        parsing_info_t* pi = NULL;
         MYSQL*          mysql;
         const char*     user  = "skygw";
         const char*     db    = "skygw";
         
-        ss_dassert(donefun != NULL);
-        
+        /** Reuse a handle from the pool if possible */
+        if ((mysql = qc_pool_get()) != NULL)
+        {
+                return mysql;
+        }
         /** Get server handle */
         mysql = mysql_init(NULL);
         ss_dassert(mysql != NULL);
@@ -1443,7 +1573,7 @@ parsing_info_t* parsing_info_init(
                         mysql_errno(mysql),
 			mysql_error(mysql))));
                 
-                goto retblock;
+                return NULL;
         }
         /** Set methods and authentication to mysql */
         mysql_options(mysql, MYSQL_READ_DEFAULT_GROUP, "libmysqld_skygw");
@@ -1453,25 +1583,90 @@ parsing_info_t* parsing_info_init(
         mysql->db      = my_strdup(db, MYF(0));
         mysql->passwd  = NULL;
         
+        return mysql;
+}
+
+/**
+ * Allocate parsing information without a MYSQL handle.
+ * 
+ * @param donefun       pointer to free function
+ * 
+ * @return pointer to parsing information or NULL
+ */
+static parsing_info_t* parsing_info_alloc(
+        void (*donefun)(void *))
+{
+        parsing_info_t* pi;
+        
+        ss_dassert(donefun != NULL);
         pi = (parsing_info_t*)calloc(1, sizeof(parsing_info_t));
         
-        if (pi == NULL)
+        if (pi != NULL)
         {
-                mysql_close(mysql);
-                goto retblock;
-        }
 #if defined(SS_DEBUG)
-        pi->pi_chk_top  = CHK_NUM_PINFO;
-        pi->pi_chk_tail = CHK_NUM_PINFO;
+                pi->pi_chk_top  = CHK_NUM_PINFO;
+                pi->pi_chk_tail = CHK_NUM_PINFO;
 #endif
-        /** Set handle and free function to parsing info struct */
-        pi->pi_handle = mysql;
-        pi->pi_done_fp = donefun;
+                pi->pi_done_fp = donefun;
+        }
+        return pi;
+}
+
+/**
+ * Create parsing information; initialize mysql handle, allocate parsing info 
+ * struct and set handle and free function pointer to it.
+ * 
+ * @param donefun       pointer to free function
+ * 
+ * @return pointer to parsing information
+ */
+parsing_info_t* parsing_info_init(
+        void (*donefun)(void *))
+{
+        parsing_info_t* pi;
         
-retblock:
+        if ((pi = parsing_info_alloc(donefun)) != NULL &&
+                (pi->pi_handle = qc_mysql_init()) == NULL)
+        {
+                free(pi);
+                pi = NULL;
+        }
         return pi;
 }
 
+/**
+ * Return the thread context holding the parse tree of the query. If the
+ * query was classified with a cache entry, the query is parsed now.
+ * 
+ * @param pi    Parsing information
+ * 
+ * @return Thread context or NULL if the query could not be parsed
+ */
+static THD* parsing_info_get_thd(
+        parsing_info_t* pi)
+{
+        MYSQL* mysql;
+        THD*   thd;
+        
+        if (pi->pi_handle == NULL)
+        {
+                if (pi->pi_query_plain_str == NULL ||
+                        (pi->pi_handle = qc_mysql_init()) == NULL)
+                {
+                        return NULL;
+                }
+                thd = get_or_create_thd_for_parsing((MYSQL *)pi->pi_handle, 
+                                                    pi->pi_query_plain_str);
+                if (thd != NULL)
+                {
+                        create_parse_tree(thd);
+                }
+                return thd;
+        }
+        mysql = (MYSQL *)pi->pi_handle;
+        return (THD *)mysql->thd;
+}
+
 /**
  * Free function for parsing info. Called by gwbuf_free or in case initialization
  * of parsing information fails.
@@ -1490,7 +1685,11 @@ void parsing_info_done(
 	{
 		pi = (parsing_info_t *)ptr;
         
-		if (pi->pi_handle != NULL)
+		if (pi->pi_cache != NULL)
+		{
+			qc_cache_entry_release((qc_cache_entry_t *)pi->pi_cache);
+		}
+		if (pi->pi_handle != NULL && !qc_pool_put((MYSQL *)pi->pi_handle))
 		{
 			MYSQL* mysql = (MYSQL *)pi->pi_handle;
 			
@@ -1510,6 +1709,529 @@ void parsing_info_done(
 	}
 }
 
+/**
+ * Close the parsing contexts in the pool of the calling thread. This must be
+ * called by every thread that classifies queries before it calls
+ * mysql_thread_end, the THDs can't be freed after that. The pool itself is
+ * kept in the list of all pools so that its statistics remain, contexts
+ * released by the thread later are closed instead of pooled.
+ */
+void query_classifier_thread_end(void)
+{
+        qc_pool_t* pool = qc_thread_pool;
+        
+        if (pool == NULL)
+        {
+                return;
+        }
+        pool->qp_closed = true;
+        
+        while (pool->qp_nfree > 0)
+        {
+                MYSQL* mysql = pool->qp_free[--pool->qp_nfree];
+                THD*   thd = (THD *)mysql->thd;
+                
+                thd->thread_stack = (char *)&thd;
+                thd->store_globals();
+                (*mysql->methods->free_embedded_thd)(mysql);
+                mysql->thd = NULL;
+                mysql_close(mysql);
+        }
+}
+
+/**
+ * Return the parsing context pool of the calling thread, creating it on
+ * first use.
+ * 
+ * @return The pool or NULL if it could not be allocated
+ */
+static qc_pool_t* qc_pool_get_thread_pool(void)
+{
+        if (qc_thread_pool == NULL)
+        {
+                if ((qc_thread_pool = (qc_pool_t *)calloc(1, sizeof(qc_pool_t))) == NULL)
+                {
+                        return NULL;
+                }
+                pthread_mutex_lock(&qc_pool_lock);
+                qc_thread_pool->qp_next = qc_all_pools;
+                qc_all_pools = qc_thread_pool;
+                pthread_mutex_unlock(&qc_pool_lock);
+        }
+        return qc_thread_pool;
+}
+
+/**
+ * Take a connected parsing context from the pool of the calling thread.
+ * 
+ * @return MYSQL handle with a THD attached or NULL if the pool is empty
+ */
+static MYSQL* qc_pool_get(void)
+{
+        qc_pool_t* pool = qc_pool_get_thread_pool();
+        
+        if (pool == NULL)
+        {
+                return NULL;
+        }
+        if (pool->qp_nfree == 0)
+        {
+                pool->qp_created += 1;
+                return NULL;
+        }
+        pool->qp_reused += 1;
+        return pool->qp_free[--pool->qp_nfree];
+}
+
+/**
+ * Reset a parsing context and return it to the pool of the calling thread.
+ * The parse tree of the previous statement is released so that the THD is
+ * in the same state as after the connection was made.
+ * 
+ * @param mysql MYSQL handle of the context
+ * 
+ * @return true if the context was pooled, false if the caller has to close it
+ */
+static bool qc_pool_put(
+        MYSQL* mysql)
+{
+        qc_pool_t* pool;
+        THD*       thd = (THD *)mysql->thd;
+        
+        if (thd == NULL || (pool = qc_pool_get_thread_pool()) == NULL)
+        {
+                return false;
+        }
+        if (pool->qp_closed || pool->qp_nfree == QC_POOL_MAX_FREE)
+        {
+                pool->qp_released += 1;
+                return false;
+        }
+        thd->thread_stack = (char *)&thd;
+        thd->store_globals();
+        thd->end_statement();
+        thd->cleanup_after_query();
+        free_root(thd->mem_root, MYF(MY_KEEP_PREALLOC));
+        /** The query string belongs to the parsing info being freed */
+        thd->extra_data = NULL;
+        thd->extra_length = 0;
+        
+        pool->qp_free[pool->qp_nfree++] = mysql;
+        return true;
+}
+
+/**
+ * Report the parsing context pool statistics, summed over all the threads.
+ * 
+ * @param reporter      The function called for each statistic
+ * @param hdl           The handle passed to the reporter
+ */
+void query_classifier_pool_stats(
+        void (*reporter)(void *, char *, int),
+        void* hdl)
+{
+        qc_pool_t* pool;
+        int        nfree = 0;
+        int        reused = 0;
+        int        created = 0;
+        int        released = 0;
+        
+        pthread_mutex_lock(&qc_pool_lock);
+        for (pool = qc_all_pools; pool != NULL; pool = pool->qp_next)
+        {
+                nfree += pool->qp_nfree;
+                reused += pool->qp_reused;
+                created += pool->qp_created;
+                released += pool->qp_released;
+        }
+        pthread_mutex_unlock(&qc_pool_lock);
+        
+        reporter(hdl, (char *)"Parsing contexts in pools", nfree);
+        reporter(hdl, (char *)"Parsing contexts reused", reused);
+        reporter(hdl, (char *)"Parsing contexts created", created);
+        reporter(hdl, (char *)"Parsing contexts closed, pool full", released);
+}
+
+/**
+ * Create the query classification cache if it is enabled in the
+ * configuration.
+ */
+static void qc_cache_init(void)
+{
+        qc_cache_stripe_t* cache;
+        int                size = config_qc_cache_size();
+        int                nslots;
+        int                i;
+        
+        if (size <= 0)
+        {
+                return;
+        }
+        nslots = (size > QC_CACHE_NSTRIPES ? size / QC_CACHE_NSTRIPES : 1);
+        
+        if ((cache = (qc_cache_stripe_t *)calloc(QC_CACHE_NSTRIPES, 
+                                                 sizeof(qc_cache_stripe_t))) == NULL)
+        {
+                goto return_err;
+        }
+        for (i = 0; i < QC_CACHE_NSTRIPES; i++)
+        {
+                pthread_mutex_init(&cache[i].qcs_lock, NULL);
+                cache[i].qcs_nslots = nslots;
+                cache[i].qcs_buckets = (qc_cache_entry_t **)calloc(
+                        nslots, sizeof(qc_cache_entry_t *));
+                cache[i].qcs_slots = (qc_cache_entry_t **)calloc(
+                        nslots, sizeof(qc_cache_entry_t *));
+                
+                if (cache[i].qcs_buckets == NULL || cache[i].qcs_slots == NULL)
+                {
+                        /** Memory of the stripes is not released, nothing else is */
+                        goto return_err;
+                }
+        }
+        qc_cache = cache;
+        return;
+        
+return_err:
+        LOGIF(LE, (skygw_log_write_flush(
+                LOGFILE_ERROR,
+                "Error : Failed to allocate the query classification cache "
+                "of %d entries, the cache is disabled.",
+                size)));
+}
+
+/**
+ * Check whether the query classification cache is in use, creating it
+ * on first use.
+ * 
+ * @return true if the cache is enabled
+ */
+static bool qc_cache_enabled(void)
+{
+        pthread_once(&qc_cache_once, qc_cache_init);
+        return qc_cache != NULL;
+}
+
+/**
+ * Calculate the hash value of a canonical query, FNV-1a.
+ * 
+ * @param key           The canonical query
+ * @param keylen        Length of the query
+ * 
+ * @return The hash value
+ */
+static unsigned int qc_cache_hash(
+        const char* key,
+        size_t      keylen)
+{
+        unsigned int hash = 2166136261U;
+        size_t       i;
+        
+        for (i = 0; i < keylen; i++)
+        {
+                hash = (hash ^ (unsigned char)key[i]) * 16777619U;
+        }
+        return hash;
+}
+
+/**
+ * Find a cache entry by the canonical form of a query. The entry that is
+ * returned is referenced by the caller and must be released with
+ * qc_cache_entry_release.
+ * 
+ * @param key           The canonical query
+ * @param keylen        Length of the query
+ * @param hash          Hash value of the query
+ * 
+ * @return The cache entry or NULL if it was not found
+ */
+static qc_cache_entry_t* qc_cache_lookup(
+        const char*  key,
+        size_t       keylen,
+        unsigned int hash)
+{
+        qc_cache_stripe_t* stripe = &qc_cache[hash % QC_CACHE_NSTRIPES];
+        qc_cache_entry_t*  entry;
+        
+        pthread_mutex_lock(&stripe->qcs_lock);
+        entry = stripe->qcs_buckets[(hash / QC_CACHE_NSTRIPES) % stripe->qcs_nslots];
+        
+        while (entry != NULL &&
+                (entry->qce_hash != hash ||
+                 entry->qce_keylen != keylen ||
+                 memcmp(entry->qce_key, key, keylen) != 0))
+        {
+                entry = entry->qce_next;
+        }
+        
+        if (entry != NULL)
+        {
+                entry->qce_referenced = true;
+                __sync_fetch_and_add(&entry->qce_refcount, 1);
+                stripe->qcs_hits += 1;
+        }
+        else
+        {
+                stripe->qcs_misses += 1;
+        }
+        pthread_mutex_unlock(&stripe->qcs_lock);
+        return entry;
+}
+
+/**
+ * Release a reference to a cache entry and free the entry when the last
+ * reference is released.
+ * 
+ * @param entry The cache entry
+ */
+static void qc_cache_entry_release(
+        qc_cache_entry_t* entry)
+{
+        if (__sync_sub_and_fetch(&entry->qce_refcount, 1) > 0)
+        {
+                return;
+        }
+        qc_free_names(entry->qce_tables, entry->qce_ntables);
+        qc_free_names(entry->qce_fulltables, entry->qce_ntables);
+        qc_free_names(entry->qce_databases, entry->qce_ndatabases);
+        free(entry->qce_fields);
+        free(entry->qce_key);
+        free(entry);
+}
+
+/**
+ * Classify a parsed query and store the results in the cache. Statements
+ * whose classification depends on their literal values are not cached.
+ * The entry that is returned is referenced by the caller.
+ * 
+ * @param querybuf      Buffer with the parsed query
+ * @param thd           Thread context with the parse tree
+ * @param key           The canonical query
+ * @param keylen        Length of the query
+ * @param hash          Hash value of the query
+ * 
+ * @return The cache entry or NULL if the query was not cached
+ */
+static qc_cache_entry_t* qc_cache_add(
+        GWBUF*       querybuf,
+        THD*         thd,
+        const char*  key,
+        size_t       keylen,
+        unsigned int hash)
+{
+        qc_cache_stripe_t* stripe = &qc_cache[hash % QC_CACHE_NSTRIPES];
+        qc_cache_entry_t*  entry;
+        qc_cache_entry_t*  old;
+        qc_cache_entry_t** p_entry;
+        int                ntables;
+        int                slot;
+        
+        if (thd->lex->sql_command == SQLCOM_SET_OPTION ||
+                thd->lex->sql_command == SQLCOM_PREPARE)
+        {
+                return NULL;
+        }
+        if ((entry = (qc_cache_entry_t *)calloc(1, sizeof(qc_cache_entry_t))) == NULL ||
+                (entry->qce_key = (char *)malloc(keylen + 1)) == NULL)
+        {
+                free(entry);
+                return NULL;
+        }
+        memcpy(entry->qce_key, key, keylen + 1);
+        entry->qce_keylen = keylen;
+        entry->qce_hash = hash;
+        entry->qce_refcount = 2; /*< The cache and the caller */
+        entry->qce_type = resolve_query_type(thd);
+        entry->qce_op = query_classifier_get_operation(querybuf);
+        entry->qce_is_real = skygw_is_real_query(querybuf);
+        entry->qce_is_drop_table = is_drop_table_query(querybuf);
+        entry->qce_has_clause = skygw_query_has_clause(querybuf);
+        entry->qce_tables = skygw_get_table_names(querybuf, &entry->qce_ntables, false);
+        entry->qce_fulltables = skygw_get_table_names(querybuf, &ntables, true);
+        entry->qce_databases = skygw_get_database_names(querybuf, &entry->qce_ndatabases);
+        entry->qce_fields = skygw_get_affected_fields(querybuf);
+
+        if (ntables != entry->qce_ntables)
+        {
+                /** A failed allocation, don't cache an incomplete result */
+                qc_free_names(entry->qce_fulltables, ntables);
+                entry->qce_fulltables = NULL;
+                entry->qce_ntables = 0;
+                entry->qce_refcount = 1;
+                qc_cache_entry_release(entry);
+                return NULL;
+        }
+        pthread_mutex_lock(&stripe->qcs_lock);
+        p_entry = &stripe->qcs_buckets[(hash / QC_CACHE_NSTRIPES) % stripe->qcs_nslots];
+        
+        for (old = *p_entry; old != NULL; old = old->qce_next)
+        {
+                if (old->qce_hash == hash && 
+                        old->qce_keylen == keylen &&
+                        memcmp(old->qce_key, key, keylen) == 0)
+                {
+                        /** Another thread added the same query */
+                        __sync_fetch_and_add(&old->qce_refcount, 1);
+                        pthread_mutex_unlock(&stripe->qcs_lock);
+                        entry->qce_refcount = 1;
+                        qc_cache_entry_release(entry);
+                        return old;
+                }
+        }
+        
+        if (stripe->qcs_nentries < stripe->qcs_nslots)
+        {
+                slot = stripe->qcs_nentries++;
+        }
+        else
+        {
+                qc_cache_entry_t** p_old;
+                
+                /** Give the recently used entries a second chance */
+                while (stripe->qcs_slots[stripe->qcs_hand]->qce_referenced)
+                {
+                        stripe->qcs_slots[stripe->qcs_hand]->qce_referenced = false;
+                        stripe->qcs_hand = (stripe->qcs_hand + 1) % stripe->qcs_nslots;
+                }
+                slot = stripe->qcs_hand;
+                stripe->qcs_hand = (stripe->qcs_hand + 1) % stripe->qcs_nslots;
+                old = stripe->qcs_slots[slot];
+                p_old = &stripe->qcs_buckets[(old->qce_hash / QC_CACHE_NSTRIPES) % 
+                                             stripe->qcs_nslots];
+                
+                while (*p_old != old)
+                {
+                        p_old = &(*p_old)->qce_next;
+                }
+                *p_old = old->qce_next;
+                stripe->qcs_evictions += 1;
+                qc_cache_entry_release(old);
+        }
+        stripe->qcs_slots[slot] = entry;
+        entry->qce_next = *p_entry;
+        *p_entry = entry;
+        pthread_mutex_unlock(&stripe->qcs_lock);
+        
+        return entry;
+}
+
+/**
+ * Copy an array of names.
+ * 
+ * @param names Array of names
+ * @param n     Number of names
+ * 
+ * @return Newly allocated copy of the array or NULL if there are no names
+ */
+static char** qc_copy_names(
+        char** names,
+        int    n)
+{
+        char** copy;
+        int    i;
+        
+        if (n <= 0 || (copy = (char **)malloc(sizeof(char *) * n)) == NULL)
+        {
+                return NULL;
+        }
+        for (i = 0; i < n; i++)
+        {
+                copy[i] = strdup(names[i]);
+        }
+        return copy;
+}
+
+/**
+ * Free an array of names.
+ * 
+ * @param names Array of names, may be NULL
+ * @param n     Number of names
+ */
+static void qc_free_names(
+        char** names,
+        int    n)
+{
+        int i;
+        
+        if (names != NULL)
+        {
+                for (i = 0; i < n; i++)
+                {
+                        free(names[i]);
+                }
+                free(names);
+        }
+}
+
+/**
+ * Return the cache entry the query in the buffer was classified with.
+ * 
+ * @param querybuf      The query buffer
+ * 
+ * @return The cache entry or NULL if the query is not parsed or the query
+ * was not cached
+ */
+static qc_cache_entry_t* get_cache_entry(
+        GWBUF* querybuf)
+{
+        parsing_info_t* pi;
+        
+        if (querybuf == NULL || !GWBUF_IS_PARSED(querybuf))
+        {
+                return NULL;
+        }
+        pi = (parsing_info_t *)gwbuf_get_buffer_object_data(querybuf, 
+                                                            GWBUF_PARSING_INFO);
+        return (pi != NULL ? (qc_cache_entry_t *)pi->pi_cache : NULL);
+}
+
+/**
+ * Return a statistic of the query classification cache.
+ * 
+ * @param stat  The statistic
+ * 
+ * @return The value of the statistic
+ */
+int query_classifier_cache_get_stat(
+        qc_cache_stat_t stat)
+{
+        int hits = 0;
+        int misses = 0;
+        int entries = 0;
+        int evictions = 0;
+        int i;
+        
+        if (!qc_cache_enabled())
+        {
+                return 0;
+        }
+        for (i = 0; i < QC_CACHE_NSTRIPES; i++)
+        {
+                pthread_mutex_lock(&qc_cache[i].qcs_lock);
+                hits += qc_cache[i].qcs_hits;
+                misses += qc_cache[i].qcs_misses;
+                entries += qc_cache[i].qcs_nentries;
+                evictions += qc_cache[i].qcs_evictions;
+                pthread_mutex_unlock(&qc_cache[i].qcs_lock);
+        }
+        
+        switch (stat)
+        {
+        case QC_CACHE_STAT_HITS:
+                return hits;
+        case QC_CACHE_STAT_MISSES:
+                return misses;
+        case QC_CACHE_STAT_ENTRIES:
+                return entries;
+        case QC_CACHE_STAT_EVICTIONS:
+                return evictions;
+        case QC_CACHE_STAT_HIT_RATIO:
+                return (hits + misses > 0 ? 
+                        (int)(100.0 * hits / (hits + misses)) : 0);
+        }
+        return 0;
+}
+
 /**
  * Add plain text query string to parsing info.
  * 
@@ -1591,6 +2313,14 @@ char** skygw_get_database_names(GWBUF* querybuf,int* size)
 	TABLE_LIST*		tbl;
 	char			**databases = NULL, **tmp = NULL;
 	int			currsz = 0,i = 0;
+	qc_cache_entry_t*	entry;
+
+	if ((entry = get_cache_entry(querybuf)) != NULL)
+	{
+		databases = qc_copy_names(entry->qce_databases, entry->qce_ndatabases);
+		i = (databases != NULL ? entry->qce_ndatabases : 0);
+		goto retblock;
+	}
 
 	if( (lex = get_lex(querybuf)) == NULL)
 	{
@@ -1632,6 +2362,12 @@ retblock:
 
 skygw_query_op_t query_classifier_get_operation(GWBUF* querybuf)
 {
+	qc_cache_entry_t* entry = get_cache_entry(querybuf);
+	
+	if (entry != NULL)
+	{
+		return entry->qce_op;
+	}
 	LEX* lex = get_lex(querybuf);
 	skygw_query_op_t operation = QUERY_OP_UNDEFINED;
 	if(lex){
@@ -85,12 +85,22 @@ typedef struct parsing_info_st {
         void*       pi_handle;		/*< parsing info object pointer */
         char*       pi_query_plain_str;	/*< query as plain string */
         void     (*pi_done_fp)(void *);	/*< clean-up function for parsing info */
+        void*       pi_cache;		/*< classification cache entry or NULL */
 #if defined(SS_DEBUG)
         skygw_chk_t pi_chk_tail;
 #endif
 } parsing_info_t;
 
 
+/** Statistics of the query classification cache */
+typedef enum {
+        QC_CACHE_STAT_HITS,
+        QC_CACHE_STAT_MISSES,
+        QC_CACHE_STAT_ENTRIES,
+        QC_CACHE_STAT_EVICTIONS,
+        QC_CACHE_STAT_HIT_RATIO    /*< Hits of all lookups, in percent */
+} qc_cache_stat_t;
+
 #define QUERY_IS_TYPE(mask,type) ((mask & type) == type)
 
 /** 
@@ -116,6 +126,9 @@ bool			skygw_query_has_clause(GWBUF* buf);
 char*           skygw_get_qtype_str(skygw_query_type_t qtype);
 char*			skygw_get_affected_fields(GWBUF* buf);
 char** skygw_get_database_names(GWBUF* querybuf,int* size);
+void            query_classifier_pool_stats(void (*reporter)(void *, char *, int), void* hdl);
+void            query_classifier_thread_end(void);
+int             query_classifier_cache_get_stat(qc_cache_stat_t stat);
 
 EXTERN_C_BLOCK_END
 
@@ -0,0 +1,106 @@
+/**
+ * Micro-benchmark of query canonicalization
+ *
+ * Compares the single pass canonicalization of skygw_canonicalize_query with
+ * replacing the literals one at a time with replace_literal, which is what
+ * skygw_get_canonical used to do for every literal of the parse tree. The
+ * query is a multi-row INSERT where both methods must produce the same
+ * canonical query.
+ *
+ * Usage: canonbench [rows] [iterations]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <skygw_utils.h>
+
+static double
+elapsed(struct timespec *start, struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) +
+		(end->tv_nsec - start->tv_nsec) / 1000000000.0;
+}
+
+int main(int argc, char** argv)
+{
+	int		rows = argc > 1 ? atoi(argv[1]) : 500;
+	int		iterations = argc > 2 ? atoi(argv[2]) : 10;
+	char		**literals;
+	char		*query, *ptr, *canon_old = NULL, *canon_new = NULL;
+	size_t		len;
+	int		i, n, nliterals = rows * 3;
+	struct timespec	start, end;
+	double		t_old, t_new;
+
+	if (rows <= 0 || iterations <= 0)
+	{
+		printf("Usage: canonbench [rows] [iterations]\n");
+		return 1;
+	}
+	query = malloc(64 + rows * 64);
+	literals = malloc(sizeof(char *) * nliterals);
+
+	ptr = query + sprintf(query, "insert into tst values ");
+
+	for (i = 0; i < rows; i++)
+	{
+		ptr += sprintf(ptr, "%s(%d,\"name%d\",%d.25)",
+			       i > 0 ? "," : "", i + 1, i + 1, i + 1);
+		literals[i * 3] = malloc(16);
+		literals[i * 3 + 1] = malloc(16);
+		literals[i * 3 + 2] = malloc(16);
+		sprintf(literals[i * 3], "%d", i + 1);
+		sprintf(literals[i * 3 + 1], "name%d", i + 1);
+		sprintf(literals[i * 3 + 2], "%d.25", i + 1);
+	}
+	len = strlen(query);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (n = 0; n < iterations; n++)
+	{
+		free(canon_old);
+		canon_old = strdup(query);
+
+		for (i = 0; i < nliterals; i++)
+		{
+			canon_old = replace_literal(canon_old, literals[i], "?");
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	t_old = elapsed(&start, &end);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (n = 0; n < iterations; n++)
+	{
+		free(canon_new);
+		canon_new = malloc(CANONICAL_BUFSIZE(len));
+		skygw_canonicalize_query(query, len, canon_new);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	t_new = elapsed(&start, &end);
+
+	printf("Query of %d rows, %lu bytes, %d iterations\n",
+	       rows, (unsigned long)len, iterations);
+	printf("replace_literal per literal: %10.3f ms per query\n",
+	       t_old * 1000 / iterations);
+	printf("single pass:                 %10.3f ms per query\n",
+	       t_new * 1000 / iterations);
+
+	if (strcmp(canon_old, canon_new) != 0)
+	{
+		printf("Error: The canonical queries differ:\n%s\n%s\n",
+		       canon_old, canon_new);
+		return 1;
+	}
+
+	for (i = 0; i < nliterals; i++)
+	{
+		free(literals[i]);
+	}
+	free(literals);
+	free(canon_old);
+	free(canon_new);
+	free(query);
+	return 0;
+}
@@ -9,10 +9,14 @@ select * from tst where fname like '?';
 select * from tst where lname like '?' order by fname;
 insert into tst values ("?","?"),("?",?),("?","?");
 drop table if exists tst;
-create table tst(fname varchar(30), lname varchar(30));
+create table tst(fname varchar(?), lname varchar(?));
 update tst set lname="?" where fname like '?' or lname like '?';
 delete from tst where lname like '?' and fname like '?';
 select ? from tst where fname='?' or lname like '?';
 select ?,?,?,? from tst where name='?' or name='?' or name='?' or name='?';
+select * from t1 where a = '?' and b = "?";
+select ?, ?, ?, ?, -? from t2 /* comment 5 */;
+select * from `tbl 1` where x is null and y = ? # trailing 7
+insert into t3 values (?,'?',?),(?,'?',?);
 select count(?),count(?),count(?),count(?),count (?),count(?) from tst;
 select count(?),count(?),count(?),count(?),count (?),count(?) from tst;
@@ -14,4 +14,8 @@ update tst set lname="Human" where fname like '%a%' or lname like '%a%';
 delete from tst where lname like '%man%' and fname like '%ard%';
 select 100 from tst where fname='10' or lname like '%100%';
 select 1,20,300,4000 from tst where name='1000' or name='200' or name='30' or name='4';
+select * from t1 where a = 'it''s' and b = "say \"hi\"";
+select 0x1F, X'4D', b'101', 1.5e10, -3.25 from t2 /* comment 5 */;
+select * from `tbl 1` where x is null and y = null # trailing 7
+insert into t3 values (1,'a',NULL),(2,'',NULL);
 select count(1),count(10),count(100),count(2),count (20),count(200) from tst;
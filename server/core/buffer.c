@@ -46,6 +46,8 @@
 #include <hint.h>
 #include <log_manager.h>
 #include <errno.h>
+#include <pthread.h>
+#include <gw.h>
 
 /** Defined in log_manager.cc */
 extern int            lm_enabled_logfiles_bitmask;
@@ -56,13 +58,286 @@ static buffer_object_t* gwbuf_remove_buffer_object(
         GWBUF*           buf,
         buffer_object_t* bufobj);
 
+/**
+ * The buffer pool
+ *
+ * Every thread keeps free lists of recently released GWBUF headers and shared
+ * buffers so that the common allocations are satisfied without calling malloc.
+ * The shared buffer and its data area are allocated as a single block of one
+ * of the size classes below, requests larger than the largest class are passed
+ * to malloc. A block may be released by a thread other than the one that
+ * allocated it, in which case it ends up in the free list of the releasing
+ * thread. The number of free blocks kept per class is limited so that each
+ * thread holds at most GWBUF_POOL_MAX_BYTES of free memory in each class.
+ */
+#define	GWBUF_POOL_HEADER	0	/*< The size class of GWBUF headers */
+#define	GWBUF_POOL_NCLASSES	7	/*< Number of size classes */
+#define	GWBUF_POOL_MAX_BYTES	(256 * 1024)
+#define	GWBUF_POOL_MIN_FREE	16	/*< Minimum free list length limit */
+
+/** Data area sizes of the shared buffer size classes */
+static const unsigned int pool_data_sizes[GWBUF_POOL_NCLASSES] = {
+	0, 64, 256, 1024, 4096, 16384, MAX_BUFFER_SIZE
+};
+
+typedef struct pool_block {
+	struct pool_block	*next;
+} POOL_BLOCK;
+
+typedef struct gwbuf_pool {
+	POOL_BLOCK	*freelist[GWBUF_POOL_NCLASSES]; /*< Free blocks */
+	int		n_free[GWBUF_POOL_NCLASSES];	 /*< Length of free lists */
+	int		hits[GWBUF_POOL_NCLASSES];	 /*< From the free list */
+	int		misses[GWBUF_POOL_NCLASSES];	 /*< From malloc */
+	int		overflows[GWBUF_POOL_NCLASSES];	 /*< Freed, list full */
+	struct gwbuf_pool *next;	/*< All pools, for the statistics */
+} GWBUF_POOL;
+
+static __thread GWBUF_POOL	*thread_pool = NULL;
+static GWBUF_POOL		*all_pools = NULL;
+static SPINLOCK			pool_lock = SPINLOCK_INIT;
+static pthread_key_t		pool_key;
+static pthread_once_t		pool_key_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Return the size of the blocks of a size class
+ *
+ * @param pclass	The size class
+ * @return The block size in bytes
+ */
+static size_t
+pool_block_size(int pclass)
+{
+	if (pclass == GWBUF_POOL_HEADER)
+		return sizeof(GWBUF);
+	return sizeof(SHARED_BUF) + pool_data_sizes[pclass];
+}
+
+/**
+ * Return the smallest size class that can hold a data area of the given size
+ *
+ * @param size	The data area size
+ * @return The size class or -1 if the size is larger than any class
+ */
+static int
+pool_class_for_size(unsigned int size)
+{
+int	i;
+
+	for (i = GWBUF_POOL_HEADER + 1; i < GWBUF_POOL_NCLASSES; i++)
+	{
+		if (size <= pool_data_sizes[i])
+			return i;
+	}
+	return -1;
+}
+
+/**
+ * Release the free blocks of a thread's pool when the thread exits. The pool
+ * itself is kept in the list of all pools so that its statistics remain.
+ *
+ * @param data	The pool of the exiting thread
+ */
+static void
+pool_thread_exit(void *data)
+{
+GWBUF_POOL	*pool = (GWBUF_POOL *)data;
+POOL_BLOCK	*block;
+int		i;
+
+	for (i = 0; i < GWBUF_POOL_NCLASSES; i++)
+	{
+		while ((block = pool->freelist[i]) != NULL)
+		{
+			pool->freelist[i] = block->next;
+			free(block);
+		}
+		pool->n_free[i] = 0;
+	}
+}
+
+static void
+pool_key_init()
+{
+	pthread_key_create(&pool_key, pool_thread_exit);
+}
+
+/**
+ * Return the pool of the calling thread, creating it on first use
+ *
+ * @return The pool or NULL if it could not be allocated
+ */
+static GWBUF_POOL *
+pool_get()
+{
+	if (thread_pool == NULL)
+	{
+		if ((thread_pool = calloc(1, sizeof(GWBUF_POOL))) == NULL)
+			return NULL;
+		pthread_once(&pool_key_once, pool_key_init);
+		pthread_setspecific(pool_key, thread_pool);
+		spinlock_acquire(&pool_lock);
+		thread_pool->next = all_pools;
+		all_pools = thread_pool;
+		spinlock_release(&pool_lock);
+	}
+	return thread_pool;
+}
+
+/**
+ * Allocate a block of a size class, from the free list of the calling thread
+ * if possible.
+ *
+ * @param pclass	The size class
+ * @return The block or NULL if memory could not be allocated
+ */
+static void *
+pool_alloc(int pclass)
+{
+GWBUF_POOL	*pool = pool_get();
+POOL_BLOCK	*block;
+
+	if (pool && (block = pool->freelist[pclass]) != NULL)
+	{
+		pool->freelist[pclass] = block->next;
+		pool->n_free[pclass]--;
+		pool->hits[pclass]++;
+		return block;
+	}
+	if (pool)
+		pool->misses[pclass]++;
+	return malloc(pool_block_size(pclass));
+}
+
+/**
+ * Return a block to the free list of the calling thread or to the system
+ * if the free list is full.
+ *
+ * @param pclass	The size class of the block
+ * @param ptr		The block
+ */
+static void
+pool_free(int pclass, void *ptr)
+{
+GWBUF_POOL	*pool = pool_get();
+POOL_BLOCK	*block = (POOL_BLOCK *)ptr;
+int		max_free;
+
+	max_free = GWBUF_POOL_MAX_BYTES / pool_block_size(pclass);
+	if (max_free < GWBUF_POOL_MIN_FREE)
+		max_free = GWBUF_POOL_MIN_FREE;
+
+	if (pool == NULL || pool->n_free[pclass] >= max_free)
+	{
+		if (pool)
+			pool->overflows[pclass]++;
+		free(ptr);
+		return;
+	}
+	block->next = pool->freelist[pclass];
+	pool->freelist[pclass] = block;
+	pool->n_free[pclass]++;
+}
+
+/**
+ * Allocate a GWBUF header
+ *
+ * @return A header with undefined content or NULL
+ */
+static GWBUF *
+gwbuf_alloc_header()
+{
+	return (GWBUF *)pool_alloc(GWBUF_POOL_HEADER);
+}
+
+/**
+ * Allocate a shared buffer and the data area for it as a single block
+ *
+ * @param size	Size of the data area
+ * @return The shared buffer or NULL
+ */
+static SHARED_BUF *
+gwbuf_alloc_sbuf(unsigned int size)
+{
+SHARED_BUF	*sbuf;
+int		pclass = pool_class_for_size(size);
+
+	if (pclass == -1)
+		sbuf = (SHARED_BUF *)malloc(sizeof(SHARED_BUF) + size);
+	else
+		sbuf = (SHARED_BUF *)pool_alloc(pclass);
+
+	if (sbuf != NULL)
+	{
+		sbuf->data = (unsigned char *)(sbuf + 1);
+		sbuf->refcount = 1;
+		sbuf->pool_class = pclass;
+	}
+	return sbuf;
+}
+
+/**
+ * Release a shared buffer and its data area
+ *
+ * @param sbuf	The shared buffer
+ */
+static void
+gwbuf_free_sbuf(SHARED_BUF *sbuf)
+{
+	if (sbuf->pool_class == -1)
+		free(sbuf);
+	else
+		pool_free(sbuf->pool_class, sbuf);
+}
+
+/**
+ * Report the buffer pool statistics, summed over all the threads.
+ *
+ * @param reporter	The function called for each statistic
+ * @param hdl		The handle passed to the reporter
+ */
+void
+gwbuf_pool_stats(void (*reporter)(void *, char *, int), void *hdl)
+{
+GWBUF_POOL	*pool;
+char		desc[80];
+char		name[40];
+int		i, hits, misses, overflows, n_free;
+
+	for (i = 0; i < GWBUF_POOL_NCLASSES; i++)
+	{
+		hits = misses = overflows = n_free = 0;
+		spinlock_acquire(&pool_lock);
+		for (pool = all_pools; pool; pool = pool->next)
+		{
+			hits += pool->hits[i];
+			misses += pool->misses[i];
+			overflows += pool->overflows[i];
+			n_free += pool->n_free[i];
+		}
+		spinlock_release(&pool_lock);
+
+		if (i == GWBUF_POOL_HEADER)
+			sprintf(name, "Buffer headers");
+		else
+			sprintf(name, "%u byte buffers", pool_data_sizes[i]);
+		sprintf(desc, "%s, pool hits", name);
+		reporter(hdl, desc, hits);
+		sprintf(desc, "%s, pool misses", name);
+		reporter(hdl, desc, misses);
+		sprintf(desc, "%s, released to system", name);
+		reporter(hdl, desc, overflows);
+		sprintf(desc, "%s, free in pools", name);
+		reporter(hdl, desc, n_free);
+	}
+}
+
 
 /**
  * Allocate a new gateway buffer structure of size bytes.
  *
- * For now we allocate memory directly from malloc for buffer the management
- * structure and the actual data buffer itself. We may swap at a future date
- * to a more effecient mechanism.
+ * The buffer header and the shared buffer, which holds the data area, are
+ * allocated from the buffer pool of the calling thread.
  *
  * @param	size The size in bytes of the data area required
  * @return	Pointer to the buffer structure or NULL if memory could not
@@ -75,32 +350,22 @@ GWBUF		*rval;
 SHARED_BUF	*sbuf;
 
 	/* Allocate the buffer header */
-	if ((rval = (GWBUF *)malloc(sizeof(GWBUF))) == NULL)
+	if ((rval = gwbuf_alloc_header()) == NULL)
 	{
 		goto retblock;;
 	}
 
-	/* Allocate the shared data buffer */
-	if ((sbuf = (SHARED_BUF *)malloc(sizeof(SHARED_BUF))) == NULL)
+	/* Allocate the shared data buffer and the space for the actual data */
+	if ((sbuf = gwbuf_alloc_sbuf(size)) == NULL)
 	{
-		free(rval);
-		rval = NULL;
-		goto retblock;
-	}
-
-	/* Allocate the space for the actual data */
-	if ((sbuf->data = (unsigned char *)malloc(size)) == NULL)
-	{
-		ss_dassert(sbuf->data != NULL);
-		free(rval);
-		free(sbuf);
+		ss_dassert(sbuf != NULL);
+		pool_free(GWBUF_POOL_HEADER, rval);
 		rval = NULL;
 		goto retblock;
 	}
 	spinlock_init(&rval->gwbuf_lock);
 	rval->start = sbuf->data;
 	rval->end = (void *)((char *)rval->start+size);
-	sbuf->refcount = 1;
 	rval->sbuf = sbuf;
 	rval->next = NULL;
 	rval->tail = rval;
@@ -136,8 +401,7 @@ BUF_PROPERTY	*prop;
 	CHK_GWBUF(buf);
 	if (atomic_add(&buf->sbuf->refcount, -1) == 1)
 	{
-                free(buf->sbuf->data);
-                free(buf->sbuf);
+                gwbuf_free_sbuf(buf->sbuf);
 		bo = buf->gwbuf_bufobj;
 
                 while (bo != NULL)
@@ -161,7 +425,7 @@ BUF_PROPERTY	*prop;
                 buf->hint = buf->hint->next;
                 hint_free(h);
         }
-	free(buf);
+	pool_free(GWBUF_POOL_HEADER, buf);
 }
 
 /**
@@ -179,7 +443,7 @@ gwbuf_clone(GWBUF *buf)
 {
 GWBUF	*rval;
 
-	if ((rval = (GWBUF *)calloc(1,sizeof(GWBUF))) == NULL)
+	if ((rval = gwbuf_alloc_header()) == NULL)
 	{
 		ss_dassert(rval != NULL);
 		LOGIF(LE, (skygw_log_write_flush(
@@ -188,6 +452,7 @@ GWBUF	*rval;
 			strerror(errno))));
 		return NULL;
 	}
+	memset(rval, 0, sizeof(GWBUF));
 
 	atomic_add(&buf->sbuf->refcount, 1);
 	rval->sbuf = buf->sbuf;
@@ -242,7 +507,7 @@ GWBUF *gwbuf_clone_portion(
         CHK_GWBUF(buf);
         ss_dassert(start_offset+length <= GWBUF_LENGTH(buf));
         
-        if ((clonebuf = (GWBUF *)malloc(sizeof(GWBUF))) == NULL)
+        if ((clonebuf = gwbuf_alloc_header()) == NULL)
         {
 		ss_dassert(clonebuf != NULL);
 		LOGIF(LE, (skygw_log_write_flush(
@@ -90,6 +90,7 @@ static	int	handle_feedback_item(const char *, const char *);
 static	void	global_defaults();
 static	void	feedback_defaults();
 static	void	check_config_objects(CONFIG_CONTEXT *context);
+static	void	config_set_persistent(SERVER *server, CONFIG_PARAMETER *params);
 int	config_truth_value(char *str);
 static	int	internalService(char *router);
 int	config_get_ifaddr(unsigned char *output);
@@ -342,6 +343,7 @@ hashtable_memory_fns(monitorhash,strdup,NULL,free,NULL);
 				char *auth_all_servers;
 				char *optimize_wildcard;
 				char *strip_db_esc;
+				char *scatter_gather_writes;
 				char *weightby;
 				char *version_string;
 				char *subservices;
@@ -376,6 +378,11 @@ hashtable_memory_fns(monitorhash,strdup,NULL,free,NULL);
 					config_get_value(
 						obj->parameters, 
 						"strip_db_esc");
+
+				scatter_gather_writes =
+					config_get_value(
+						obj->parameters,
+						"scatter_gather_writes");
                 
 				allow_localhost_match_wildcard_host =
 					config_get_value(obj->parameters, 
@@ -452,6 +459,10 @@ hashtable_memory_fns(monitorhash,strdup,NULL,free,NULL);
 					serviceStripDbEsc(obj->element, 
 						config_truth_value(strip_db_esc));
 
+				if (scatter_gather_writes)
+					serviceScatterGatherWrites(obj->element,
+						config_truth_value(scatter_gather_writes));
+
 				if (weightby)
 					serviceWeightBy(obj->element, weightby);
 
@@ -652,6 +663,8 @@ hashtable_memory_fns(monitorhash,strdup,NULL,free,NULL);
                                         obj->object)));
 				error_count++;
 			}
+			if (obj->element)
+				config_set_persistent(obj->element, obj->parameters);
 			if (obj->element && monuser && monpw)
 				serverAddMonUser(obj->element, monuser, monpw);
 			else if (monuser && monpw == NULL)
@@ -677,6 +690,12 @@ hashtable_memory_fns(monitorhash,strdup,NULL,free,NULL);
 								"monitorpw")
 						&& strcmp(params->name,
 								"type")
+						&& strcmp(params->name,
+								"persistpoolmax")
+						&& strcmp(params->name,
+								"persistmaxtime")
+						&& strcmp(params->name,
+								"persistmaxage")
 						)
 					{
 						serverAddParameter(obj->element,
@@ -1280,6 +1299,29 @@ config_pollsleep()
 	return gateway.pollsleep;
 }
 
+/**
+ * Return whether each polling thread should own its own epoll instance and
+ * the DCBs assigned to it.
+ *
+ * @return Non-zero if thread affinity is enabled
+ */
+int
+config_thread_affinity()
+{
+	return gateway.thread_affinity;
+}
+
+/**
+ * Return the maximum number of entries in the query classification cache
+ *
+ * @return The number of cache entries, 0 if the cache is disabled
+ */
+int
+config_qc_cache_size()
+{
+	return gateway.qc_cache_size;
+}
+
 /**
  * Return the feedback config data pointer
  *
@@ -1323,10 +1365,31 @@ int i;
 	{
 		gateway.pollsleep = atoi(value);
         }
+	else if (strcmp(name, "thread_affinity") == 0)
+	{
+		gateway.thread_affinity = config_truth_value((char *)value);
+	}
+	else if (strcmp(name, "query_classifier_cache_size") == 0)
+	{
+		gateway.qc_cache_size = atoi(value);
+	}
 	else if (strcmp(name, "ms_timestamp") == 0)
 	{
 		skygw_set_highp(config_truth_value(value));
 	}
+	else if (strcmp(name, "log_buffer_full") == 0)
+	{
+		if (strcmp(value, "block") == 0)
+			logmanager_enable_block_on_full(1);
+		else if (strcmp(value, "drop") == 0)
+			logmanager_enable_block_on_full(0);
+		else
+			LOGIF(LE, (skygw_log_write_flush(
+				LOGFILE_ERROR,
+				"Error : Unknown value '%s' for parameter "
+				"log_buffer_full, expected block or drop.",
+				value)));
+	}
 	else
 	{
 		for (i = 0; lognames[i].logname; i++)
@@ -1392,6 +1455,8 @@ global_defaults()
 	gateway.n_threads = 1;
 	gateway.n_nbpoll = DEFAULT_NBPOLLS;
 	gateway.pollsleep = DEFAULT_POLLSLEEP;
+	gateway.thread_affinity = 0;
+	gateway.qc_cache_size = 0;
 	if (version_string != NULL)
 		gateway.version_string = strdup(version_string);
 	else
@@ -1481,6 +1546,7 @@ SERVER			*server;
 					char* auth_all_servers;
 					char* optimize_wildcard;
 					char* strip_db_esc;
+					char* scatter_gather_writes;
 					char* max_slave_conn_str;
 					char* max_slave_rlag_str;
 					char *version_string;
@@ -1497,6 +1563,7 @@ SERVER			*server;
 					auth_all_servers = config_get_value(obj->parameters, "auth_all_servers");
 					optimize_wildcard = config_get_value(obj->parameters, "optimize_wildcard");
 					strip_db_esc = config_get_value(obj->parameters, "strip_db_esc");
+					scatter_gather_writes = config_get_value(obj->parameters, "scatter_gather_writes");
 					version_string = config_get_value(obj->parameters, "version_string");
 					allow_localhost_match_wildcard_host = config_get_value(obj->parameters, "localhost_match_wildcard_host");
 
@@ -1524,6 +1591,8 @@ SERVER			*server;
                                                     serviceOptimizeWildcard(service, config_truth_value(optimize_wildcard));
 						if(strip_db_esc)
                                                     serviceStripDbEsc(service, config_truth_value(strip_db_esc));
+						if(scatter_gather_writes)
+                                                    serviceScatterGatherWrites(service, config_truth_value(scatter_gather_writes));
 
 						if (allow_localhost_match_wildcard_host)
 							serviceEnableLocalhostMatchWildcardHost(
@@ -1728,6 +1797,11 @@ SERVER			*server;
                                                                  monpw);
                                         }
 				}
+				if (obj->element)
+				{
+					config_set_persistent(obj->element,
+							      obj->parameters);
+				}
 			}
 			else
                         {
@@ -1900,6 +1974,7 @@ static char *service_params[] =
                 "auth_all_servers",
 		"optimize_wildcard",
                 "strip_db_esc",
+                "scatter_gather_writes",
                 "localhost_match_wildcard_host",
                 "max_slave_connections",
                 "max_slave_replication_lag",
@@ -1932,6 +2007,7 @@ static char *monitor_params[] =
 		"monitor_interval",
 		"detect_replication_lag",
 		"detect_stale_master",
+		"probe_threads",
 		"disable_master_failback",
 		"backend_connect_timeout",
 		"backend_read_timeout",
@@ -1940,6 +2016,26 @@ static char *monitor_params[] =
                 "disable_master_role_setting",
                 NULL
         };
+/**
+ * Configure the connection pool of a server from the parameters of the
+ * server section.
+ *
+ * @param server	The server
+ * @param params	The parameters of the server section
+ */
+static void
+config_set_persistent(SERVER *server, CONFIG_PARAMETER *params)
+{
+char	*poolmax = config_get_value(params, "persistpoolmax");
+char	*maxtime = config_get_value(params, "persistmaxtime");
+char	*maxage = config_get_value(params, "persistmaxage");
+
+	server_set_persistent(server,
+			      poolmax ? atoi(poolmax) : 0,
+			      maxtime ? atol(maxtime) : 0,
+			      maxage ? atol(maxage) : 0);
+}
+
 /**
  * Check the configuration objects have valid parameters
  */
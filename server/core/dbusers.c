@@ -96,11 +96,40 @@ extern int            lm_enabled_logfiles_bitmask;
 extern size_t         log_ses_count[];
 extern __thread log_info_t tls_log_info;
 
+/**
+ * A host entry in the lookup index of the MySQL users.
+ *
+ * The index maps a user name to the list of the hosts the user is defined
+ * for. The list is ordered by descending netmask so that the first entry
+ * matching the client address is the most specific grant.
+ */
+typedef struct mysql_host_entry {
+	uint32_t	addr;		/**< The IPv4 address with the netmask applied */
+	int		netmask;	/**< The netmask of the host */
+	char		*resource;	/**< The database grant, as in MYSQL_USER_HOST */
+	char		*auth;		/**< The authentication data */
+	struct mysql_host_entry
+			*next;		/**< The next host, smaller or equal netmask */
+} MYSQL_HOST_ENTRY;
+
+/**
+ * The hosts of a user in the lookup index of the MySQL users
+ */
+typedef struct mysql_user_hosts {
+	MYSQL_HOST_ENTRY	*hosts;	/**< The hosts in descending netmask order */
+} MYSQL_USER_HOSTS;
+
 static int getUsers(SERVICE *service, USERS *users);
 static int uh_cmpfun( void* v1, void* v2);
 static void *uh_keydup(void* key);
 static void uh_keyfree( void* key);
 static int uh_hfun( void* key);
+static unsigned int uh_hash_bytes(const void *data, size_t len, unsigned int hash);
+static int uh_user_hfun(void *key);
+static void uh_hosts_free(void *data);
+static uint32_t uh_netmask_bits(int netmask);
+static bool uh_resource_match(char *resource, char *granted);
+static int mysql_users_index_add(USERS *users, MYSQL_USER_HOST *key, char *auth);
 char *mysql_users_fetch(USERS *users, MYSQL_USER_HOST *key);
 char *mysql_format_user_entry(void *data);
 int add_mysql_users_with_host_ipv4(USERS *users, char *user, char *host, char *passwd, char *anydb, char *db);
@@ -1564,11 +1593,19 @@ USERS	*rval;
 	if ((rval = calloc(1, sizeof(USERS))) == NULL)
 		return NULL;
 
-	if ((rval->data = hashtable_alloc(USERS_HASHTABLE_DEFAULT_SIZE, uh_hfun, uh_cmpfun)) == NULL) {
+	if ((rval->data = hashtable_alloc_concurrent(USERS_HASHTABLE_DEFAULT_SIZE, uh_hfun, uh_cmpfun)) == NULL) {
 		free(rval);
 		return NULL;
 	}
 
+	/* user name to host list index used by mysql_users_find */
+	if ((rval->index = hashtable_alloc_concurrent(USERS_HASHTABLE_DEFAULT_SIZE, uh_user_hfun, strcmp)) == NULL) {
+		hashtable_free(rval->data);
+		free(rval);
+		return NULL;
+	}
+	hashtable_memory_fns(rval->index, (HASHMEMORYFN)strdup, NULL, (HASHMEMORYFN)free, (HASHMEMORYFN)uh_hosts_free);
+
 	/* set the MySQL user@host print routine for the debug interface */
 	rval->usersCustomUserFormat = mysql_format_user_entry;
 
@@ -1600,9 +1637,121 @@ int     add;
         add = hashtable_add(users->data, key, auth);
         atomic_add(&users->stats.n_entries, add);
 
+	if (add)
+		mysql_users_index_add(users, key, auth);
+
         return add;
 }
 
+/**
+ * Add a user@host to the lookup index of the MySQL users table.
+ *
+ * The host is inserted in the host list of the user before the hosts with
+ * the same or a smaller netmask.
+ *
+ * @param users		The users table
+ * @param key		The user@host that was added to the table
+ * @param auth		The authentication data
+ * @return		1 if the host was indexed, 0 on failure
+ */
+static int
+mysql_users_index_add(USERS *users, MYSQL_USER_HOST *key, char *auth)
+{
+MYSQL_USER_HOSTS	*hosts;
+MYSQL_HOST_ENTRY	*entry, **prev;
+
+	if (users->index == NULL)
+		return 0;
+
+	if ((entry = (MYSQL_HOST_ENTRY *)calloc(1, sizeof(MYSQL_HOST_ENTRY))) == NULL)
+		return 0;
+
+	entry->netmask = key->netmask;
+	entry->addr = key->ipv4.sin_addr.s_addr & uh_netmask_bits(key->netmask);
+	entry->auth = strdup(auth ? auth : "");
+
+	if (key->resource)
+		entry->resource = strdup(key->resource);
+
+	if ((hosts = hashtable_fetch(users->index, key->user)) == NULL)
+	{
+		if ((hosts = (MYSQL_USER_HOSTS *)calloc(1, sizeof(MYSQL_USER_HOSTS))) == NULL ||
+		    hashtable_add(users->index, key->user, hosts) == 0)
+		{
+			free(hosts);
+			free(entry->resource);
+			free(entry->auth);
+			free(entry);
+			return 0;
+		}
+	}
+
+	prev = &hosts->hosts;
+
+	while (*prev && (*prev)->netmask > entry->netmask)
+		prev = &(*prev)->next;
+
+	entry->next = *prev;
+	*prev = entry;
+
+	return 1;
+}
+
+/**
+ * Find the authentication data of the best matching grant of a user.
+ *
+ * This resolves in a single lookup what used to take a fetch per netmask:
+ * the hosts of the user are checked in descending netmask order and the
+ * first host whose network contains the client address and whose database
+ * grant allows the requested database is used.
+ *
+ * If no grant allows the requested database, a user@% entry is still
+ * accepted in the same way as a fetch without a database would accept it.
+ *
+ * @param users		The MySQL users table
+ * @param key		The user, the client IPv4 address and the database, the
+ *			netmask of the key is not used
+ * @param wildcard	Whether hosts with wildcards may match
+ * @return		The authentication data or NULL if no grant matches
+ */
+char *
+mysql_users_find(USERS *users, MYSQL_USER_HOST *key, bool wildcard)
+{
+MYSQL_USER_HOSTS	*hosts;
+MYSQL_HOST_ENTRY	*entry;
+uint32_t		addr;
+
+	if (key == NULL || key->user == NULL || users->index == NULL)
+		return NULL;
+
+        atomic_add(&users->stats.n_fetches, 1);
+
+	if ((hosts = hashtable_fetch(users->index, key->user)) == NULL)
+		return NULL;
+
+	addr = key->ipv4.sin_addr.s_addr;
+
+	for (entry = hosts->hosts; entry; entry = entry->next)
+	{
+		if (!wildcard && entry->netmask < 32)
+			return NULL;
+
+		if ((addr & uh_netmask_bits(entry->netmask)) == entry->addr &&
+		    uh_resource_match(key->resource, entry->resource))
+			return entry->auth;
+	}
+
+	if (wildcard && key->resource)
+	{
+		for (entry = hosts->hosts; entry; entry = entry->next)
+		{
+			if (entry->netmask == 0 && entry->addr == 0)
+				return entry->auth;
+		}
+	}
+	return NULL;
+}
+
 /**
  * Fetch the authentication data for a particular user from the users table
  *
@@ -1617,24 +1766,117 @@ char *mysql_users_fetch(USERS *users, MYSQL_USER_HOST *key) {
 	return hashtable_fetch(users->data, key);
 }
 
+/**
+ * Hash a block of memory with the FNV-1a hash function
+ *
+ * @param data	The data to hash
+ * @param len	The length of the data
+ * @param hash	The initial value, the result of a previous call or
+ *		2166136261 for a new hash
+ * @return	The hash value
+ */
+static unsigned int uh_hash_bytes(const void *data, size_t len, unsigned int hash) {
+	const unsigned char *ptr = (const unsigned char *)data;
+
+	while (len--) {
+		hash ^= *ptr++;
+		hash *= 16777619;
+	}
+	return hash;
+}
+
 /**
  * The hash function we use for storing MySQL users as: users@hosts.
  * Currently only IPv4 addresses are supported
  *
+ * The whole user name and address are hashed. The netmask and the database
+ * are not part of the hash since uh_cmpfun does not require them to be equal.
+ *
  * @param key	The key value, i.e. username@host (IPv4)
  * @return	The hash key
  */
 
 static int uh_hfun( void* key) {
         MYSQL_USER_HOST *hu = (MYSQL_USER_HOST *) key;
+	unsigned int hash;
 
 	if (key == NULL || hu == NULL || hu->user == NULL) {
 		return 0;
 	} else {
-        	return (*hu->user + *(hu->user + 1) + (unsigned int) (hu->ipv4.sin_addr.s_addr & 0xFF000000 / (256 * 256 * 256)));
+		hash = uh_hash_bytes(hu->user, strlen(hu->user), 2166136261U);
+		hash = uh_hash_bytes(&hu->ipv4.sin_addr.s_addr, sizeof(hu->ipv4.sin_addr.s_addr), hash);
+		return (int)hash;
 	}
 }
 
+/**
+ * The hash function of the user name index of the MySQL users
+ *
+ * @param key	The user name
+ * @return	The hash key
+ */
+static int uh_user_hfun(void *key) {
+	if (key == NULL)
+		return 0;
+
+	return (int)uh_hash_bytes(key, strlen((char *)key), 2166136261U);
+}
+
+/**
+ * Free the hosts of a user in the MySQL users index
+ *
+ * @param data	The MYSQL_USER_HOSTS of the user
+ */
+static void uh_hosts_free(void *data) {
+	MYSQL_USER_HOSTS *hosts = (MYSQL_USER_HOSTS *)data;
+	MYSQL_HOST_ENTRY *entry, *next;
+
+	if (hosts == NULL)
+		return;
+
+	for (entry = hosts->hosts; entry; entry = next) {
+		next = entry->next;
+		free(entry->resource);
+		free(entry->auth);
+		free(entry);
+	}
+	free(hosts);
+}
+
+/**
+ * Convert a netmask length to the IPv4 netmask in network byte order
+ *
+ * @param netmask	The number of bits in the netmask, 0 to 32
+ * @return		The netmask
+ */
+static uint32_t uh_netmask_bits(int netmask) {
+	if (netmask <= 0)
+		return 0;
+	if (netmask >= 32)
+		return 0xFFFFFFFF;
+
+	return htonl(0xFFFFFFFFU << (32 - netmask));
+}
+
+/**
+ * Check a database against the database grant of a user@host. These are
+ * the same rules uh_cmpfun applies to the resource of the keys.
+ *
+ * @param resource	The requested database, NULL or empty for none
+ * @param granted	The grant: NULL for no database grants, empty for
+ *			any database or the name of the database
+ * @return		True if the database is allowed
+ */
+static bool uh_resource_match(char *resource, char *granted) {
+	if (resource == NULL || *resource == '\0')
+		return true;
+
+	if (granted == NULL)
+		return false;
+
+	return *granted == '\0' || strcmp(resource, granted) == 0;
+}
+
 /**
  * The compare function we use for compare MySQL users as: users@hosts.
  * Currently only IPv4 addresses are supported
@@ -2173,7 +2415,22 @@ dbusers_save(USERS *users, char *filename)
 int
 dbusers_load(USERS *users, char *filename)
 {
-	return hashtable_load(users->data, filename, dbusers_keyread, dbusers_valueread);
+HASHITERATOR	*iter;
+MYSQL_USER_HOST	*key;
+int		rval;
+
+	rval = hashtable_load(users->data, filename, dbusers_keyread, dbusers_valueread);
+
+	/* hashtable_load bypasses mysql_users_add, index the loaded users */
+	if (rval > 0 && users->index && (iter = hashtable_iterator(users->data)) != NULL)
+	{
+		while ((key = (MYSQL_USER_HOST *)hashtable_next(iter)) != NULL)
+		{
+			mysql_users_index_add(users, key, hashtable_fetch(users->data, key));
+		}
+		hashtable_iterator_free(iter);
+	}
+	return rval;
 }
 
 /**
@@ -71,15 +71,72 @@
 #include <log_manager.h>
 #include <hashtable.h>
 #include <hk_heartbeat.h>
+#include <objpool.h>
+#include <histogram.h>
+#include <sys/uio.h>
+#include <limits.h>
+
+#ifndef IOV_MAX
+#define	IOV_MAX	1024
+#endif
 
 /** Defined in log_manager.cc */
 extern int            lm_enabled_logfiles_bitmask;
 extern size_t         log_ses_count[];
 extern __thread log_info_t tls_log_info;
 
-static	DCB		*allDCBs = NULL;	/* Diagnostics need a list of DCBs */
+/**
+ * Diagnostics need a list of DCBs. The DCBs are kept in a number of separately
+ * locked doubly linked lists so that adding and removing a DCB is a constant
+ * time operation that only contends with the DCBs in the same list. The list
+ * of a DCB is chosen by its address.
+ */
+#define	DCB_REGISTRY_SHARDS	16
+#define	DCB_REGISTRY(dcb)	\
+	(&allDCBs[((uintptr_t)(dcb) / sizeof(DCB)) % DCB_REGISTRY_SHARDS])
+
+typedef struct {
+	SPINLOCK	lock;		/*< Protects the list */
+	DCB		*head;		/*< First DCB in the list */
+	DCB		*tail;		/*< Last DCB in the list */
+} DCB_REGISTRY;
+
+/**
+ * The memory of the freed DCBs is kept in the object pool for the next
+ * connections, every thread keeps at most DCB_POOL_MAX_FREE of them.
+ */
+#define	DCB_POOL_MAX_FREE	256
+
+static OBJPOOL	*dcb_pool = NULL;
+
+static	DCB_REGISTRY	allDCBs[DCB_REGISTRY_SHARDS];
+
+/**
+ * Zombie DCBs are freed with epoch based reclamation. A DCB that is closed
+ * is stamped with the zombie epoch, the epoch is advanced and the DCB is
+ * put on the zombie list of the closing polling thread. Each polling thread
+ * records the epoch in dcb_process_zombies, once per polling loop, and frees
+ * the DCBs at the head of its own list that were closed before the oldest
+ * epoch recorded by the running polling threads. DCBs closed outside the
+ * polling threads go to a shared list that is processed by whichever polling
+ * thread gets its lock first.
+ */
+typedef struct {
+	int	epoch;		/*< The last epoch the thread recorded */
+	bool	active;		/*< The thread is polling */
+	DCB	*head;		/*< Oldest zombie closed by the thread */
+	DCB	*tail;		/*< Newest zombie closed by the thread */
+} ZOMBIE_THREAD;
+
+/** Epoch a is later than epoch b, allowing for the wrap around */
+#define	ZOMBIE_EPOCH_AFTER(a, b)	((int)((unsigned int)(a) - (unsigned int)(b)) > 0)
+
+static	ZOMBIE_THREAD	*zombie_threads = NULL;
+static	int		n_zombie_threads = 0;
+static	int		zombie_epoch = 0;
+static	__thread int	zombie_thread = -1;	/*< Polling thread id of the caller */
 static	DCB		*zombies = NULL;
-static	SPINLOCK	dcbspin = SPINLOCK_INIT;
+static	DCB		*zombies_tail = NULL;
 static	SPINLOCK	zombiespin = SPINLOCK_INIT;
 
 static void dcb_final_free(DCB *dcb);
@@ -93,6 +150,16 @@ static int  dcb_null_write(DCB *dcb, GWBUF *buf);
 static int  dcb_null_close(DCB *dcb);
 static int  dcb_null_auth(DCB *dcb, SERVER *server, SESSION *session, GWBUF *buf);
 static int  dcb_isvalid_nolock(DCB *dcb);
+static bool dcb_use_writev(DCB *dcb);
+static int  gw_writev(DCB *dcb, GWBUF *queue);
+static GWBUF *dcb_consume_written(GWBUF *queue, int nbytes);
+static DCB  *dcb_persistent_get(SERVER *server, SESSION *session);
+static bool dcb_persistent_add(DCB *dcb);
+static DCB  *dcb_persistent_expire(SERVER *server);
+static void dcb_persistent_close_list(DCB *list);
+static void dcb_latency_done(DCB *dcb);
+static DCB  *dcb_zombies_collect(DCB **head, DCB **tail, bool bounded,
+	int oldest, DCB *victims);
 
 size_t dcb_get_session_id(
 	DCB* dcb)
@@ -147,16 +214,72 @@ bool dcb_get_ses_log_info(
 }
 
 /**
- * Return the pointer to the list of zombie DCB's
+ * Return the pointer to the list of zombie DCB's of the calling polling
+ * thread or to the shared list if not called by a polling thread.
  *
  * @return Zombies DCB list
  */
 DCB *
 dcb_get_zombies(void)
 {
+        if (zombie_thread >= 0)
+        {
+                return zombie_threads[zombie_thread].head;
+        }
         return zombies;
 }
 
+/**
+ * Allocate the zombie lists of the polling threads. This must be called
+ * before the polling threads are started.
+ *
+ * @param nthreads	The number of polling threads
+ * @return		1 on success, 0 if the lists could not be allocated
+ */
+int
+dcb_zombies_init(int nthreads)
+{
+	if ((zombie_threads = (ZOMBIE_THREAD *)calloc(nthreads,
+				sizeof(ZOMBIE_THREAD))) == NULL)
+	{
+		return 0;
+	}
+	n_zombie_threads = nthreads;
+	return 1;
+}
+
+/**
+ * Stop taking part in the zombie processing. The polling thread no longer
+ * holds back the freeing of zombies and the zombies it has closed are
+ * moved to the shared list for the other threads to free.
+ *
+ * @param threadid	The thread ID of the caller
+ */
+void
+dcb_zombies_stop(int threadid)
+{
+ZOMBIE_THREAD	*thr;
+
+	if (threadid < 0 || threadid >= n_zombie_threads)
+		return;
+	thr = &zombie_threads[threadid];
+	thr->active = false;
+	zombie_thread = -1;
+
+	if (thr->head)
+	{
+		spinlock_acquire(&zombiespin);
+		if (zombies_tail)
+			zombies_tail->memdata.next = thr->head;
+		else
+			zombies = thr->head;
+		zombies_tail = thr->tail;
+		spinlock_release(&zombiespin);
+		thr->head = NULL;
+		thr->tail = NULL;
+	}
+}
+
 /**
  * Allocate a new DCB. 
  *
@@ -169,9 +292,12 @@ dcb_get_zombies(void)
 DCB *
 dcb_alloc(dcb_role_t role)
 {
-DCB	*rval;
+DCB		*rval;
+DCB_REGISTRY	*registry;
 
-	if ((rval = calloc(1, sizeof(DCB))) == NULL)
+	if (dcb_pool == NULL)
+		dcb_pool = objpool_get("DCB", sizeof(DCB), DCB_POOL_MAX_FREE);
+	if (dcb_pool == NULL || (rval = objpool_alloc(dcb_pool)) == NULL)
 	{
 		return NULL;
 	}
@@ -199,10 +325,11 @@ DCB	*rval;
 	rval->evq.pending_events = 0;
 	rval->evq.processing = 0;
 	spinlock_init(&rval->evq.eventqlock);
+	rval->owner = -1;
 
 	memset(&rval->stats, 0, sizeof(DCBSTATS));	// Zero the statistics
+	rval->read_avg = DCB_MIN_READ_SIZE / 2;
 	rval->state = DCB_STATE_ALLOC;
-	bitmask_init(&rval->memdata.bitmask);
 	rval->writeqlen = 0;
 	rval->high_water = 0;
 	rval->low_water = 0;
@@ -214,17 +341,15 @@ DCB	*rval;
 	rval->user = NULL;
 	rval->flags = 0;
 
-	spinlock_acquire(&dcbspin);
-	if (allDCBs == NULL)
-		allDCBs = rval;
+	registry = DCB_REGISTRY(rval);
+	spinlock_acquire(&registry->lock);
+	rval->prev = registry->tail;
+	if (registry->tail)
+		registry->tail->next = rval;
 	else
-	{
-		DCB *ptr = allDCBs;
-		while (ptr->next)
-			ptr = ptr->next;
-		ptr->next = rval;
-	}
-	spinlock_release(&dcbspin);
+		registry->head = rval;
+	registry->tail = rval;
+	spinlock_release(&registry->lock);
 	return rval;
 }
 
@@ -256,6 +381,9 @@ dcb_free(DCB *dcb)
  * Adding to list occurs once per DCB. This is ensured by changing the
  * state of DCB to DCB_STATE_ZOMBIE after addition. Prior insertion, DCB state
  * is checked and operation proceeds only if state differs from DCB_STATE_ZOMBIE.
+ * The DCB is stamped with the current zombie epoch and added to the list of
+ * the calling polling thread, or to the shared list if the caller is not a
+ * polling thread.
  * @param dcb The DCB to add to the zombie list
  * @return none
  */
@@ -263,36 +391,54 @@ void
 dcb_add_to_zombieslist(DCB *dcb)
 {
         bool        succp = false;
-        dcb_state_t prev_state = DCB_STATE_UNDEFINED;
+        ZOMBIE_THREAD *thr;
         
         CHK_DCB(dcb);        
 
-        /*<
-         * Protect zombies list access.
-         */
-	spinlock_acquire(&zombiespin);
         /*<
          * If dcb is already added to zombies list, return.
          */
+	spinlock_acquire(&dcb->dcb_initlock);
         if (dcb->state != DCB_STATE_NOPOLLING) {
                 ss_dassert(dcb->state != DCB_STATE_POLLING &&
                            dcb->state != DCB_STATE_LISTENING);
-                spinlock_release(&zombiespin);
+                spinlock_release(&dcb->dcb_initlock);
                 return;
         }
-        /*<
-         * Add closing dcb to the top of the list.
-         */
-        dcb->memdata.next = zombies;
-        zombies = dcb;
         /*<
          * Set state which indicates that it has been added to zombies
          * list.
          */
-        succp = dcb_set_state(dcb, DCB_STATE_ZOMBIE, &prev_state);
+        succp = dcb_set_state_nomutex(dcb, DCB_STATE_ZOMBIE, NULL);
         ss_info_dassert(succp, "Failed to set DCB_STATE_ZOMBIE");
-        
-	spinlock_release(&zombiespin);
+	spinlock_release(&dcb->dcb_initlock);
+
+        /*<
+         * Stamp the dcb with the epoch it was closed in and advance the
+         * epoch. Threads that record the new epoch no longer see the dcb.
+         */
+        dcb->memdata.epoch = atomic_add(&zombie_epoch, 1);
+        dcb->memdata.next = NULL;
+
+        if (zombie_thread >= 0)
+        {
+                thr = &zombie_threads[zombie_thread];
+                if (thr->tail)
+                        thr->tail->memdata.next = dcb;
+                else
+                        thr->head = dcb;
+                thr->tail = dcb;
+        }
+        else
+        {
+                spinlock_acquire(&zombiespin);
+                if (zombies_tail)
+                        zombies_tail->memdata.next = dcb;
+                else
+                        zombies = dcb;
+                zombies_tail = dcb;
+                spinlock_release(&zombiespin);
+        }
 }
 
 /*
@@ -344,6 +490,7 @@ static void
 dcb_final_free(DCB *dcb)
 {
 DCB_CALLBACK		*cb;
+DCB_REGISTRY		*registry;
 
         CHK_DCB(dcb);
         ss_info_dassert(dcb->state == DCB_STATE_DISCONNECTED || 
@@ -359,30 +506,26 @@ DCB_CALLBACK		*cb;
 			dcb)));
 	}
 
+	/*< The last reply of a backend connection is complete */
+	dcb_latency_done(dcb);
+
 	/*< First remove this DCB from the chain */
-	spinlock_acquire(&dcbspin);
-	if (allDCBs == dcb)
-	{
-		/*<
-		 * Deal with the special case of removing the DCB at the head of
-		 * the chain.
-		 */
-		allDCBs = dcb->next;
-	}
-	else
+	registry = DCB_REGISTRY(dcb);
+	spinlock_acquire(&registry->lock);
+	if (dcb->prev || registry->head == dcb)
 	{
-		/*<
-		 * We find the DCB that point to the one we are removing and then
-		 * set the next pointer of that DCB to the next pointer of the
-		 * DCB we are removing.
-		 */
-		DCB *ptr = allDCBs;
-		while (ptr && ptr->next != dcb)
-			ptr = ptr->next;
-		if (ptr)
-			ptr->next = dcb->next;
+		if (dcb->prev)
+			dcb->prev->next = dcb->next;
+		else
+			registry->head = dcb->next;
+		if (dcb->next)
+			dcb->next->prev = dcb->prev;
+		else
+			registry->tail = dcb->prev;
+		dcb->next = NULL;
+		dcb->prev = NULL;
 	}
-	spinlock_release(&dcbspin);
+	spinlock_release(&registry->lock);
 
         if (dcb->session) {
                 /*<
@@ -408,7 +551,12 @@ DCB_CALLBACK		*cb;
 	}
 
 	if (dcb->protocol && (!DCB_IS_CLONE(dcb)))
-		free(dcb->protocol);	
+	{
+		if (dcb->protocol_pool)
+			objpool_free(dcb->protocol_pool, dcb->protocol);
+		else
+			free(dcb->protocol);
+	}
 	if (dcb->remote)
 		free(dcb->remote);
 	if (dcb->user)
@@ -433,121 +581,133 @@ DCB_CALLBACK		*cb;
 	}
 	spinlock_release(&dcb->cb_lock);
 
-	bitmask_free(&dcb->memdata.bitmask);
-	free(dcb);
+	objpool_free(dcb_pool, dcb);
+}
+
+/**
+ * Move the zombies at the head of a list that no polling thread can reference
+ * anymore to the list of victims. The list is in the order the DCBs were
+ * closed in, so the processing stops at the first DCB that must be kept.
+ *
+ * @param head		The head of the zombie list
+ * @param tail		The tail of the zombie list
+ * @param bounded	Whether there are polling threads that may hold references
+ * @param oldest	The oldest epoch recorded by the polling threads
+ * @param victims	The list of victims to add to
+ * @return		The new list of victims
+ */
+static DCB *
+dcb_zombies_collect(DCB **head, DCB **tail, bool bounded, int oldest,
+	DCB *victims)
+{
+DCB	*ptr;
+
+	while ((ptr = *head) != NULL)
+	{
+		CHK_DCB(ptr);
+
+		/*
+		 * Stop at DCB's that are in the event queue waiting
+		 * to be processed or that are not yet seen by all threads.
+		 */
+		if (ptr->evq.next || ptr->evq.prev ||
+			(bounded && !ZOMBIE_EPOCH_AFTER(oldest, ptr->memdata.epoch)))
+		{
+			break;
+		}
+		*head = ptr->memdata.next;
+		if (*head == NULL)
+			*tail = NULL;
+
+		LOGIF(LD, (skygw_log_write_flush(
+			LOGFILE_DEBUG,
+			"%lu [dcb_process_zombies] Remove dcb "
+			"%p fd %d " "in state %s from the "
+			"list of zombies.",
+			pthread_self(),
+			ptr,
+			ptr->fd,
+			STRDCBSTATE(ptr->state)))); 
+		ss_info_dassert(ptr->state == DCB_STATE_ZOMBIE,
+				"dcb not in DCB_STATE_ZOMBIE state.");
+		/*<
+		 * Move dcb to linked list of victim dcbs.
+		 */
+		ptr->memdata.next = victims;
+		victims = ptr;
+	}
+	return victims;
 }
 
 /**
  * Process the DCB zombie queue
  *
  * This routine is called by each of the polling threads with
- * the thread id of the polling thread. It must clear the bit in
- * the memdata bitmask for the polling thread that calls it. If the
- * operation of clearing this bit means that no bits are set in
- * the memdata.bitmask then the DCB is no longer able to be 
- * referenced and it can be finally removed.
+ * the thread id of the polling thread once per polling loop, at a
+ * point where the thread holds no references to DCBs. It records the
+ * current zombie epoch for the thread and frees the zombies the thread
+ * has closed that were closed before the oldest epoch recorded by the
+ * running polling threads. Those DCBs are no longer able to be
+ * referenced by any polling thread and can be finally removed.
  *
  * @param	threadid	The thread ID of the caller
  */
 DCB *
 dcb_process_zombies(int threadid)
 {
-DCB	*ptr, *lptr;
+ZOMBIE_THREAD	*thr = NULL;
 DCB*    dcb_list = NULL;
 DCB*    dcb = NULL;
 bool    succp = false;
+bool	bounded = false;
+int	oldest = 0;
+int	i;
+
+	if (threadid >= 0 && threadid < n_zombie_threads)
+	{
+		thr = &zombie_threads[threadid];
+		zombie_thread = threadid;
+		/** Make the references of the loop done before the epoch is recorded */
+		__sync_synchronize();
+		thr->epoch = zombie_epoch;
+		thr->active = true;
+		__sync_synchronize();
+	}
 
 	/**
-	 * Perform a dirty read to see if there is anything in the queue.
-	 * This avoids threads hitting the queue spinlock when the queue 
-	 * is empty. This will really help when the only entry is being
-	 * freed, since the queue is updated before the expensive call to
-	 * dcb_final_free.
+	 * Perform a dirty read to see if there is anything to free. This
+	 * avoids threads hitting the shared queue spinlock when the queue 
+	 * is empty.
 	 */
-	if (!zombies)
+	if ((thr == NULL || thr->head == NULL) && zombies == NULL)
 		return NULL;
 
-	/*
-	 * Process the zombie queue and create a list of DCB's that can be
-	 * finally freed. This processing is down under a spinlock that
-	 * will prevent new entries being added to the zombie queue. Therefore
-	 * we do not want to do any expensive operations under this spinlock
-	 * as it will block other threads. The expensive operations will be
-	 * performed on the victim queue within holding the zombie queue
-	 * spinlock.
-	 */
-	spinlock_acquire(&zombiespin);
-	ptr = zombies;
-	lptr = NULL;
-	while (ptr)
+	for (i = 0; i < n_zombie_threads; i++)
 	{
-		CHK_DCB(ptr);
-
-		/*
-		 * Skip processing of DCB's that are
-		 * in the event queue waiting to be processed.
-		 */
-		if (ptr->evq.next || ptr->evq.prev)
+		if (zombie_threads[i].active &&
+			(!bounded || ZOMBIE_EPOCH_AFTER(oldest, zombie_threads[i].epoch)))
 		{
-			lptr = ptr;
-			ptr = ptr->memdata.next;
+			oldest = zombie_threads[i].epoch;
+			bounded = true;
 		}
-		else
-		{
+	}
 
-			bitmask_clear(&ptr->memdata.bitmask, threadid);
-			
-			if (bitmask_isallclear(&ptr->memdata.bitmask))
-			{
-				/**
-				 * Remove the DCB from the zombie queue
-				 * and call the final free routine for the
-				 * DCB
-				 *
-				 * ptr is the DCB we are processing
-				 * lptr is the previous DCB on the zombie queue
-				 * or NULL if the DCB is at the head of the
-				 * queue tptr is the DCB after the one we are
-				 * processing on the zombie queue
-				 */
-				DCB	*tptr = ptr->memdata.next;
-				if (lptr == NULL)
-					zombies = tptr;
-				else
-					lptr->memdata.next = tptr;
-				
-				LOGIF(LD, (skygw_log_write_flush(
-					LOGFILE_DEBUG,
-					"%lu [dcb_process_zombies] Remove dcb "
-					"%p fd %d " "in state %s from the "
-					"list of zombies.",
-					pthread_self(),
-					ptr,
-					ptr->fd,
-					STRDCBSTATE(ptr->state)))); 
-				ss_info_dassert(ptr->state == DCB_STATE_ZOMBIE,
-						"dcb not in DCB_STATE_ZOMBIE state.");
-				/*<
-				 * Move dcb to linked list of victim dcbs.
-				 */
-				if (dcb_list == NULL) {
-					dcb_list = ptr;
-					dcb = dcb_list;
-				} else {
-					dcb->memdata.next = ptr;
-					dcb = dcb->memdata.next;
-				}
-				dcb->memdata.next = NULL;
-				ptr = tptr;
-			}
-			else
-			{
-				lptr = ptr;
-				ptr = ptr->memdata.next;
-			}
-		}
+	if (thr)
+	{
+		dcb_list = dcb_zombies_collect(&thr->head, &thr->tail,
+					bounded, oldest, dcb_list);
+	}
+
+	/*
+	 * The shared queue is processed by the first thread that gets the
+	 * spinlock, the others will see the DCB's on their next loop.
+	 */
+	if (zombies && spinlock_acquire_nowait(&zombiespin))
+	{
+		dcb_list = dcb_zombies_collect(&zombies, &zombies_tail,
+					bounded, oldest, dcb_list);
+		spinlock_release(&zombiespin);
 	}
-	spinlock_release(&zombiespin);
 
 	/*
 	 * Process the victim queue. These are DCBs that are not in
@@ -610,7 +770,7 @@ bool    succp = false;
         /** Reset threads session data */
         LOGIF(LT, tls_log_info.li_sesid = 0);
 	
-        return zombies;
+        return thr ? thr->head : zombies;
 }
 
 /**
@@ -633,6 +793,21 @@ GWPROTOCOL	*funcs;
 int             fd;
 int             rc;
 
+	/**
+	 * Reuse an idle connection from the connection pool of the server
+	 * if one has been authenticated for the same user.
+	 */
+	if (server->persistpoolmax > 0)
+	{
+		if ((dcb = dcb_persistent_get(server, session)) != NULL)
+		{
+			atomic_add(&server->stats.n_pool_hits, 1);
+			atomic_add(&server->stats.n_current, 1);
+			return dcb;
+		}
+		atomic_add(&server->stats.n_pool_misses, 1);
+	}
+
 	if ((dcb = dcb_alloc(DCB_ROLE_REQUEST_HANDLER)) == NULL)
 	{
 		return NULL;
@@ -704,6 +879,12 @@ int             rc;
 	 * Add server pointer to dcb
 	 */
         dcb->server = server;
+	dcb->connected = time(NULL);
+
+	if (session->client && session->client->user)
+	{
+		dcb->user = strdup(session->client->user);
+	}
 
         /** Copy status field to DCB */
         dcb->dcb_server_status = server->status;
@@ -736,23 +917,46 @@ int             rc;
 }
 
 
+/**
+ * Return the size of the buffer to use for the next read from a DCB. The
+ * size is twice the moving average of the recent read sizes so that a
+ * typical read fits in a single buffer, bounded by DCB_MIN_READ_SIZE and
+ * MAX_BUFFER_SIZE.
+ *
+ * @param dcb	The DCB to read from
+ * @return The read buffer size
+ */
+static int
+dcb_read_bufsize(DCB *dcb)
+{
+int	size = dcb->read_avg * 2;
+
+	if (size < DCB_MIN_READ_SIZE)
+		size = DCB_MIN_READ_SIZE;
+	return MIN(size, MAX_BUFFER_SIZE);
+}
+
 /**
  * General purpose read routine to read data from a socket in the
  * Descriptor Control Block and append it to a linked list of buffers.
  * The list may be empty, in which case *head == NULL
  *
+ * The data is read directly into buffers whose size adapts to the sizes
+ * of the recent reads of the DCB. Reading stops when a read does not fill
+ * the buffer, since the socket has then been drained and the edge triggered
+ * poll will report any data that arrives later, or when the read would block.
+ *
  * @param dcb	The DCB to read from
  * @param head	Pointer to linked list to append data to
- * @return	-1 on error, otherwise the number of read bytes on the last 
- * iteration of while loop. 0 is returned if no data available.
+ * @return	-1 on error or if the client has closed the connection, otherwise
+ * the number of read bytes on the last iteration of while loop. 0 is returned
+ * if no data available.
  */
 int dcb_read(
         DCB   *dcb, 
         GWBUF **head)
 {
         GWBUF *buffer = NULL;
-        int   b;
-        int   rc;
         int   n;
         int   nread = 0;
         
@@ -767,62 +971,11 @@ int dcb_read(
 		n = 0;
 		goto return_n;
 	}
+	dcb->stats.n_read_events++;
 
 	while (true)
         {
-                int bufsize;
-                
-                rc = ioctl(dcb->fd, FIONREAD, &b);
-                
-                if (rc == -1) 
-                {
-                        LOGIF(LE, (skygw_log_write_flush(
-                                LOGFILE_ERROR,
-                                "Error : ioctl FIONREAD for dcb %p in "
-                                "state %s fd %d failed due error %d, %s.",
-                                dcb,
-                                STRDCBSTATE(dcb->state),
-                                dcb->fd,
-                                errno,
-                                strerror(errno))));
-                        n = -1;
-                        goto return_n;
-                }
-
-                if (b == 0 && nread == 0)
-                {                        
-                        /** Handle closed client socket */
-                        if (dcb_isclient(dcb)) 
-                        {
-                                char c;
-                                int l_errno = 0;
-                                int r = -1;
-                                
-                                /* try to read 1 byte, without consuming the socket buffer */
-                                r = recv(dcb->fd, &c, sizeof(char), MSG_PEEK);
-                                l_errno = errno;
-                                
-                                if (r <= 0 && 
-                                        l_errno != EAGAIN && 
-                                        l_errno != EWOULDBLOCK &&
-					l_errno != 0) 
-                                {
-                                        n = -1;
-                                        goto return_n;
-                                }
-                        }
-                        n = 0;
-                        goto return_n;
-                }
-                else if (b == 0)
-                {
-                        n = 0;
-                        goto return_n;
-                }
-
-		dcb->last_read = hkheartbeat;
-
-                bufsize = MIN(b, MAX_BUFFER_SIZE);
+                int bufsize = dcb_read_bufsize(dcb);
                 
                 if ((buffer = gwbuf_alloc(bufsize)) == NULL)
                 {
@@ -847,7 +1000,21 @@ int dcb_read(
                 
                 if (n <= 0)
                 {                        
-                        if (errno != 0 && errno != EAGAIN && errno != EWOULDBLOCK) 
+                        int eno = errno;
+
+			gwbuf_free(buffer);
+
+                        if (n < 0 && (eno == EAGAIN || eno == EWOULDBLOCK))
+                        {
+                                /** Nothing more to read */
+                                n = 0;
+                        }
+                        else if (n == 0 && nread == 0 && dcb_isclient(dcb))
+                        {
+                                /** Handle closed client socket */
+                                n = -1;
+                        }
+                        else if (n < 0)
                         {
                                 LOGIF(LE, (skygw_log_write_flush(
                                         LOGFILE_ERROR,
@@ -856,13 +1023,21 @@ int dcb_read(
                                         dcb,
                                         STRDCBSTATE(dcb->state),
                                         dcb->fd, 
-                                        errno,
-                                        strerror(errno))));
+                                        eno,
+                                        strerror(eno))));
                         }
-			gwbuf_free(buffer);
                         goto return_n;
                 }
+		dcb->last_read = hkheartbeat;
                 nread += n;
+
+                /** Exponentially weighted moving average with alpha 1/4 */
+                dcb->read_avg += (n - dcb->read_avg) / 4;
+
+                if (n < bufsize)
+                {
+                        buffer = gwbuf_rtrim(buffer, bufsize - n);
+                }
                 
                 LOGIF(LD, (skygw_log_write(
                         LOGFILE_DEBUG,
@@ -875,6 +1050,17 @@ int dcb_read(
                         dcb->fd)));
                 /*< Append read data to the gwbuf */
                 *head = gwbuf_append(*head, buffer);
+
+                if (n < bufsize)
+                {
+                        /** The socket buffer has been drained */
+                        goto return_n;
+                }
+                /** The buffer was filled, use a larger one for the rest */
+                if (dcb->read_avg < bufsize)
+                {
+                        dcb->read_avg = bufsize;
+                }
         } /*< while (true) */
 return_n:
         return n;
@@ -892,6 +1078,7 @@ dcb_write(DCB *dcb, GWBUF *queue)
 int	w;
 int	saved_errno = 0;
 int	below_water;
+bool	use_writev = dcb_use_writev(dcb);
 
 	below_water = (dcb->high_water && dcb->writeqlen < dcb->high_water) ? 1 : 0;
         ss_dassert(queue != NULL);
@@ -994,10 +1181,20 @@ int	below_water;
                         }
 #endif /* FAKE_CODE */
 			qlen = GWBUF_LENGTH(queue);
-			GW_NOINTR_CALL(
-                                w = gw_write(dcb, GWBUF_DATA(queue), qlen);
-                                dcb->stats.n_writes++;
-                                );
+			if (use_writev)
+			{
+				GW_NOINTR_CALL(
+					w = gw_writev(dcb, queue);
+					dcb->stats.n_writes++;
+					);
+			}
+			else
+			{
+				GW_NOINTR_CALL(
+					w = gw_write(dcb, GWBUF_DATA(queue), qlen);
+					dcb->stats.n_writes++;
+					);
+			}
                         
 			if (w < 0)
 			{
@@ -1046,7 +1243,7 @@ int	below_water;
 			 * Pull the number of bytes we have written from
 			 * queue with have.
 			 */
-			queue = gwbuf_consume(queue, w);
+			queue = dcb_consume_written(queue, w);
                         LOGIF(LD, (skygw_log_write(
                                 LOGFILE_DEBUG,
                                 "%lu [dcb_write] Wrote %d Bytes to dcb %p in "
@@ -1116,6 +1313,125 @@ int	below_water;
 	return 1;
 }
 
+/**
+ * Check whether writes to a DCB should use scatter/gather writes. This is
+ * enabled per service.
+ *
+ * @param dcb	The DCB
+ * @return True if the buffer chains should be written with writev
+ */
+static bool
+dcb_use_writev(DCB *dcb)
+{
+SERVICE	*service;
+
+	if (dcb->session && dcb->session->service)
+		service = dcb->session->service;
+	else
+		service = dcb->service;
+
+	return service != NULL && service->scatter_gather_writes;
+}
+
+/**
+ * Write the data of a buffer chain with a single writev call. At most
+ * IOV_MAX buffers from the start of the chain are written. The service
+ * statistics record the number of write calls saved by combining the
+ * buffers, counting only the buffers that were completely written.
+ *
+ * @param dcb	The DCB to write to
+ * @param queue	The buffer chain to write
+ * @return The number of bytes written or -1 with errno set
+ */
+static int
+gw_writev(DCB *dcb, GWBUF *queue)
+{
+struct iovec	iov[IOV_MAX];
+int		n_iov = 0;
+int		n_done = 0;
+int		w;
+size_t		left;
+SERVICE		*service;
+
+	if (dcb->fd <= 0)
+		return 0;
+
+	while (queue != NULL && n_iov < IOV_MAX)
+	{
+		iov[n_iov].iov_base = GWBUF_DATA(queue);
+		iov[n_iov].iov_len = GWBUF_LENGTH(queue);
+		n_iov++;
+		queue = queue->next;
+	}
+#if defined(FAKE_CODE)
+	if (dcb_fake_write_errno[dcb->fd] != 0)
+	{
+		ss_dassert(dcb_fake_write_ev[dcb->fd] != 0);
+		/*< leave peer to read missing bytes */
+		w = write(dcb->fd, iov[0].iov_base, iov[0].iov_len / 2);
+
+		if (w > 0)
+		{
+			w = -1;
+			errno = dcb_fake_write_errno[dcb->fd];
+		}
+		return w;
+	}
+#endif /* FAKE_CODE */
+	w = writev(dcb->fd, iov, n_iov);
+
+	if (w > 0)
+	{
+		for (left = w; n_done < n_iov && iov[n_done].iov_len <= left; n_done++)
+			left -= iov[n_done].iov_len;
+		service = dcb->session && dcb->session->service ?
+				dcb->session->service : dcb->service;
+		if (service)
+		{
+			atomic_add(&service->stats.n_writev, 1);
+			if (n_done > 1)
+				atomic_add(&service->stats.n_writev_saved, n_done - 1);
+		}
+	}
+	return w;
+}
+
+/**
+ * Remove the written bytes from the start of a buffer chain. Unlike
+ * gwbuf_consume this continues past the end of the first buffer. Empty
+ * buffers at the start of the remaining chain are removed as well, even if
+ * nothing was written, so that a chain of empty buffers is not written
+ * forever.
+ *
+ * @param queue		The buffer chain
+ * @param nbytes	The number of bytes written
+ * @return The remaining buffer chain or NULL if all of it was written
+ */
+static GWBUF *
+dcb_consume_written(GWBUF *queue, int nbytes)
+{
+GWBUF	*next;
+int	len;
+
+	while (queue != NULL && (nbytes > 0 || GWBUF_EMPTY(queue)))
+	{
+		len = GWBUF_LENGTH(queue);
+		if (len > nbytes)
+		{
+			queue = gwbuf_consume(queue, nbytes);
+			break;
+		}
+		/** gwbuf_consume doesn't accept an empty buffer after the head */
+		next = queue->next;
+		if (next)
+			next->tail = queue->tail;
+		gwbuf_free(queue);
+		queue = next;
+		nbytes -= len;
+	}
+	return queue;
+}
+
 /**
  * Drain the write queue of a DCB. This is called as part of the EPOLLOUT handling
  * of a socket and will try to send any buffered data from the write queue
@@ -1131,6 +1447,7 @@ int	n = 0;
 int	w;
 int	saved_errno = 0;
 int	above_water;
+bool	use_writev = dcb_use_writev(dcb);
 
 	above_water = (dcb->low_water && dcb->writeqlen > dcb->low_water) ? 1 : 0;
 
@@ -1147,7 +1464,14 @@ int	above_water;
 		while (dcb->writeq != NULL)
 		{
 			len = GWBUF_LENGTH(dcb->writeq);
-			GW_NOINTR_CALL(w = gw_write(dcb, GWBUF_DATA(dcb->writeq), len););
+			if (use_writev)
+			{
+				GW_NOINTR_CALL(w = gw_writev(dcb, dcb->writeq););
+			}
+			else
+			{
+				GW_NOINTR_CALL(w = gw_write(dcb, GWBUF_DATA(dcb->writeq), len););
+			}
 			saved_errno = errno;
                         errno = 0;
                         
@@ -1179,7 +1503,7 @@ int	above_water;
 			 * Pull the number of bytes we have written from
 			 * queue with have.
 			 */
-			dcb->writeq = gwbuf_consume(dcb->writeq, w);
+			dcb->writeq = dcb_consume_written(dcb->writeq, w);
                         LOGIF(LD, (skygw_log_write(
                                 LOGFILE_DEBUG,
                                 "%lu [dcb_drain_writeq] Wrote %d Bytes to dcb %p "
@@ -1250,6 +1574,14 @@ dcb_close(DCB *dcb)
         */
 	if (dcb->state == DCB_STATE_POLLING)
 	{
+		/**
+		 * An idle backend connection is kept in the poll set and
+		 * moved to the connection pool of the server instead.
+		 */
+		if (dcb_persistent_add(dcb))
+		{
+			return;
+		}
 		rc = poll_remove_dcb(dcb);
 
 		if (rc == 0) {
@@ -1291,6 +1623,365 @@ dcb_close(DCB *dcb)
 	}
 }
 
+/**
+ * Move a backend DCB to the connection pool of its server
+ *
+ * The connection is pooled only when the client has closed the session, the
+ * connection is idle and the pool of the server has room for it. The close
+ * callbacks of the DCB are called and removed and the DCB is unlinked from the
+ * session, but it is left in the poll set so that a connection closed by the
+ * server can be removed from the pool.
+ *
+ * @param dcb	The backend DCB that is being closed
+ * @return	True if the DCB was added to the pool
+ */
+static bool
+dcb_persistent_add(DCB *dcb)
+{
+SERVER		*server = dcb->server;
+SESSION		*session = dcb->session;
+DCB_CALLBACK	*cb;
+DCB		*expired;
+bool		added = false;
+
+	if (dcb->dcb_role != DCB_ROLE_REQUEST_HANDLER ||
+		server == NULL ||
+		server->persistpoolmax <= 0 ||
+		dcb->func.reset == NULL ||
+		dcb->user == NULL ||
+		session == NULL ||
+		dcb->dcb_errhandle_called ||
+		DCB_POLL_BUSY(dcb) ||
+		!SERVER_IS_RUNNING(server) ||
+		dcb->writeq != NULL ||
+		dcb->delayq != NULL ||
+		dcb->dcb_readqueue != NULL)
+	{
+		return false;
+	}
+	/**
+	 * If the client is still connected, the router is closing the backend
+	 * because of an error and the protocol close must run.
+	 */
+	if (session->client != NULL &&
+		session->client->state == DCB_STATE_POLLING)
+	{
+		return false;
+	}
+	if (server->persistmaxage > 0 &&
+		time(NULL) - dcb->connected >= server->persistmaxage)
+	{
+		return false;
+	}
+	/** Let the protocol check that there are no replies pending */
+	if (!dcb->func.reset(dcb, NULL))
+	{
+		return false;
+	}
+	/** The callbacks belong to the router session that is closing */
+	dcb_call_callback(dcb, DCB_REASON_CLOSE);
+	spinlock_acquire(&dcb->cb_lock);
+	while ((cb = dcb->callbacks) != NULL)
+	{
+		dcb->callbacks = cb->next;
+		free(cb);
+	}
+	spinlock_release(&dcb->cb_lock);
+
+	spinlock_acquire(&server->persistlock);
+	expired = dcb_persistent_expire(server);
+
+	if (server->stats.n_persistent < server->persistpoolmax)
+	{
+		dcb->persistentstart = time(NULL);
+		dcb->nextpersistent = server->persistent;
+		server->persistent = dcb;
+		server->stats.n_persistent++;
+		dcb->session = NULL;
+		added = true;
+	}
+	spinlock_release(&server->persistlock);
+
+	if (added)
+	{
+		LOGIF(LD, (skygw_log_write(
+			LOGFILE_DEBUG,
+			"%lu [dcb_persistent_add] Added dcb %p fd %d to the "
+			"connection pool of server %s:%d.",
+			pthread_self(),
+			dcb,
+			dcb->fd,
+			server->name,
+			server->port)));
+		/** Drop the reference the DCB held to the session */
+		session_free(session);
+	}
+	dcb_persistent_close_list(expired);
+
+	return added;
+}
+
+/**
+ * Take a connection for the session from the connection pool of a server
+ *
+ * A pooled connection that was authenticated for the user of the session is
+ * linked to the session and reset by the protocol, which re-authenticates it
+ * and selects the default database of the session.
+ *
+ * @param server	The server to connect to
+ * @param session	The session the connection is for
+ * @return		The pooled DCB or NULL if there was none to reuse
+ */
+static DCB *
+dcb_persistent_get(SERVER *server, SESSION *session)
+{
+DCB	*dcb, *prev = NULL, *expired;
+char	*user;
+
+	if (session->client == NULL || (user = session->client->user) == NULL)
+	{
+		return NULL;
+	}
+	spinlock_acquire(&server->persistlock);
+	expired = dcb_persistent_expire(server);
+
+	for (dcb = server->persistent; dcb; dcb = dcb->nextpersistent)
+	{
+		if (strcmp(dcb->user, user) == 0)
+		{
+			break;
+		}
+		prev = dcb;
+	}
+
+	if (dcb)
+	{
+		if (prev)
+			prev->nextpersistent = dcb->nextpersistent;
+		else
+			server->persistent = dcb->nextpersistent;
+		server->stats.n_persistent--;
+
+		/**
+		 * The session is linked while the lock is held so that the
+		 * event handlers never see a DCB that is neither pooled nor
+		 * linked to a session.
+		 */
+		if (session_link_dcb(session, dcb))
+		{
+			dcb->persistentstart = 0;
+			dcb->nextpersistent = NULL;
+		}
+		else
+		{
+			dcb->nextpersistent = expired;
+			expired = dcb;
+			dcb = NULL;
+		}
+	}
+	spinlock_release(&server->persistlock);
+	dcb_persistent_close_list(expired);
+
+	if (dcb && !dcb->func.reset(dcb, session))
+	{
+		LOGIF(LD, (skygw_log_write(
+			LOGFILE_DEBUG,
+			"%lu [dcb_persistent_get] Failed to reset pooled dcb %p "
+			"fd %d, closing it.",
+			pthread_self(),
+			dcb,
+			dcb->fd)));
+		dcb_close(dcb);
+		dcb = NULL;
+	}
+	return dcb;
+}
+
+/**
+ * Remove the expired and broken connections from the connection pool
+ *
+ * The caller must hold the persistlock of the server.
+ *
+ * @param server	The server
+ * @return		The removed DCBs linked by nextpersistent
+ */
+static DCB *
+dcb_persistent_expire(SERVER *server)
+{
+DCB	*dcb, *next, *prev = NULL, *expired = NULL;
+time_t	now = time(NULL);
+
+	for (dcb = server->persistent; dcb; dcb = next)
+	{
+		next = dcb->nextpersistent;
+
+		if (dcb->dcb_errhandle_called ||
+			!SERVER_IS_RUNNING(server) ||
+			(server->persistmaxtime > 0 &&
+			now - dcb->persistentstart >= server->persistmaxtime) ||
+			(server->persistmaxage > 0 &&
+			now - dcb->connected >= server->persistmaxage))
+		{
+			if (prev)
+				prev->nextpersistent = next;
+			else
+				server->persistent = next;
+			server->stats.n_persistent--;
+			dcb->nextpersistent = expired;
+			expired = dcb;
+		}
+		else
+		{
+			prev = dcb;
+		}
+	}
+	return expired;
+}
+
+/**
+ * Close DCBs removed from a connection pool
+ *
+ * @param list	The DCBs linked by nextpersistent
+ */
+static void
+dcb_persistent_close_list(DCB *list)
+{
+DCB	*dcb;
+
+	while ((dcb = list) != NULL)
+	{
+		list = dcb->nextpersistent;
+		dcb->nextpersistent = NULL;
+		dcb->persistentstart = 0;
+		dcb_close(dcb);
+	}
+}
+
+/**
+ * Remove a DCB from the connection pool of its server and close it
+ *
+ * The protocol calls this when a pooled connection gets an event, for example
+ * when the server closes a connection that has been idle for too long.
+ *
+ * @param dcb	The backend DCB
+ * @return	True if the DCB was pooled and has been closed
+ */
+bool
+dcb_persistent_discard(DCB *dcb)
+{
+SERVER	*server = dcb->server;
+DCB	*ptr, *prev = NULL;
+
+	if (server == NULL || dcb->persistentstart == 0)
+	{
+		return false;
+	}
+	spinlock_acquire(&server->persistlock);
+	for (ptr = server->persistent; ptr && ptr != dcb; ptr = ptr->nextpersistent)
+	{
+		prev = ptr;
+	}
+	if (ptr)
+	{
+		if (prev)
+			prev->nextpersistent = dcb->nextpersistent;
+		else
+			server->persistent = dcb->nextpersistent;
+		server->stats.n_persistent--;
+		dcb->nextpersistent = NULL;
+		dcb->persistentstart = 0;
+	}
+	spinlock_release(&server->persistlock);
+
+	if (ptr == NULL)
+	{
+		return false;
+	}
+	LOGIF(LD, (skygw_log_write(
+		LOGFILE_DEBUG,
+		"%lu [dcb_persistent_discard] Closing pooled dcb %p fd %d of "
+		"server %s:%d.",
+		pthread_self(),
+		dcb,
+		dcb->fd,
+		server->name,
+		server->port)));
+	dcb_close(dcb);
+	return true;
+}
+
+/**
+ * Record the time to the last byte of the reply to the request of a backend
+ * DCB, if there is one, and clear the request.
+ *
+ * @param dcb	The backend DCB
+ */
+static void
+dcb_latency_done(DCB *dcb)
+{
+	if (dcb->request_sent && dcb->reply_read &&
+		dcb->server && dcb->server->latency_last)
+	{
+		histogram_add(dcb->server->latency_last,
+			dcb->reply_read - dcb->request_sent);
+	}
+	dcb->request_sent = 0;
+	dcb->reply_read = 0;
+}
+
+/**
+ * Record the latencies of a request that is routed to a backend server. The
+ * routing latency of the service is the time from the reading of the client
+ * packet to the first backend write of it.
+ *
+ * A reply is complete when the next request is written, so that is when the
+ * time to the last byte of the previous reply is recorded, as long as some of
+ * the reply has been read. A request written while no reply to the previous
+ * one has arrived is pipelined and the latencies are measured from the
+ * earlier request.
+ *
+ * @param dcb	The backend DCB
+ */
+void
+dcb_latency_request(DCB *dcb)
+{
+SESSION		*session = dcb->session;
+unsigned long	now = histogram_usecs();
+
+	if (session && session->stats.request_read)
+	{
+		if (session->service && session->service->latency)
+			histogram_add(session->service->latency,
+				now - session->stats.request_read);
+		session->stats.request_read = 0;
+	}
+	if (dcb->request_sent && dcb->reply_read == 0)
+		return;
+	dcb_latency_done(dcb);
+	dcb->request_sent = now;
+}
+
+/**
+ * Record the time to the first byte of a reply when data is read from a
+ * backend server and remember the time of the last read.
+ *
+ * @param dcb	The backend DCB
+ */
+void
+dcb_latency_reply(DCB *dcb)
+{
+unsigned long	now;
+
+	if (dcb->request_sent == 0)
+		return;
+	now = histogram_usecs();
+	if (dcb->reply_read == 0 && dcb->server && dcb->server->latency_first)
+	{
+		histogram_add(dcb->server->latency_first, now - dcb->request_sent);
+	}
+	dcb->reply_read = now;
+}
+
 /**
  * Diagnostic to print a DCB
  *
@@ -1336,6 +2027,18 @@ spin_reporter(void *dcb, char *desc, int value)
 }
 
 
+/**
+ * Diagnostic to print the statistics of the buffer pool
+ *
+ * @param pdcb	DCB to print results to
+ */
+void
+dprintBufferPoolStats(DCB *pdcb)
+{
+	dcb_printf(pdcb, "Buffer pool statistics.\n\n");
+	gwbuf_pool_stats(spin_reporter, pdcb);
+}
+
 /**
  * Diagnostic to print all DCB allocated in the system
  *
@@ -1343,15 +2046,17 @@ spin_reporter(void *dcb, char *desc, int value)
 void printAllDCBs()
 {
 DCB	*dcb;
+int	i;
 
-	spinlock_acquire(&dcbspin);
-	dcb = allDCBs;
-	while (dcb)
+	for (i = 0; i < DCB_REGISTRY_SHARDS; i++)
 	{
-		printDCB(dcb);
-		dcb = dcb->next;
+		spinlock_acquire(&allDCBs[i].lock);
+		for (dcb = allDCBs[i].head; dcb; dcb = dcb->next)
+		{
+			printDCB(dcb);
+		}
+		spinlock_release(&allDCBs[i].lock);
 	}
-	spinlock_release(&dcbspin);
 }
 
 
@@ -1362,44 +2067,49 @@ DCB	*dcb;
 void dprintAllDCBs(DCB *pdcb)
 {
 DCB	*dcb;
+int	i;
 
-	spinlock_acquire(&dcbspin);
 #if SPINLOCK_PROFILE
-	dcb_printf(pdcb, "DCB List Spinlock Statistics:\n");
-	spinlock_stats(&dcbspin, spin_reporter, pdcb);
+	for (i = 0; i < DCB_REGISTRY_SHARDS; i++)
+	{
+		dcb_printf(pdcb, "DCB List %d Spinlock Statistics:\n", i);
+		spinlock_stats(&allDCBs[i].lock, spin_reporter, pdcb);
+	}
 	dcb_printf(pdcb, "Zombie Queue Lock Statistics:\n");
 	spinlock_stats(&zombiespin, spin_reporter, pdcb);
 #endif
-	dcb = allDCBs;
-	while (dcb)
-	{
-		dcb_printf(pdcb, "DCB: %p\n", (void *)dcb);
-		dcb_printf(pdcb, "\tDCB state:          %s\n",
-					gw_dcb_state2string(dcb->state));
-		if (dcb->session && dcb->session->service)
-			dcb_printf(pdcb, "\tService:            %s\n",
-					dcb->session->service->name);
-		if (dcb->remote)
-			dcb_printf(pdcb, "\tConnected to:       %s\n",
-					dcb->remote);
-		if (dcb->user)
-			dcb_printf(pdcb, "\tUsername:           %s\n",
-					dcb->user);
-		if (dcb->writeq)
-			dcb_printf(pdcb, "\tQueued write data:  %d\n",
-					gwbuf_length(dcb->writeq));
-		dcb_printf(pdcb, "\tStatistics:\n");
-		dcb_printf(pdcb, "\t\tNo. of Reads:           	%d\n", dcb->stats.n_reads);
-		dcb_printf(pdcb, "\t\tNo. of Writes:          	%d\n", dcb->stats.n_writes);
-		dcb_printf(pdcb, "\t\tNo. of Buffered Writes: 	%d\n", dcb->stats.n_buffered);
-		dcb_printf(pdcb, "\t\tNo. of Accepts:         	%d\n", dcb->stats.n_accepts);
-		dcb_printf(pdcb, "\t\tNo. of High Water Events:	%d\n", dcb->stats.n_high_water);
-		dcb_printf(pdcb, "\t\tNo. of Low Water Events:	%d\n", dcb->stats.n_low_water);
-		if (dcb->flags & DCBF_CLONE)
-			dcb_printf(pdcb, "\t\tDCB is a clone.\n");
-		dcb = dcb->next;
-	}
-	spinlock_release(&dcbspin);
+	for (i = 0; i < DCB_REGISTRY_SHARDS; i++)
+	{
+		spinlock_acquire(&allDCBs[i].lock);
+		for (dcb = allDCBs[i].head; dcb; dcb = dcb->next)
+		{
+			dcb_printf(pdcb, "DCB: %p\n", (void *)dcb);
+			dcb_printf(pdcb, "\tDCB state:          %s\n",
+						gw_dcb_state2string(dcb->state));
+			if (dcb->session && dcb->session->service)
+				dcb_printf(pdcb, "\tService:            %s\n",
+						dcb->session->service->name);
+			if (dcb->remote)
+				dcb_printf(pdcb, "\tConnected to:       %s\n",
+						dcb->remote);
+			if (dcb->user)
+				dcb_printf(pdcb, "\tUsername:           %s\n",
+						dcb->user);
+			if (dcb->writeq)
+				dcb_printf(pdcb, "\tQueued write data:  %d\n",
+						gwbuf_length(dcb->writeq));
+			dcb_printf(pdcb, "\tStatistics:\n");
+			dcb_printf(pdcb, "\t\tNo. of Reads:           	%d\n", dcb->stats.n_reads);
+			dcb_printf(pdcb, "\t\tNo. of Writes:          	%d\n", dcb->stats.n_writes);
+			dcb_printf(pdcb, "\t\tNo. of Buffered Writes: 	%d\n", dcb->stats.n_buffered);
+			dcb_printf(pdcb, "\t\tNo. of Accepts:         	%d\n", dcb->stats.n_accepts);
+			dcb_printf(pdcb, "\t\tNo. of High Water Events:	%d\n", dcb->stats.n_high_water);
+			dcb_printf(pdcb, "\t\tNo. of Low Water Events:	%d\n", dcb->stats.n_low_water);
+			if (dcb->flags & DCBF_CLONE)
+				dcb_printf(pdcb, "\t\tDCB is a clone.\n");
+		}
+		spinlock_release(&allDCBs[i].lock);
+	}
 }
 
 /** 
@@ -1411,25 +2121,26 @@ void
 dListDCBs(DCB *pdcb)
 {
 DCB     *dcb;
+int	i;
 
-	spinlock_acquire(&dcbspin);
-	dcb = allDCBs;
 	dcb_printf(pdcb, "Descriptor Control Blocks\n");
 	dcb_printf(pdcb, "------------------+----------------------------+--------------------+----------\n");
 	dcb_printf(pdcb, " %-16s | %-26s | %-18s | %s\n", 
 			"DCB", "State", "Service", "Remote");
 	dcb_printf(pdcb, "------------------+----------------------------+--------------------+----------\n");
-	while (dcb)
+	for (i = 0; i < DCB_REGISTRY_SHARDS; i++)
 	{
-		dcb_printf(pdcb, " %-16p | %-26s | %-18s | %s\n",
-			dcb, gw_dcb_state2string(dcb->state),
-			
-			((dcb->session && dcb->session->service) ? dcb->session->service->name : ""), 
-			(dcb->remote ? dcb->remote : ""));
-		dcb = dcb->next;
+		spinlock_acquire(&allDCBs[i].lock);
+		for (dcb = allDCBs[i].head; dcb; dcb = dcb->next)
+		{
+			dcb_printf(pdcb, " %-16p | %-26s | %-18s | %s\n",
+				dcb, gw_dcb_state2string(dcb->state),
+				((dcb->session && dcb->session->service) ? dcb->session->service->name : ""), 
+				(dcb->remote ? dcb->remote : ""));
+		}
+		spinlock_release(&allDCBs[i].lock);
 	}
 	dcb_printf(pdcb, "------------------+----------------------------+--------------------+----------\n\n");
-	spinlock_release(&dcbspin);
 }
 
 /** 
@@ -1441,29 +2152,31 @@ void
 dListClients(DCB *pdcb)
 {
 DCB     *dcb;
+int	i;
 
-	spinlock_acquire(&dcbspin);
-	dcb = allDCBs;
 	dcb_printf(pdcb, "Client Connections\n");
 	dcb_printf(pdcb, "-----------------+------------------+----------------------+------------\n");
 	dcb_printf(pdcb, " %-15s | %-16s | %-20s | %s\n", 
 			"Client", "DCB", "Service", "Session");
 	dcb_printf(pdcb, "-----------------+------------------+----------------------+------------\n");
-	while (dcb)
+	for (i = 0; i < DCB_REGISTRY_SHARDS; i++)
 	{
-		if (dcb_isclient(dcb)
-			&& dcb->dcb_role == DCB_ROLE_REQUEST_HANDLER)
+		spinlock_acquire(&allDCBs[i].lock);
+		for (dcb = allDCBs[i].head; dcb; dcb = dcb->next)
 		{
-			dcb_printf(pdcb, " %-15s | %16p | %-20s | %10p\n",
-				(dcb->remote ? dcb->remote : ""),
-				dcb, (dcb->session->service ?
-					dcb->session->service->name : ""), 
-				dcb->session);
+			if (dcb_isclient(dcb)
+				&& dcb->dcb_role == DCB_ROLE_REQUEST_HANDLER)
+			{
+				dcb_printf(pdcb, " %-15s | %16p | %-20s | %10p\n",
+					(dcb->remote ? dcb->remote : ""),
+					dcb, (dcb->session->service ?
+						dcb->session->service->name : ""), 
+					dcb->session);
+			}
 		}
-		dcb = dcb->next;
+		spinlock_release(&allDCBs[i].lock);
 	}
 	dcb_printf(pdcb, "-----------------+------------------+----------------------+------------\n\n");
-	spinlock_release(&dcbspin);
 }
 
 
@@ -1487,6 +2200,8 @@ dprintDCB(DCB *pdcb, DCB *dcb)
 		dcb_printf(pdcb, "\tUsername:			%s\n",
 					dcb->user);
 	dcb_printf(pdcb, "\tOwning Session:   	%p\n", dcb->session);
+	if (dcb->owner >= 0)
+		dcb_printf(pdcb, "\tOwning Thread:   	%d\n", dcb->owner);
 	if (dcb->writeq)
 		dcb_printf(pdcb, "\tQueued write data:	%d\n", gwbuf_length(dcb->writeq));
 	if (dcb->delayq)
@@ -1494,6 +2209,11 @@ dprintDCB(DCB *pdcb, DCB *dcb)
 	dcb_printf(pdcb, "\tStatistics:\n");
 	dcb_printf(pdcb, "\t\tNo. of Reads: 			%d\n",
 						dcb->stats.n_reads);
+	if (dcb->stats.n_read_events)
+		dcb_printf(pdcb, "\t\tRead calls per event:		%.2f\n",
+			(double)dcb->stats.n_reads / dcb->stats.n_read_events);
+	dcb_printf(pdcb, "\t\tAverage read size:		%d\n",
+						dcb->read_avg);
 	dcb_printf(pdcb, "\t\tNo. of Writes:			%d\n",
 						dcb->stats.n_writes);
 	dcb_printf(pdcb, "\t\tNo. of Buffered Writes:		%d\n",
@@ -2030,13 +2750,15 @@ DCB_CALLBACK	*cb, *nextcb;
 int
 dcb_isvalid(DCB *dcb)
 {
-int	rval = 0;
+DCB_REGISTRY	*registry;
+int		rval = 0;
 
     if (dcb)
     {
-	spinlock_acquire(&dcbspin);
+	registry = DCB_REGISTRY(dcb);
+	spinlock_acquire(&registry->lock);
         rval = dcb_isvalid_nolock(dcb);
-	spinlock_release(&dcbspin);
+	spinlock_release(&registry->lock);
     }
 
     return rval;
@@ -2045,7 +2767,8 @@ int	rval = 0;
 
 /**
  * Check the passed DCB to ensure it is in the list of allDCBS.
- * Requires that the DCB list is already locked before call.
+ * Requires that the list of the DCB is already locked before call.
+ * The DCB is not dereferenced as it may already have been freed.
  *
  * @param	dcb	The DCB to check
  * @return	1 if the DCB is in the list, otherwise 0
@@ -2058,7 +2781,7 @@ int	rval = 0;
 
     if (dcb)
     {
-	ptr = allDCBs;
+	ptr = DCB_REGISTRY(dcb)->head;
 	while (ptr && ptr != dcb)
 	{
 		ptr = ptr->next;
@@ -2078,12 +2801,30 @@ int	rval = 0;
 static DCB *
 dcb_get_next (DCB* dcb)
 {
-        spinlock_acquire(&dcbspin);
+DCB_REGISTRY	*registry;
+int		i = 0;
+
         if (dcb) {
-            dcb = dcb_isvalid_nolock(dcb) ? dcb->next : NULL;
+            registry = DCB_REGISTRY(dcb);
+            spinlock_acquire(&registry->lock);
+            if (!dcb_isvalid_nolock(dcb)) {
+                spinlock_release(&registry->lock);
+                return NULL;
+            }
+            dcb = dcb->next;
+            spinlock_release(&registry->lock);
+
+            if (dcb) {
+                return dcb;
+            }
+            i = registry - allDCBs + 1;
+        }
+
+        for (; i < DCB_REGISTRY_SHARDS && dcb == NULL; i++) {
+            spinlock_acquire(&allDCBs[i].lock);
+            dcb = allDCBs[i].head;
+            spinlock_release(&allDCBs[i].lock);
         }
-        else dcb = allDCBs;
-        spinlock_release(&dcbspin);
         
         return dcb;
 }        
@@ -2188,40 +2929,42 @@ dcb_count_by_usage(DCB_USAGE usage)
 {
 int	rval = 0;
 DCB	*ptr;
+int	i;
 
-	spinlock_acquire(&dcbspin);
-	ptr = allDCBs;
-	while (ptr)
+	for (i = 0; i < DCB_REGISTRY_SHARDS; i++)
 	{
-		switch (usage)
+		spinlock_acquire(&allDCBs[i].lock);
+		for (ptr = allDCBs[i].head; ptr; ptr = ptr->next)
 		{
-		case DCB_USAGE_CLIENT:
-			if (dcb_isclient(ptr))
-				rval++;
-			break;
-		case DCB_USAGE_LISTENER:
-			if (ptr->state == DCB_STATE_LISTENING)
-				rval++;
-			break;
-		case DCB_USAGE_BACKEND:
-			if (dcb_isclient(ptr) == 0
-					&& ptr->dcb_role == DCB_ROLE_REQUEST_HANDLER)
-				rval++;
-			break;
-		case DCB_USAGE_INTERNAL:
-			if (ptr->dcb_role == DCB_ROLE_REQUEST_HANDLER)
-				rval++;
-			break;
-		case DCB_USAGE_ZOMBIE:
-			if (DCB_ISZOMBIE(ptr))
+			switch (usage)
+			{
+			case DCB_USAGE_CLIENT:
+				if (dcb_isclient(ptr))
+					rval++;
+				break;
+			case DCB_USAGE_LISTENER:
+				if (ptr->state == DCB_STATE_LISTENING)
+					rval++;
+				break;
+			case DCB_USAGE_BACKEND:
+				if (dcb_isclient(ptr) == 0
+						&& ptr->dcb_role == DCB_ROLE_REQUEST_HANDLER)
+					rval++;
+				break;
+			case DCB_USAGE_INTERNAL:
+				if (ptr->dcb_role == DCB_ROLE_REQUEST_HANDLER)
+					rval++;
+				break;
+			case DCB_USAGE_ZOMBIE:
+				if (DCB_ISZOMBIE(ptr))
+					rval++;
+				break;
+			case DCB_USAGE_ALL:
 				rval++;
-			break;
-		case DCB_USAGE_ALL:
-			rval++;
-			break;
+				break;
+			}
 		}
-		ptr = ptr->next;
+		spinlock_release(&allDCBs[i].lock);
 	}
-	spinlock_release(&dcbspin);
 	return rval;
 }
@@ -37,6 +37,7 @@
 #include <spinlock.h>
 #include <skygw_utils.h>
 #include <log_manager.h>
+#include <histogram.h>
 
 /** Defined in log_manager.cc */
 extern int            lm_enabled_logfiles_bitmask;
@@ -68,6 +69,7 @@ FILTER_DEF 	*filter;
 	filter->options = NULL;
 	filter->obj = NULL;
 	filter->parameters = NULL;
+	filter->latency = histogram_alloc("Filter", name, "routeQuery");
 
 	spinlock_init(&filter->spin);
 
@@ -112,6 +114,7 @@ FILTER_DEF *ptr;
 		spinlock_release(&filter_spin);
 
 		/* Clean up session and free the memory */
+		histogram_free(filter->latency);
 		free(filter->name);
 		free(filter->module);
 		free(filter);
@@ -22,6 +22,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <sched.h>
 #include <hashtable.h>
 
 /**
@@ -50,6 +51,15 @@
  * number of readers and writers counters when taking out locks. Releasing of
  * locks uses pure atomic actions and thus does not require spinlock protection.
  *
+ * A hashtable allocated with hashtable_alloc_concurrent is meant for tables that
+ * are read by many threads at the same time. Instead of the single lock the
+ * buckets are divided into HASHTABLE_STRIPES stripes, each with a read/write
+ * lock of its own, so that threads using different stripes do not contend for
+ * the same lock. The number of buckets is kept a multiple of the number of
+ * stripes so that a key maps to the same stripe at every table size. When the
+ * average chain length exceeds HASHTABLE_MAX_LOAD the table doubles its size
+ * while holding the locks of all the stripes.
+ *
  * @verbatim
  * Revision History
  *
@@ -68,10 +78,17 @@ static	void hashtable_read_lock(HASHTABLE *table);
 static	void hashtable_read_unlock(HASHTABLE *table);
 static	void hashtable_write_lock(HASHTABLE *table);
 static	void hashtable_write_unlock(HASHTABLE *table);
+static	void hashtable_read_lock_hash(HASHTABLE *table, unsigned int hashval);
+static	void hashtable_read_unlock_hash(HASHTABLE *table, unsigned int hashval);
+static	void hashtable_write_lock_hash(HASHTABLE *table, unsigned int hashval);
+static	void hashtable_write_unlock_hash(HASHTABLE *table, unsigned int hashval);
+static	void hashtable_grow(HASHTABLE *table);
+static	void hashtable_wait_zero(int *counter);
 static HASHTABLE *hashtable_alloc_real(HASHTABLE* target, 
 					int size, 
 					int (*hashfn)(), 
-					int (*cmpfn)());
+					int (*cmpfn)(),
+					bool concurrent);
 
 /**
  * Special null function used as default memory allfunctions in the hashtable
@@ -102,7 +119,26 @@ nullfn(void *data)
 HASHTABLE *
 hashtable_alloc(int size, int (*hashfn)(), int (*cmpfn)())
 {
-	return hashtable_alloc_real(NULL, size, hashfn, cmpfn);
+	return hashtable_alloc_real(NULL, size, hashfn, cmpfn, false);
+}
+
+/**
+ * Allocate a new hash table for concurrent use.
+ *
+ * The table is used with the same hashtable functions as the tables
+ * allocated with hashtable_alloc but it uses a lock per stripe of buckets
+ * instead of a single lock and it grows automatically. The size is rounded
+ * up to a multiple of HASHTABLE_STRIPES.
+ *
+ * @param size		The initial size of the hash table
+ * @param hashfn	The user supplied hash function
+ * @param cmpfn		The user supplied key comparison function
+ * @return The hashtable table
+ */
+HASHTABLE *
+hashtable_alloc_concurrent(int size, int (*hashfn)(), int (*cmpfn)())
+{
+	return hashtable_alloc_real(NULL, size, hashfn, cmpfn, true);
 }
 
 HASHTABLE* hashtable_alloc_flat(
@@ -111,7 +147,7 @@ HASHTABLE* hashtable_alloc_flat(
 	int (*hashfn)(), 
 	int (*cmpfn)())
 {
-	return hashtable_alloc_real(target, size, hashfn, cmpfn);
+	return hashtable_alloc_real(target, size, hashfn, cmpfn, false);
 }
 
 static HASHTABLE *
@@ -119,9 +155,11 @@ hashtable_alloc_real(
 	HASHTABLE* target, 
 	int        size, 
 	int (*hashfn)(), 
-	int (*cmpfn)())
+	int (*cmpfn)(),
+	bool       concurrent)
 {
 	HASHTABLE       *rval;
+	int             i;
 	
 	if (target == NULL)
 	{
@@ -148,7 +186,17 @@ hashtable_alloc_real(
 	rval->vfreefn = nullfn;
 	rval->n_readers = 0;
 	rval->writelock = 0;
+	rval->ht_concurrent = concurrent;
+	rval->stripes = NULL;
+	rval->n_elements = 0;
 	spinlock_init(&rval->spin);
+
+	if (concurrent)
+	{
+		/* Round up so that every stripe protects the same buckets */
+		rval->hashsize = ((rval->hashsize + HASHTABLE_STRIPES - 1) /
+				  HASHTABLE_STRIPES) * HASHTABLE_STRIPES;
+	}
 	if ((rval->entries = (HASHENTRIES **)calloc(rval->hashsize, sizeof(HASHENTRIES *))) == NULL)
 	{
 		free(rval);
@@ -156,6 +204,21 @@ hashtable_alloc_real(
 	}
 	memset(rval->entries, 0, rval->hashsize * sizeof(HASHENTRIES *));
 
+	if (concurrent)
+	{
+		if ((rval->stripes = (pthread_rwlock_t *)calloc(HASHTABLE_STRIPES,
+								sizeof(pthread_rwlock_t))) == NULL)
+		{
+			free(rval->entries);
+			free(rval);
+			return NULL;
+		}
+		for (i = 0; i < HASHTABLE_STRIPES; i++)
+		{
+			pthread_rwlock_init(&rval->stripes[i], NULL);
+		}
+	}
+
 	return rval;
 }
 
@@ -186,6 +249,14 @@ HASHENTRIES	*entry, *ptr;
 	free(table->entries);
 	
 	hashtable_write_unlock(table);
+	if (table->ht_concurrent)
+	{
+		for (i = 0; i < HASHTABLE_STRIPES; i++)
+		{
+			pthread_rwlock_destroy(&table->stripes[i]);
+		}
+		free(table->stripes);
+	}
 	if (!table->ht_isflat)
 	{
 		free(table);
@@ -233,7 +304,9 @@ int
 hashtable_add(HASHTABLE *table, void *key, void *value)
 {
         unsigned int		hashkey;
+        unsigned int		hashval;
         HASHENTRIES	*entry;
+        bool		grow = false;
 
         if (key == NULL || value == NULL)
             return 0;
@@ -241,9 +314,10 @@ hashtable_add(HASHTABLE *table, void *key, void *value)
         if (table->hashsize <= 0) {            
             return 0;
         } else {
-            hashkey = table->hashfn(key) % table->hashsize;
+            hashval = table->hashfn(key);
         }
-	hashtable_write_lock(table);
+	hashtable_write_lock_hash(table, hashval);
+	hashkey = hashval % table->hashsize;
 	entry = table->entries[hashkey % table->hashsize];
 	while (entry && table->cmpfn(key, entry->key) != 0)
 	{
@@ -252,7 +326,7 @@ hashtable_add(HASHTABLE *table, void *key, void *value)
 	if (entry && table->cmpfn(key, entry->key) == 0)
 	{
 		/* Duplicate key value */
-		hashtable_write_unlock(table);
+		hashtable_write_unlock_hash(table, hashval);
 		return 0;
 	}
 	else
@@ -260,7 +334,7 @@ hashtable_add(HASHTABLE *table, void *key, void *value)
 		HASHENTRIES	*ptr = (HASHENTRIES *)malloc(sizeof(HASHENTRIES));
 		if (ptr == NULL)
 		{
-			hashtable_write_unlock(table);
+			hashtable_write_unlock_hash(table, hashval);
 			return 0;
 		}
 
@@ -270,7 +344,7 @@ hashtable_add(HASHTABLE *table, void *key, void *value)
 		/* check succesfull key copy */
 		if ( ptr->key  == NULL) {
 			free(ptr);
-			hashtable_write_unlock(table);
+			hashtable_write_unlock_hash(table, hashval);
 
 			return 0;
 		}
@@ -285,15 +359,24 @@ hashtable_add(HASHTABLE *table, void *key, void *value)
 			free(ptr);
 
 			/* value not copied, return */
-			hashtable_write_unlock(table);
+			hashtable_write_unlock_hash(table, hashval);
 
 			return 0;
 		}
 
 		ptr->next = table->entries[hashkey % table->hashsize];
 		table->entries[hashkey % table->hashsize] = ptr;
+
+		if (table->ht_concurrent)
+		{
+			grow = atomic_add(&table->n_elements, 1) + 1 >
+				table->hashsize * HASHTABLE_MAX_LOAD;
+		}
 	}
-	hashtable_write_unlock(table);
+	hashtable_write_unlock_hash(table, hashval);
+
+	if (grow)
+		hashtable_grow(table);
 
 	return 1;
 }
@@ -308,10 +391,12 @@ hashtable_add(HASHTABLE *table, void *key, void *value)
 int
 hashtable_delete(HASHTABLE *table, void *key)
 {
-unsigned int		hashkey = table->hashfn(key) % table->hashsize;
+unsigned int		hashval = table->hashfn(key);
+unsigned int		hashkey;
 HASHENTRIES	*entry, *ptr;
 
-	hashtable_write_lock(table);
+	hashtable_write_lock_hash(table, hashval);
+	hashkey = hashval % table->hashsize;
 	entry = table->entries[hashkey % table->hashsize];
 	while (entry && entry->key && table->cmpfn(key, entry->key) != 0)
 	{
@@ -320,7 +405,7 @@ HASHENTRIES	*entry, *ptr;
 	if (entry == NULL)
 	{
 		/* Not found */
-		hashtable_write_unlock(table);
+		hashtable_write_unlock_hash(table, hashval);
 		return 0;
 	}
 
@@ -347,7 +432,7 @@ HASHENTRIES	*entry, *ptr;
 			ptr = ptr->next;
 		if (ptr == NULL)
 		{
-			hashtable_write_unlock(table);
+			hashtable_write_unlock_hash(table, hashval);
 			return 0;	/* This should never happen */
 		}
 		ptr->next = entry->next;
@@ -355,7 +440,9 @@ HASHENTRIES	*entry, *ptr;
 		table->vfreefn(entry->value);
 		free(entry);
 	}
-	hashtable_write_unlock(table);
+	if (table->ht_concurrent)
+		atomic_add(&table->n_elements, -1);
+	hashtable_write_unlock_hash(table, hashval);
 	return 1;
 }
 
@@ -369,25 +456,24 @@ HASHENTRIES	*entry, *ptr;
 void *
 hashtable_fetch(HASHTABLE *table, void *key)
 {
-unsigned int		hashkey = table->hashfn(key) % table->hashsize;
+unsigned int		hashval = table->hashfn(key);
+unsigned int		hashkey;
 HASHENTRIES	*entry;
+void		*value = NULL;
 
-	hashtable_read_lock(table);
+	hashtable_read_lock_hash(table, hashval);
+	hashkey = hashval % table->hashsize;
 	entry = table->entries[hashkey % table->hashsize];
 	while (entry && entry->key && table->cmpfn(key, entry->key) != 0)
 	{
 		entry = entry->next;
 	}
-	if (entry == NULL)
+	if (entry != NULL)
 	{
-		hashtable_read_unlock(table);
-		return NULL;
-	}
-	else
-	{
-		hashtable_read_unlock(table);
-		return entry->value;
+		value = entry->value;
 	}
+	hashtable_read_unlock_hash(table, hashval);
+	return value;
 }
 
 /**
@@ -485,6 +571,28 @@ void hashtable_get_stats(
 }
 
 
+/**
+ * Wait for a lock counter of the hashtable to drop to zero.
+ *
+ * The counter is read through a volatile pointer so that the compiler
+ * can not hoist the read out of the loop. After a short spin the
+ * processor is given away on every round so that a preempted lock holder
+ * gets to run and release the lock.
+ *
+ * @param counter	The counter to wait for
+ */
+static void
+hashtable_wait_zero(int *counter)
+{
+int	spins = 0;
+
+	while (*(volatile int *)counter)
+	{
+		if (++spins > 100)
+			sched_yield();
+	}
+}
+
 /**
  * Take a read lock on the hashtable.
  *
@@ -506,12 +614,19 @@ void hashtable_get_stats(
 static void
 hashtable_read_lock(HASHTABLE *table)
 {
+int	i;
+
+	if (table->ht_concurrent)
+	{
+		for (i = 0; i < HASHTABLE_STRIPES; i++)
+			pthread_rwlock_rdlock(&table->stripes[i]);
+		return;
+	}
 	spinlock_acquire(&table->spin);
 	while (table->writelock)
 	{
 		spinlock_release(&table->spin);
-		while (table->writelock)
-			;
+		hashtable_wait_zero(&table->writelock);
 		spinlock_acquire(&table->spin);
 	}
 	atomic_add(&table->n_readers, 1);
@@ -528,6 +643,14 @@ hashtable_read_lock(HASHTABLE *table)
 static void
 hashtable_read_unlock(HASHTABLE *table)
 {
+int	i;
+
+	if (table->ht_concurrent)
+	{
+		for (i = HASHTABLE_STRIPES - 1; i >= 0; i--)
+			pthread_rwlock_unlock(&table->stripes[i]);
+		return;
+	}
 	atomic_add(&table->n_readers, -1);
 }
 
@@ -551,11 +674,17 @@ static void
 hashtable_write_lock(HASHTABLE *table)
 {
 int	available;
+int	i;
 
+	if (table->ht_concurrent)
+	{
+		for (i = 0; i < HASHTABLE_STRIPES; i++)
+			pthread_rwlock_wrlock(&table->stripes[i]);
+		return;
+	}
 	spinlock_acquire(&table->spin);
 	do {
-		while (table->n_readers)
-			;
+		hashtable_wait_zero(&table->n_readers);
 		available = atomic_add(&table->writelock, 1);
 		if (available != 0)
 			atomic_add(&table->writelock, -1);
@@ -571,9 +700,127 @@ int	available;
 static void
 hashtable_write_unlock(HASHTABLE *table)
 {
+int	i;
+
+	if (table->ht_concurrent)
+	{
+		for (i = HASHTABLE_STRIPES - 1; i >= 0; i--)
+			pthread_rwlock_unlock(&table->stripes[i]);
+		return;
+	}
 	atomic_add(&table->writelock, -1);
 }
 
+/**
+ * Take a read lock on the part of the hashtable that holds the entries
+ * with the given hash value.
+ *
+ * For a concurrent hashtable this is the lock of the stripe of the hash
+ * value, otherwise the whole table is locked. The bucket of the hash value
+ * may only be computed once the lock is held since the size of a concurrent
+ * table can change while it is not locked.
+ *
+ * @param table		The hashtable to lock
+ * @param hashval	The hash value or the bucket number
+ */
+static void
+hashtable_read_lock_hash(HASHTABLE *table, unsigned int hashval)
+{
+	if (table->ht_concurrent)
+		pthread_rwlock_rdlock(&table->stripes[hashval % HASHTABLE_STRIPES]);
+	else
+		hashtable_read_lock(table);
+}
+
+/**
+ * Release a read lock obtained with hashtable_read_lock_hash
+ *
+ * @param table		The hashtable to unlock
+ * @param hashval	The hash value or the bucket number
+ */
+static void
+hashtable_read_unlock_hash(HASHTABLE *table, unsigned int hashval)
+{
+	if (table->ht_concurrent)
+		pthread_rwlock_unlock(&table->stripes[hashval % HASHTABLE_STRIPES]);
+	else
+		hashtable_read_unlock(table);
+}
+
+/**
+ * Obtain an exclusive write lock on the part of the hashtable that holds
+ * the entries with the given hash value.
+ *
+ * @param table		The hashtable to lock
+ * @param hashval	The hash value or the bucket number
+ */
+static void
+hashtable_write_lock_hash(HASHTABLE *table, unsigned int hashval)
+{
+	if (table->ht_concurrent)
+		pthread_rwlock_wrlock(&table->stripes[hashval % HASHTABLE_STRIPES]);
+	else
+		hashtable_write_lock(table);
+}
+
+/**
+ * Release a write lock obtained with hashtable_write_lock_hash
+ *
+ * @param table		The hashtable to unlock
+ * @param hashval	The hash value or the bucket number
+ */
+static void
+hashtable_write_unlock_hash(HASHTABLE *table, unsigned int hashval)
+{
+	if (table->ht_concurrent)
+		pthread_rwlock_unlock(&table->stripes[hashval % HASHTABLE_STRIPES]);
+	else
+		hashtable_write_unlock(table);
+}
+
+/**
+ * Double the number of buckets of a concurrent hashtable.
+ *
+ * The entries are moved to the new buckets while the locks of all the
+ * stripes are held. If the new buckets can not be allocated the table
+ * keeps its current size.
+ *
+ * @param table		The hashtable to grow
+ */
+static void
+hashtable_grow(HASHTABLE *table)
+{
+HASHENTRIES	**entries, *entry, *next;
+unsigned int	hashkey;
+int		size, i;
+
+	hashtable_write_lock(table);
+
+	/* Another thread may have grown the table already */
+	if (table->n_elements > table->hashsize * HASHTABLE_MAX_LOAD)
+	{
+		size = table->hashsize * 2;
+
+		if ((entries = (HASHENTRIES **)calloc(size, sizeof(HASHENTRIES *))) != NULL)
+		{
+			for (i = 0; i < table->hashsize; i++)
+			{
+				for (entry = table->entries[i]; entry; entry = next)
+				{
+					next = entry->next;
+					hashkey = (unsigned int)table->hashfn(entry->key) % size;
+					entry->next = entries[hashkey];
+					entries[hashkey] = entry;
+				}
+			}
+			free(table->entries);
+			table->entries = entries;
+			table->hashsize = size;
+		}
+	}
+	hashtable_write_unlock(table);
+}
+
 /**
  * Create an iterator on a hash table
  *
@@ -609,7 +856,7 @@ HASHENTRIES	*entries;
 	iter->depth++;
 	while (iter->chain < iter->table->hashsize)
 	{
-		hashtable_read_lock(iter->table);
+		hashtable_read_lock_hash(iter->table, iter->chain);
 		if ((entries = iter->table->entries[iter->chain]) != NULL)
 		{
 			i = 0;
@@ -618,13 +865,13 @@ HASHENTRIES	*entries;
 				entries = entries->next;
 				i++;
 			}
-			hashtable_read_unlock(iter->table);
+			hashtable_read_unlock_hash(iter->table, iter->chain);
 			if (entries)
 				return entries->key;
 		}
 		else
 		{
-			hashtable_read_unlock(iter->table);
+			hashtable_read_unlock_hash(iter->table, iter->chain);
 		}
 		iter->depth = 0;
 		iter->chain++;
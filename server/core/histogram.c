@@ -0,0 +1,378 @@
+/*
+ * This file is distributed as part of the MariaDB Corporation MaxScale.  It is free
+ * software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation,
+ * version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Copyright MariaDB Corporation Ab 2015
+ */
+
+/**
+ * @file histogram.c  - Latency histograms
+ *
+ * The histograms of the services, servers and filters are kept in a list so
+ * that the latencies of all of them can be reported together. Recording a
+ * value takes no locks, each thread only writes to its own counters. The
+ * threads after the first HISTOGRAM_MAX_THREADS - 1 share the last counters
+ * and update them with atomic operations.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <histogram.h>
+#include <spinlock.h>
+#include <atomic.h>
+#include <dcb.h>
+
+static HISTOGRAM	*all_histograms = NULL;
+static SPINLOCK		histogram_lock = SPINLOCK_INIT;
+static int		histogram_nthreads = 0;
+static __thread int	histogram_thread = -1;
+
+/**
+ * Return the bucket of a value
+ *
+ * @param usecs	The value
+ * @return The index of the bucket
+ */
+static int
+histogram_bucket(unsigned long usecs)
+{
+int	msb;
+
+	if (usecs < HISTOGRAM_SUB_BUCKETS)
+		return (int)usecs;
+	if (usecs > 0xffffffffUL)
+		return HISTOGRAM_BUCKETS - 1;
+	msb = 31 - __builtin_clz((unsigned int)usecs);
+	return (msb - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS +
+		(int)(usecs >> (msb - HISTOGRAM_SUB_BITS)) - HISTOGRAM_SUB_BUCKETS;
+}
+
+/**
+ * Return the largest value that is counted in a bucket
+ *
+ * @param bucket	The index of the bucket
+ * @return The largest value of the bucket
+ */
+static unsigned long
+histogram_bucket_max(int bucket)
+{
+int	shift;
+
+	if (bucket < HISTOGRAM_SUB_BUCKETS)
+		return bucket;
+	shift = bucket / HISTOGRAM_SUB_BUCKETS - 1;
+	return ((unsigned long)(HISTOGRAM_SUB_BUCKETS +
+		bucket % HISTOGRAM_SUB_BUCKETS + 1) << shift) - 1;
+}
+
+/**
+ * Allocate a histogram and add it to the list of all histograms
+ *
+ * @param type		The type of the measured object, e.g. "Server"
+ * @param name		The name of the measured object
+ * @param metric	What is measured
+ * @return The histogram or NULL if memory could not be allocated
+ */
+HISTOGRAM *
+histogram_alloc(char *type, char *name, char *metric)
+{
+HISTOGRAM	*hist;
+
+	if ((hist = (HISTOGRAM *)calloc(1, sizeof(HISTOGRAM))) == NULL)
+		return NULL;
+	if ((hist->name = strdup(name)) == NULL)
+	{
+		free(hist);
+		return NULL;
+	}
+	hist->type = type;
+	hist->metric = metric;
+	spinlock_acquire(&histogram_lock);
+	hist->next = all_histograms;
+	all_histograms = hist;
+	spinlock_release(&histogram_lock);
+	return hist;
+}
+
+/**
+ * Remove a histogram from the list of all histograms and free it
+ *
+ * @param hist	The histogram
+ */
+void
+histogram_free(HISTOGRAM *hist)
+{
+HISTOGRAM	**ptr;
+int		i;
+
+	if (hist == NULL)
+		return;
+	spinlock_acquire(&histogram_lock);
+	for (ptr = &all_histograms; *ptr; ptr = &(*ptr)->next)
+	{
+		if (*ptr == hist)
+		{
+			*ptr = hist->next;
+			break;
+		}
+	}
+	spinlock_release(&histogram_lock);
+	for (i = 0; i < HISTOGRAM_MAX_THREADS; i++)
+		free(hist->threads[i]);
+	free(hist->name);
+	free(hist);
+}
+
+/**
+ * Add a value to the counters of the calling thread
+ *
+ * @param hist	The histogram
+ * @param usecs	The latency in microseconds
+ */
+void
+histogram_add(HISTOGRAM *hist, unsigned long usecs)
+{
+HISTOGRAM_DATA	*data;
+int		slot, bucket = histogram_bucket(usecs);
+
+	if (histogram_thread == -1)
+		histogram_thread = atomic_add(&histogram_nthreads, 1);
+	slot = histogram_thread < HISTOGRAM_MAX_THREADS - 1 ?
+		histogram_thread : HISTOGRAM_MAX_THREADS - 1;
+
+	if ((data = hist->threads[slot]) == NULL)
+	{
+		if ((data = calloc(1, sizeof(HISTOGRAM_DATA))) == NULL)
+			return;
+		if (!__sync_bool_compare_and_swap(&hist->threads[slot], NULL, data))
+		{
+			free(data);
+			data = hist->threads[slot];
+		}
+	}
+
+	if (slot < HISTOGRAM_MAX_THREADS - 1)
+	{
+		data->count++;
+		data->sum += usecs;
+		data->buckets[bucket]++;
+		if (usecs > data->max)
+			data->max = usecs;
+	}
+	else
+	{
+		__sync_fetch_and_add(&data->count, 1);
+		__sync_fetch_and_add(&data->sum, usecs);
+		__sync_fetch_and_add(&data->buckets[bucket], 1);
+		if (usecs > data->max)
+			data->max = usecs;
+	}
+}
+
+/**
+ * Merge the counters of all threads
+ *
+ * @param hist	The histogram
+ * @param data	The merged counters
+ */
+void
+histogram_merge(HISTOGRAM *hist, HISTOGRAM_DATA *data)
+{
+HISTOGRAM_DATA	*tdata;
+int		i, j;
+
+	memset(data, 0, sizeof(HISTOGRAM_DATA));
+	for (i = 0; i < HISTOGRAM_MAX_THREADS; i++)
+	{
+		if ((tdata = hist->threads[i]) == NULL)
+			continue;
+		data->count += tdata->count;
+		data->sum += tdata->sum;
+		if (tdata->max > data->max)
+			data->max = tdata->max;
+		for (j = 0; j < HISTOGRAM_BUCKETS; j++)
+			data->buckets[j] += tdata->buckets[j];
+	}
+}
+
+/**
+ * Return a percentile of merged counters. The value returned is the upper
+ * limit of the bucket the percentile falls in.
+ *
+ * @param data	The merged counters
+ * @param pct	The percentile, e.g. 99.9
+ * @return The latency in microseconds or 0 if there are no values
+ */
+unsigned long
+histogram_percentile(HISTOGRAM_DATA *data, double pct)
+{
+unsigned long	target, total = 0, value;
+int		i;
+
+	if (data->count == 0)
+		return 0;
+	target = (unsigned long)(data->count * pct / 100.0 + 0.999999);
+	if (target < 1)
+		target = 1;
+	for (i = 0; i < HISTOGRAM_BUCKETS; i++)
+	{
+		total += data->buckets[i];
+		if (total >= target)
+			break;
+	}
+	value = histogram_bucket_max(i < HISTOGRAM_BUCKETS ? i : HISTOGRAM_BUCKETS - 1);
+	return value < data->max ? value : data->max;
+}
+
+/**
+ * Return the time of a monotonic clock in microseconds
+ *
+ * @return The current time in microseconds
+ */
+unsigned long
+histogram_usecs()
+{
+struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * Print the latencies of all histograms to a DCB
+ *
+ * @param pdcb	DCB to print results to
+ */
+void
+dprintLatency(DCB *pdcb)
+{
+HISTOGRAM	*hist;
+HISTOGRAM_DATA	*data;
+
+	if ((data = malloc(sizeof(HISTOGRAM_DATA))) == NULL)
+		return;
+	dcb_printf(pdcb, "Latencies in microseconds.\n\n");
+	dcb_printf(pdcb, " %-8s | %-20s | %-10s | %10s | %8s | %8s | %8s | %8s | %8s | %8s\n",
+		"Type", "Name", "Metric", "Count", "Mean", "p50", "p90", "p99",
+		"p99.9", "Max");
+	dcb_printf(pdcb, "----------+----------------------+------------+------------"
+		"+----------+----------+----------+----------+----------+----------\n");
+	spinlock_acquire(&histogram_lock);
+	for (hist = all_histograms; hist; hist = hist->next)
+	{
+		histogram_merge(hist, data);
+		dcb_printf(pdcb, " %-8s | %-20s | %-10s | %10lu | %8lu | %8lu | %8lu | %8lu | %8lu | %8lu\n",
+			hist->type, hist->name, hist->metric, data->count,
+			data->count ? data->sum / data->count : 0,
+			histogram_percentile(data, 50.0),
+			histogram_percentile(data, 90.0),
+			histogram_percentile(data, 99.0),
+			histogram_percentile(data, 99.9),
+			data->max);
+	}
+	spinlock_release(&histogram_lock);
+	free(data);
+}
+
+/**
+ * Provide a row to the result set of the latencies
+ *
+ * @param set	The result set
+ * @param data	The index of the row to send
+ * @return The next row or NULL
+ */
+static RESULT_ROW *
+latencyRowCallback(RESULTSET *set, void *data)
+{
+int		*rowno = (int *)data;
+int		i = 0;
+char		buf[40];
+RESULT_ROW	*row;
+HISTOGRAM	*hist;
+HISTOGRAM_DATA	*hdata;
+
+	if ((hdata = malloc(sizeof(HISTOGRAM_DATA))) == NULL)
+	{
+		free(data);
+		return NULL;
+	}
+	spinlock_acquire(&histogram_lock);
+	for (hist = all_histograms; hist && i < *rowno; hist = hist->next)
+		i++;
+	if (hist == NULL)
+	{
+		spinlock_release(&histogram_lock);
+		free(hdata);
+		free(data);
+		return NULL;
+	}
+	(*rowno)++;
+	histogram_merge(hist, hdata);
+	row = resultset_make_row(set);
+	resultset_row_set(row, 0, hist->type);
+	resultset_row_set(row, 1, hist->name);
+	resultset_row_set(row, 2, hist->metric);
+	spinlock_release(&histogram_lock);
+
+	sprintf(buf, "%lu", hdata->count);
+	resultset_row_set(row, 3, buf);
+	sprintf(buf, "%lu", hdata->count ? hdata->sum / hdata->count : 0);
+	resultset_row_set(row, 4, buf);
+	sprintf(buf, "%lu", histogram_percentile(hdata, 50.0));
+	resultset_row_set(row, 5, buf);
+	sprintf(buf, "%lu", histogram_percentile(hdata, 90.0));
+	resultset_row_set(row, 6, buf);
+	sprintf(buf, "%lu", histogram_percentile(hdata, 99.0));
+	resultset_row_set(row, 7, buf);
+	sprintf(buf, "%lu", histogram_percentile(hdata, 99.9));
+	resultset_row_set(row, 8, buf);
+	sprintf(buf, "%lu", hdata->max);
+	resultset_row_set(row, 9, buf);
+	free(hdata);
+	return row;
+}
+
+/**
+ * Return a resultset that has the latencies of all histograms in it
+ *
+ * @return A Result set
+ */
+RESULTSET *
+latencyGetList()
+{
+RESULTSET	*set;
+int		*data;
+
+	if ((data = (int *)malloc(sizeof(int))) == NULL)
+		return NULL;
+	*data = 0;
+	if ((set = resultset_create(latencyRowCallback, data)) == NULL)
+	{
+		free(data);
+		return NULL;
+	}
+	resultset_add_column(set, "Type", 8, COL_TYPE_VARCHAR);
+	resultset_add_column(set, "Name", 20, COL_TYPE_VARCHAR);
+	resultset_add_column(set, "Metric", 10, COL_TYPE_VARCHAR);
+	resultset_add_column(set, "Count", 12, COL_TYPE_VARCHAR);
+	resultset_add_column(set, "Mean", 10, COL_TYPE_VARCHAR);
+	resultset_add_column(set, "P50", 10, COL_TYPE_VARCHAR);
+	resultset_add_column(set, "P90", 10, COL_TYPE_VARCHAR);
+	resultset_add_column(set, "P99", 10, COL_TYPE_VARCHAR);
+	resultset_add_column(set, "P99.9", 10, COL_TYPE_VARCHAR);
+	resultset_add_column(set, "Max", 10, COL_TYPE_VARCHAR);
+
+	return set;
+}
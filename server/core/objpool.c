@@ -0,0 +1,253 @@
+/*
+ * This file is distributed as part of the MariaDB Corporation MaxScale.  It is free
+ * software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation,
+ * version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Copyright MariaDB Corporation Ab 2015
+ */
+
+/**
+ * @file objpool.c  - Pools of fixed size objects
+ *
+ * Every thread keeps a free list for each object pool. An object that is
+ * released is put in the free list of the releasing thread and handed out by
+ * the next allocation from the same pool in that thread. The DCBs are released
+ * by the zombie processing of the polling threads, so under connection churn
+ * the memory of the closed connections is reused for the new ones instead of
+ * going back to the heap. The length of each free list is limited by the
+ * max_free of the pool, objects released beyond the limit are freed.
+ *
+ * The pools are identified by name so that modules that are loaded more than
+ * once, or share code with other modules, get the same pool.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <objpool.h>
+#include <spinlock.h>
+#include <dcb.h>
+
+typedef struct pool_object {
+	struct pool_object	*next;
+} POOL_OBJECT;
+
+/**
+ * The free lists and statistics of one thread
+ */
+typedef struct objpool_thread {
+	POOL_OBJECT	*freelist[OBJPOOL_MAX];	/*< Free objects */
+	int		n_free[OBJPOOL_MAX];	/*< Length of free lists */
+	int		high_water[OBJPOOL_MAX];/*< Longest free lists */
+	unsigned long	hits[OBJPOOL_MAX];	/*< From the free list */
+	unsigned long	misses[OBJPOOL_MAX];	/*< From malloc */
+	unsigned long	overflows[OBJPOOL_MAX];	/*< Freed, list full */
+	struct objpool_thread *next;	/*< All threads, for the statistics */
+} OBJPOOL_THREAD;
+
+static OBJPOOL			pools[OBJPOOL_MAX];
+static int			n_pools = 0;
+static __thread OBJPOOL_THREAD	*thread_lists = NULL;
+static OBJPOOL_THREAD		*all_threads = NULL;
+static SPINLOCK			objpool_lock = SPINLOCK_INIT;
+static pthread_key_t		objpool_key;
+static pthread_once_t		objpool_key_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Release the free objects of a thread when the thread exits. The statistics
+ * of the thread are kept in the list of all threads.
+ *
+ * @param data	The free lists of the exiting thread
+ */
+static void
+objpool_thread_exit(void *data)
+{
+OBJPOOL_THREAD	*lists = (OBJPOOL_THREAD *)data;
+POOL_OBJECT	*obj;
+int		i;
+
+	for (i = 0; i < OBJPOOL_MAX; i++)
+	{
+		while ((obj = lists->freelist[i]) != NULL)
+		{
+			lists->freelist[i] = obj->next;
+			free(obj);
+		}
+		lists->n_free[i] = 0;
+	}
+}
+
+static void
+objpool_key_init()
+{
+	pthread_key_create(&objpool_key, objpool_thread_exit);
+}
+
+/**
+ * Return the free lists of the calling thread, creating them on first use
+ *
+ * @return The free lists or NULL if they could not be allocated
+ */
+static OBJPOOL_THREAD *
+objpool_thread_get()
+{
+	if (thread_lists == NULL)
+	{
+		if ((thread_lists = calloc(1, sizeof(OBJPOOL_THREAD))) == NULL)
+			return NULL;
+		pthread_once(&objpool_key_once, objpool_key_init);
+		pthread_setspecific(objpool_key, thread_lists);
+		spinlock_acquire(&objpool_lock);
+		thread_lists->next = all_threads;
+		all_threads = thread_lists;
+		spinlock_release(&objpool_lock);
+	}
+	return thread_lists;
+}
+
+/**
+ * Return the object pool of the given name, creating it if it does not
+ * exist yet. The pools are never removed.
+ *
+ * @param name		The name of the pool
+ * @param size		The size of the objects
+ * @param max_free	Maximum number of free objects kept by each thread
+ * @return The pool or NULL if there are too many pools or the size differs
+ *	   from that of the existing pool
+ */
+OBJPOOL *
+objpool_get(char *name, size_t size, int max_free)
+{
+OBJPOOL	*pool = NULL;
+int	i;
+
+	if (size < sizeof(POOL_OBJECT))
+		size = sizeof(POOL_OBJECT);
+	spinlock_acquire(&objpool_lock);
+	for (i = 0; i < n_pools; i++)
+	{
+		if (strcmp(pools[i].name, name) == 0)
+		{
+			if (pools[i].size == size)
+				pool = &pools[i];
+			spinlock_release(&objpool_lock);
+			return pool;
+		}
+	}
+	if (n_pools < OBJPOOL_MAX && (pools[n_pools].name = strdup(name)) != NULL)
+	{
+		pool = &pools[n_pools];
+		pool->size = size;
+		pool->max_free = max_free;
+		pool->index = n_pools;
+		n_pools++;
+	}
+	spinlock_release(&objpool_lock);
+	return pool;
+}
+
+/**
+ * Allocate an object, from the free list of the calling thread if possible.
+ * Like calloc, the object is filled with zeros.
+ *
+ * @param pool	The object pool
+ * @return The object or NULL if memory could not be allocated
+ */
+void *
+objpool_alloc(OBJPOOL *pool)
+{
+OBJPOOL_THREAD	*lists = objpool_thread_get();
+POOL_OBJECT	*obj;
+int		i = pool->index;
+
+	if (lists && (obj = lists->freelist[i]) != NULL)
+	{
+		lists->freelist[i] = obj->next;
+		lists->n_free[i]--;
+		lists->hits[i]++;
+		memset(obj, 0, pool->size);
+		return obj;
+	}
+	if (lists)
+		lists->misses[i]++;
+	return calloc(1, pool->size);
+}
+
+/**
+ * Return an object to the free list of the calling thread or to the system
+ * if the free list is full.
+ *
+ * @param pool	The object pool the object was allocated from
+ * @param obj	The object
+ */
+void
+objpool_free(OBJPOOL *pool, void *obj)
+{
+OBJPOOL_THREAD	*lists = objpool_thread_get();
+POOL_OBJECT	*pobj = (POOL_OBJECT *)obj;
+int		i = pool->index;
+
+	if (obj == NULL)
+		return;
+	if (lists == NULL || lists->n_free[i] >= pool->max_free)
+	{
+		if (lists)
+			lists->overflows[i]++;
+		free(obj);
+		return;
+	}
+	pobj->next = lists->freelist[i];
+	lists->freelist[i] = pobj;
+	if (++lists->n_free[i] > lists->high_water[i])
+		lists->high_water[i] = lists->n_free[i];
+}
+
+/**
+ * Print the sizing and the statistics of the object pools. The free objects
+ * are the sum over all threads, the high water is the longest free list of
+ * a single thread.
+ *
+ * @param pdcb	DCB to print results to
+ */
+void
+dprintObjectPools(DCB *pdcb)
+{
+OBJPOOL_THREAD	*lists;
+int		i, n_free, high_water;
+unsigned long	hits, misses, overflows;
+
+	dcb_printf(pdcb, "\nObject Pools.\n\n");
+	dcb_printf(pdcb, " Pool              | Size   | Max free | Free     | High water "
+			"| Hits       | Misses     | Released\n");
+	dcb_printf(pdcb, "-------------------+--------+----------+----------+------------"
+			"+------------+------------+-----------\n");
+	spinlock_acquire(&objpool_lock);
+	for (i = 0; i < n_pools; i++)
+	{
+		n_free = high_water = hits = misses = overflows = 0;
+		for (lists = all_threads; lists; lists = lists->next)
+		{
+			n_free += lists->n_free[i];
+			if (lists->high_water[i] > high_water)
+				high_water = lists->high_water[i];
+			hits += lists->hits[i];
+			misses += lists->misses[i];
+			overflows += lists->overflows[i];
+		}
+		dcb_printf(pdcb, " %-17s | %6lu | %8d | %8d | %10d | %10lu | %10lu | %lu\n",
+			pools[i].name, (unsigned long)pools[i].size,
+			pools[i].max_free, n_free, high_water, hits, misses,
+			overflows);
+	}
+	spinlock_release(&objpool_lock);
+}
@@ -20,9 +20,11 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <errno.h>
 #include <poll.h>
 #include <dcb.h>
+#include <session.h>
 #include <atomic.h>
 #include <gwbitmask.h>
 #include <skygw_utils.h>
@@ -33,6 +35,8 @@
 #include <maxconfig.h>
 #include <mysql.h>
 #include <resultset.h>
+#include <objpool.h>
+#include <query_classifier.h>
 
 #define		PROFILE_POLL	0
 
@@ -82,19 +86,40 @@ int	max_poll_sleep;
  */
 #define	MUTEX_EPOLL	0
 
-static	int		epoll_fd = -1;	  /*< The epoll file descriptor */
+/**
+ * A poll queue is an epoll instance together with the queue of DCBs that
+ * have events pending processing. Without thread affinity there is a single
+ * poll queue that is shared by all the polling threads. With thread affinity
+ * every polling thread owns a poll queue of its own and only processes the
+ * DCBs that have been assigned to it, the other threads hand work over to
+ * the owning thread by adding the DCB to its queue and waking it up.
+ */
+typedef struct {
+	int		epoll_fd;	/*< The epoll file descriptor */
+	int		wakeup_fd;	/*< eventfd used to wake up the owner */
+	DCB		*eventq;	/*< The DCBs with pending events */
+	SPINLOCK	lock;		/*< Protects the event queue */
+	int		evq_length;	/*< Event queue length */
+	int		evq_pending;	/*< Number of DCBs with pending events */
+	int		n_wakeups;	/*< Number of wakeups from other threads */
+} POLL_QUEUE;
+
+static	POLL_QUEUE	*poll_queues = NULL; /*< The poll queues */
+static	int		n_poll_queues = 0;   /*< No. of poll queues */
+static	int		poll_affinity = 0;   /*< DCBs are owned by a thread */
+static	int		next_owner = 0;	     /*< Round-robin owner assignment */
+static	__thread int	current_thread = -1; /*< Polling thread id of caller */
 static	int		do_shutdown = 0;  /*< Flag the shutdown of the poll subsystem */
 static	GWBITMASK	poll_mask;
 #if MUTEX_EPOLL
 static  simple_mutex_t  epoll_wait_mutex; /*< serializes calls to epoll_wait */
 #endif
 static	int		n_waiting = 0;	  /*< No. of threads in epoll_wait */
-static	int		process_pollq(int thread_id);
+static	int		process_pollq(POLL_QUEUE *queue, int thread_id);
 static	void		poll_add_event_to_dcb(DCB* dcb, GWBUF* buf, __uint32_t ev);
-
-
-DCB		*eventq = NULL;
-SPINLOCK	pollqlock = SPINLOCK_INIT;
+static	POLL_QUEUE	*poll_dcb_queue(DCB *dcb);
+static	void		poll_queue_event(POLL_QUEUE *queue, DCB *dcb, __uint32_t ev);
+static	void		poll_wakeup(POLL_QUEUE *queue);
 
 /**
  * Thread load average, this is the average number of descriptors in each
@@ -195,18 +220,62 @@ void
 poll_init()
 {
 int	i;
+struct	epoll_event	ev;
 
-	if (epoll_fd != -1)
+	if (poll_queues != NULL)
 		return;
-	if ((epoll_fd = epoll_create(MAX_EVENTS)) == -1)
-	{
-		perror("epoll_create");
-		exit(-1);
-	}
 	memset(&pollStats, 0, sizeof(pollStats));
 	memset(&queueStats, 0, sizeof(queueStats));
 	bitmask_init(&poll_mask);
         n_threads = config_threadcount();
+
+	/*
+	 * With thread affinity each polling thread gets an epoll instance
+	 * of its own, otherwise all the threads share a single one.
+	 */
+	poll_affinity = config_thread_affinity() && n_threads > 1;
+	n_poll_queues = poll_affinity ? n_threads : 1;
+	if ((poll_queues =
+		(POLL_QUEUE *)calloc(n_poll_queues, sizeof(POLL_QUEUE))) == NULL)
+	{
+		perror("calloc");
+		exit(-1);
+	}
+	for (i = 0; i < n_poll_queues; i++)
+	{
+		spinlock_init(&poll_queues[i].lock);
+		poll_queues[i].wakeup_fd = -1;
+		if ((poll_queues[i].epoll_fd = epoll_create(MAX_EVENTS)) == -1)
+		{
+			perror("epoll_create");
+			exit(-1);
+		}
+		if (poll_affinity)
+		{
+			if ((poll_queues[i].wakeup_fd =
+				eventfd(0, EFD_NONBLOCK)) == -1)
+			{
+				perror("eventfd");
+				exit(-1);
+			}
+			/** The wakeup descriptor is the only one without a DCB */
+			ev.events = EPOLLIN;
+			ev.data.ptr = NULL;
+			if (epoll_ctl(poll_queues[i].epoll_fd, EPOLL_CTL_ADD,
+					poll_queues[i].wakeup_fd, &ev) == -1)
+			{
+				perror("epoll_ctl");
+				exit(-1);
+			}
+		}
+	}
+
+	if (!dcb_zombies_init(n_threads))
+	{
+		perror("calloc");
+		exit(-1);
+	}
+
 	if ((thread_data =
 		(THREAD_DATA *)malloc(n_threads * sizeof(THREAD_DATA))) != NULL)
 	{
@@ -236,6 +305,133 @@ int	i;
 #endif
 }
 
+/**
+ * Return the poll queue of a DCB, assigning the DCB to a polling thread
+ * if thread affinity is used and the DCB does not have an owner yet.
+ *
+ * DCBs that belong to a session with a client DCB are assigned to the thread
+ * that owns the client DCB, so that all the events of a session are processed
+ * by the same thread. Client and listener DCBs are distributed round-robin.
+ *
+ * @param dcb	The DCB
+ * @return	The poll queue the DCB belongs to
+ */
+static POLL_QUEUE *
+poll_dcb_queue(DCB *dcb)
+{
+int	owner;
+
+	if (!poll_affinity)
+		return &poll_queues[0];
+
+	if ((owner = dcb->owner) < 0)
+	{
+		spinlock_acquire(&dcb->dcb_initlock);
+		if (dcb->owner < 0)
+		{
+			SESSION	*session = dcb->session;
+
+			if (session && session->client &&
+				session->client != dcb &&
+				session->client->owner >= 0)
+			{
+				dcb->owner = session->client->owner;
+			}
+			else
+			{
+				dcb->owner = (unsigned int)atomic_add(&next_owner, 1)
+						% n_poll_queues;
+			}
+		}
+		owner = dcb->owner;
+		spinlock_release(&dcb->dcb_initlock);
+	}
+	return &poll_queues[owner];
+}
+
+/**
+ * Wake up the thread that owns a poll queue so that it will process the
+ * events that another thread has added to the queue. Nothing is done if
+ * the queue is shared or owned by the calling thread.
+ *
+ * @param queue	The poll queue
+ */
+static void
+poll_wakeup(POLL_QUEUE *queue)
+{
+uint64_t	val = 1;
+
+	if (queue->wakeup_fd == -1 ||
+		(current_thread >= 0 && queue == &poll_queues[current_thread]))
+	{
+		return;
+	}
+	atomic_add(&queue->n_wakeups, 1);
+	if (write(queue->wakeup_fd, &val, sizeof(val)) != sizeof(val)
+		&& errno != EAGAIN)
+	{
+		LOGIF(LE, (skygw_log_write_flush(
+			LOGFILE_ERROR,
+			"Error : Failed to wake up polling thread %d due "
+			"%d, %s.",
+			(int)(queue - poll_queues),
+			errno,
+			strerror(errno))));
+	}
+}
+
+/**
+ * Add events to a DCB in a poll queue. If the DCB is already in the queue the
+ * events are merged into the pending events, otherwise the DCB is added to the
+ * end of the queue.
+ *
+ * The caller must hold the queue spinlock.
+ *
+ * @param queue	The poll queue of the DCB
+ * @param dcb	The DCB
+ * @param ev	The events to add
+ */
+static void
+poll_queue_event(POLL_QUEUE *queue, DCB *dcb, __uint32_t ev)
+{
+	if (DCB_POLL_BUSY(dcb))
+	{
+		if (dcb->evq.pending_events == 0)
+		{
+			queue->evq_pending++;
+			atomic_add(&pollStats.evq_pending, 1);
+			dcb->evq.inserted = hkheartbeat;
+		}
+		dcb->evq.pending_events |= ev;
+	}
+	else
+	{
+		dcb->evq.pending_events = ev;
+		if (queue->eventq)
+		{
+			dcb->evq.prev = queue->eventq->evq.prev;
+			queue->eventq->evq.prev->evq.next = dcb;
+			queue->eventq->evq.prev = dcb;
+			dcb->evq.next = queue->eventq;
+		}
+		else
+		{
+			queue->eventq = dcb;
+			dcb->evq.prev = dcb;
+			dcb->evq.next = dcb;
+		}
+		queue->evq_length++;
+		queue->evq_pending++;
+		atomic_add(&pollStats.evq_length, 1);
+		atomic_add(&pollStats.evq_pending, 1);
+		dcb->evq.inserted = hkheartbeat;
+		if (pollStats.evq_length > pollStats.evq_max)
+		{
+			pollStats.evq_max = pollStats.evq_length;
+		}
+	}
+}
+
 /**
  * Add a DCB to the set of descriptors within the polling
  * environment.
@@ -274,7 +470,10 @@ poll_add_dcb(DCB *dcb)
          * is not polling anymore.
          */
         if (dcb_set_state(dcb, new_state, &old_state)) {
-                rc = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, dcb->fd, &ev);
+                rc = epoll_ctl(poll_dcb_queue(dcb)->epoll_fd,
+                               EPOLL_CTL_ADD,
+                               dcb->fd,
+                               &ev);
 
                 if (rc != 0) {
                         int eno = errno;
@@ -349,7 +548,10 @@ poll_remove_dcb(DCB *dcb)
 		 */		 
 		if (dcb->fd > 0) 
 		{
-			rc = epoll_ctl(epoll_fd, EPOLL_CTL_DEL, dcb->fd, &ev);
+			rc = epoll_ctl(poll_dcb_queue(dcb)->epoll_fd,
+					EPOLL_CTL_DEL,
+					dcb->fd,
+					&ev);
 
 			if (rc != 0) {
 				int eno = errno;
@@ -371,9 +573,6 @@ poll_remove_dcb(DCB *dcb)
                 rc = 0;
                 goto return_rc;
         }
-        
-        /*< Set bit for each maxscale thread */
-        bitmask_copy(&dcb->memdata.bitmask, poll_bitmask()); 
         rc = 0;
 return_rc:
         return rc;
@@ -432,6 +631,11 @@ return_rc:
  * point there is an event to be processed then the value will be reduced to 10% again
  * for the next blocking call.
  *
+ * When thread affinity is enabled every thread waits on an epoll instance of
+ * its own and processes only the event queue of the DCBs it owns. Events that
+ * other threads generate for those DCBs are added to the owner's queue and the
+ * owner is woken up through the eventfd of its poll queue.
+ *
  * @param arg	The thread ID passed as a void * to satisfy the threading package
  */
 void
@@ -442,9 +646,14 @@ int		   i, nfds, timeout_bias = 1;
 intptr_t	   thread_id = (intptr_t)arg;
 DCB                *zombies = NULL;
 int		   poll_spins = 0;
+POLL_QUEUE	   *queue = &poll_queues[poll_affinity ? thread_id : 0];
+
+	current_thread = thread_id;
 
 	/** Add this thread to the bitmask of running polling threads */
 	bitmask_set(&poll_mask, thread_id);
+	/** Take part in the zombie processing before touching any DCB */
+	dcb_process_zombies(thread_id);
 	if (thread_data)
 	{
 		thread_data[thread_id].state = THREAD_IDLE;
@@ -455,14 +664,14 @@ int		   poll_spins = 0;
 	
 	while (1)
 	{
-		if (pollStats.evq_pending == 0 && timeout_bias < 10)
+		if (queue->evq_pending == 0 && timeout_bias < 10)
 		{
 			timeout_bias++;
 		}
 
 		atomic_add(&n_waiting, 1);
 #if BLOCKINGPOLL
-		nfds = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+		nfds = epoll_wait(queue->epoll_fd, events, MAX_EVENTS, -1);
 		atomic_add(&n_waiting, -1);
 #else /* BLOCKINGPOLL */
 #if MUTEX_EPOLL
@@ -474,7 +683,7 @@ int		   poll_spins = 0;
 		}
                 
 		atomic_add(&pollStats.n_polls, 1);
-		if ((nfds = epoll_wait(epoll_fd, events, MAX_EVENTS, 0)) == -1)
+		if ((nfds = epoll_wait(queue->epoll_fd, events, MAX_EVENTS, 0)) == -1)
 		{
 			atomic_add(&n_waiting, -1);
                         int eno = errno;
@@ -496,14 +705,14 @@ int		   poll_spins = 0;
 		 * We calculate a timeout bias to alter the length of the blocking
 		 * call based on the time since we last received an event to process
 		 */
-		else if (nfds == 0 && pollStats.evq_pending == 0 && poll_spins++ > number_poll_spins)
+		else if (nfds == 0 && queue->evq_pending == 0 && poll_spins++ > number_poll_spins)
 		{
 			atomic_add(&pollStats.blockingpolls, 1);
-			nfds = epoll_wait(epoll_fd,
+			nfds = epoll_wait(queue->epoll_fd,
                                                   events,
                                                   MAX_EVENTS,
                                                   (max_poll_sleep * timeout_bias) / 10);
-			if (nfds == 0 && pollStats.evq_pending)
+			if (nfds == 0 && queue->evq_pending)
 			{
 				atomic_add(&pollStats.wake_evqpending, 1);
 				poll_spins = 0;
@@ -562,41 +771,32 @@ int		   poll_spins = 0;
 				DCB 	*dcb = (DCB *)events[i].data.ptr;
 				__uint32_t	ev = events[i].events;
 
-				spinlock_acquire(&pollqlock);
-				if (DCB_POLL_BUSY(dcb))
-				{
-					if (dcb->evq.pending_events == 0)
-					{
-						pollStats.evq_pending++;
-						dcb->evq.inserted = hkheartbeat;
-					}
-					dcb->evq.pending_events |= ev;
-				}
-				else
+				if (dcb == NULL)
 				{
-					dcb->evq.pending_events = ev;
-					if (eventq)
+					uint64_t	val;
+
+					/*
+					 * Wakeup from another thread, the work
+					 * is already in our event queue.
+					 */
+					if (read(queue->wakeup_fd, &val,
+						sizeof(val)) == -1 && errno != EAGAIN)
 					{
-						dcb->evq.prev = eventq->evq.prev;
-						eventq->evq.prev->evq.next = dcb;
-						eventq->evq.prev = dcb;
-						dcb->evq.next = eventq;
-					}
-					else
-					{
-						eventq = dcb;
-						dcb->evq.prev = dcb;
-						dcb->evq.next = dcb;
-					}
-					pollStats.evq_length++;
-					pollStats.evq_pending++;
-					dcb->evq.inserted = hkheartbeat;
-					if (pollStats.evq_length > pollStats.evq_max)
-					{
-						pollStats.evq_max = pollStats.evq_length;
+						LOGIF(LE, (skygw_log_write_flush(
+							LOGFILE_ERROR,
+							"Error : Failed to read wakeup "
+							"descriptor of thread %d due "
+							"%d, %s.",
+							thread_id,
+							errno,
+							strerror(errno))));
 					}
+					continue;
 				}
-				spinlock_release(&pollqlock);
+
+				spinlock_acquire(&queue->lock);
+				poll_queue_event(queue, dcb, ev);
+				spinlock_release(&queue->lock);
 			}
 		}
 
@@ -606,7 +806,7 @@ int		   poll_spins = 0;
 		 * precautionary measure to avoid issues if the house keeping
 		 * of the count goes wrong.
 		 */
-		if (process_pollq(thread_id))
+		if (process_pollq(queue, thread_id))
 			timeout_bias = 1;
 
 		if (thread_data)
@@ -626,6 +826,9 @@ int		   poll_spins = 0;
 				thread_data[thread_id].state = THREAD_STOPPED;
 			}
 			bitmask_clear(&poll_mask, thread_id);
+			dcb_zombies_stop(thread_id);
+			/** Close the pooled parsing contexts while the thread context exists */
+			query_classifier_thread_end();
 			/** Release mysql thread context */
 			mysql_thread_end();
 			return;
@@ -684,25 +887,26 @@ poll_set_maxwait(unsigned int maxwait)
  * Thread local storage (tls_log_info_t) follows thread and is accessed every
  * time log is written to particular log.
  *
+ * @param queue	The poll queue to process
  * @param thread_id	The thread ID of the calling thread
  * @return 		0 if no DCB's have been processed
  */
 static int
-process_pollq(int thread_id)
+process_pollq(POLL_QUEUE *queue, int thread_id)
 {
 DCB		*dcb;
 int		found = 0;
 uint32_t	ev;
 unsigned long	qtime;
 
-	spinlock_acquire(&pollqlock);
-	if (eventq == NULL)
+	spinlock_acquire(&queue->lock);
+	if (queue->eventq == NULL)
 	{
 		/* Nothing to process */
-		spinlock_release(&pollqlock);
+		spinlock_release(&queue->lock);
 		return 0;
 	}
-	dcb = eventq;
+	dcb = queue->eventq;
 	if (dcb->evq.next == dcb->evq.prev && dcb->evq.processing == 0)
 	{
 		found = 1;
@@ -711,14 +915,14 @@ unsigned long	qtime;
 	else if (dcb->evq.next == dcb->evq.prev)
 	{
 		/* Only item in queue is being processed */
-		spinlock_release(&pollqlock);
+		spinlock_release(&queue->lock);
 		return 0;
 	}
 	else
 	{
 		do {
 			dcb = dcb->evq.next;
-		} while (dcb != eventq && dcb->evq.processing == 1);
+		} while (dcb != queue->eventq && dcb->evq.processing == 1);
 
 		if (dcb->evq.processing == 0)
 		{
@@ -732,10 +936,11 @@ unsigned long	qtime;
 		ev = dcb->evq.pending_events;
 		dcb->evq.processing_events = ev;
 		dcb->evq.pending_events = 0;
-		pollStats.evq_pending--;
-		ss_dassert(pollStats.evq_pending >= 0);
+		queue->evq_pending--;
+		atomic_add(&pollStats.evq_pending, -1);
+		ss_dassert(queue->evq_pending >= 0);
 	}
-	spinlock_release(&pollqlock);
+	spinlock_release(&queue->lock);
 
 	if (found == 0)
 		return 0;
@@ -983,7 +1188,7 @@ unsigned long	qtime;
 	if (qtime > queueStats.maxexectime)
 		queueStats.maxexectime = qtime;
 
-	spinlock_acquire(&pollqlock);
+	spinlock_acquire(&queue->lock);
 	dcb->evq.processing_events = 0;
 
 	if (dcb->evq.pending_events == 0)
@@ -993,16 +1198,17 @@ unsigned long	qtime;
 		{
 			dcb->evq.prev->evq.next = dcb->evq.next;
 			dcb->evq.next->evq.prev = dcb->evq.prev;
-			if (eventq == dcb)
-				eventq = dcb->evq.next;
+			if (queue->eventq == dcb)
+				queue->eventq = dcb->evq.next;
 		}
 		else
 		{
-			eventq = NULL;
+			queue->eventq = NULL;
 		}
 		dcb->evq.next = NULL;
 		dcb->evq.prev = NULL;
-		pollStats.evq_length--;
+		queue->evq_length--;
+		atomic_add(&pollStats.evq_length, -1);
 	}
 	else
 	{
@@ -1015,15 +1221,15 @@ unsigned long	qtime;
 		 */
 		if (dcb->evq.prev != dcb)
 		{
-			if (eventq == dcb)
-				eventq = dcb->evq.next;
+			if (queue->eventq == dcb)
+				queue->eventq = dcb->evq.next;
 			else
 			{
 				dcb->evq.prev->evq.next = dcb->evq.next;
 				dcb->evq.next->evq.prev = dcb->evq.prev;
-				dcb->evq.prev = eventq->evq.prev;
-				dcb->evq.next = eventq;
-				eventq->evq.prev = dcb;
+				dcb->evq.prev = queue->eventq->evq.prev;
+				dcb->evq.next = queue->eventq;
+				queue->eventq->evq.prev = dcb;
 				dcb->evq.prev->evq.next = dcb;
 			}
 		}
@@ -1031,7 +1237,7 @@ unsigned long	qtime;
 	dcb->evq.processing = 0;
 	/** Reset session id from thread's local storage */
 	LOGIF(LT, tls_log_info.li_sesid = 0);
-	spinlock_release(&pollqlock);
+	spinlock_release(&queue->lock);
 
 	return 1;
 }
@@ -1119,9 +1325,25 @@ int	i;
 	dcb_printf(dcb, "\t>= %d\t\t\t%d\n", MAXNFDS,
 					pollStats.n_fds[MAXNFDS-1]);
 
+	if (poll_affinity)
+	{
+		dcb_printf(dcb, "Per thread event queues\n");
+		dcb_printf(dcb, "\tThread\tQueue length\tPending\tWakeups\n");
+		for (i = 0; i < n_poll_queues; i++)
+		{
+			dcb_printf(dcb, "\t%2d\t%-12d\t%-7d\t%d\n", i,
+					poll_queues[i].evq_length,
+					poll_queues[i].evq_pending,
+					poll_queues[i].n_wakeups);
+		}
+	}
+
 #if SPINLOCK_PROFILE
-	dcb_printf(dcb, "Event queue lock statistics:\n");
-	spinlock_stats(&pollqlock, spin_reporter, dcb);
+	for (i = 0; i < n_poll_queues; i++)
+	{
+		dcb_printf(dcb, "Event queue %d lock statistics:\n", i);
+		spinlock_stats(&poll_queues[i].lock, spin_reporter, dcb);
+	}
 #endif
 }
 
@@ -1174,6 +1396,19 @@ char	*str;
 	return str;
 }
 
+/**
+ * Print one statistic of the parsing context pools of the query classifier
+ *
+ * @param dcb	The DCB to print to
+ * @param desc	Description of the statistic
+ * @param value	The statistic value
+ */
+static void
+qc_pool_reporter(void *dcb, char *desc, int value)
+{
+	dcb_printf((DCB *)dcb, "	%-40s  %d\n", desc, value);
+}
+
 /**
  * Print the thread status for all the polling threads
  *
@@ -1292,6 +1527,9 @@ double	qavg1 = 0.0, qavg5 = 0.0, qavg15 = 0.0;
 			}
 		}
 	}
+	dprintObjectPools(dcb);
+	dcb_printf(dcb, "\nParsing Context Pools.\n\n");
+	query_classifier_pool_stats(qc_pool_reporter, dcb);
 }
 
 /**
@@ -1349,48 +1587,19 @@ static void poll_add_event_to_dcb(
 	GWBUF*     buf,
 	__uint32_t ev)
 {	
+	POLL_QUEUE *queue = poll_dcb_queue(dcb);
+
 	/** Add buf to readqueue */
 	spinlock_acquire(&dcb->authlock);
 	dcb->dcb_readqueue = gwbuf_append(dcb->dcb_readqueue, buf);
 	spinlock_release(&dcb->authlock);
 		
-	spinlock_acquire(&pollqlock);
-	
-	/** Set event to DCB */
-	if (DCB_POLL_BUSY(dcb))
-	{
-		if (dcb->evq.pending_events == 0)
-		{
-			pollStats.evq_pending++;
-		}
-		dcb->evq.pending_events |= ev;
-	}
-	else
-	{
-		dcb->evq.pending_events = ev;
-		/** Add DCB to eventqueue if it isn't already there */
-		if (eventq)
-		{
-			dcb->evq.prev = eventq->evq.prev;
-			eventq->evq.prev->evq.next = dcb;
-			eventq->evq.prev = dcb;
-			dcb->evq.next = eventq;
-		}
-		else
-		{
-			eventq = dcb;
-			dcb->evq.prev = dcb;
-			dcb->evq.next = dcb;
-		}
-		pollStats.evq_length++;
-		pollStats.evq_pending++;
-		
-		if (pollStats.evq_length > pollStats.evq_max)
-		{
-			pollStats.evq_max = pollStats.evq_length;
-		}
-	}
-	spinlock_release(&pollqlock);
+	spinlock_acquire(&queue->lock);
+	/** Set event to DCB and add it to the event queue if it isn't there */
+	poll_queue_event(queue, dcb, ev);
+	spinlock_release(&queue->lock);
+
+	poll_wakeup(queue);
 }
 
 /*
@@ -1409,9 +1618,10 @@ static void poll_add_event_to_dcb(
 void
 poll_fake_write_event(DCB *dcb)
 {
-uint32_t ev = EPOLLOUT;
+uint32_t	ev = EPOLLOUT;
+POLL_QUEUE	*queue = poll_dcb_queue(dcb);
 
-	spinlock_acquire(&pollqlock);
+	spinlock_acquire(&queue->lock);
 	/*
 	 * If the DCB is already on the queue, there are no pending events and
 	 * there are other events on the queue, then
@@ -1421,45 +1631,18 @@ uint32_t ev = EPOLLOUT;
 	{
 		dcb->evq.prev->evq.next = dcb->evq.next;
 		dcb->evq.next->evq.prev = dcb->evq.prev;
-		if (eventq == dcb)
-			eventq = dcb->evq.next;
+		if (queue->eventq == dcb)
+			queue->eventq = dcb->evq.next;
 		dcb->evq.next = NULL;
 		dcb->evq.prev = NULL;
-		pollStats.evq_length--;
+		queue->evq_length--;
+		atomic_add(&pollStats.evq_length, -1);
 	}
 
-	if (DCB_POLL_BUSY(dcb))
-	{
-		if (dcb->evq.pending_events == 0)
-			pollStats.evq_pending++;
-		dcb->evq.pending_events |= ev;
-	}
-	else
-	{
-		dcb->evq.pending_events = ev;
-		dcb->evq.inserted = hkheartbeat;
-		if (eventq)
-		{
-			dcb->evq.prev = eventq->evq.prev;
-			eventq->evq.prev->evq.next = dcb;
-			eventq->evq.prev = dcb;
-			dcb->evq.next = eventq;
-		}
-		else
-		{
-			eventq = dcb;
-			dcb->evq.prev = dcb;
-			dcb->evq.next = dcb;
-		}
-		pollStats.evq_length++;
-		pollStats.evq_pending++;
-		dcb->evq.inserted = hkheartbeat;
-		if (pollStats.evq_length > pollStats.evq_max)
-		{
-			pollStats.evq_max = pollStats.evq_length;
-		}
-	}
-	spinlock_release(&pollqlock);
+	poll_queue_event(queue, dcb, ev);
+	spinlock_release(&queue->lock);
+
+	poll_wakeup(queue);
 }
 
 /**
@@ -1472,29 +1655,38 @@ dShowEventQ(DCB *pdcb)
 {
 DCB		*dcb;
 char		*tmp1, *tmp2;
+int		i;
 
-	spinlock_acquire(&pollqlock);
-	if (eventq == NULL)
+	for (i = 0; i < n_poll_queues; i++)
 	{
-		/* Nothing to process */
-		spinlock_release(&pollqlock);
-		return;
+		POLL_QUEUE	*queue = &poll_queues[i];
+
+		spinlock_acquire(&queue->lock);
+		if (queue->eventq == NULL)
+		{
+			/* Nothing to process */
+			spinlock_release(&queue->lock);
+			continue;
+		}
+		dcb = queue->eventq;
+		if (poll_affinity)
+			dcb_printf(pdcb, "\nEvent Queue of thread %d.\n", i);
+		else
+			dcb_printf(pdcb, "\nEvent Queue.\n");
+		dcb_printf(pdcb, "%-16s | %-10s | %-18s | %s\n", "DCB", "Status", "Processing Events",
+					"Pending Events");
+		dcb_printf(pdcb, "-----------------+------------+--------------------+-------------------\n");
+		do {
+			dcb_printf(pdcb, "%-16p | %-10s | %-18s | %-18s\n", dcb,
+					dcb->evq.processing ? "Processing" : "Pending", 
+					   (tmp1 = event_to_string(dcb->evq.processing_events)),
+					   (tmp2 = event_to_string(dcb->evq.pending_events)));
+			free(tmp1);
+			free(tmp2);
+			dcb = dcb->evq.next;
+		} while (dcb != queue->eventq);
+		spinlock_release(&queue->lock);
 	}
-	dcb = eventq;
-	dcb_printf(pdcb, "\nEvent Queue.\n");
-	dcb_printf(pdcb, "%-16s | %-10s | %-18s | %s\n", "DCB", "Status", "Processing Events",
-				"Pending Events");
-	dcb_printf(pdcb, "-----------------+------------+--------------------+-------------------\n");
-	do {
-		dcb_printf(pdcb, "%-16p | %-10s | %-18s | %-18s\n", dcb,
-				dcb->evq.processing ? "Processing" : "Pending", 
-				   (tmp1 = event_to_string(dcb->evq.processing_events)),
-				   (tmp2 = event_to_string(dcb->evq.pending_events)));
-		free(tmp1);
-		free(tmp2);
-		dcb = dcb->evq.next;
-	} while (dcb != eventq);
-	spinlock_release(&pollqlock);
 }
 
 
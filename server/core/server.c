@@ -44,6 +44,7 @@
 #include <dcb.h>
 #include <skygw_utils.h>
 #include <log_manager.h>
+#include <histogram.h>
 
 /** Defined in log_manager.cc */
 extern int            lm_enabled_logfiles_bitmask;
@@ -78,6 +79,7 @@ SERVER 	*server;
 	server->rlag = -2;
 	server->master_id = -1;
 	server->depth = -1;
+	spinlock_init(&server->persistlock);
 
 	spinlock_acquire(&server_spin);
 	server->next = allServers;
@@ -122,12 +124,30 @@ SERVER *ptr;
 	free(server->protocol);
 	if (server->unique_name)
 		free(server->unique_name);
+	histogram_free(server->latency_first);
+	histogram_free(server->latency_last);
 	if (server->server_string)
 		free(server->server_string);
 	free(server);
 	return 1;
 }
 
+/**
+ * Configure the connection pool of the server
+ *
+ * @param	server	The server
+ * @param	poolmax	Maximum number of pooled connections, 0 disables the pool
+ * @param	maxtime	Maximum idle time of a pooled connection in seconds
+ * @param	maxage	Maximum age of a pooled connection in seconds
+ */
+void
+server_set_persistent(SERVER *server, int poolmax, long maxtime, long maxage)
+{
+	server->persistpoolmax = poolmax;
+	server->persistmaxtime = maxtime;
+	server->persistmaxage = maxage;
+}
+
 /**
  * Set a unique name for the server
  *
@@ -138,6 +158,11 @@ void
 server_set_unique_name(SERVER *server, char *name)
 {
 	server->unique_name = strdup(name);
+	if (server->latency_first == NULL)
+	{
+		server->latency_first = histogram_alloc("Server", name, "First byte");
+		server->latency_last = histogram_alloc("Server", name, "Last byte");
+	}
 }
 
 /**
@@ -439,6 +464,21 @@ SERVER_PARAM	*param;
 	dcb_printf(dcb, "\tCurrent no. of conns:		%d\n",
 						server->stats.n_current);
         dcb_printf(dcb, "\tCurrent no. of operations:	%d\n", server->stats.n_current_ops);
+	if (server->persistpoolmax > 0)
+	{
+		dcb_printf(dcb, "\tPersistent pool size:		%d\n",
+						server->stats.n_persistent);
+		dcb_printf(dcb, "\tPersistent pool max size:	%d\n",
+						server->persistpoolmax);
+		dcb_printf(dcb, "\tPersistent max idle time:	%ld\n",
+						server->persistmaxtime);
+		dcb_printf(dcb, "\tPersistent max age:		%ld\n",
+						server->persistmaxage);
+		dcb_printf(dcb, "\tPersistent pool hits:		%d\n",
+						server->stats.n_pool_hits);
+		dcb_printf(dcb, "\tPersistent pool misses:		%d\n",
+						server->stats.n_pool_misses);
+	}
 }
 
 /**
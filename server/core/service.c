@@ -61,6 +61,7 @@
 #include <sys/types.h>
 #include <housekeeper.h>
 #include <resultset.h>
+#include <histogram.h>
 
 /** Defined in log_manager.cc */
 extern int            lm_enabled_logfiles_bitmask;
@@ -142,6 +143,7 @@ SERVICE 	*service;
 		return NULL;
 	}
 	service->stats.started = time(0);
+	service->latency = histogram_alloc("Service", service->name, "Routing");
 	service->state = SERVICE_STATE_ALLOC;
 	spinlock_init(&service->spin);
 	spinlock_init(&service->users_table_spin);
@@ -247,8 +249,7 @@ GWPROTOCOL	*funcs;
 				}
 				if (loaded == -1)
 				{
-					hashtable_free(service->users->data);
-					free(service->users);
+					users_free(service->users);
 					dcb_free(port->listener);
 					port->listener = NULL;
 					goto retblock;
@@ -330,11 +331,7 @@ GWPROTOCOL	*funcs;
 	if ((funcs=(GWPROTOCOL *)load_module(port->protocol, MODULE_PROTOCOL)) 
 		== NULL)
 	{
-		if (service->users->data)
-		{
-			hashtable_free(service->users->data);
-		}
-		free(service->users);
+		users_free(service->users);
 		dcb_free(port->listener);
 		port->listener = NULL;
 		LOGIF(LE, (skygw_log_write_flush(
@@ -369,11 +366,7 @@ GWPROTOCOL	*funcs;
 				"Error : Failed to create session to service %s.",
 				service->name)));
 			
-			if (service->users->data)
-			{
-				hashtable_free(service->users->data);
-			}
-			free(service->users);
+			users_free(service->users);
                         dcb_close(port->listener);
 			port->listener = NULL;
 			goto retblock;
@@ -387,11 +380,7 @@ GWPROTOCOL	*funcs;
 			port->port,
                         port->protocol,
                         service->name)));
-		if (service->users->data)
-		{
-			hashtable_free(service->users->data);
-		}
-		free(service->users);
+		users_free(service->users);
 		dcb_close(port->listener);
 		port->listener = NULL;
         }
@@ -596,6 +585,7 @@ SERVER_REF *srv;
             free(srv);
         }
         
+	histogram_free(service->latency);
 	free(service->name);
 	free(service->routerModule);
 	if (service->credentials.name)
@@ -860,6 +850,24 @@ serviceOptimizeWildcard(SERVICE *service, int action)
 	return 1;
 }
 
+/**
+ * Enable/Disable the use of scatter/gather writes for the connections
+ * of the service
+ *
+ * @param service	The service we are setting the data for
+ * @param action	1 to write buffer chains with writev, 0 for normal writes
+ * @return		0 on failure
+ */
+int
+serviceScatterGatherWrites(SERVICE *service, int action)
+{
+	if (action != 0 && action != 1)
+		return 0;
+
+	service->scatter_gather_writes = action;
+	return 1;
+}
+
 /**
  * Whether to strip escape characters from the name of the database the client
  * is connecting to.
@@ -1132,6 +1140,13 @@ int		i;
 						service->stats.n_sessions);
 	dcb_printf(dcb, "\tCurrently connected:			%d\n",
 						service->stats.n_current);
+	if (service->scatter_gather_writes)
+	{
+		dcb_printf(dcb, "\tScatter/gather writes:			%d\n",
+						service->stats.n_writev);
+		dcb_printf(dcb, "\tWrite calls saved:			%d\n",
+						service->stats.n_writev_saved);
+	}
 }
 
 /**
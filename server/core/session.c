@@ -43,20 +43,47 @@
 #include <skygw_utils.h>
 #include <log_manager.h>
 #include <housekeeper.h>
+#include <objpool.h>
+#include <histogram.h>
 
 /** Defined in log_manager.cc */
 extern int            lm_enabled_logfiles_bitmask;
 extern size_t         log_ses_count[];
 extern __thread log_info_t tls_log_info;
 
-/** Global session id; updated safely by holding session_spin */
+/** Global session id; updated atomically */
 static size_t session_id;
 
-static SPINLOCK	session_spin = SPINLOCK_INIT;
-static SESSION	*allSessions = NULL;
+/**
+ * The sessions are kept in a number of separately locked doubly linked lists
+ * so that adding and removing a session is a constant time operation that only
+ * contends with the sessions in the same list. The list of a session is chosen
+ * by its address.
+ */
+#define	SESSION_REGISTRY_SHARDS	16
+#define	SESSION_REGISTRY(ses)	\
+	(&allSessions[((uintptr_t)(ses) / sizeof(SESSION)) % SESSION_REGISTRY_SHARDS])
+
+typedef struct {
+	SPINLOCK	lock;		/*< Protects the list */
+	SESSION		*head;		/*< First session in the list */
+	SESSION		*tail;		/*< Last session in the list */
+} SESSION_REGISTRY;
+
+static SESSION_REGISTRY	allSessions[SESSION_REGISTRY_SHARDS];
+
+/**
+ * The memory of the freed sessions is kept in the object pool for the next
+ * connections. The child sessions of cloned DCBs are released by the filter
+ * that created them and are allocated with calloc.
+ */
+#define	SESSION_POOL_MAX_FREE	256
+
+static OBJPOOL		*session_pool = NULL;
 
 
 static int session_setup_filters(SESSION *session);
+static SESSION *session_get_next(SESSION *session);
 
 /**
  * Allocate a new session for a new client of the specified service.
@@ -74,7 +101,17 @@ session_alloc(SERVICE *service, DCB *client_dcb)
 {
         SESSION 	*session;
 
-        session = (SESSION *)calloc(1, sizeof(SESSION));
+	if (DCB_IS_CLONE(client_dcb))
+	{
+		session = (SESSION *)calloc(1, sizeof(SESSION));
+	}
+	else
+	{
+		if (session_pool == NULL)
+			session_pool = objpool_get("SESSION", sizeof(SESSION),
+						SESSION_POOL_MAX_FREE);
+		session = session_pool ? (SESSION *)objpool_alloc(session_pool) : NULL;
+	}
         ss_info_dassert(session != NULL,
                         "Allocating memory for session failed.");
         
@@ -227,18 +264,23 @@ session_alloc(SERVICE *service, DCB *client_dcb)
                         LOGFILE_ERROR,
                         "Error : Failed to create %s session.",
                         service->name)));
-                spinlock_release(&session_spin);
         }
         else
         {
+                SESSION_REGISTRY *registry = SESSION_REGISTRY(session);
+
                 session->state = SESSION_STATE_ROUTER_READY;
 		spinlock_release(&session->ses_lock);		
-		spinlock_acquire(&session_spin);
 		/** Assign a session id and increase */
-		session->ses_id = ++session_id; 
-		session->next = allSessions;
-                allSessions = session;
-                spinlock_release(&session_spin);
+		session->ses_id = __sync_add_and_fetch(&session_id, 1);
+		spinlock_acquire(&registry->lock);
+		session->prev = registry->tail;
+		if (registry->tail)
+			registry->tail->next = session;
+		else
+			registry->head = session;
+		registry->tail = session;
+                spinlock_release(&registry->lock);
                 
 		if (session->client->user == NULL)
 		{
@@ -369,7 +411,7 @@ bool session_free(
         SESSION *session)
 {
         bool    succp = false;
-        SESSION *ptr;
+        SESSION_REGISTRY *registry;
         int     nlink;
 	int	i;
 
@@ -386,22 +428,22 @@ bool session_free(
         }
         
 	/* First of all remove from the linked list */
-	spinlock_acquire(&session_spin);
-	if (allSessions == session)
-	{
-		allSessions = session->next;
-	}
-	else
+	registry = SESSION_REGISTRY(session);
+	spinlock_acquire(&registry->lock);
+	if (session->prev || registry->head == session)
 	{
-		ptr = allSessions;
-		while (ptr && ptr->next != session)
-		{
-			ptr = ptr->next;
-		}
-		if (ptr)
-			ptr->next = session->next;
+		if (session->prev)
+			session->prev->next = session->next;
+		else
+			registry->head = session->next;
+		if (session->next)
+			session->next->prev = session->prev;
+		else
+			registry->tail = session->prev;
+		session->next = NULL;
+		session->prev = NULL;
 	}
-	spinlock_release(&session_spin);
+	spinlock_release(&registry->lock);
 	atomic_add(&session->service->stats.n_current, -1);
 
 	/**
@@ -451,7 +493,7 @@ bool session_free(
 		{
 			free(session->data);
 		}
-		free(session);
+		objpool_free(session_pool, session);
 	}
         succp = true;
         
@@ -468,11 +510,12 @@ return_succp :
 int
 session_isvalid(SESSION *session)
 {
-SESSION		*ptr;
-int		rval = 0;
+SESSION_REGISTRY	*registry = SESSION_REGISTRY(session);
+SESSION			*ptr;
+int			rval = 0;
 
-	spinlock_acquire(&session_spin);
-	ptr = allSessions;
+	spinlock_acquire(&registry->lock);
+	ptr = registry->head;
 	while (ptr)
 	{
 		if (ptr == session)
@@ -482,11 +525,69 @@ int		rval = 0;
 		}
 		ptr = ptr->next;
 	}
-	spinlock_release(&session_spin);
+	spinlock_release(&registry->lock);
 
 	return rval;
 }
 
+/**
+ * Get the next session in the lists of all sessions
+ *
+ * @param session	The current session or NULL for the first session
+ * @return		The next session or NULL if this is the last one
+ */
+static SESSION *
+session_get_next(SESSION *session)
+{
+SESSION_REGISTRY	*registry;
+int			i = 0;
+
+	if (session)
+	{
+		registry = SESSION_REGISTRY(session);
+		spinlock_acquire(&registry->lock);
+		session = session->next;
+		spinlock_release(&registry->lock);
+
+		if (session)
+			return session;
+		i = registry - allSessions + 1;
+	}
+
+	for (; i < SESSION_REGISTRY_SHARDS && session == NULL; i++)
+	{
+		spinlock_acquire(&allSessions[i].lock);
+		session = allSessions[i].head;
+		spinlock_release(&allSessions[i].lock);
+	}
+	return session;
+}
+
+/**
+ * Find a session by its id
+ *
+ * @param id	The session id
+ * @return	The session or NULL if there is no session with the id
+ */
+SESSION *
+session_find_by_id(size_t id)
+{
+SESSION	*ptr = NULL;
+int	i;
+
+	for (i = 0; i < SESSION_REGISTRY_SHARDS && ptr == NULL; i++)
+	{
+		spinlock_acquire(&allSessions[i].lock);
+		for (ptr = allSessions[i].head; ptr; ptr = ptr->next)
+		{
+			if (ptr->ses_id == id)
+				break;
+		}
+		spinlock_release(&allSessions[i].lock);
+	}
+	return ptr;
+}
+
 /**
  * Print details of an individual session
  *
@@ -516,15 +617,17 @@ void
 printAllSessions()
 {
 SESSION	*ptr;
+int	i;
 
-	spinlock_acquire(&session_spin);
-	ptr = allSessions;
-	while (ptr)
+	for (i = 0; i < SESSION_REGISTRY_SHARDS; i++)
 	{
-		printSession(ptr);
-		ptr = ptr->next;
+		spinlock_acquire(&allSessions[i].lock);
+		for (ptr = allSessions[i].head; ptr; ptr = ptr->next)
+		{
+			printSession(ptr);
+		}
+		spinlock_release(&allSessions[i].lock);
 	}
-	spinlock_release(&session_spin);
 }
 
 
@@ -540,51 +643,54 @@ CheckSessions()
 SESSION	*ptr;
 int	noclients = 0;
 int	norouter = 0;
+int	i;
 
-	spinlock_acquire(&session_spin);
-	ptr = allSessions;
-	while (ptr)
+	for (i = 0; i < SESSION_REGISTRY_SHARDS; i++)
 	{
-		if (ptr->state != SESSION_STATE_LISTENER ||
-				ptr->state != SESSION_STATE_LISTENER_STOPPED)
+		spinlock_acquire(&allSessions[i].lock);
+		for (ptr = allSessions[i].head; ptr; ptr = ptr->next)
 		{
-			if (ptr->client == NULL && ptr->refcount)
+			if (ptr->state != SESSION_STATE_LISTENER ||
+					ptr->state != SESSION_STATE_LISTENER_STOPPED)
 			{
-				if (noclients == 0)
+				if (ptr->client == NULL && ptr->refcount)
 				{
-					printf("Sessions without a client DCB.\n");
-					printf("==============================\n");
+					if (noclients == 0)
+					{
+						printf("Sessions without a client DCB.\n");
+						printf("==============================\n");
+					}
+					printSession(ptr);
+					noclients++;
 				}
-				printSession(ptr);
-				noclients++;
 			}
 		}
-		ptr = ptr->next;
+		spinlock_release(&allSessions[i].lock);
 	}
-	spinlock_release(&session_spin);
 	if (noclients)
 		printf("%d Sessions have no clients\n", noclients);
-	spinlock_acquire(&session_spin);
-	ptr = allSessions;
-	while (ptr)
+	for (i = 0; i < SESSION_REGISTRY_SHARDS; i++)
 	{
-		if (ptr->state != SESSION_STATE_LISTENER ||
-				ptr->state != SESSION_STATE_LISTENER_STOPPED)
+		spinlock_acquire(&allSessions[i].lock);
+		for (ptr = allSessions[i].head; ptr; ptr = ptr->next)
 		{
-			if (ptr->router_session == NULL && ptr->refcount)
+			if (ptr->state != SESSION_STATE_LISTENER ||
+					ptr->state != SESSION_STATE_LISTENER_STOPPED)
 			{
-				if (norouter == 0)
+				if (ptr->router_session == NULL && ptr->refcount)
 				{
-					printf("Sessions without a router session.\n");
-					printf("==================================\n");
+					if (norouter == 0)
+					{
+						printf("Sessions without a router session.\n");
+						printf("==================================\n");
+					}
+					printSession(ptr);
+					norouter++;
 				}
-				printSession(ptr);
-				norouter++;
 			}
 		}
-		ptr = ptr->next;
+		spinlock_release(&allSessions[i].lock);
 	}
-	spinlock_release(&session_spin);
 	if (norouter)
 		printf("%d Sessions have no router session\n", norouter);
 }
@@ -603,38 +709,40 @@ dprintAllSessions(DCB *dcb)
 struct tm	result;
 char		timebuf[40];
 SESSION		*ptr;
+int		i;
 
-	spinlock_acquire(&session_spin);
-	ptr = allSessions;
-	while (ptr)
+	for (i = 0; i < SESSION_REGISTRY_SHARDS; i++)
 	{
+		spinlock_acquire(&allSessions[i].lock);
+		for (ptr = allSessions[i].head; ptr; ptr = ptr->next)
+		{
 
-		dcb_printf(dcb, "Session %d (%p)\n",ptr->ses_id, ptr);
-		dcb_printf(dcb, "\tState:    		%s\n", session_state(ptr->state));
-		dcb_printf(dcb, "\tService:		%s (%p)\n", ptr->service->name, ptr->service);
-		dcb_printf(dcb, "\tClient DCB:		%p\n", ptr->client);
+			dcb_printf(dcb, "Session %d (%p)\n",ptr->ses_id, ptr);
+			dcb_printf(dcb, "\tState:    		%s\n", session_state(ptr->state));
+			dcb_printf(dcb, "\tService:		%s (%p)\n", ptr->service->name, ptr->service);
+			dcb_printf(dcb, "\tClient DCB:		%p\n", ptr->client);
 
-		if (ptr->client && ptr->client->remote)
-		{
-			dcb_printf(dcb, "\tClient Address:		%s%s%s\n",
-                       ptr->client->user?ptr->client->user:"",
-                       ptr->client->user?"@":"",
-                       ptr->client->remote);
-		}
+			if (ptr->client && ptr->client->remote)
+			{
+				dcb_printf(dcb, "\tClient Address:		%s%s%s\n",
+	                       ptr->client->user?ptr->client->user:"",
+	                       ptr->client->user?"@":"",
+	                       ptr->client->remote);
+			}
 
-		dcb_printf(dcb, "\tConnected:		%s",
-			asctime_r(localtime_r(&ptr->stats.connect, &result), timebuf));
+			dcb_printf(dcb, "\tConnected:		%s",
+				asctime_r(localtime_r(&ptr->stats.connect, &result), timebuf));
 
-		if(ptr->client && ptr->client->state == DCB_STATE_POLLING)
-		{
-		    double idle = (hkheartbeat - ptr->client->last_read);
-		    idle = idle > 0 ? idle/10.0:0;
-		    dcb_printf(dcb, "\tIdle:			   	%.0f seconds\n",idle);
-		}
+			if(ptr->client && ptr->client->state == DCB_STATE_POLLING)
+			{
+			    double idle = (hkheartbeat - ptr->client->last_read);
+			    idle = idle > 0 ? idle/10.0:0;
+			    dcb_printf(dcb, "\tIdle:			   	%.0f seconds\n",idle);
+			}
 		
-		ptr = ptr->next;
+		}
+		spinlock_release(&allSessions[i].lock);
 	}
-	spinlock_release(&session_spin);
 }
 
 /**
@@ -700,29 +808,32 @@ void
 dListSessions(DCB *dcb)
 {
 SESSION	*ptr;
+int	i;
+int	n = 0;
 
-	spinlock_acquire(&session_spin);
-	ptr = allSessions;
-	if (ptr)
+	for (i = 0; i < SESSION_REGISTRY_SHARDS; i++)
 	{
-		dcb_printf(dcb, "Sessions.\n");
-		dcb_printf(dcb, "-----------------+-----------------+----------------+--------------------------\n");
-		dcb_printf(dcb, "Session          | Client          | Service        | State\n");
-		dcb_printf(dcb, "-----------------+-----------------+----------------+--------------------------\n");
-	}
-	while (ptr)
-	{
-		dcb_printf(dcb, "%-16p | %-15s | %-14s | %s\n", ptr,
-			((ptr->client && ptr->client->remote)
-				? ptr->client->remote : ""),
-			(ptr->service && ptr->service->name ? ptr->service->name
-				: ""),
-			session_state(ptr->state));
-		ptr = ptr->next;
+		spinlock_acquire(&allSessions[i].lock);
+		for (ptr = allSessions[i].head; ptr; ptr = ptr->next)
+		{
+			if (n++ == 0)
+			{
+				dcb_printf(dcb, "Sessions.\n");
+				dcb_printf(dcb, "-----------------+-----------------+----------------+--------------------------\n");
+				dcb_printf(dcb, "Session          | Client          | Service        | State\n");
+				dcb_printf(dcb, "-----------------+-----------------+----------------+--------------------------\n");
+			}
+			dcb_printf(dcb, "%-16p | %-15s | %-14s | %s\n", ptr,
+				((ptr->client && ptr->client->remote)
+					? ptr->client->remote : ""),
+				(ptr->service && ptr->service->name ? ptr->service->name
+					: ""),
+				session_state(ptr->state));
+		}
+		spinlock_release(&allSessions[i].lock);
 	}
-	if (allSessions)
+	if (n)
 		dcb_printf(dcb, "-----------------+-----------------+----------------+--------------------------\n\n");
-	spinlock_release(&session_spin);
 }
 
 /**
@@ -763,19 +874,79 @@ session_state(int state)
 SESSION* get_session_by_router_ses(
         void* rses)
 {
-        SESSION* ses = allSessions;
-        
-        while (ses->router_session != rses && ses->next != NULL)
-                ses = ses->next;
-        
-        if (ses->router_session != rses)
+        SESSION* ses = NULL;
+        int      i;
+
+        for (i = 0; i < SESSION_REGISTRY_SHARDS && ses == NULL; i++)
         {
-                ses = NULL;
+                spinlock_acquire(&allSessions[i].lock);
+                ses = allSessions[i].head;
+
+                while (ses != NULL && ses->router_session != rses)
+                        ses = ses->next;
+                spinlock_release(&allSessions[i].lock);
         }
         return ses;
 }
 
 
+/**
+ * The time the routeQuery of the filters and the router called by the current
+ * filter of the thread have taken, in microseconds.
+ */
+static __thread unsigned long session_nested_usecs;
+
+/**
+ * The downstream entry point of a filter in the filter chain of a session.
+ * Calls the routeQuery of the filter and records the time spent in the filter
+ * itself, that is without the time of the filters and the router after it.
+ *
+ * @param instance	The SESSION_FILTER of the filter
+ * @param fsession	The filter session
+ * @param queue		The request
+ * @return The return value of the routeQuery of the filter
+ */
+static int
+session_route_filter(void *instance, void *fsession, GWBUF *queue)
+{
+SESSION_FILTER	*filter = (SESSION_FILTER *)instance;
+unsigned long	start, elapsed, nested = session_nested_usecs;
+int		rc;
+
+	session_nested_usecs = 0;
+	start = histogram_usecs();
+	rc = filter->filter->obj->routeQuery(filter->instance, fsession, queue);
+	elapsed = histogram_usecs() - start;
+	if (filter->filter->latency && elapsed >= session_nested_usecs)
+		histogram_add(filter->filter->latency,
+			elapsed - session_nested_usecs);
+	session_nested_usecs = nested + elapsed;
+	return rc;
+}
+
+/**
+ * The downstream entry point of the router after the last filter of a
+ * session. Calls the routeQuery of the router and adds the time it took to
+ * the time of the calls made by the last filter.
+ *
+ * @param instance	The session
+ * @param rsession	The router session
+ * @param queue		The request
+ * @return The return value of the routeQuery of the router
+ */
+static int
+session_route_router(void *instance, void *rsession, GWBUF *queue)
+{
+SESSION		*session = (SESSION *)instance;
+unsigned long	start = histogram_usecs();
+int		rc;
+
+	rc = session->service->router->routeQuery(
+		session->service->router_instance, rsession, queue);
+	session_nested_usecs += histogram_usecs() - start;
+	return rc;
+}
+
 /**
  * Create the filter chain for this session.
  *
@@ -806,6 +977,13 @@ int		i;
 			return 0;
 	}
 	session->n_filters = service->n_filters;
+	/*<
+	 * The filters are called through session_route_filter, which records
+	 * the time spent in each filter, and the last one calls the router
+	 * through session_route_router.
+	 */
+	session->head.instance = session;
+	session->head.routeQuery = session_route_router;
 	for (i = service->n_filters - 1; i >= 0; i--)
 	{
 		if (service->filters[i] == NULL)
@@ -830,7 +1008,9 @@ int		i;
 		session->filters[i].filter = service->filters[i];
 		session->filters[i].session = head->session;
 		session->filters[i].instance = head->instance;
-		session->head = *head;
+		session->head.instance = &session->filters[i];
+		session->head.session = head->session;
+		session->head.routeQuery = session_route_filter;
                 free(head);
 	}
 
@@ -932,12 +1112,14 @@ session_getUser(SESSION *session)
 	return (session && session->client) ? session->client->user : NULL;
 }
 /**
- * Return the pointer to the list of all sessions.
- * @return Pointer to the list of all sessions.
+ * Return the first session in the lists of all sessions. The rest of the
+ * sessions are reached with the next pointer of the session and then the
+ * following lists.
+ * @return Pointer to the first session or NULL if there are no sessions.
  */
 SESSION *get_all_sessions()
 {
-	return allSessions;
+	return session_get_next(NULL);
 }
 
 /**
@@ -952,9 +1134,7 @@ void session_close_timeouts(void* data)
 {
     SESSION* ses;
     
-    spinlock_acquire(&session_spin);
     ses = get_all_sessions();
-    spinlock_release(&session_spin);
     
     while(ses)
     {
@@ -965,9 +1145,7 @@ void session_close_timeouts(void* data)
 	    ses->client->func.hangup(ses->client);
 	}
 	
-	spinlock_acquire(&session_spin);
-	ses = ses->next;
-	spinlock_release(&session_spin);
+	ses = session_get_next(ses);
 	
     }
 }
@@ -976,6 +1154,7 @@ void session_close_timeouts(void* data)
  * Callback structure for the session list extraction
  */
 typedef struct {
+	int			shard;
 	int			index;
 	SESSIONLISTFILTER	filter;
 } SESSIONFILTER;
@@ -984,48 +1163,44 @@ typedef struct {
  * Provide a row to the result set that defines the set of sessions
  *
  * @param set	The result set
- * @param data	The index of the row to send
+ * @param data	The list and the index in the list of the row to send
  * @return The next row or NULL
  */
 static RESULT_ROW *
 sessionRowCallback(RESULTSET *set, void *data)
 {
 SESSIONFILTER	*cbdata = (SESSIONFILTER *)data;
-int		i = 0;
+int		i;
 char		buf[20];
 RESULT_ROW	*row;
-SESSION		*ptr;
+SESSION		*ptr = NULL;
 
-	spinlock_acquire(&session_spin);
-	ptr = allSessions;
-	/* Skip to the first non-listener if not showing listeners */
-	while (ptr && cbdata->filter == SESSION_LIST_CONNECTION &&
-			ptr->state == SESSION_STATE_LISTENER)
-	{
-		ptr = ptr->next;
-	}
-	while (i < cbdata->index && ptr)
+	for (; cbdata->shard < SESSION_REGISTRY_SHARDS; cbdata->shard++)
 	{
-		if (cbdata->filter == SESSION_LIST_CONNECTION &&
-			ptr->state !=  SESSION_STATE_LISTENER)
+		spinlock_acquire(&allSessions[cbdata->shard].lock);
+		i = 0;
+		for (ptr = allSessions[cbdata->shard].head; ptr; ptr = ptr->next)
 		{
-			i++;
+			/* Skip the listeners if not showing listeners */
+			if (cbdata->filter == SESSION_LIST_CONNECTION &&
+				ptr->state == SESSION_STATE_LISTENER)
+			{
+				continue;
+			}
+			if (i++ == cbdata->index)
+			{
+				break;
+			}
 		}
-		else if (cbdata->filter == SESSION_LIST_ALL)
+		if (ptr)
 		{
-			i++;
+			break;
 		}
-		ptr = ptr->next;
-	}
-	/* Skip to the next non-listener if not showing listeners */
-	while (ptr && cbdata->filter == SESSION_LIST_CONNECTION &&
-			ptr->state == SESSION_STATE_LISTENER)
-	{
-		ptr = ptr->next;
+		spinlock_release(&allSessions[cbdata->shard].lock);
+		cbdata->index = 0;
 	}
 	if (ptr == NULL)
 	{
-		spinlock_release(&session_spin);
 		free(data);
 		return NULL;
 	}
@@ -1038,7 +1213,7 @@ SESSION		*ptr;
 	resultset_row_set(row, 2, (ptr->service && ptr->service->name
 				? ptr->service->name : ""));
 	resultset_row_set(row, 3, session_state(ptr->state));
-	spinlock_release(&session_spin);
+	spinlock_release(&allSessions[cbdata->shard].lock);
 	return row;
 }
 
@@ -1055,6 +1230,7 @@ SESSIONFILTER	*data;
 
 	if ((data = (SESSIONFILTER *)malloc(sizeof(SESSIONFILTER))) == NULL)
 		return NULL;
+	data->shard = 0;
 	data->index = 0;
 	data->filter = filter;
 	if ((set = resultset_create(sessionRowCallback, data)) == NULL)
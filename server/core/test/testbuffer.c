@@ -154,11 +154,52 @@ int     buflen;
 	return 0;
 }
 
+static int pool_hits;
+
+static void
+pool_reporter(void *hdl, char *desc, int value)
+{
+	if (strstr(desc, "pool hits"))
+		pool_hits += value;
+}
+
+/**
+ * test2	Check that released buffers are reused from the buffer pool
+ *
+ */
+static int
+test2()
+{
+GWBUF   *buffer, *clone;
+int     hits;
+
+        ss_dfprintf(stderr, "testbuffer : allocating and releasing buffers");
+        buffer = gwbuf_alloc(1000);
+        clone = gwbuf_clone(buffer);
+        gwbuf_free(buffer);
+        ss_info_dassert(clone->sbuf->refcount == 1, "Clone should hold the only reference");
+        gwbuf_free(clone);
+        pool_hits = 0;
+        gwbuf_pool_stats(pool_reporter, NULL);
+        hits = pool_hits;
+        buffer = gwbuf_alloc(1000);
+        ss_info_dassert(GWBUF_LENGTH(buffer) == 1000, "Incorrect buffer size");
+        memset(GWBUF_DATA(buffer), 'a', 1000);
+        pool_hits = 0;
+        gwbuf_pool_stats(pool_reporter, NULL);
+        ss_info_dassert(pool_hits == hits + 2, "Header and data should come from the pool");
+        gwbuf_free(buffer);
+        ss_dfprintf(stderr, "\t..done\n");
+
+	return 0;
+}
+
 int main(int argc, char **argv)
 {
 int	result = 0;
 
 	result += test1();
+	result += test2();
 
 	exit(result);
 }
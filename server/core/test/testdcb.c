@@ -30,8 +30,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <dcb.h>
+#include <service.h>
 
 /**
  * test1	Allocate a dcb and do lots of other things
@@ -75,11 +77,170 @@ int     buflen;
 	return 0;
 }
 
+/**
+ * test2	Allocate and free many DCBs in a mixed order and check that
+ *		the list of all DCBs stays consistent
+ *
+ */
+static int
+test2()
+{
+DCB	*dcbs[1000];
+int	ndcbs = sizeof(dcbs) / sizeof(dcbs[0]);
+int	count, i;
+
+        ss_dfprintf(stderr, "testdcb : allocating %d DCBs", ndcbs);
+        count = dcb_count_by_usage(DCB_USAGE_ALL);
+        for (i = 0; i < ndcbs; i++)
+        {
+                dcbs[i] = dcb_alloc(DCB_ROLE_REQUEST_HANDLER);
+                ss_info_dassert(dcbs[i] != NULL, "DCB must be allocated");
+        }
+        ss_info_dassert(dcb_count_by_usage(DCB_USAGE_ALL) == count + ndcbs,
+                        "All new DCBs must be in the list");
+        for (i = 0; i < ndcbs; i++)
+        {
+                ss_info_dassert(dcb_isvalid(dcbs[i]), "New DCB must be valid");
+        }
+        ss_dfprintf(stderr, "\t..done\nFree every other DCB");
+        for (i = 0; i < ndcbs; i += 2)
+        {
+                dcb_free(dcbs[i]);
+        }
+        ss_info_dassert(dcb_count_by_usage(DCB_USAGE_ALL) == count + ndcbs / 2,
+                        "Freed DCBs must be removed from the list");
+        for (i = 1; i < ndcbs; i += 2)
+        {
+                ss_info_dassert(dcb_isvalid(dcbs[i]), "Remaining DCB must be valid");
+        }
+        ss_dfprintf(stderr, "\t..done\nFree the rest in reverse order");
+        for (i = ndcbs - 1; i > 0; i -= 2)
+        {
+                dcb_free(dcbs[i]);
+        }
+        ss_info_dassert(dcb_count_by_usage(DCB_USAGE_ALL) == count,
+                        "All DCBs must be removed from the list");
+        ss_dfprintf(stderr, "\t..done\n");
+
+	return 0;
+}
+
+/**
+ * test3	Check that a zombie DCB is freed only after all polling threads
+ *		have recorded a later zombie epoch than the one it was closed in
+ *
+ */
+static int
+test3()
+{
+DCB	*dcb;
+
+        ss_dfprintf(stderr, "testdcb : zombie processing of two polling threads");
+        ss_info_dassert(dcb_zombies_init(2), "Zombie lists must be allocated");
+        /* Thread 1 records the epoch before the DCB is closed */
+        dcb_process_zombies(1);
+        /* Thread 0 closes the DCB */
+        dcb_process_zombies(0);
+        dcb = dcb_alloc(DCB_ROLE_REQUEST_HANDLER);
+        dcb->state = DCB_STATE_NOPOLLING;
+        dcb_add_to_zombieslist(dcb);
+        ss_info_dassert(dcb_get_zombies() == dcb,
+                        "DCB must be on the zombie list of thread 0");
+        dcb_process_zombies(0);
+        ss_info_dassert(dcb_isvalid(dcb),
+                        "DCB must not be freed before thread 1 records an epoch");
+        ss_dfprintf(stderr, "\t..done\nThread 1 records a later epoch");
+        dcb_process_zombies(1);
+        ss_info_dassert(dcb_isvalid(dcb),
+                        "DCB must be freed only by the thread that closed it");
+        dcb_process_zombies(0);
+        ss_info_dassert(!dcb_isvalid(dcb),
+                        "DCB must be freed after all threads recorded an epoch");
+        ss_dfprintf(stderr, "\t..done\n");
+
+	return 0;
+}
+
+/**
+ * test4	Check that the memory of a freed DCB is reused for the next DCB
+ *		allocated by the same thread and that the DCB is reinitialised
+ *
+ */
+static int
+test4()
+{
+DCB	*dcb, *dcb2;
+
+        ss_dfprintf(stderr, "testdcb : reuse of freed DCBs");
+        dcb = dcb_alloc(DCB_ROLE_REQUEST_HANDLER);
+        dcb->remote = strdup("127.0.0.1");
+        dcb_free(dcb);
+        dcb2 = dcb_alloc(DCB_ROLE_SERVICE_LISTENER);
+        ss_info_dassert(dcb2 == dcb, "Freed DCB must be reused");
+        ss_info_dassert(dcb_isvalid(dcb2), "Reused DCB must be valid");
+        ss_info_dassert(dcb2->remote == NULL && dcb2->flags == 0 &&
+                        dcb2->protocol == NULL && dcb2->protocol_pool == NULL,
+                        "Reused DCB must not have data of the freed DCB");
+        ss_info_dassert(dcb2->state == DCB_STATE_ALLOC &&
+                        dcb2->dcb_role == DCB_ROLE_SERVICE_LISTENER,
+                        "Reused DCB must be initialised");
+        dcb_free(dcb2);
+        ss_dfprintf(stderr, "\t..done\n");
+
+	return 0;
+}
+
+/**
+ * test5	Check that a write queue that ends in an empty buffer is drained
+ *		with scatter/gather writes
+ *
+ */
+static int
+test5()
+{
+DCB	*dcb;
+SERVICE	service;
+GWBUF	*queue;
+int	fds[2];
+char	data[10];
+
+        ss_dfprintf(stderr, "testdcb : drain a write queue ending in an empty buffer");
+        memset(&service, 0, sizeof(service));
+        service.scatter_gather_writes = true;
+        ss_info_dassert(pipe(fds) == 0, "Pipe must be created");
+        dcb = dcb_alloc(DCB_ROLE_REQUEST_HANDLER);
+        dcb->fd = fds[1];
+        dcb->service = &service;
+        queue = gwbuf_append(gwbuf_alloc(sizeof(data)), gwbuf_alloc(0));
+        dcb->writeq = queue;
+        dcb->writeqlen = sizeof(data);
+        /** A busy loop on the empty buffer fails the test */
+        alarm(10);
+        ss_info_dassert(dcb_drain_writeq(dcb) == sizeof(data),
+                        "All data must be written");
+        alarm(0);
+        ss_info_dassert(dcb->writeq == NULL, "Empty buffer must be removed");
+        ss_info_dassert(read(fds[0], data, sizeof(data)) == sizeof(data),
+                        "Data must be readable from the pipe");
+        dcb->fd = -1;
+        dcb->service = NULL;
+        dcb_free(dcb);
+        close(fds[0]);
+        close(fds[1]);
+        ss_dfprintf(stderr, "\t..done\n");
+
+	return 0;
+}
+
 int main(int argc, char **argv)
 {
 int	result = 0;
 
 	result += test1();
+	result += test2();
+	result += test3();
+	result += test4();
+	result += test5();
 
 	exit(result);
 }
@@ -32,6 +32,7 @@
 #include <string.h>
 #include <math.h>
 #include <time.h>
+#include <pthread.h>
 
 #include <hashtable.h>
 
@@ -162,6 +163,148 @@ static bool do_hashtest(
         return succp;
 }
 
+/**
+ * Test a concurrent hashtable: it must grow as elements are added and
+ * all the elements must be found after the resizes.
+ */
+static bool do_concurrent_hashtest(
+        int argelems,
+        int argsize)
+{
+        HASHTABLE* h;
+        int        nelems;
+        int        i;
+        int*       val_arr;
+        int        hsize;
+        int        longest;
+
+        ss_dfprintf(stderr,
+                    "testhash : concurrent hash table of initial size %d, "
+                    "including %d elements in total.",
+                    argsize,
+                    argelems);
+
+        val_arr = (int *)malloc(sizeof(int)*argelems);
+        h = hashtable_alloc_concurrent(argsize, hfun, cmpfun);
+
+        for (i=0; i<argelems; i++) {
+            val_arr[i] = i;
+            hashtable_add(h, (void *)&val_arr[i], (void *)&val_arr[i]);
+        }
+        hashtable_get_stats((void *)h, &hsize, &nelems, &longest);
+
+        ss_info_dassert(hsize % HASHTABLE_STRIPES == 0, "Invalid hash size");
+        ss_info_dassert(hsize >= argsize, "Hash table shrunk");
+        ss_info_dassert(nelems == argelems, "Invalid element count");
+        ss_info_dassert(nelems <= hsize * HASHTABLE_MAX_LOAD,
+                        "Hash table did not grow");
+
+        for (i=0; i<argelems; i++) {
+            ss_info_dassert(hashtable_fetch(h, &val_arr[i]) == &val_arr[i],
+                            "Element not found after resize");
+        }
+        for (i=0; i<argelems; i += 2) {
+            ss_info_dassert(hashtable_delete(h, &val_arr[i]) == 1,
+                            "Element could not be deleted");
+        }
+        for (i=0; i<argelems; i++) {
+            ss_info_dassert((hashtable_fetch(h, &val_arr[i]) != NULL) == (i % 2 == 1),
+                            "Wrong element found after delete");
+        }
+        ss_dfprintf(stderr, "\t..done\n");
+
+        hashtable_free(h);
+        free(val_arr);
+        return true;
+}
+
+/** Number of keys in the benchmark table */
+#define BENCH_KEYS 10000
+
+static HASHTABLE* bench_table;
+static int        bench_keys[BENCH_KEYS * 2];
+static int        bench_ops;
+
+/**
+ * Benchmark thread: nine fetches for every add and delete of a key that
+ * only this thread uses.
+ */
+static void* bench_thread(
+        void* data)
+{
+        long         id = (long)data;
+        unsigned int seed = (unsigned int)id;
+        int          i;
+        int*         key;
+
+        for (i = 0; i < bench_ops; i++)
+        {
+            if (i % 10 == 9)
+            {
+                key = &bench_keys[BENCH_KEYS + (id + i) % BENCH_KEYS];
+                hashtable_add(bench_table, key, key);
+                hashtable_delete(bench_table, key);
+            }
+            else
+            {
+                key = &bench_keys[rand_r(&seed) % BENCH_KEYS];
+                ss_info_dassert(hashtable_fetch(bench_table, key) == key,
+                                "Benchmark key not found");
+            }
+        }
+        return NULL;
+}
+
+/**
+ * Multi-threaded throughput benchmark of a hashtable allocated with
+ * the given function, prints the operations per second for 1, 2, 4 and 8
+ * threads.
+ */
+static void do_hashbench(
+        const char* name,
+        HASHTABLE*  (*allocfn)(int, int (*)(), int (*)()),
+        int         ops)
+{
+        pthread_t       threads[8];
+        struct timespec begin, end;
+        double          t;
+        long            i;
+        int             nthr;
+
+        bench_table = allocfn(100, hfun, cmpfun);
+        bench_ops = ops;
+
+        for (i = 0; i < BENCH_KEYS * 2; i++)
+        {
+            bench_keys[i] = i;
+        }
+        for (i = 0; i < BENCH_KEYS; i++)
+        {
+            hashtable_add(bench_table, &bench_keys[i], &bench_keys[i]);
+        }
+
+        for (nthr = 1; nthr <= 8; nthr *= 2)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &begin);
+
+            for (i = 0; i < nthr; i++)
+            {
+                pthread_create(&threads[i], NULL, bench_thread, (void *)i);
+            }
+            for (i = 0; i < nthr; i++)
+            {
+                pthread_join(threads[i], NULL);
+            }
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            t = (end.tv_sec - begin.tv_sec) +
+                (end.tv_nsec - begin.tv_nsec) / 1000000000.0;
+
+            fprintf(stderr, "%-12s %2d threads %12.0f operations/second\n",
+                    name, nthr, nthr * ops / t);
+        }
+        hashtable_free(bench_table);
+}
+
 /** 
  * @node Simple test which creates hashtable and frees it. Size and number of entries
  * sre specified by user and passed as arguments.
@@ -173,9 +316,10 @@ static bool do_hashtest(
  * @details (write detailed description here)
  *
  */
-int main(void)
+int main(int argc, char** argv)
 {
         int rc = 1;
+        int ops = argc > 1 ? atoi(argv[1]) : 100000;
         start = (double) clock();
 
         if (!do_hashtest(0, 1))         goto return_rc;
@@ -188,6 +332,13 @@ int main(void)
         if (!do_hashtest(10000, 133))   goto return_rc;
         if (!do_hashtest(1000, 1000))   goto return_rc;
         if (!do_hashtest(1000, 100000)) goto return_rc;
+        if (!do_concurrent_hashtest(0, 1))         goto return_rc;
+        if (!do_concurrent_hashtest(10, 0))        goto return_rc;
+        if (!do_concurrent_hashtest(1500, 17))     goto return_rc;
+        if (!do_concurrent_hashtest(100000, 100))  goto return_rc;
+
+        do_hashbench("hashtable", hashtable_alloc, ops);
+        do_hashbench("concurrent", hashtable_alloc_concurrent, ops);
         
         rc = 0;
 return_rc:
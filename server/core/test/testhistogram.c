@@ -0,0 +1,146 @@
+/*
+ * This file is distributed as part of MaxScale.  It is free
+ * software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation,
+ * version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Copyright MariaDB Corporation Ab 2015
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <histogram.h>
+#include <skygw_debug.h>
+
+/**
+ * test1	Check the percentiles of a uniform distribution of values
+ *
+ * Every percentile must be within the precision of the buckets of the
+ * exact value and never below it.
+ */
+static int
+test1()
+{
+HISTOGRAM	*hist;
+HISTOGRAM_DATA	data;
+unsigned long	i, value, exact;
+double		pcts[] = { 50.0, 90.0, 99.0, 99.9 };
+int		j;
+
+	ss_dfprintf(stderr, "testhistogram : percentiles of 1 - 100000");
+	hist = histogram_alloc("Test", "uniform", "Values");
+	ss_info_dassert(hist != NULL, "Histogram must be allocated");
+	for (i = 1; i <= 100000; i++)
+		histogram_add(hist, i);
+	histogram_merge(hist, &data);
+	ss_info_dassert(data.count == 100000, "All values must be counted");
+	ss_info_dassert(data.max == 100000, "Maximum must be the largest value");
+	ss_info_dassert(data.sum / data.count == 50000, "Mean must be exact");
+	for (j = 0; j < sizeof(pcts) / sizeof(pcts[0]); j++)
+	{
+		exact = (unsigned long)(pcts[j] * 1000);
+		value = histogram_percentile(&data, pcts[j]);
+		ss_info_dassert(value >= exact &&
+				value <= exact + exact / HISTOGRAM_SUB_BUCKETS,
+				"Percentile must be within the bucket precision");
+	}
+	ss_info_dassert(histogram_percentile(&data, 100.0) == 100000,
+			"The 100th percentile must be the maximum");
+	histogram_free(hist);
+	ss_dfprintf(stderr, "\t..done\n");
+
+	return 0;
+}
+
+/**
+ * test2	Check the small and the out of range values
+ */
+static int
+test2()
+{
+HISTOGRAM	*hist;
+HISTOGRAM_DATA	data;
+
+	ss_dfprintf(stderr, "testhistogram : small and large values");
+	hist = histogram_alloc("Test", "range", "Values");
+	histogram_merge(hist, &data);
+	ss_info_dassert(histogram_percentile(&data, 99.0) == 0,
+			"Empty histogram must have no percentiles");
+	histogram_add(hist, 0);
+	histogram_add(hist, 7);
+	histogram_add(hist, 15);
+	histogram_merge(hist, &data);
+	ss_info_dassert(histogram_percentile(&data, 30.0) == 0 &&
+			histogram_percentile(&data, 60.0) == 7 &&
+			histogram_percentile(&data, 90.0) == 15,
+			"Small values must be exact");
+	histogram_add(hist, 1UL << 40);
+	histogram_merge(hist, &data);
+	ss_info_dassert(histogram_percentile(&data, 100.0) == 0xffffffffUL,
+			"Values out of range must be in the last bucket");
+	histogram_free(hist);
+	ss_dfprintf(stderr, "\t..done\n");
+
+	return 0;
+}
+
+static void *
+add_values(void *arg)
+{
+HISTOGRAM	*hist = (HISTOGRAM *)arg;
+int		i;
+
+	for (i = 0; i < 10000; i++)
+		histogram_add(hist, 1000);
+	return NULL;
+}
+
+/**
+ * test3	Check that the values added by several threads are all merged
+ */
+static int
+test3()
+{
+HISTOGRAM	*hist;
+HISTOGRAM_DATA	data;
+pthread_t	threads[8];
+int		i;
+
+	ss_dfprintf(stderr, "testhistogram : values of 8 threads");
+	hist = histogram_alloc("Test", "threads", "Values");
+	for (i = 0; i < 8; i++)
+		pthread_create(&threads[i], NULL, add_values, hist);
+	for (i = 0; i < 8; i++)
+		pthread_join(threads[i], NULL);
+	histogram_merge(hist, &data);
+	ss_info_dassert(data.count == 80000, "Values of all threads must be merged");
+	ss_info_dassert(histogram_percentile(&data, 50.0) == 1000,
+			"Percentile must be capped by the maximum");
+	histogram_free(hist);
+	ss_dfprintf(stderr, "\t..done\n");
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+int	result = 0;
+
+	result += test1();
+	result += test2();
+	result += test3();
+
+	exit(result);
+}
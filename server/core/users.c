@@ -61,7 +61,7 @@ USERS 	*rval;
         if ((rval = calloc(1, sizeof(USERS))) == NULL)
 		return NULL;
 
-	if ((rval->data = hashtable_alloc(USERS_HASHTABLE_DEFAULT_SIZE, user_hash, strcmp)) == NULL)
+	if ((rval->data = hashtable_alloc_concurrent(USERS_HASHTABLE_DEFAULT_SIZE, user_hash, strcmp)) == NULL)
 	{
 		free(rval);
 		return NULL;
@@ -81,6 +81,8 @@ void
 users_free(USERS *users)
 {
 	hashtable_free(users->data);
+	if (users->index)
+		hashtable_free(users->index);
 	free(users);
 }
 
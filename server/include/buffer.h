@@ -94,6 +94,7 @@ typedef enum
 typedef struct  {
 	unsigned char	*data;			/*< Physical memory that was allocated */
 	int		refcount;		/*< Reference count on the buffer */
+	int		pool_class;		/*< Buffer pool size class, -1 if none */
 } SHARED_BUF;
 
 typedef enum
@@ -193,6 +194,7 @@ extern int		gwbuf_add_property(GWBUF *buf, char *name, char *value);
 extern char		*gwbuf_get_property(GWBUF *buf, char *name);
 extern GWBUF		*gwbuf_make_contiguous(GWBUF *);
 extern int		gwbuf_add_hint(GWBUF *, HINT *);
+extern void		gwbuf_pool_stats(void (*reporter)(void *, char *, int), void *);
 
 void                    gwbuf_add_buffer_object(GWBUF* buf,
                                                 bufobj_id_t id,
@@ -64,6 +64,7 @@ extern int mysql_users_add(USERS *users, MYSQL_USER_HOST *key, char *auth);
 extern int add_mysql_users_with_host_ipv4(USERS *users, char *user, char *host, char *passwd, char *anydb, char *db);
 extern USERS *mysql_users_alloc();
 extern char *mysql_users_fetch(USERS *users, MYSQL_USER_HOST *key);
+extern char *mysql_users_find(USERS *users, MYSQL_USER_HOST *key, bool wildcard);
 extern int replace_mysql_users(SERVICE *service);
 extern int dbusers_save(USERS *, char *);
 extern int dbusers_load(USERS *, char *);
@@ -78,6 +78,9 @@ struct dcb;
 	 *	listen		Create a listener for the protocol
 	 *	auth		Authentication entry point
          *	session		Session handling entry point
+	 *	reset		Check if a backend connection can be pooled
+	 *			when the session is NULL, otherwise reset
+	 *			a pooled connection for the session passed in
 	 * @endverbatim
 	 *
 	 * This forms the "module object" for protocol modules within the gateway.
@@ -96,6 +99,7 @@ typedef struct gw_protocol {
 	int		(*listen)(struct dcb *, char *);
 	int		(*auth)(struct dcb *, struct server *, struct session *, GWBUF *);
 	int		(*session)(struct dcb *, void *);
+	int		(*reset)(struct dcb *, struct session *);
 } GWPROTOCOL;
 
 /**
@@ -127,15 +131,22 @@ typedef struct {
  * the GWPROTOCOL structure is changed. See the rules defined in modinfo.h
  * that define how these numbers should change.
  */
-#define	GWPROTOCOL_VERSION	{1, 0, 0}
+#define	GWPROTOCOL_VERSION	{1, 1, 0}
 
 #define DCBFD_CLOSED -1
 
+/**
+ * The smallest buffer used for reading from a descriptor. The buffer size
+ * adapts to the sizes of the recent reads above this.
+ */
+#define	DCB_MIN_READ_SIZE	512
+
 /**
  * The statitics gathered on a descriptor control block
  */
 typedef struct dcbstats {
 	int	n_reads;	/*< Number of reads on this descriptor */
+	int	n_read_events;	/*< Number of calls to dcb_read */
 	int	n_writes;	/*< Number of writes on this descriptor */
 	int	n_accepts;	/*< Number of accepts on this descriptor */
 	int	n_buffered;	/*< Number of buffered writes */
@@ -155,14 +166,14 @@ typedef struct dcbstats {
  * processing an event that will access the DCB.
  *
  * We solve this issue by making the dcb_free routine merely mark a DCB as a zombie and
- * place it on a special zombie list. Before placing the DCB on the zombie list we create
- * a bitmask with a bit set in it for each active polling thread. Each thread will call
- * a routine to process the zombie list at the end of the polling loop. This routine
- * will clear the bit value that corresponds to the calling thread. Once the bitmask
- * is completely cleared the DCB can finally be freed and removed from the zombie list.
+ * place it on a zombie list of the closing polling thread, stamped with the current
+ * zombie epoch. Each polling thread records the zombie epoch once per polling loop, at
+ * a point where it holds no references to DCBs. Once every running polling thread has
+ * recorded a later epoch than the one the DCB was closed in, no thread can access the
+ * DCB anymore and it is finally freed by the thread that closed it.
  */
 typedef struct {
-	GWBITMASK	bitmask;	/*< The bitmask of threads */
+	int		epoch;		/*< The zombie epoch the DCB was closed in */
 	struct dcb	*next;		/*< Next pointer for the zombie list */
 } DCBMM;
 
@@ -228,13 +239,16 @@ typedef struct dcb {
 	dcb_role_t      dcb_role;
         SPINLOCK        dcb_initlock;
 	DCBEVENTQ	evq;		/**< The event queue for this DCB */
+	int		owner;		/**< Owning polling thread, -1 if none */
 	int	 	fd;		/**< The descriptor */
 	dcb_state_t	state;		/**< Current descriptor state */
 	int		flags;		/**< DCB flags */
+	int		read_avg;	/**< Moving average of the read sizes */
 	char		*remote;	/**< Address of remote end */
 	char		*user;		/**< User name for connection */
 	struct sockaddr_in ipv4;	/**< remote end IPv4 address */
 	void		*protocol;	/**< The protocol specific state */
+	struct objpool	*protocol_pool;	/**< Pool of the protocol state, NULL if malloc'd */
 	struct session	*session;	/**< The owning session */
 	GWPROTOCOL	func;		/**< The functions for this descriptor */
 
@@ -249,6 +263,7 @@ typedef struct dcb {
 	DCBSTATS	stats;		/**< DCB related statistics */
         unsigned int    dcb_server_status; /*< the server role indicator from SERVER */
 	struct dcb	*next;		/**< Next DCB in the chain of allocated DCB's */
+	struct dcb	*prev;		/**< Previous DCB in the chain of allocated DCB's */
 	struct service	*service;	/**< The related service */
 	void		*data;		/**< Specific client data */
 	DCBMM		memdata;	/**< The data related to DCB memory management */
@@ -265,6 +280,11 @@ typedef struct dcb {
 	unsigned int	high_water;	/**< High water mark */
 	unsigned int	low_water;	/**< Low water mark */
 	struct server	*server;	/**< The associated backend server */
+	struct dcb	*nextpersistent; /**< Next DCB in the connection pool */
+	time_t		persistentstart; /**< Time the DCB was pooled, 0 if not */
+	time_t		connected;	/**< Time the backend connection was made */
+	unsigned long	request_sent;	/**< When the request being replied to was written, in microseconds */
+	unsigned long	reply_read;	/**< When data of its reply was last read, in microseconds */
 #if defined(SS_DEBUG)
         int             dcb_port;       /**< port of target server */
         skygw_chk_t     dcb_chk_tail;
@@ -315,12 +335,15 @@ int             dcb_read(DCB *, GWBUF **);
 int             dcb_drain_writeq(DCB *);
 void            dcb_close(DCB *);
 DCB		*dcb_process_zombies(int);		/* Process Zombies except the one behind the pointer */
+int		dcb_zombies_init(int);			/* Allocate the zombie lists of the polling threads */
+void		dcb_zombies_stop(int);			/* Polling thread no longer processes zombies */
 void		printAllDCBs();				/* Debug to print all DCB in the system */
 void		printDCB(DCB *);			/* Debug print routine */
 void		dprintAllDCBs(DCB *);			/* Debug to print all DCB in the system */
 void		dprintDCB(DCB *, DCB *);		/* Debug to print a DCB in the system */
 void		dListDCBs(DCB *);			/* List all DCBs in the system */
 void		dListClients(DCB *);			/* List al the client DCBs */
+void		dprintBufferPoolStats(DCB *);		/* Print buffer pool statistics */
 const char 	*gw_dcb_state2string(int);		/* DCB state to string */
 void		dcb_printf(DCB *, const char *, ...);	/* DCB version of printf */
 int		dcb_isclient(DCB *);			/* the DCB is the client of the session */
@@ -337,6 +360,9 @@ bool   dcb_set_state(DCB* dcb, dcb_state_t new_state, dcb_state_t* old_state);
 void   dcb_call_foreach (struct server* server, DCB_REASON reason);
 size_t dcb_get_session_id(DCB* dcb);
 bool   dcb_get_ses_log_info(DCB* dcb, size_t* sesid, int* enabled_logs);
+bool   dcb_persistent_discard(DCB *dcb);
+void	dcb_latency_request(DCB *);		/* A routed request is written to a backend */
+void	dcb_latency_reply(DCB *);		/* Reply data is read from a backend */
 
 
 
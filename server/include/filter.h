@@ -101,6 +101,8 @@ typedef struct filter_def {
 	FILTER		filter;		/**< The runtime filter */
 	FILTER_OBJECT	*obj;		/**< The "MODULE_OBJECT" for the filter */
 	SPINLOCK	spin;		/**< Spinlock to protect the filter definition */
+	struct histogram
+			*latency;	/**< Time spent in the routeQuery of the filter */
 	struct	filter_def
 			*next;		/**< Next filter in the chain of all filters */
 } FILTER_DEF;
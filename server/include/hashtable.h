@@ -66,6 +66,17 @@ typedef struct hashiterator {
  */
 typedef void *(*HASHMEMORYFN)(void *);
 
+/**
+ * The number of lock stripes of a concurrent hashtable. Bucket i of the
+ * table is protected by stripe i % HASHTABLE_STRIPES.
+ */
+#define HASHTABLE_STRIPES	16
+
+/**
+ * The average chain length at which a concurrent hashtable doubles its size
+ */
+#define HASHTABLE_MAX_LOAD	2
+
 /**
  * The general purpose hashtable struct.
  */
@@ -85,12 +96,17 @@ typedef struct hashtable {
 	int		n_readers;			/**< Number of clients reading the table */
 	int		writelock;			/**< The table is locked by a writer */
 	bool            ht_isflat;			/**< Indicates whether hashtable is in stack or heap */
+	bool		ht_concurrent;			/**< Striped locks and automatic resizing */
+	pthread_rwlock_t *stripes;			/**< The bucket locks of a concurrent hashtable */
+	int		n_elements;			/**< Number of entries in a concurrent hashtable */
 #if defined(SS_DEBUG)
         skygw_chk_t     ht_chk_tail;
 #endif
 } HASHTABLE;
 
 extern HASHTABLE	*hashtable_alloc(int, int (*hashfn)(), int (*cmpfn)());
+extern HASHTABLE	*hashtable_alloc_concurrent(int, int (*hashfn)(), int (*cmpfn)());
+				/**< Allocate a hashtable for concurrent use */
 HASHTABLE		*hashtable_alloc_flat(HASHTABLE* target, 
 						int size,
 						int (*hashfn)(),
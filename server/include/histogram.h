@@ -0,0 +1,71 @@
+#ifndef _HISTOGRAM_H
+#define _HISTOGRAM_H
+/*
+ * This file is distributed as part of the MariaDB Corporation MaxScale.  It is free
+ * software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation,
+ * version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Copyright MariaDB Corporation Ab 2015
+ */
+#include <resultset.h>
+
+/**
+ * @file histogram.h Latency histograms
+ *
+ * A histogram counts latencies in microseconds in log-linear buckets: the
+ * values below HISTOGRAM_SUB_BUCKETS have a bucket each and every power of
+ * two above that is split into HISTOGRAM_SUB_BUCKETS buckets of equal width,
+ * so the error of a percentile is at most 1/HISTOGRAM_SUB_BUCKETS of the value.
+ * Values of 2^32 microseconds and above are counted in the last bucket.
+ *
+ * Every thread records in counters of its own, allocated on the first value
+ * the thread adds, and the counters of all threads are merged when the
+ * histogram is read.
+ */
+
+#define	HISTOGRAM_SUB_BITS	4
+#define	HISTOGRAM_SUB_BUCKETS	(1 << HISTOGRAM_SUB_BITS)
+#define	HISTOGRAM_BUCKETS	((32 - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+#define	HISTOGRAM_MAX_THREADS	64	/*< Threads with counters of their own */
+
+/**
+ * The counters of a histogram
+ */
+typedef struct {
+	unsigned long	count;		/*< Number of values */
+	unsigned long	sum;		/*< Sum of the values */
+	unsigned long	max;		/*< Largest value */
+	unsigned long	buckets[HISTOGRAM_BUCKETS];
+} HISTOGRAM_DATA;
+
+/**
+ * A latency histogram
+ */
+typedef struct histogram {
+	char		*type;		/*< The type of the measured object */
+	char		*name;		/*< The name of the measured object */
+	char		*metric;	/*< What is measured */
+	HISTOGRAM_DATA	*threads[HISTOGRAM_MAX_THREADS];
+					/*< The counters of the threads */
+	struct histogram *next;		/*< All histograms, for the reports */
+} HISTOGRAM;
+
+extern HISTOGRAM	*histogram_alloc(char *type, char *name, char *metric);
+extern void		histogram_free(HISTOGRAM *hist);
+extern void		histogram_add(HISTOGRAM *hist, unsigned long usecs);
+extern void		histogram_merge(HISTOGRAM *hist, HISTOGRAM_DATA *data);
+extern unsigned long	histogram_percentile(HISTOGRAM_DATA *data, double pct);
+extern unsigned long	histogram_usecs();
+extern void		dprintLatency(struct dcb *pdcb);
+extern RESULTSET	*latencyGetList();
+#endif
@@ -104,6 +104,8 @@ typedef struct {
 	unsigned long		id;					/**< MaxScale ID */
 	unsigned int		n_nbpoll;		/**< Tune number of non-blocking polls */
 	unsigned int		pollsleep;		/**< Wait time in blocking polls */
+	int			thread_affinity;	/**< Per-thread epoll instances */
+	int			qc_cache_size;		/**< Query classification cache entries */
 } GATEWAY_CONF;
 
 extern int		config_load(char *);
@@ -111,6 +113,8 @@ extern int		config_reload();
 extern int		config_threadcount();
 extern unsigned int	config_nbpolls();
 extern unsigned int	config_pollsleep();
+extern int		config_thread_affinity();
+extern int		config_qc_cache_size();
 CONFIG_PARAMETER*	config_get_param(CONFIG_PARAMETER* params, const char* name);
 config_param_type_t 	config_get_paramtype(CONFIG_PARAMETER* param);
 CONFIG_PARAMETER*	config_clone_param(CONFIG_PARAMETER* param);
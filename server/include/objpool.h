@@ -0,0 +1,49 @@
+#ifndef _OBJPOOL_H
+#define _OBJPOOL_H
+/*
+ * This file is distributed as part of the MariaDB Corporation MaxScale.  It is free
+ * software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation,
+ * version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Copyright MariaDB Corporation Ab 2015
+ */
+#include <stdlib.h>
+
+/**
+ * @file objpool.h Pools of fixed size objects
+ *
+ * The objects that are allocated and released for every connection, such
+ * as the DCBs, the sessions and the protocol data, are kept in per-thread
+ * free lists once released so that the memory is reused instead of being
+ * returned to the heap.
+ */
+
+#define	OBJPOOL_MAX	16	/*< Maximum number of object pools */
+
+/**
+ * An object pool
+ */
+typedef struct objpool {
+	char	*name;		/*< The name of the pool */
+	size_t	size;		/*< The size of the objects */
+	int	max_free;	/*< Maximum free objects kept per thread */
+	int	index;		/*< Index of the pool in the thread free lists */
+} OBJPOOL;
+
+struct dcb;
+
+extern OBJPOOL	*objpool_get(char *name, size_t size, int max_free);
+extern void	*objpool_alloc(OBJPOOL *pool);
+extern void	objpool_free(OBJPOOL *pool, void *obj);
+extern void	dprintObjectPools(struct dcb *pdcb);
+#endif
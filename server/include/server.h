@@ -66,6 +66,9 @@ typedef struct {
 	int		n_connections;	/**< Number of connections */
 	int		n_current;	/**< Current connections */
 	int             n_current_ops;  /**< Current active operations */
+	int		n_persistent;	/**< Connections in the connection pool */
+	int		n_pool_hits;	/**< Connections taken from the pool */
+	int		n_pool_misses;	/**< New connections made with the pool in use */
 } SERVER_STATS;
 
 /**
@@ -83,6 +86,10 @@ typedef struct server {
 	char		*monuser;	/**< User name to use to monitor the db */
 	char		*monpw;		/**< Password to use to monitor the db */
 	SERVER_STATS	stats;		/**< The server statistics */
+	struct histogram
+			*latency_first;	/**< Time from a request to the first byte of the reply */
+	struct histogram
+			*latency_last;	/**< Time from a request to the last byte of the reply */
 	struct	server	*next;		/**< Next server */
 	struct	server	*nextdb;	/**< Next server in list attached to a service */
 	char		*server_string;	/**< Server version string, i.e. MySQL server version */
@@ -94,6 +101,11 @@ typedef struct server {
 	int		depth;		/**< Replication level in the tree */
 	long		*slaves;	/**< Slaves of this node */
 	bool            master_err_is_logged; /*< If node failed, this indicates whether it is logged */
+	DCB		*persistent;	/**< Idle connections in the connection pool */
+	SPINLOCK	persistlock;	/**< Lock for the connection pool */
+	int		persistpoolmax;	/**< Maximum size of the pool, 0 disables it */
+	long		persistmaxtime;	/**< Maximum idle time of a pooled connection */
+	long		persistmaxage;	/**< Maximum age of a pooled connection */
 } SERVER;
 
 /**
@@ -189,5 +201,6 @@ extern void	serverAddParameter(SERVER *, char *, char *);
 extern char	*serverGetParameter(SERVER *, char *);
 extern void	server_update(SERVER *, char *, char *, char *);
 extern void     server_set_unique_name(SERVER *, char *);
+extern void	server_set_persistent(SERVER *, int, long, long);
 extern RESULTSET	*serverGetList();
 #endif
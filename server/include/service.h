@@ -78,6 +78,8 @@ typedef struct {
 	time_t		started;	/**< The time when the service was started */
 	int		n_sessions;	/**< Number of sessions created on service since start */
 	int		n_current;	/**< Current number of sessions */
+	int		n_writev;	/**< Number of scatter/gather writes */
+	int		n_writev_saved;	/**< Write calls saved by writev */
 } SERVICE_STATS;
 
 /**
@@ -129,6 +131,8 @@ typedef struct service {
 	SERVICE_USER	credentials;	/**< The cedentials of the service user */	
 	SPINLOCK	spin;		/**< The service spinlock */
 	SERVICE_STATS	stats;		/**< The service statistics */
+	struct histogram
+			*latency;	/**< Time from a client packet to the backend write */
 	struct users	*users;		/**< The user data for this service */
 	int		enable_root;	/**< Allow root user  access */
 	int		localhost_match_wildcard_host; /**< Match localhost against wildcard */
@@ -142,6 +146,7 @@ typedef struct service {
                                             * when querying them from the server. MySQL Workbench seems
                                             * to escape at least the underscore character. */
         bool optimize_wildcard;             /*< Convert wildcard grants to individual database grants */
+        bool scatter_gather_writes;         /*< Write buffer chains with writev */
 	SPINLOCK
 			users_table_spin;	/**< The spinlock for users data refresh */
 	SERVICE_REFRESH_RATE
@@ -186,6 +191,7 @@ extern	int	serviceEnableLocalhostMatchWildcardHost(SERVICE *, int);
 int serviceStripDbEsc(SERVICE* service, int action);
 int serviceAuthAllServers(SERVICE *service, int action);
 int serviceOptimizeWildcard(SERVICE *service, int action);
+int serviceScatterGatherWrites(SERVICE *service, int action);
 extern	void	service_update(SERVICE *, char *, char *, char *);
 extern	int	service_refresh_users(SERVICE *);
 extern	void	printService(SERVICE *);
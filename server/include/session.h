@@ -54,6 +54,7 @@ struct filter_def;
  */
 typedef struct {
 	time_t		connect;	/**< Time when the session was started */
+	unsigned long	request_read;	/**< When the request being routed was read, in microseconds */
 } SESSION_STATS;
 
 typedef enum {
@@ -134,6 +135,7 @@ typedef struct session {
 	DOWNSTREAM	head;		  /*< Head of the filter chain */
 	UPSTREAM	tail;		  /*< The tail of the filter chain */
 	struct session	*next;		  /*< Linked list of all sessions */
+	struct session	*prev;		  /*< Previous session in the list */
 	int		refcount;	  /*< Reference count on the session */
 	bool            ses_is_child;	  /*< this is a child session */
 #if defined(SS_DEBUG)
@@ -164,6 +166,7 @@ SESSION *get_all_sessions();
 SESSION	*session_alloc(struct service *, struct dcb *);
 bool    session_free(SESSION *);
 int	session_isvalid(SESSION *);
+SESSION	*session_find_by_id(size_t);
 int	session_reply(void *inst, void *session, GWBUF *data);
 char	*session_get_remote(SESSION *);
 char	*session_getUser(SESSION *);
@@ -55,6 +55,7 @@ typedef struct {
  */
 typedef struct users {
 	HASHTABLE	*data;			/**< The hashtable containing the actual data */
+	HASHTABLE	*index;			/**< Optional lookup index of the data, freed with the table */
         char *(*usersCustomUserFormat)(void *);	/**< Optional username format routine */	
 	USERS_STATS	stats;			/**< The statistics for the users table */
 	unsigned char
@@ -189,6 +189,7 @@ typedef struct rule_t{
     bool		allow;/*< Allow or deny the query if this rule matches */
     int times_matched;/*< Number of times this rule has been matched */
     TIMERANGE* active;/*< List of times when this rule is active */
+    char* pattern;/*< Source of the regular expression of a regex rule */
 }RULE;
 
 /**
@@ -207,6 +208,9 @@ typedef struct user_t{
     RULELIST* rules_and;/*< All of these rules must match for the action to trigger */
     RULELIST* rules_strict_and; /*< rules that skip the rest of the rules if one of them
 				 * fails. This is only for rules paired with 'match strict_all'. */
+    regex_t* regex_or;/*< All regex rules of rules_or combined into one */
+    regex_t* regex_and;/*< All regex rules of rules_and combined into one */
+    regex_t* regex_strict_and;/*< All regex rules of rules_strict_and combined into one */
    
 }USER;
 
@@ -230,8 +234,28 @@ typedef struct {
 	SPINLOCK* lock;/*< Instance spinlock */
 	long idgen; /*< UID generator */
 	int regflags;
+	HASHTABLE* columns; /*< Lowercase names of all columns in column rules */
 } FW_INSTANCE;
 
+/**
+ * The properties of a query that the rules are matched against. These are
+ * resolved once per query and shared by all the rules of the user. The
+ * affected fields are only resolved when a rule needs them.
+ */
+typedef struct query_info_t{
+    GWBUF* buffer;/*< The query */
+    char* query;/*< Null-terminated SQL or NULL if the query is not SQL */
+    bool is_sql;/*< The query is a COM_QUERY or COM_STMT_PREPARE */
+    bool is_real;/*< The query is not a session command */
+    skygw_query_op_t optype;/*< Operation type of the query */
+    bool has_fields;/*< The fields below have been resolved */
+    bool wildcard;/*< The query uses a wildcard field */
+    char* fields;/*< Affected fields, tokenized in place */
+    char** columns;/*< Affected fields that are named in some column rule */
+    int ncolumns;/*< Number of elements in columns */
+    bool regex_possible;/*< Some regex rule of the rule list can match */
+}QUERYINFO;
+
 /**
  * The session structure for Firewall filter.
  */
@@ -312,10 +336,22 @@ static void* hrulefree(void* fval)
 	return NULL;
 }
 
+static void regexfree(regex_t* re)
+{
+    if(re)
+    {
+	regfree(re);
+	free(re);
+    }
+}
+
 static void* huserfree(void* fval)
 {
     USER* value = (USER*)fval;
 
+    regexfree(value->regex_or);
+    regexfree(value->regex_and);
+    regexfree(value->regex_strict_and);
     hrulefree(value->rules_and);
     hrulefree(value->rules_or);
     hrulefree(value->rules_strict_and);
@@ -837,6 +873,131 @@ bool link_rules(char* orig, FW_INSTANCE* instance)
 	return rval;
 }
 
+/**
+ * Add a column name of a column rule to the index of all columns in the
+ * column rules. The names are stored in lowercase.
+ * @param instance The FW_FILTER instance
+ * @param column Column name
+ */
+void add_column(FW_INSTANCE* instance, char* column)
+{
+    char* name = strdup(column);
+    char* ptr;
+
+    if(name == NULL)
+    {
+	return;
+    }
+
+    for(ptr = name;*ptr;ptr++)
+    {
+	*ptr = tolower(*ptr);
+    }
+
+    if(hashtable_fetch(instance->columns,name) == NULL)
+    {
+	hashtable_add(instance->columns,name,(void*)true);
+    }
+    free(name);
+}
+
+/**
+ * Combine the regular expressions of all the regex rules in a rule list into
+ * one regular expression. A query that does not match the combined expression
+ * can't match any of the regex rules so they don't need to be checked one by
+ * one. The expressions are combined as alternatives of basic regular
+ * expressions. Expressions with back-references can't be combined because
+ * the numbering of the subexpressions changes.
+ * @param rulelist Rule list
+ * @param regflags Flags for regcomp
+ * @return The combined expression or NULL if the list has no regex rules or
+ * the expressions can't be combined
+ */
+regex_t* combine_regex(RULELIST* rulelist, int regflags)
+{
+    RULELIST* node;
+    regex_t* re;
+    char *pattern, *ptr;
+    int len = 0, nregex = 0;
+
+    for(node = rulelist;node;node = node->next)
+    {
+	if(node->rule->type == RT_REGEX && node->rule->pattern)
+	{
+	    for(ptr = node->rule->pattern;*ptr;ptr++)
+	    {
+		if(*ptr == '\\' && isdigit(*(ptr + 1)))
+		{
+		    return NULL;
+		}
+	    }
+	    len += strlen(node->rule->pattern) + strlen("\\(\\)\\|");
+	    nregex++;
+	}
+    }
+
+    if(nregex == 0 || (pattern = malloc(len + 1)) == NULL)
+    {
+	return NULL;
+    }
+
+    *pattern = '\0';
+
+    for(node = rulelist;node;node = node->next)
+    {
+	if(node->rule->type == RT_REGEX && node->rule->pattern)
+	{
+	    if(*pattern)
+	    {
+		strcat(pattern,"\\|");
+	    }
+	    strcat(pattern,"\\(");
+	    strcat(pattern,node->rule->pattern);
+	    strcat(pattern,"\\)");
+	}
+    }
+
+    if((re = malloc(sizeof(regex_t))) != NULL &&
+       regcomp(re,pattern,REG_NOSUB|regflags) != 0)
+    {
+	skygw_log_write(LOGFILE_TRACE,"dbfwfilter: Failed to combine regular "
+		"expressions, checking them one by one: %s",pattern);
+	free(re);
+	re = NULL;
+    }
+    free(pattern);
+    return re;
+}
+
+/**
+ * Combine the regex rules of all the users.
+ * @param instance The FW_FILTER instance
+ */
+void combine_user_regex(FW_INSTANCE* instance)
+{
+    HASHITERATOR* iter;
+    USER* user;
+    char* key;
+
+    if((iter = hashtable_iterator(instance->htable)) == NULL)
+    {
+	return;
+    }
+
+    while((key = hashtable_next(iter)) != NULL)
+    {
+	if((user = hashtable_fetch(instance->htable,key)) != NULL &&
+	   user->regex_or == NULL && user->regex_and == NULL &&
+	   user->regex_strict_and == NULL)
+	{
+	    user->regex_or = combine_regex(user->rules_or,instance->regflags);
+	    user->regex_and = combine_regex(user->rules_and,instance->regflags);
+	    user->regex_strict_and = combine_regex(user->rules_strict_and,instance->regflags);
+	}
+    }
+    hashtable_iterator_free(iter);
+}
+
 /**
  * Free a TIMERANGE struct
  * @param tr pointer to a TIMERANGE struct
@@ -992,6 +1153,7 @@ bool parse_rule(char* rule, FW_INSTANCE* instance)
                     current->value = strdup(tok);
                     current->next = tail;
                     tail = current;
+                    add_column(instance,tok);
                     tok = strtok_r(NULL, " ,",&saveptr);
                 }
 
@@ -1130,6 +1292,8 @@ bool parse_rule(char* rule, FW_INSTANCE* instance)
                 {
                     ruledef->type = RT_REGEX;
                     ruledef->data = (void*) re;
+                    ruledef->pattern = str;
+                    str = NULL;
                 }
                 free(str);
 
@@ -1331,6 +1495,15 @@ createInstance(char **options, FILTER_PARAMETER **params)
 	hashtable_memory_fns(ht,(HASHMEMORYFN)strdup,NULL,(HASHMEMORYFN)free,huserfree);
 	
 	my_instance->htable = ht;
+
+	if((my_instance->columns = hashtable_alloc(100, hashkeyfun, hashcmpfun)) == NULL){
+		skygw_log_write(LOGFILE_ERROR, "Unable to allocate hashtable.");
+		hashtable_free(ht);
+		free(my_instance);
+		return NULL;
+	}
+
+	hashtable_memory_fns(my_instance->columns,(HASHMEMORYFN)strdup,NULL,(HASHMEMORYFN)free,NULL);
 	my_instance->def_op = true;
 	my_instance->userstrings = NULL;
 	my_instance->regflags = 0;
@@ -1359,6 +1532,7 @@ createInstance(char **options, FILTER_PARAMETER **params)
             skygw_log_write(LOGFILE_ERROR, "Unable to find rule file for firewall filter. Please provide the path with"
                     " rules=<path to file>");
             hashtable_free(my_instance->htable);
+            hashtable_free(my_instance->columns);
             free(my_instance);
             return NULL;
         }
@@ -1366,6 +1540,7 @@ createInstance(char **options, FILTER_PARAMETER **params)
 	if((file = fopen(filename,"rb")) == NULL ){
             skygw_log_write(LOGFILE_ERROR, "Error while opening rule file for firewall filter.");
             hashtable_free(my_instance->htable);
+            hashtable_free(my_instance->columns);
             free(my_instance);
             free(filename);
             return NULL;
@@ -1382,6 +1557,7 @@ createInstance(char **options, FILTER_PARAMETER **params)
                 skygw_log_write(LOGFILE_ERROR, "Error while reading rule file for firewall filter.");
                 fclose(file);
                 hashtable_free(my_instance->htable);
+                hashtable_free(my_instance->columns);
                 free(my_instance);
                 return NULL;
             }
@@ -1444,12 +1620,18 @@ createInstance(char **options, FILTER_PARAMETER **params)
 	    free(tmp);
 	}
 
+	if(!err)
+	{
+	    combine_user_regex(my_instance);
+	}
+
 	retblock:
 
 	if(err)
 	{
 	    hrulefree(my_instance->rules);
 	    hashtable_free(my_instance->htable);
+	    hashtable_free(my_instance->columns);
             free(my_instance);
 	    my_instance = NULL;
 	}
@@ -1648,43 +1830,134 @@ bool rule_is_active(RULE* rule)
 	return true;
 }
 
+/**
+ * Resolve the properties of a query that the rules are matched against.
+ * @param qinfo Query information to initialize
+ * @param queue The GWBUF containing the query
+ */
+void query_info_init(QUERYINFO* qinfo, GWBUF* queue)
+{
+	unsigned char* memptr = (unsigned char*)queue->start;
+	int qlen;
+
+	memset(qinfo,0,sizeof(QUERYINFO));
+	qinfo->buffer = queue;
+	qinfo->optype = QUERY_OP_UNDEFINED;
+	qinfo->regex_possible = true;
+	qinfo->is_sql = modutil_is_SQL(queue) || modutil_is_SQL_prepare(queue);
+
+	if(qinfo->is_sql){
+		if(!query_is_parsed(queue)){
+			parse_query(queue);
+		}
+		qinfo->optype = query_classifier_get_operation(queue);
+		qinfo->is_real = skygw_is_real_query(queue);
+
+		qlen = gw_mysql_get_byte3(memptr);
+		qlen = qlen < 0xffffff ? qlen : 0xffffff;
+		if((qinfo->query = malloc(qlen)) != NULL)
+		{
+		    memcpy(qinfo->query,memptr + 5,qlen - 1);
+		    qinfo->query[qlen - 1] = '\0';
+		}
+	}
+}
+
+/**
+ * Free the memory allocated for the query information.
+ * @param qinfo Query information
+ */
+void query_info_free(QUERYINFO* qinfo)
+{
+	free(qinfo->query);
+	free(qinfo->fields);
+	free(qinfo->columns);
+}
+
+/**
+ * Resolve the fields the query affects. The fields are looked up from the
+ * index of columns named in the column rules so that a query which doesn't
+ * use any of them is only inspected once regardless of the number of rules.
+ * @param my_instance Fwfilter instance
+ * @param qinfo Query information
+ */
+void query_info_get_fields(FW_INSTANCE* my_instance, QUERYINFO* qinfo)
+{
+	char *tok, *saveptr = NULL, *ptr;
+	int nfields = 1;
+
+	if(qinfo->has_fields)
+	{
+	    return;
+	}
+	qinfo->has_fields = true;
+
+	if((qinfo->fields = skygw_get_affected_fields(qinfo->buffer)) == NULL)
+	{
+	    return;
+	}
+
+	for(ptr = qinfo->fields;*ptr;ptr++)
+	{
+	    if(*ptr == ' ')
+		nfields++;
+	}
+
+	if((qinfo->columns = malloc(sizeof(char*) * nfields)) == NULL)
+	{
+	    return;
+	}
+
+	tok = strtok_r(qinfo->fields," ,",&saveptr);
+
+	while(tok)
+	{
+	    if(strchr(tok,'*'))
+	    {
+		qinfo->wildcard = true;
+	    }
+
+	    for(ptr = tok;*ptr;ptr++)
+	    {
+		*ptr = tolower(*ptr);
+	    }
+
+	    if(qinfo->ncolumns < nfields &&
+	       hashtable_fetch(my_instance->columns,tok))
+	    {
+		qinfo->columns[qinfo->ncolumns++] = tok;
+	    }
+	    tok = strtok_r(NULL," ,",&saveptr);
+	}
+}
+
 /**
  * Check if a query matches a single rule
  * @param my_instance Fwfilter instance
  * @param my_session Fwfilter session
- * @param queue The GWBUF containing the query
+ * @param qinfo Information about the query
  * @param rulelist The rule to check
- * @param query Pointer to the null-terminated query string
  * @return true if the query matches the rule
  */
-bool rule_matches(FW_INSTANCE* my_instance, FW_SESSION* my_session, GWBUF *queue, USER* user, RULELIST *rulelist, char* query)
+bool rule_matches(FW_INSTANCE* my_instance, FW_SESSION* my_session, QUERYINFO* qinfo, USER* user, RULELIST *rulelist)
 {
-	char *ptr,*where,*msg = NULL;
+	char *msg = NULL;
 	char emsg[512];
-	int qlen;
-	unsigned char* memptr = (unsigned char*)queue->start;
-	bool is_sql, is_real, matches;
-	skygw_query_op_t optype = QUERY_OP_UNDEFINED;
+	char* query = qinfo->query;
+	bool is_sql = qinfo->is_sql, is_real = qinfo->is_real, matches;
+	skygw_query_op_t optype = qinfo->optype;
+	GWBUF* queue = qinfo->buffer;
 	STRLINK* strln = NULL;
 	QUERYSPEED* queryspeed = NULL;
 	QUERYSPEED* rule_qs = NULL;
 	time_t time_now;
 	struct tm* tm_now; 
+	int i;
 
 	time(&time_now);
 	tm_now = localtime(&time_now);
 
 	matches = false;
-	is_sql = modutil_is_SQL(queue) || modutil_is_SQL_prepare(queue);
-	
-	if(is_sql){
-		if(!query_is_parsed(queue)){
-			parse_query(queue);
-		}
-		optype =  query_classifier_get_operation(queue);
-		is_real = skygw_is_real_query(queue);
-		qlen = gw_mysql_get_byte3(memptr) - 1;
-	}
 
 	if(rulelist->rule->on_queries == QUERY_OP_UNDEFINED || rulelist->rule->on_queries & optype){
 
@@ -1696,7 +1969,8 @@ bool rule_matches(FW_INSTANCE* my_instance, FW_SESSION* my_session, GWBUF *queue
 			
         case RT_REGEX:
 
-            if(query && regexec(rulelist->rule->data,query,0,NULL,0) == 0){
+            if(query && qinfo->regex_possible &&
+               regexec(rulelist->rule->data,query,0,NULL,0) == 0){
 
                 matches = true;
 				
@@ -1726,35 +2000,31 @@ bool rule_matches(FW_INSTANCE* my_instance, FW_SESSION* my_session, GWBUF *queue
 		   
             if(is_sql && is_real)
 	    {
-                where = skygw_get_affected_fields(queue);
-                if(where != NULL){
-		    char* saveptr;
-		    char* tok = strtok_r(where," ",&saveptr);
-		    while(tok)
+		query_info_get_fields(my_instance,qinfo);
+
+		/** Only the fields found in the column index can match */
+		for(i = 0;i < qinfo->ncolumns;i++)
+		{
+		    strln = (STRLINK*)rulelist->rule->data;
+		    while(strln)
 		    {
-			strln = (STRLINK*)rulelist->rule->data;
-			while(strln)
+			if(strcasecmp(qinfo->columns[i],strln->value) == 0)
 			{
-			    if(strcasecmp(tok,strln->value) == 0)
+			    matches = true;
+
+			    if(!rulelist->rule->allow)
 			    {
-				matches = true;
-
-				if(!rulelist->rule->allow)
-				{
-				    sprintf(emsg,"Permission denied to column '%s'.",strln->value);
-				    skygw_log_write(LOGFILE_TRACE, "dbfwfilter: rule '%s': query targets forbidden column: %s",rulelist->rule->name,strln->value);
-				    msg = strdup(emsg);
-				    goto queryresolved;
-				}
-				else
-				    break;
+				sprintf(emsg,"Permission denied to column '%s'.",strln->value);
+				skygw_log_write(LOGFILE_TRACE, "dbfwfilter: rule '%s': query targets forbidden column: %s",rulelist->rule->name,strln->value);
+				msg = strdup(emsg);
+				goto queryresolved;
 			    }
-			    strln = strln->next;
+			    else
+				break;
 			}
-			tok = strtok_r(NULL,",",&saveptr);
+			strln = strln->next;
 		    }
-		    free(where);
-                }
+		}
             }
 			
             break;
@@ -1763,20 +2033,14 @@ bool rule_matches(FW_INSTANCE* my_instance, FW_SESSION* my_session, GWBUF *queue
 
 
             if(is_sql && is_real){
-                char * strptr;
-                where = skygw_get_affected_fields(queue);
-						
-                if(where != NULL){
-                    strptr = where;
-
-		    if(strchr(strptr,'*')){
-
-			matches = true;
-			msg = strdup("Usage of wildcard denied.");
-			skygw_log_write(LOGFILE_TRACE, "dbfwfilter: rule '%s': query contains a wildcard.",rulelist->rule->name);
-			goto queryresolved;
-		    }
-		    free(where);
+		query_info_get_fields(my_instance,qinfo);
+
+		if(qinfo->wildcard){
+
+		    matches = true;
+		    msg = strdup("Usage of wildcard denied.");
+		    skygw_log_write(LOGFILE_TRACE, "dbfwfilter: rule '%s': query contains a wildcard.",rulelist->rule->name);
+		    goto queryresolved;
 		}
             }
 			
@@ -1904,47 +2168,45 @@ bool rule_matches(FW_INSTANCE* my_instance, FW_SESSION* my_session, GWBUF *queue
 	return matches;
 }
 
+/**
+ * Check the combined regular expression of a rule list. If it doesn't match,
+ * none of the regex rules in the list need to be checked.
+ * @param qinfo Query information
+ * @param re Combined regular expression or NULL if there is none
+ */
+void check_combined_regex(QUERYINFO* qinfo, regex_t* re)
+{
+	qinfo->regex_possible = re == NULL || qinfo->query == NULL ||
+	    regexec(re,qinfo->query,0,NULL,0) == 0;
+}
+
 /**
  * Check if the query matches any of the rules in the user's rulelist.
  * @param my_instance Fwfilter instance
  * @param my_session Fwfilter session
- * @param queue The GWBUF containing the query
+ * @param qinfo Information about the query
  * @param user The user whose rulelist is checked
  * @return True if the query matches at least one of the rules otherwise false
  */
-bool check_match_any(FW_INSTANCE* my_instance, FW_SESSION* my_session, GWBUF *queue, USER* user)
+bool check_match_any(FW_INSTANCE* my_instance, FW_SESSION* my_session, QUERYINFO* qinfo, USER* user)
 {
-	bool is_sql, rval = false;
-	int qlen;
-	char *fullquery = NULL,*ptr;
-	unsigned char* memptr = (unsigned char*)queue->start;
+	bool rval = false;
 	RULELIST* rulelist;
-	is_sql = modutil_is_SQL(queue) || modutil_is_SQL_prepare(queue);
-	
-	if(is_sql){
-		if(!query_is_parsed(queue)){
-			parse_query(queue);
-		}
-
-		qlen = gw_mysql_get_byte3(memptr);
-		qlen = qlen < 0xffffff ? qlen : 0xffffff;
-		fullquery = malloc((qlen) * sizeof(char));
-		memcpy(fullquery,memptr + 5,qlen - 1);
-		memset(fullquery + qlen - 1,0,1);
-	}
 
 	if((rulelist = user->rules_or) == NULL)
 	{
 	    goto retblock;
 	}
 
+	check_combined_regex(qinfo,user->regex_or);
+
 	while(rulelist){
 		
 		if(!rule_is_active(rulelist->rule)){
 			rulelist = rulelist->next;
 			continue;
 		}
-		if((rval = rule_matches(my_instance,my_session,queue,user,rulelist,fullquery))){
+		if((rval = rule_matches(my_instance,my_session,qinfo,user,rulelist))){
 		    goto retblock;
 		}
 		
@@ -1953,8 +2215,6 @@ bool check_match_any(FW_INSTANCE* my_instance, FW_SESSION* my_session, GWBUF *qu
 
     retblock:
 
-	free(fullquery);
-
 	return rval;
 }
 
@@ -1962,40 +2222,25 @@ bool check_match_any(FW_INSTANCE* my_instance, FW_SESSION* my_session, GWBUF *qu
  * Check if the query matches all rules in the user's rulelist.
  * @param my_instance Fwfilter instance
  * @param my_session Fwfilter session
- * @param queue The GWBUF containing the query
+ * @param qinfo Information about the query
  * @param user The user whose rulelist is checked
  * @return True if the query matches all of the rules otherwise false
  */
-bool check_match_all(FW_INSTANCE* my_instance, FW_SESSION* my_session, GWBUF *queue, USER* user,bool strict_all)
+bool check_match_all(FW_INSTANCE* my_instance, FW_SESSION* my_session, QUERYINFO* qinfo, USER* user,bool strict_all)
 {
-	bool is_sql, rval = true;
+	bool rval = true;
 	bool have_active_rule = false;
-	int qlen;
-	unsigned char* memptr = (unsigned char*)queue->start;
-	char *fullquery = NULL,*ptr;
-	
 	RULELIST* rulelist;
-	is_sql = modutil_is_SQL(queue) || modutil_is_SQL_prepare(queue);
-
-	if(is_sql){
-		if(!query_is_parsed(queue)){
-			parse_query(queue);
-		}
-
-		qlen = gw_mysql_get_byte3(memptr);
-		qlen = qlen < 0xffffff ? qlen : 0xffffff;
-		fullquery = malloc((qlen) * sizeof(char));
-		memcpy(fullquery,memptr + 5,qlen - 1);
-		memset(fullquery + qlen - 1,0,1);
-	}
 	
 	if(strict_all)
 	{
 	    rulelist = user->rules_strict_and;
+	    check_combined_regex(qinfo,user->regex_strict_and);
 	}
 	else
 	{
 	    rulelist = user->rules_and;
+	    check_combined_regex(qinfo,user->regex_and);
 	}
 	
 	if(rulelist == NULL)
@@ -2013,7 +2258,7 @@ bool check_match_all(FW_INSTANCE* my_instance, FW_SESSION* my_session, GWBUF *qu
 
 		have_active_rule = true;
 
-		if(!rule_matches(my_instance,my_session,queue,user,rulelist,fullquery)){
+		if(!rule_matches(my_instance,my_session,qinfo,user,rulelist)){
 			rval = false;
 			if(strict_all)
 			    break;
@@ -2029,8 +2274,6 @@ bool check_match_all(FW_INSTANCE* my_instance, FW_SESSION* my_session, GWBUF *qu
 
     retblock:
 	
-	free(fullquery);
-	
 	return rval;
 }
 
@@ -2055,6 +2298,7 @@ routeQuery(FILTER *instance, void *session, GWBUF *queue)
 	DCB* dcb = my_session->session->client;
 	USER* user = NULL;
 	GWBUF* forward;
+	QUERYINFO qinfo;
 	ipaddr = strdup(dcb->remote);
 	sprintf(uname_addr,"%s@%s",dcb->user,ipaddr);
 
@@ -2093,20 +2337,15 @@ routeQuery(FILTER *instance, void *session, GWBUF *queue)
 		goto queryresolved;
 	}
 
-	if(check_match_any(my_instance,my_session,queue,user)){
-		accept = false;
-		goto queryresolved;
-	}
+	query_info_init(&qinfo,queue);
 
-	if(check_match_all(my_instance,my_session,queue,user,false)){
-		accept = false;
-		goto queryresolved;
-	}
-	
-	if(check_match_all(my_instance,my_session,queue,user,true)){
+	if(check_match_any(my_instance,my_session,&qinfo,user) ||
+	   check_match_all(my_instance,my_session,&qinfo,user,false) ||
+	   check_match_all(my_instance,my_session,&qinfo,user,true)){
 		accept = false;
-		goto queryresolved;
 	}
+
+	query_info_free(&qinfo);
 	
 queryresolved:
 
@@ -2178,6 +2417,87 @@ diagnostic(FILTER *instance, void *fsession, DCB *dcb)
 #ifdef BUILD_RULE_PARSER
 #include <test_utils.h>
 
+/**
+ * Match the queries in a file, one query per line, against the rules of a
+ * user and print the time it took. The queries are parsed before the timing
+ * starts so only the rule matching is measured.
+ * @param instance Filter instance with the rules loaded
+ * @param filename File with the queries
+ * @param username User whose rules are used
+ * @param iterations How many times the queries are matched
+ * @return 0 on success, 1 on error
+ */
+int benchmark(FW_INSTANCE* instance, char* filename, char* username, int iterations)
+{
+    FW_SESSION session;
+    GWBUF* queries[1024];
+    QUERYINFO qinfo;
+    USER* user;
+    FILE* file;
+    char line[2048], *nl;
+    struct timespec start, end;
+    double elapsed;
+    int nqueries = 0, denied = 0, i, n;
+
+    if((user = hashtable_fetch(instance->htable,username)) == NULL)
+    {
+	printf("No rules for user '%s'.\n",username);
+	return 1;
+    }
+
+    if((file = fopen(filename,"r")) == NULL)
+    {
+	printf("Failed to open query file '%s'.\n",filename);
+	return 1;
+    }
+
+    while(nqueries < 1024 && fgets(line,sizeof(line),file))
+    {
+	if((nl = strchr(line,'\n')))
+	    *nl = '\0';
+	if(*line)
+	{
+	    queries[nqueries] = modutil_create_query(line);
+	    parse_query(queries[nqueries]);
+	    nqueries++;
+	}
+    }
+    fclose(file);
+
+    memset(&session,0,sizeof(session));
+    clock_gettime(CLOCK_MONOTONIC,&start);
+
+    for(n = 0;n < iterations;n++)
+    {
+	for(i = 0;i < nqueries;i++)
+	{
+	    query_info_init(&qinfo,queries[i]);
+	    if(check_match_any(instance,&session,&qinfo,user) ||
+	       check_match_all(instance,&session,&qinfo,user,false) ||
+	       check_match_all(instance,&session,&qinfo,user,true))
+	    {
+		denied++;
+	    }
+	    query_info_free(&qinfo);
+	    free(session.errmsg);
+	    session.errmsg = NULL;
+	}
+    }
+
+    clock_gettime(CLOCK_MONOTONIC,&end);
+    elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1000000000.0;
+
+    printf("Matched %d queries %d times: %d denied, %.3f seconds, %.0f queries/second.\n",
+	   nqueries, iterations, denied, elapsed,
+	   elapsed > 0 ? (double)nqueries * iterations / elapsed : 0.0);
+
+    for(i = 0;i < nqueries;i++)
+    {
+	gwbuf_free(queries[i]);
+    }
+    return 0;
+}
+
 int main(int argc, char** argv)
 {
     char ch;
@@ -2185,19 +2505,34 @@ int main(int argc, char** argv)
     char *home;
     char cwd[PATH_MAX];
     char* opts[2] = {NULL,NULL};
+    char *queryfile = NULL, *username = "%@%";
+    int iterations = 1000;
     FILTER_PARAMETER ruleparam;
     FILTER_PARAMETER* paramlist[2];
+    FW_INSTANCE* instance;
 
     opterr = 0;
-    while((ch = getopt(argc,argv,"h?")) != -1)
+    while((ch = getopt(argc,argv,"h?b:n:u:")) != -1)
     {
         switch(ch)
         {
+	case 'b':
+	    queryfile = optarg;
+	    break;
+	case 'n':
+	    iterations = atoi(optarg);
+	    break;
+	case 'u':
+	    username = optarg;
+	    break;
         case '?':
         case 'h':
             printf("Usage: %s [OPTION]... RULEFILE\n"
 		    "Options:\n"
-		    "\t-?\tPrint this information\n",
+		    "\t-?\tPrint this information\n"
+		    "\t-b FILE\tBenchmark the rules with the queries in FILE, one per line\n"
+		    "\t-n NUM\tNumber of benchmark iterations, defaults to 1000\n"
+		    "\t-u USER\tUser whose rules are benchmarked, defaults to %%@%%\n",
                    argv[0]);
             return 0;
 	default:
@@ -2206,7 +2541,7 @@ int main(int argc, char** argv)
         }
     }
 
-    if(argc < 2)
+    if(optind >= argc)
     {
         printf("Usage: %s [OPTION]... RULEFILE\n"
 		"-?\tPrint this information\n",
@@ -2238,13 +2573,18 @@ int main(int argc, char** argv)
 
     init_test_env(home);
     ruleparam.name = strdup("rules");
-    ruleparam.value = strdup(argv[1]);
+    ruleparam.value = strdup(argv[optind]);
     paramlist[0] = &ruleparam;
     paramlist[1] = NULL;
 
-    if(createInstance(opts,paramlist))
+    if((instance = (FW_INSTANCE*)createInstance(opts,paramlist)))
     {
 	printf("Rule parsing was successful.\n");
+
+	if(queryfile && benchmark(instance,queryfile,username,iterations))
+	{
+	    return 1;
+	}
     }
     else
     {
@@ -402,8 +402,7 @@ QLA_INSTANCE	*my_instance = (QLA_INSTANCE *)instance;
 QLA_SESSION	*my_session = (QLA_SESSION *)session;
 char		*ptr;
 int		length = 0;
-struct tm	t;
-struct timeval	tv;
+char		timestamp[TS_CACHE_STRLEN];
 
 	if (my_session->active)
 	{
@@ -418,14 +417,9 @@ struct timeval	tv;
 				(my_instance->nomatch == NULL ||
 					regexec(&my_instance->nore,ptr,0,NULL, 0) != 0))
 			{
-				gettimeofday(&tv, NULL);
-				localtime_r(&tv.tv_sec, &t);
-				fprintf(my_session->fp,
-					"%02d:%02d:%02d.%-3d %d/%02d/%d, ",
-					t.tm_hour, t.tm_min, t.tm_sec, (int)(tv.tv_usec / 1000),
-					t.tm_mday, t.tm_mon + 1, 1900 + t.tm_year);
-				fprintf(my_session->fp,"%s\n",ptr);
-				
+				snprint_timestamp_cached(TS_FORMAT_QLA, NULL,
+					timestamp, sizeof(timestamp));
+				fprintf(my_session->fp, "%s%s\n", timestamp, ptr);
 			}
 			free(ptr);
 		}
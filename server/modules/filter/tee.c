@@ -34,6 +34,10 @@
  *		of the request (optional)
  * user		A user name to match against. If present only requests that
  *		originate from this user will be duplciated (optional)
+ * async	Do not wait for the branch service before replying to the
+ *		client, queue the duplicates for the branch instead (optional)
+ * max_queue	The maximum number of duplicates queued for the branch in
+ *		asynchronous mode (optional)
  *
  * Revision History
  * ================
@@ -79,6 +83,9 @@
 #define PARENT 0
 #define CHILD 1
 
+/** Default limit of duplicated packets queued for an asynchronous branch */
+#define TEE_DEFAULT_MAX_QUEUE 100
+
 #ifdef SS_DEBUG
 static int debug_seq = 0;
 #endif
@@ -147,6 +154,10 @@ typedef struct {
 	regex_t	re;		/* Compiled regex text */
 	char	*nomatch;	/* Optional text to match against for exclusion */
 	regex_t	nore;		/* Compiled regex nomatch text */
+	bool	async;		/* Replies are not synchronized with the branch */
+	int	max_queue;	/* Maximum number of packets queued for the branch */
+	int	n_overflow;	/* Number of branches dropped by queue overflow */
+	int	n_dropped;	/* Number of duplicates dropped by queue overflow */
 } TEE_INSTANCE;
 
 /**
@@ -180,6 +191,10 @@ typedef struct {
 	GWBUF*          tee_replybuf;	/* Buffer for reply */
         GWBUF*          tee_partials[2];
 	GWBUF*		queue;
+	GWBUF*		branch_queue;	/* Duplicates waiting for the async branch */
+	int		n_branch_queued; /* Number of packets in branch_queue */
+	unsigned char	branch_command;	/* Command the async branch is executing */
+	bool		branch_dropped;	/* The async branch fell too far behind */
         SPINLOCK        tee_lock;
 	DCB*		client_dcb;
 
@@ -212,6 +227,10 @@ int route_single_query(TEE_INSTANCE* my_instance,
 		       GWBUF* buffer,
 		       GWBUF* clone);
 int reset_session_state(TEE_SESSION* my_session, GWBUF* buffer);
+static void reset_branch_state(TEE_SESSION* my_session, int branch, unsigned char command);
+static int route_async(TEE_INSTANCE* my_instance, TEE_SESSION* my_session, GWBUF* queue);
+static void branch_enqueue(TEE_INSTANCE* my_instance, TEE_SESSION* my_session, GWBUF* clone);
+static void branch_dispatch(TEE_SESSION* my_session);
 
 static void
 orphan_free(void* data)
@@ -371,6 +390,8 @@ int		i;
 		my_instance->userName = NULL;
 		my_instance->match = NULL;
 		my_instance->nomatch = NULL;
+		my_instance->async = false;
+		my_instance->max_queue = TEE_DEFAULT_MAX_QUEUE;
 		if (params)
 		{
 			for (i = 0; params[i]; i++)
@@ -398,6 +419,22 @@ int		i;
 					my_instance->source = strdup(params[i]->value);
 				else if (!strcmp(params[i]->name, "user"))
 					my_instance->userName = strdup(params[i]->value);
+				else if (!strcmp(params[i]->name, "async"))
+					my_instance->async = config_truth_value(params[i]->value);
+				else if (!strcmp(params[i]->name, "max_queue"))
+				{
+					if ((my_instance->max_queue = atoi(params[i]->value)) <= 0)
+					{
+						LOGIF(LE, (skygw_log_write_flush(
+							LOGFILE_ERROR,
+							"tee: Invalid value '%s' for "
+							"max_queue, using the default "
+							"of %d.\n",
+							params[i]->value,
+							TEE_DEFAULT_MAX_QUEUE)));
+						my_instance->max_queue = TEE_DEFAULT_MAX_QUEUE;
+					}
+				}
 				else if (!filter_standard_parameter(params[i]->name))
 				{
 					LOGIF(LE, (skygw_log_write_flush(
@@ -733,6 +770,8 @@ skygw_log_write(LOGFILE_TRACE,"Tee free: %d", atomic_add(&debug_seq,1));
 	}
         if(my_session->tee_replybuf)
             gwbuf_free(my_session->tee_replybuf);
+	if(my_session->branch_queue)
+	    gwbuf_free(my_session->branch_queue);
 	free(session);
         
 	orphan_free(NULL);
@@ -815,6 +854,12 @@ routeQuery(FILTER *instance, void *session, GWBUF *queue)
 	return 0;
     }
 
+    if(my_instance->async)
+    {
+	/** Releases the lock */
+	return route_async(my_instance,my_session,queue);
+    }
+
     if(my_session->queue)
     {
 	my_session->queue = gwbuf_append(my_session->queue,queue);
@@ -933,7 +978,7 @@ clientReply (FILTER* instance, void *session, GWBUF *reply)
     GWBUF *complete = NULL;
     unsigned char *ptr;
     uint16_t flags = 0;
-    int min_eof = my_session->command != 0x04 ? 2 : 1;
+    int min_eof;
     int more_results = 0;
 #ifdef SS_DEBUG
     ptr = (unsigned char*) reply->start;
@@ -944,6 +989,14 @@ clientReply (FILTER* instance, void *session, GWBUF *reply)
 		    atomic_add(&debug_seq,1));
 #endif
 
+    if(instance && my_session->instance->async)
+    {
+	/** In asynchronous mode the replies of the parent are not delayed */
+	return my_session->up.clientReply(my_session->up.instance,
+					  my_session->up.session,
+					  reply);
+    }
+
     spinlock_acquire(&my_session->tee_lock);
 
     if(!my_session->active)
@@ -964,6 +1017,15 @@ clientReply (FILTER* instance, void *session, GWBUF *reply)
 
     branch = instance == NULL ? CHILD : PARENT;
 
+    if(branch == CHILD && my_session->instance->async)
+    {
+	min_eof = my_session->branch_command != 0x04 ? 2 : 1;
+    }
+    else
+    {
+	min_eof = my_session->command != 0x04 ? 2 : 1;
+    }
+
     my_session->tee_partials[branch] = gwbuf_append(my_session->tee_partials[branch], reply);
     my_session->tee_partials[branch] = gwbuf_make_contiguous(my_session->tee_partials[branch]);
     complete = modutil_get_complete_packets(&my_session->tee_partials[branch]);
@@ -1052,6 +1114,17 @@ clientReply (FILTER* instance, void *session, GWBUF *reply)
 
     my_session->replies[branch]++;
     rc = 1;
+
+    if(my_session->instance->async)
+    {
+	/** The reply of the branch is complete, send it the next duplicate */
+	if(!my_session->waiting[CHILD])
+	{
+	    branch_dispatch(my_session);
+	}
+	goto retblock;
+    }
+
     mpkt = my_session->multipacket[PARENT] || my_session->multipacket[CHILD];
 
     if(my_session->tee_replybuf != NULL)
@@ -1163,12 +1236,28 @@ TEE_SESSION	*my_session = (TEE_SESSION *)fsession;
 	if (my_instance->nomatch)
 		dcb_printf(dcb, "\t\tExclude queries that match		%s\n",
 				my_instance->nomatch);
+	if (my_instance->async)
+	{
+		dcb_printf(dcb, "\t\tAsynchronous branch, queue limit	%d\n",
+				my_instance->max_queue);
+		dcb_printf(dcb, "\t\tNo. of branches dropped:		%d\n",
+				my_instance->n_overflow);
+		dcb_printf(dcb, "\t\tNo. of statements dropped:	%d\n",
+				my_instance->n_dropped);
+	}
 	if (my_session)
 	{
 		dcb_printf(dcb, "\t\tNo. of statements duplicated:	%d.\n",
 			my_session->n_duped);
 		dcb_printf(dcb, "\t\tNo. of statements rejected:	%d.\n",
 			my_session->n_rejected);
+		if (my_instance->async)
+		{
+			dcb_printf(dcb, "\t\tNo. of statements queued:	%d.\n",
+				my_session->n_branch_queued);
+			dcb_printf(dcb, "\t\tBranch dropped:			%s\n",
+				my_session->branch_dropped ? "yes" : "no");
+		}
 	}
 }
 
@@ -1376,29 +1465,179 @@ int reset_session_state(TEE_SESSION* my_session, GWBUF* buffer)
 
     unsigned char command = *((unsigned char*)buffer->start + 4);
 
-          switch(command)
-        {
-	case 0x1b:
+    if(command == 0x1b)
+    {
+	my_session->client_multistatement = *((unsigned char*) buffer->start + 5);
+	LOGIF(LT,(skygw_log_write(LT,"Tee: client %s multistatements",
+		    my_session->client_multistatement ? "enabled":"disabled")));
+    }
+
+    reset_branch_state(my_session,PARENT,command);
+    reset_branch_state(my_session,CHILD,command);
+    my_session->command = command;
+
+    return 1;
+}
+
+/**
+ * Reset the reply tracking of one branch for a new command.
+ * @param my_session Tee session
+ * @param branch PARENT or CHILD
+ * @param command The command sent to the branch
+ */
+static void reset_branch_state(TEE_SESSION* my_session, int branch, unsigned char command)
+{
+    switch(command)
+    {
+    case 0x1b:
+    case 0x03:
+    case 0x16:
+    case 0x17:
+    case 0x04:
+    case 0x0a:
+	my_session->multipacket[branch] = true;
+	break;
+    default:
+	my_session->multipacket[branch] = false;
+	break;
+    }
+
+    my_session->replies[branch] = 0;
+    my_session->reply_packets[branch] = 0;
+    my_session->eof[branch] = 0;
+    my_session->waiting[branch] = true;
+}
+
+/**
+ * Route a query in asynchronous mode. The query is routed to the parent
+ * service immediately and the duplicates are queued for the branch which
+ * executes them at its own pace. The tee_lock must be held by the caller
+ * and it is released by this function.
+ * @param my_instance Tee instance
+ * @param my_session Tee session
+ * @param queue The query data
+ * @return 1 on success, 0 on failure
+ */
+static int route_async(TEE_INSTANCE* my_instance, TEE_SESSION* my_session, GWBUF* queue)
+{
+    GWBUF *buffer, *clone, *packets = NULL;
+    int rval = 1;
+
+    my_session->queue = gwbuf_append(my_session->queue,queue);
+
+    while((buffer = modutil_get_next_MySQL_packet(&my_session->queue)) != NULL)
+    {
+	if(gwbuf_length(buffer) > 5 &&
+	   *((unsigned char*)buffer->start + 4) == 0x1b)
+	{
 	    my_session->client_multistatement = *((unsigned char*) buffer->start + 5);
-	    LOGIF(LT,(skygw_log_write(LT,"Tee: client %s multistatements",
-			my_session->client_multistatement ? "enabled":"disabled")));
-        case 0x03:
-        case 0x16:
-        case 0x17:
-        case 0x04:
-        case 0x0a:
-            memset(my_session->multipacket,(char)true,2*sizeof(bool));
-            break;
-        default:
-            memset(my_session->multipacket,(char)false,2*sizeof(bool));
-            break;
-        }
+	}
+	my_session->command = *((unsigned char*)buffer->start + 4);
 
-        memset(my_session->replies,0,2*sizeof(int));
-	memset(my_session->reply_packets,0,2*sizeof(int));
-        memset(my_session->eof,0,2*sizeof(int));
-        memset(my_session->waiting,1,2*sizeof(bool));
-        my_session->command = command;
+	if(!my_session->branch_dropped &&
+	   (clone = clone_query(my_instance,my_session,buffer)) != NULL)
+	{
+	    branch_enqueue(my_instance,my_session,clone);
+	}
+	else
+	{
+	    my_session->n_rejected++;
+	}
+	packets = gwbuf_append(packets,buffer);
+    }
 
-	return 1;
-}
\ No newline at end of file
+    if(!my_session->waiting[CHILD])
+    {
+	branch_dispatch(my_session);
+    }
+    spinlock_release(&my_session->tee_lock);
+
+    /** The parent is never held back by the branch */
+    while((buffer = modutil_get_next_MySQL_packet(&packets)) != NULL)
+    {
+	if(!my_session->down.routeQuery(my_session->down.instance,
+					my_session->down.session,
+					buffer))
+	{
+	    rval = 0;
+	}
+    }
+
+    return rval;
+}
+
+/**
+ * Add a duplicate to the queue of the asynchronous branch. If the queue is
+ * full, the branch has fallen too far behind the client and no more queries
+ * are sent to it in this session. The tee_lock must be held by the caller.
+ * @param my_instance Tee instance
+ * @param my_session Tee session
+ * @param clone The duplicated packet
+ */
+static void branch_enqueue(TEE_INSTANCE* my_instance, TEE_SESSION* my_session, GWBUF* clone)
+{
+    if(my_session->n_branch_queued >= my_instance->max_queue)
+    {
+	/** Dropping single statements would leave the branch in an
+	 * inconsistent state so the whole branch is dropped */
+	atomic_add(&my_instance->n_overflow,1);
+	atomic_add(&my_instance->n_dropped,my_session->n_branch_queued + 1);
+	LOGIF(LT, (skygw_log_write(
+		LOGFILE_TRACE,
+		"Tee: Branch queue of %d statements is full, "
+		"no longer duplicating statements to service '%s'.",
+		my_session->n_branch_queued,
+		my_instance->service->name)));
+	gwbuf_free(clone);
+	if(my_session->branch_queue)
+	{
+	    gwbuf_free(my_session->branch_queue);
+	    my_session->branch_queue = NULL;
+	}
+	my_session->n_branch_queued = 0;
+	my_session->branch_dropped = true;
+	return;
+    }
+
+    my_session->branch_queue = gwbuf_append(my_session->branch_queue,clone);
+    my_session->n_branch_queued++;
+    my_session->n_duped++;
+}
+
+/**
+ * Send queued duplicates to the asynchronous branch until one is sent that
+ * the branch replies to. The tee_lock must be held by the caller.
+ * @param my_session Tee session
+ */
+static void branch_dispatch(TEE_SESSION* my_session)
+{
+    GWBUF* buffer;
+    unsigned char command;
+
+    while(!my_session->waiting[CHILD] &&
+	  (buffer = modutil_get_next_MySQL_packet(&my_session->branch_queue)) != NULL)
+    {
+	my_session->n_branch_queued--;
+
+	if(my_session->branch_session == NULL ||
+	   my_session->branch_session->state != SESSION_STATE_ROUTER_READY)
+	{
+	    gwbuf_free(buffer);
+	    continue;
+	}
+
+	command = GWBUF_LENGTH(buffer) > 4 ? *((unsigned char*)buffer->start + 4) : 0;
+	my_session->branch_command = command;
+	reset_branch_state(my_session,CHILD,command);
+
+	/** COM_QUIT, COM_STMT_SEND_LONG_DATA and COM_STMT_CLOSE have no reply */
+	if(command == MYSQL_COM_QUIT ||
+	   command == MYSQL_COM_STMT_SEND_LONG_DATA ||
+	   command == MYSQL_COM_STMT_CLOSE)
+	{
+	    my_session->waiting[CHILD] = false;
+	}
+
+	SESSION_ROUTE_QUERY(my_session->branch_session, buffer);
+    }
+}
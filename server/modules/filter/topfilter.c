@@ -348,6 +348,7 @@ TOPN_SESSION	*my_session = (TOPN_SESSION *)session;
 struct timeval	diff;
 int		i;
 FILE		*fp;
+char		timestamp[TS_CACHE_STRLEN];
 
 	gettimeofday(&my_session->disconnect, NULL);
 	timersub((&my_session->disconnect), &(my_session->connect), &diff);
@@ -369,8 +370,9 @@ FILE		*fp;
 			}
 		}
 		fprintf(fp, "-----------+-----------------------------------------------------------------\n");
-		fprintf(fp, "\n\nSession started %s",
-			asctime(localtime(&my_session->connect.tv_sec)));
+		snprint_timestamp_cached(TS_FORMAT_LOG, &my_session->connect,
+			timestamp, sizeof(timestamp));
+		fprintf(fp, "\n\nSession started %.19s\n", timestamp);
 		if (my_session->clientHost)
 			fprintf(fp, "Connection from %s\n",
 				my_session->clientHost);
@@ -45,6 +45,7 @@
 
 /* How often to call the binlog status function (seconds) */
 #define	BLR_STATS_FREQ		60
+#define	BLR_SYNC_FREQ		1	/*< Group commit check, in seconds */
 #define BLR_NSTATS_MINUTES	30
 
 /**
@@ -61,6 +62,52 @@
 #define DEF_LONG_BURST		500
 #define DEF_BURST_SIZE		1024000	/* 1 Mb */
 
+/**
+ * Size of the read-ahead window used when reading binlog events for the
+ * slaves. Events that fit in the window are sent from it without a copy.
+ */
+#define BLR_READAHEAD_SIZE	65536	/* 64 Kb */
+
+/**
+ * Default size of the binlog tail cache, can be overriden by the router
+ * option tailcache. A size of 0 disables the cache.
+ */
+#define DEF_TAIL_CACHE_SIZE	(4 * 1024 * 1024)	/* 4 Mb */
+#define BLR_CACHE_INITIAL	1024	/* Initial records in the cache ring */
+
+/**
+ * When the binlog file is synced to disk, set by the router option durability.
+ *
+ * BLR_SYNC_EVENT	after every event
+ * BLR_SYNC_TRANSACTION	after every transaction commit, XID or COMMIT query
+ * BLR_SYNC_GROUP	once syncsize bytes or syncinterval milliseconds
+ *			have been written, checked after every read from the master
+ */
+#define BLR_SYNC_EVENT		1
+#define BLR_SYNC_TRANSACTION	2
+#define BLR_SYNC_GROUP		3
+
+/**
+ * The events received in a single read from the master are written to the
+ * binlog file with one write, up to these limits.
+ */
+#define BLR_WRITE_BUFFER_SIZE	262144	/* 256 Kb */
+#define BLR_WRITE_BUFFER_EVENTS	1024
+
+/**
+ * The number of buckets in the write and sync latency histograms. Bucket i
+ * counts the latencies below BLR_LATENCY_LIMIT(i) microseconds, the last
+ * bucket counts the rest.
+ */
+#define BLR_LATENCY_BUCKETS	8
+#define BLR_LATENCY_LIMIT(i)	(16UL << (2 * (i)))
+
+/**
+ * Number of read-ahead windows kept for each binlog file, slaves that read
+ * the same file at different positions each keep a window of their own.
+ */
+#define BLR_READAHEAD_WINDOWS	4
+
 /**
  * master reconnect backoff constants
  * BLR_MASTER_BACKOFF_TIME	The increments of the back off time (seconds)
@@ -96,31 +143,62 @@ typedef struct rep_header {
 } REP_HEADER;
 
 /**
- * The binlog record structure. This contains the actual packet read from the binlog
- * file.
+ * The binlog record structure. This contains an event written to the binlog
+ * file, as held in the binlog tail cache.
  */
 typedef struct {
 	unsigned long	position;	/*< binlog record position for this cache entry */
-	GWBUF		*pkt;		/*< The packet received from the master */
+	GWBUF		*pkt;		/*< The event received from the master */
 	REP_HEADER	hdr;		/*< The packet header */
 } BLCACHE_RECORD;
 
 /**
- * The binlog cache. A cache exists for each file that hold cached bin log records.
- * Caches will be used for all files being read by more than 1 slave.
+ * The binlog tail cache. The most recent events written to the current
+ * binlog file are kept in a ring, the slaves that are only slightly behind
+ * the master are sent clones of the cached events rather than reading them
+ * back from the binlog file.
  */
 typedef struct {
-	BLCACHE_RECORD	**records;	/*< The actual binlog records */
-	int		current;	/*< The next record that will be inserted */
+	BLCACHE_RECORD	*records;	/*< The ring of cached binlog records */
+	int		size;		/*< The number of entries in the ring */
+	int		first;		/*< The oldest record in the cache */
 	int		cnt;		/*< The number of records in the cache */
+	unsigned long	bytes;		/*< The size of the cached events */
+	unsigned long	max_bytes;	/*< The maximum size of the cached events */
+	char		binlogname[BINLOG_FNAMELEN+1];
+					/*< The binlog file of the cached records */
 	SPINLOCK	lock;		/*< The spinlock for the cache */
 } BLCACHE;
 
+/**
+ * The events buffered to be written to the binlog file with a single write
+ */
+typedef struct {
+	uint8_t		*data;		/*< The buffered events */
+	unsigned int	len;		/*< The size of the buffered events */
+	REP_HEADER	*events;	/*< The headers of the buffered events */
+	int		n_events;	/*< The number of buffered events */
+	int		commit;		/*< A transaction commit is buffered */
+} BLWRITEBUF;
+
+/**
+ * A read-ahead window of a binlog file. The events are sent to the slaves
+ * as clones of the part of the window that holds them.
+ */
+typedef struct {
+	GWBUF		*buf;		/*< The data read from the file */
+	unsigned long	pos;		/*< File offset of the data */
+	unsigned long	used;		/*< When the window was last used */
+} BLWINDOW;
+
 typedef struct blfile {
 	char		binlogname[BINLOG_FNAMELEN+1];	/*< Name of the binlog file */
 	int		fd;				/*< Actual file descriptor */
 	int		refcnt;				/*< Reference count for file */
 	BLCACHE		*cache;				/*< Record cache for this file */
+	BLWINDOW	windows[BLR_READAHEAD_WINDOWS];	/*< Read-ahead windows */
+	unsigned long	nuse;				/*< Window use counter */
+	unsigned long	filelen;			/*< Last known size of the file */
 	SPINLOCK	lock;				/*< The file lock */
 	struct blfile	*next;				/*< Next file in list */
 } BLFILE;
@@ -209,6 +287,12 @@ typedef struct {
 	uint64_t	n_fakeevents;	/*< Fake events not written to disk */
 	uint64_t	n_artificial;	/*< Artificial events not written to disk */
 	int		n_badcrc;	/*< No. of bad CRC's from master */
+	uint64_t	n_writes;	/*< Number of writes to the binlog files */
+	uint64_t	n_syncs;	/*< Number of syncs of the binlog files */
+	uint64_t	write_latency[BLR_LATENCY_BUCKETS];
+					/*< Histogram of the write latencies */
+	uint64_t	sync_latency[BLR_LATENCY_BUCKETS];
+					/*< Histogram of the sync latencies */
 	uint64_t	events[0x24];	/*< Per event counters */
 	uint64_t	lastsample;
 	int		minno;
@@ -271,9 +355,21 @@ typedef struct router_instance {
 					 *  file being written
 					 */
 	uint64_t	  last_written;	/*< Position of last event written */
+	BLWRITEBUF	  wbuf;		/*< Events waiting to be written */
+	int		  durability;	/*< When the binlog file is synced */
+	unsigned long	  sync_interval;/*< Group commit interval in milliseconds */
+	unsigned long	  sync_size;	/*< Group commit size in bytes */
+	unsigned long	  unsynced;	/*< Bytes written since the last sync */
+	unsigned long	  last_sync;	/*< Heartbeat of the last sync */
+	SPINLOCK	  sync_lock;	/*< Lock to serialise the syncs of
+					 *  the master and the housekeeper
+					 */
 	char		  prevbinlog[BINLOG_FNAMELEN+1];
 	int		  rotating;	/*< Rotation in progress flag */
 	BLFILE		  *files;	/*< Files used by the slaves */
+	BLCACHE		  *cache;	/*< Tail cache of the recent events */
+	unsigned long	  tail_cache_size;
+					/*< Maximum size of the tail cache */
 	SPINLOCK	  fileslock;	/*< Lock for the files queue above */
 	unsigned int	  low_water;	/*< Low water mark for client DCB */
 	unsigned int	  high_water;	/*< High water mark for client DCB */
@@ -443,11 +539,17 @@ extern int blr_slave_request(ROUTER_INSTANCE *, ROUTER_SLAVE *, GWBUF *);
 extern void blr_slave_rotate(ROUTER_INSTANCE *, ROUTER_SLAVE *, uint8_t *);
 extern int blr_slave_catchup(ROUTER_INSTANCE *router, ROUTER_SLAVE *slave, bool large);
 extern void blr_init_cache(ROUTER_INSTANCE *);
+extern void blr_cache_add(ROUTER_INSTANCE *, REP_HEADER *, uint8_t *);
+extern GWBUF *blr_cache_read(ROUTER_INSTANCE *, char *, unsigned long, REP_HEADER *);
+extern void blr_cache_stats(ROUTER_INSTANCE *, int *, unsigned long *);
 
 extern int  blr_file_init(ROUTER_INSTANCE *);
 extern int  blr_write_binlog_record(ROUTER_INSTANCE *, REP_HEADER *,uint8_t *);
 extern int  blr_file_rotate(ROUTER_INSTANCE *, char *, uint64_t);
 extern void blr_file_flush(ROUTER_INSTANCE *);
+extern int  blr_file_write(ROUTER_INSTANCE *, uint8_t *, unsigned int, unsigned long);
+extern void blr_file_written(ROUTER_INSTANCE *, REP_HEADER *);
+extern void blr_file_sync(ROUTER_INSTANCE *);
 extern BLFILE *blr_open_binlog(ROUTER_INSTANCE *, char *);
 extern GWBUF *blr_read_binlog(ROUTER_INSTANCE *, BLFILE *, unsigned int, REP_HEADER *);
 extern void blr_close_binlog(ROUTER_INSTANCE *, BLFILE *);
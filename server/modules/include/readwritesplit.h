@@ -32,6 +32,7 @@
 #include <dcb.h>
 #include <hashtable.h>
 #include <math.h>
+#include <limits.h>
 
 #undef PREP_STMT_CACHING
 
@@ -117,6 +118,7 @@ typedef enum select_criteria {
         LEAST_BEHIND_MASTER,
         LEAST_CURRENT_OPERATIONS,
         DEFAULT_CRITERIA=LEAST_CURRENT_OPERATIONS,
+        LEAST_RESPONSE_TIME,      /*< chosen per statement, see below */
         LAST_CRITERIA /*< not used except for an index */
 } select_criteria_t;
 
@@ -125,6 +127,22 @@ typedef enum select_criteria {
 #define CONFIG_MAX_SLAVE_CONN 1
 #define CONFIG_MAX_SLAVE_RLAG -1 /*< not used */
 #define CONFIG_SQL_VARIABLES_IN TYPE_ALL
+#define SESCMD_KEY_MAXLEN 512 /*< longest statement checked for a history key */
+
+/**
+ * With LEAST_RESPONSE_TIME the slave of each read is chosen when the statement
+ * is routed: two of the connected slaves are picked at random and the one with
+ * the smaller average response time gets the statement. The average is
+ * an exponentially weighted moving average where every new sample has the
+ * weight 1/2^RESP_TIME_EWMA_SHIFT. An average that has not been updated for
+ * RESP_TIME_STALE_USECS is stale: the slave gets one probe statement to
+ * measure it anew and loses every comparison until the probe is replied to.
+ * If the probe is not replied to in RESP_TIME_STALE_USECS the next probe is
+ * allowed.
+ */
+#define RESP_TIME_EWMA_SHIFT 3
+#define RESP_TIME_STALE_USECS 2000000
+#define RESP_TIME_PROBING ULONG_MAX /*< Stale average with a probe in flight */
 
 #define GET_SELECT_CRITERIA(s)                                                                  \
         (strncmp(s,"LEAST_GLOBAL_CONNECTIONS", strlen("LEAST_GLOBAL_CONNECTIONS")) == 0 ?       \
@@ -134,7 +152,9 @@ typedef enum select_criteria {
         strncmp(s,"LEAST_ROUTER_CONNECTIONS", strlen("LEAST_ROUTER_CONNECTIONS")) == 0 ?        \
         LEAST_ROUTER_CONNECTIONS : (                                                            \
         strncmp(s,"LEAST_CURRENT_OPERATIONS", strlen("LEAST_CURRENT_OPERATIONS")) == 0 ?        \
-        LEAST_CURRENT_OPERATIONS : UNDEFINED_CRITERIA))))
+        LEAST_CURRENT_OPERATIONS : (                                                            \
+        strncmp(s,"LEAST_RESPONSE_TIME", strlen("LEAST_RESPONSE_TIME")) == 0 ?                  \
+        LEAST_RESPONSE_TIME : UNDEFINED_CRITERIA)))))
         
 /**
  * Session variable command
@@ -151,6 +171,8 @@ typedef struct mysql_sescmd_st {
                                        *  LOCAL_INFILE. Slave servers are compared to this
                                        *  when they return session command replies.*/
         int      position; /*< Position of this command */
+        char*              my_sescmd_key; /*< Session state the command sets,
+                                           *  NULL if it can't be superseded */
 #if defined(SS_DEBUG)
         skygw_chk_t        my_sescmd_chk_tail;
 #endif
@@ -213,6 +235,13 @@ typedef struct backend_st {
 					      *  load. Expressed in .1%
 					      * increments
 					      */
+        unsigned long   resp_time;           /*< Average response time in
+                                              *  microseconds, 0 if unknown
+                                              */
+        unsigned long   resp_time_updated;   /*< When resp_time was updated */
+        unsigned long   resp_probe_start;    /*< When the probe of a stale
+                                              *  average was routed, 0 if none
+                                              */
 #if defined(SS_DEBUG)
         skygw_chk_t     be_chk_tail;
 #endif
@@ -234,6 +263,7 @@ typedef struct backend_ref_st {
         int             bref_num_result_wait;
         sescmd_cursor_t bref_sescmd_cur;
 	GWBUF*          bref_pending_cmd; /*< For stmt which can't be routed due active sescmd execution */
+        unsigned long   bref_query_start; /*< When the active query was written */
         unsigned char
 		reply_cmd;	/*< The reply the backend server sent to a session command.
                                  * Used to detect slaves that fail to execute session command. */
@@ -252,6 +282,7 @@ typedef struct rwsplit_config_st {
         int               rw_max_sescmd_history_size;
         bool disable_sescmd_hist;
         bool disable_slave_recovery;
+        bool compact_sescmd_hist;
 } rwsplit_config_t;
      
 
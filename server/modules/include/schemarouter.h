@@ -243,6 +243,26 @@ typedef struct schemarouter_config_st {
         bool disable_sescmd_hist;
 } schemarouter_config_t;
 
+/** Default interval in seconds between the refreshes of the shard map */
+#define SHARD_MAP_REFRESH_INTERVAL 300
+/** Minimum interval in seconds between refreshes caused by routing misses */
+#define SHARD_MAP_MIN_REFRESH 5
+/** Connect, read and write timeout for refreshing the shard map */
+#define SHARD_MAP_TIMEOUT 5
+
+/**
+ * The mapping of databases to servers shared by the sessions of a router
+ * instance. A published map is never modified, a refresh publishes a new map
+ * with a bigger version number. Each session using the map and the router
+ * instance holds a reference to it.
+ */
+typedef struct shard_map_st {
+        HASHTABLE*      hash;     /*< Database names mapped to server names */
+        int             version;  /*< Version of the map */
+        time_t          updated;  /*< When the map was generated */
+        int             refcount; /*< Number of references to the map */
+} shard_map_t;
+
 /**
  * The statistics for this router instance
  */
@@ -256,6 +276,9 @@ typedef struct {
         double          ses_longest;      /*< Longest session */
         double          ses_shortest; /*< Shortest session */
         double          ses_average; /*< Average session length */
+        int             shmap_cache_hit; /*< Sessions started from the shared map */
+        int             shmap_cache_miss; /*< Sessions that mapped the databases */
+        int             shmap_refresh; /*< Number of shard map refreshes */
 } ROUTER_STATS;
 
 /**
@@ -282,6 +305,7 @@ struct router_client_session {
 	struct router_instance	 *router;	/*< The router instance */
         struct router_client_session* next; /*< List of router sessions */
         HASHTABLE*      dbhash; /*< Database hash containing names of the databases mapped to the servers that contain them */
+        shard_map_t*    shard_map; /*< Shared map that dbhash belongs to, NULL if dbhash is private */
         char            connect_db[MYSQL_DATABASE_MAXLEN+1]; /*< Database the user was trying to connect to */
         init_mask_t    init; /*< Initialization state bitmask */
         GWBUF*          queue; /*< Query that was received before the session was ready */
@@ -312,6 +336,11 @@ typedef struct router_instance {
 	ROUTER_STATS            stats;       /*< Statistics for this router         */
         struct router_instance* next;        /*< Next router on the list            */
 	bool			available_slaves; /*< The router has some slaves available */
+	shard_map_t*		shard_map;   /*< Shared shard map, NULL if not yet generated */
+	SPINLOCK		map_lock;    /*< Lock for the shared shard map      */
+	int			map_version; /*< Version of the latest shard map    */
+	int			refresh_interval; /*< Shard map refresh interval, 0 disables the shared map */
+	time_t			last_refresh_attempt; /*< When a refresh was last requested */
 
 } ROUTER_INSTANCE;
 
@@ -71,6 +71,7 @@ extern size_t         log_ses_count[];
 extern __thread log_info_t tls_log_info;
 
 static	void	monitorMain(void *);
+static	void	probeMain(void *);
 
 static char *version_str = "V1.4.0";
 
@@ -100,6 +101,11 @@ static void set_slave_heartbeat(MYSQL_MONITOR *, MONITOR_SERVERS *);
 static int add_slave_to_master(long *, int, long);
 static void monitor_set_pending_status(MONITOR_SERVERS *, int);
 static void monitor_clear_pending_status(MONITOR_SERVERS *, int);
+static void monitor_set_probe_status(MONITOR_SERVERS *, int);
+static void monitor_clear_probe_status(MONITOR_SERVERS *, int);
+static void monitor_start_probes(MYSQL_MONITOR *);
+static void monitor_stop_probes(MYSQL_MONITOR *);
+static int monitor_run_probes(MYSQL_MONITOR *, size_t);
 
 static MONITOR_OBJECT MyObject = { 
 	startMonitor, 
@@ -184,6 +190,13 @@ CONFIG_PARAMETER* params = (CONFIG_PARAMETER*)opt;
             handle->connect_timeout=DEFAULT_CONNECT_TIMEOUT;
             handle->read_timeout=DEFAULT_READ_TIMEOUT;
             handle->write_timeout=DEFAULT_WRITE_TIMEOUT;
+            handle->probe_threads = MONITOR_DEFAULT_PROBE_THREADS;
+            handle->probe_tids = NULL;
+            handle->probe_queue = NULL;
+            handle->n_late_probes = 0;
+            pthread_mutex_init(&handle->probe_lock, NULL);
+            pthread_cond_init(&handle->probe_cond, NULL);
+            pthread_cond_init(&handle->probe_done, NULL);
             spinlock_init(&handle->lock);
         }
 
@@ -193,6 +206,20 @@ CONFIG_PARAMETER* params = (CONFIG_PARAMETER*)opt;
 		handle->detectStaleMaster = config_truth_value(params->value);
 	    else if(!strcmp(params->name,"detect_replication_lag"))
 		handle->replicationHeartbeat = config_truth_value(params->value);
+	    else if(!strcmp(params->name,"probe_threads"))
+	    {
+		int n = atoi(params->value);
+
+		if (n >= 0)
+		    handle->probe_threads = n;
+		else
+		    LOGIF(LE, (skygw_log_write_flush(
+			LOGFILE_ERROR,
+			"Error : Invalid value for 'probe_threads': %s, "
+			"using %d probe threads.",
+			params->value,
+			handle->probe_threads)));
+	    }
 	    params = params->next;
 	}
 
@@ -236,6 +263,12 @@ MONITOR_SERVERS	*ptr, *db;
         db->mon_prev_status = 0;
 	/* pending status is updated by get_replication_tree */
 	db->pending_status = 0;
+	db->probe_state = MON_PROBE_IDLE;
+	db->probe_round = 0;
+	db->probe_status = 0;
+	db->probe_node_id = -1;
+	db->probe_master_id = -1;
+	db->probe_next = NULL;
 
 	spinlock_acquire(&handle->lock);
         
@@ -343,6 +376,8 @@ char		*sep;
 	dcb_printf(dcb,"\tConnect Timeout:\t%i seconds\n", handle->connect_timeout);
 	dcb_printf(dcb,"\tRead Timeout:\t\t%i seconds\n", handle->read_timeout);
 	dcb_printf(dcb,"\tWrite Timeout:\t\t%i seconds\n", handle->write_timeout);
+	dcb_printf(dcb,"\tProbe threads:\t\t%i\n", handle->probe_threads);
+	dcb_printf(dcb,"\tLate probes:\t\t%i\n", handle->n_late_probes);
 	dcb_printf(dcb, "\tMonitored servers:	");
 
 	db = handle->databases;
@@ -363,6 +398,10 @@ char		*sep;
 /**
  * Monitor an individual server
  *
+ * This is called by the probe threads, in parallel for all the monitored
+ * servers. The probe only updates the probe fields of the monitored server,
+ * monitorMain applies them to the servers once the round is complete.
+ *
  * @param handle        The MySQL Monitor object
  * @param database	The database to probe
  */
@@ -384,16 +423,6 @@ char 		  *server_string;
 		passwd = database->server->monpw;
 	}
 	
-	if (uname == NULL)
-		return;
-        
-	/* Don't probe servers in maintenance mode */
-	if (SERVER_IN_MAINT(database->server))
-		return;
-
-        /** Store previous status */
-        database->mon_prev_status = database->server->status;
-        
 	if (database->con == NULL || mysql_ping(database->con) != 0)
 	{
 		char *dpwd = decryptPassword(passwd);
@@ -422,53 +451,33 @@ char 		  *server_string;
                         
 			/* The current server is not running
 			 *
-			 * Store server NOT running in server and monitor server pending struct
-			 *
+			 * Store server NOT running in the probe status, the
+			 * connect failure is logged by monitorMain
 			 */
 			if (mysql_errno(database->con) == ER_ACCESS_DENIED_ERROR)
 			{
-				server_set_status(database->server, SERVER_AUTH_ERROR);
-				monitor_set_pending_status(database, SERVER_AUTH_ERROR);
+				monitor_set_probe_status(database, SERVER_AUTH_ERROR);
 			}
-			server_clear_status(database->server, SERVER_RUNNING);
-			monitor_clear_pending_status(database, SERVER_RUNNING);
+			monitor_clear_probe_status(database, SERVER_RUNNING);
 
-			/* Also clear M/S state in both server and monitor server pending struct */
-			server_clear_status(database->server, SERVER_SLAVE);
-			server_clear_status(database->server, SERVER_MASTER);
-			monitor_clear_pending_status(database, SERVER_SLAVE);
-			monitor_clear_pending_status(database, SERVER_MASTER);
+			/* Also clear M/S state */
+			monitor_clear_probe_status(database, SERVER_SLAVE);
+			monitor_clear_probe_status(database, SERVER_MASTER);
 
 			/* Clean addition status too */
-			server_clear_status(database->server, SERVER_SLAVE_OF_EXTERNAL_MASTER);
-			server_clear_status(database->server, SERVER_STALE_STATUS);
-			monitor_clear_pending_status(database, SERVER_SLAVE_OF_EXTERNAL_MASTER);
-			monitor_clear_pending_status(database, SERVER_STALE_STATUS);
-
-			/* Log connect failure only once */
-			if (mon_status_changed(database) && mon_print_fail_status(database))
-			{
-                                LOGIF(LE, (skygw_log_write_flush(
-                                        LOGFILE_ERROR,
-                                        "Error : Monitor was unable to connect to "
-                                        "server %s:%d : \"%s\"",
-                                        database->server->name,
-                                        database->server->port,
-                                        mysql_error(database->con))));
-			}
+			monitor_clear_probe_status(database, SERVER_SLAVE_OF_EXTERNAL_MASTER);
+			monitor_clear_probe_status(database, SERVER_STALE_STATUS);
 
 			return;
 		}
 		else
 		{
-			server_clear_status(database->server, SERVER_AUTH_ERROR);
-			monitor_clear_pending_status(database, SERVER_AUTH_ERROR);
+			monitor_clear_probe_status(database, SERVER_AUTH_ERROR);
 		}
 		free(dpwd);
 	}
-        /* Store current status in both server and monitor server pending struct */
-	server_set_status(database->server, SERVER_RUNNING);
-	monitor_set_pending_status(database, SERVER_RUNNING);
+        /* Store current status in the probe status */
+	monitor_set_probe_status(database, SERVER_RUNNING);
 
 	/* get server version from current server */
 	server_version = mysql_get_server_version(database->con);
@@ -495,7 +504,7 @@ char 		  *server_string;
                         {
                                 server_id = -1;
                         }
-                        database->server->node_id = server_id;
+                        database->probe_node_id = server_id;
                 }
                 mysql_free_result(result);
         }
@@ -536,7 +545,7 @@ char 		  *server_string;
 				i++;
 			}
 			/* store master_id of current node */
-			memcpy(&database->server->master_id, &master_id, sizeof(long));
+			database->probe_master_id = master_id;
 
 			mysql_free_result(result);
 
@@ -573,15 +582,15 @@ char 		  *server_string;
 				}
 			}
 			/* store master_id of current node */
-			memcpy(&database->server->master_id, &master_id, sizeof(long));
+			database->probe_master_id = master_id;
 
 			mysql_free_result(result);
 		}
 	}
 
 	/* Remove addition info */
-	monitor_clear_pending_status(database, SERVER_SLAVE_OF_EXTERNAL_MASTER);
-	monitor_clear_pending_status(database, SERVER_STALE_STATUS);
+	monitor_clear_probe_status(database, SERVER_SLAVE_OF_EXTERNAL_MASTER);
+	monitor_clear_probe_status(database, SERVER_STALE_STATUS);
 
 	/* Please note, the MASTER status and SERVER_SLAVE_OF_EXTERNAL_MASTER
 	 * will be assigned in the monitorMain() via get_replication_tree() routine
@@ -590,14 +599,272 @@ char 		  *server_string;
 	/* Set the Slave Role */
 	if (isslave)
 	{
-		monitor_set_pending_status(database, SERVER_SLAVE);
+		monitor_set_probe_status(database, SERVER_SLAVE);
 		/* Avoid any possible stale Master state */
-		monitor_clear_pending_status(database, SERVER_MASTER);
+		monitor_clear_probe_status(database, SERVER_MASTER);
 	} else {
 		/* Avoid any possible Master/Slave stale state */
-		monitor_clear_pending_status(database, SERVER_SLAVE);
-		monitor_clear_pending_status(database, SERVER_MASTER);
+		monitor_clear_probe_status(database, SERVER_SLAVE);
+		monitor_clear_probe_status(database, SERVER_MASTER);
+	}
+}
+
+/**
+ * The entry point of a probe thread
+ *
+ * The probe threads take the servers queued by monitor_run_probes and
+ * probe them one at a time until the monitor is shut down.
+ *
+ * @param arg	The handle of the monitor
+ */
+static void
+probeMain(void *arg)
+{
+MYSQL_MONITOR	*handle = (MYSQL_MONITOR *)arg;
+MONITOR_SERVERS	*database;
+
+	if (mysql_thread_init())
+	{
+		LOGIF(LE, (skygw_log_write_flush(
+			LOGFILE_ERROR,
+			"Error : mysql_thread_init failed in a probe thread "
+			"of the monitor module.")));
+		return;
+	}
+
+	pthread_mutex_lock(&handle->probe_lock);
+
+	while (!handle->shutdown)
+	{
+		if ((database = handle->probe_queue) == NULL)
+		{
+			pthread_cond_wait(&handle->probe_cond, &handle->probe_lock);
+			continue;
+		}
+		handle->probe_queue = database->probe_next;
+		database->probe_next = NULL;
+		database->probe_state = MON_PROBE_RUNNING;
+		pthread_mutex_unlock(&handle->probe_lock);
+
+		monitorDatabase(handle, database);
+
+		pthread_mutex_lock(&handle->probe_lock);
+		database->probe_state = MON_PROBE_DONE;
+		pthread_cond_broadcast(&handle->probe_done);
+	}
+	pthread_mutex_unlock(&handle->probe_lock);
+	mysql_thread_end();
+}
+
+/**
+ * Start the probe threads of the monitor. If no probe thread can be started
+ * the servers are probed by the monitor thread itself.
+ *
+ * @param handle	The monitor handle
+ */
+static void
+monitor_start_probes(MYSQL_MONITOR *handle)
+{
+MONITOR_SERVERS	*ptr;
+void		*thd;
+int		i;
+
+	/* Nothing can be queued or probed from a previous run */
+	handle->probe_queue = NULL;
+
+	for (ptr = handle->databases; ptr; ptr = ptr->next)
+	{
+		ptr->probe_state = MON_PROBE_IDLE;
+		ptr->probe_next = NULL;
+	}
+
+	if (handle->probe_threads == 0)
+		return;
+
+	if ((handle->probe_tids = (pthread_t *)calloc(handle->probe_threads,
+						      sizeof(pthread_t))) == NULL)
+	{
+		handle->probe_threads = 0;
+		return;
+	}
+
+	for (i = 0; i < handle->probe_threads; i++)
+	{
+		if ((thd = thread_start(probeMain, handle)) == NULL)
+		{
+			LOGIF(LE, (skygw_log_write_flush(
+				LOGFILE_ERROR,
+				"Error : Failed to start probe thread %d of the "
+				"monitor module.",
+				i)));
+			handle->probe_threads = i;
+			break;
+		}
+		handle->probe_tids[i] = (pthread_t)thd;
+	}
+}
+
+/**
+ * Stop the probe threads of the monitor. The shutdown flag of the monitor
+ * must be set before calling this.
+ *
+ * @param handle	The monitor handle
+ */
+static void
+monitor_stop_probes(MYSQL_MONITOR *handle)
+{
+int	i;
+
+	pthread_mutex_lock(&handle->probe_lock);
+	pthread_cond_broadcast(&handle->probe_cond);
+	pthread_mutex_unlock(&handle->probe_lock);
+
+	for (i = 0; i < handle->probe_threads; i++)
+	{
+		thread_wait((void *)handle->probe_tids[i]);
 	}
+	free(handle->probe_tids);
+	handle->probe_tids = NULL;
+}
+
+/**
+ * Check whether a probe thread is using the connection of a server. The
+ * probe of a server that missed the deadline of its round keeps running and
+ * the monitor thread must not use the connection until it has finished.
+ *
+ * @param handle	The monitor handle
+ * @param database	The monitored server
+ * @return True if the probe of the server is queued or running
+ */
+static bool
+monitor_probe_busy(MYSQL_MONITOR *handle, MONITOR_SERVERS *database)
+{
+bool	busy;
+
+	pthread_mutex_lock(&handle->probe_lock);
+	busy = database->probe_state == MON_PROBE_QUEUED ||
+		database->probe_state == MON_PROBE_RUNNING;
+	pthread_mutex_unlock(&handle->probe_lock);
+
+	return busy;
+}
+
+/**
+ * Probe the monitored servers in parallel. The probes are queued for the
+ * probe threads and the results collected until all probes are done or the
+ * monitor interval has passed. A server whose probe is still running from an
+ * earlier round is not probed again and keeps its current status.
+ *
+ * The results are copied to the pending status of the probed servers, nothing
+ * is published to the servers here.
+ *
+ * @param handle	The monitor handle
+ * @param round		The number of the monitor round
+ * @return The number of monitored servers
+ */
+static int
+monitor_run_probes(MYSQL_MONITOR *handle, size_t round)
+{
+MONITOR_SERVERS	*ptr;
+struct timespec	deadline;
+int		num_servers = 0;
+int		waiting;
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += handle->interval / 1000;
+	deadline.tv_nsec += (handle->interval % 1000) * 1000000;
+
+	if (deadline.tv_nsec >= 1000000000)
+	{
+		deadline.tv_sec += 1;
+		deadline.tv_nsec -= 1000000000;
+	}
+
+	pthread_mutex_lock(&handle->probe_lock);
+
+	for (ptr = handle->databases; ptr; ptr = ptr->next)
+	{
+		num_servers++;
+
+		/* copy server status into monitor pending_status */
+		ptr->pending_status = ptr->server->status;
+
+		/* Don't probe servers in maintenance mode or without a user */
+		if (SERVER_IN_MAINT(ptr->server) ||
+		    (ptr->server->monuser == NULL && handle->defaultUser == NULL))
+			continue;
+
+		/** Store previous status */
+		ptr->mon_prev_status = ptr->server->status;
+
+		/* The probe of an earlier round is still queued or running */
+		if (ptr->probe_state == MON_PROBE_QUEUED ||
+		    ptr->probe_state == MON_PROBE_RUNNING)
+			continue;
+
+		ptr->probe_status = ptr->server->status;
+		ptr->probe_node_id = ptr->server->node_id;
+		ptr->probe_master_id = ptr->server->master_id;
+		ptr->probe_round = round;
+
+		if (handle->probe_threads == 0)
+		{
+			monitorDatabase(handle, ptr);
+			ptr->probe_state = MON_PROBE_DONE;
+		}
+		else
+		{
+			ptr->probe_state = MON_PROBE_QUEUED;
+			ptr->probe_next = handle->probe_queue;
+			handle->probe_queue = ptr;
+		}
+	}
+
+	pthread_cond_broadcast(&handle->probe_cond);
+
+	do
+	{
+		waiting = 0;
+
+		for (ptr = handle->databases; ptr; ptr = ptr->next)
+		{
+			if (ptr->probe_round == round &&
+			    ptr->probe_state != MON_PROBE_IDLE &&
+			    ptr->probe_state != MON_PROBE_DONE)
+				waiting++;
+		}
+	}
+	while (waiting > 0 && !handle->shutdown &&
+	       pthread_cond_timedwait(&handle->probe_done,
+				      &handle->probe_lock,
+				      &deadline) == 0);
+
+	for (ptr = handle->databases; ptr; ptr = ptr->next)
+	{
+		if (ptr->probe_state == MON_PROBE_DONE)
+		{
+			ptr->pending_status = ptr->probe_status;
+			ptr->server->node_id = ptr->probe_node_id;
+			ptr->server->master_id = ptr->probe_master_id;
+			ptr->probe_state = MON_PROBE_IDLE;
+		}
+		else if (ptr->probe_state != MON_PROBE_IDLE &&
+			 ptr->probe_round == round)
+		{
+			handle->n_late_probes++;
+			LOGIF(LE, (skygw_log_write_flush(
+				LOGFILE_ERROR,
+				"Error : Monitor probe of server %s:%d did not "
+				"complete in %lu milliseconds, keeping its "
+				"current status.",
+				ptr->server->name,
+				ptr->server->port,
+				handle->interval)));
+		}
+	}
+	pthread_mutex_unlock(&handle->probe_lock);
+
+	return num_servers;
 }
 
 /**
@@ -625,6 +892,7 @@ int log_no_master = 1;
                                    "module. Exiting.\n")));
 		return;
 	}                         
+	monitor_start_probes(handle);
 	handle->status = MONITOR_RUNNING;
 	
 	while (1)
@@ -632,6 +900,7 @@ int log_no_master = 1;
 		if (handle->shutdown)
 		{
 			handle->status = MONITOR_STOPPING;
+			monitor_stop_probes(handle);
 			mysql_thread_end();
 			handle->status = MONITOR_STOPPED;
 			return;
@@ -652,20 +921,15 @@ int log_no_master = 1;
 			continue;
 		}
 		nrounds += 1;
-		/* reset num_servers */
-		num_servers = 0;
+
+		/* probe all servers, the results are stored in pending_status */
+		num_servers = monitor_run_probes(handle, nrounds);
 
 		/* start from the first server in the list */
 		ptr = handle->databases;
 
 		while (ptr)
 		{
-			/* copy server status into monitor pending_status */
-			ptr->pending_status = ptr->server->status;
-
-			/* monitor current node */
-			monitorDatabase(handle, ptr);
-
 			/* reset the slave list of current node */
 			if (ptr->server->slaves) {
 				free(ptr->server->slaves);
@@ -673,70 +937,14 @@ int log_no_master = 1;
 			/* create a new slave list */
 			ptr->server->slaves = (long *) calloc(MONITOR_MAX_NUM_SLAVES, sizeof(long));
 
-			num_servers++;
-
-                        if (mon_status_changed(ptr))
-                        {
-				if (SRV_MASTER_STATUS(ptr->mon_prev_status))
-				{
-					/** Master failed, can't recover */
-					LOGIF(LM, (skygw_log_write(
-						LOGFILE_MESSAGE,
-						"Server %s:%d lost the master status.",
-						ptr->server->name,
-						ptr->server->port)));
-				}
-				/**
-				 * Here we say: If the server's state changed
-				 * so that it isn't running or some other way
-				 * lost cluster membership, call call-back function
-				 * of every DCB for which such callback was 
-				 * registered for this kind of issue (DCB_REASON_...)
-				 */
-				if (!(SERVER_IS_RUNNING(ptr->server)) || 
-					!(SERVER_IS_IN_CLUSTER(ptr->server)))
-				{
-					dcb_call_foreach(ptr->server,DCB_REASON_NOT_RESPONDING);
-				}				
-                        }
-                        
-                        if (mon_status_changed(ptr))
-                        {
-#if defined(SS_DEBUG)
-                                LOGIF(LT, (skygw_log_write_flush(
-                                        LOGFILE_TRACE,
-                                        "Backend server %s:%d state : %s",
-                                        ptr->server->name,
-                                        ptr->server->port,
-                                        STRSRVSTATUS(ptr->server))));
-#else
-				LOGIF(LD, (skygw_log_write_flush(
-					LOGFILE_DEBUG,
-					"Backend server %s:%d state : %s",
-					ptr->server->name,
-					ptr->server->port,
-					STRSRVSTATUS(ptr->server))));
-#endif
-                        }
-
-			if (SERVER_IS_DOWN(ptr->server))
-			{
-				/** Increase this server'e error count */
-				ptr->mon_err_count += 1;                                
-			}
-                        else
-                        {
-                                /** Reset this server's error count */
-                                ptr->mon_err_count = 0;
-                        }
-
 			ptr = ptr->next;
 		}
 	
 		ptr = handle->databases;
 		/* if only one server is configured, that's is Master */
 		if (num_servers == 1) {
-			if (SERVER_IS_RUNNING(ptr->server)) {
+			if ((ptr->pending_status & SERVER_RUNNING) &&
+				!SERVER_IN_MAINT(ptr->server)) {
 				ptr->server->depth = 0;
 				/* status cleanup */
 				monitor_clear_pending_status(ptr, SERVER_SLAVE);
@@ -753,7 +961,11 @@ int log_no_master = 1;
 			root_master = get_replication_tree(handle, num_servers);
 		}
 
-		/* Update server status from monitor pending status on that server*/
+		/*
+		 * Update server status from monitor pending status on that server.
+		 * This is the only place where the monitor changes the server
+		 * status so that all servers change their status together.
+		 */
 
                 ptr = handle->databases;
 		while (ptr)
@@ -765,6 +977,7 @@ int log_no_master = 1;
 					(!strcmp(ptr->server->name, root_master->server->name) && 
 					ptr->server->port == root_master->server->port) && 
 					(ptr->server->status & SERVER_MASTER) && 
+					(ptr->pending_status & SERVER_RUNNING) &&
 					!(ptr->pending_status & SERVER_MASTER)) 
 				{
 					/**
@@ -792,6 +1005,80 @@ int log_no_master = 1;
 			ptr = ptr->next;
 		}
 
+		ptr = handle->databases;
+		while (ptr)
+		{
+			/* Log connect failure only once */
+			if (mon_status_changed(ptr) && mon_print_fail_status(ptr) &&
+				ptr->con != NULL && !monitor_probe_busy(handle, ptr))
+			{
+                                LOGIF(LE, (skygw_log_write_flush(
+                                        LOGFILE_ERROR,
+                                        "Error : Monitor was unable to connect to "
+                                        "server %s:%d : \"%s\"",
+                                        ptr->server->name,
+                                        ptr->server->port,
+                                        mysql_error(ptr->con))));
+			}
+
+                        if (mon_status_changed(ptr))
+                        {
+				if (SRV_MASTER_STATUS(ptr->mon_prev_status))
+				{
+					/** Master failed, can't recover */
+					LOGIF(LM, (skygw_log_write(
+						LOGFILE_MESSAGE,
+						"Server %s:%d lost the master status.",
+						ptr->server->name,
+						ptr->server->port)));
+				}
+				/**
+				 * Here we say: If the server's state changed
+				 * so that it isn't running or some other way
+				 * lost cluster membership, call call-back function
+				 * of every DCB for which such callback was 
+				 * registered for this kind of issue (DCB_REASON_...)
+				 */
+				if (!(SERVER_IS_RUNNING(ptr->server)) || 
+					!(SERVER_IS_IN_CLUSTER(ptr->server)))
+				{
+					dcb_call_foreach(ptr->server,DCB_REASON_NOT_RESPONDING);
+				}				
+                        }
+                        
+                        if (mon_status_changed(ptr))
+                        {
+#if defined(SS_DEBUG)
+                                LOGIF(LT, (skygw_log_write_flush(
+                                        LOGFILE_TRACE,
+                                        "Backend server %s:%d state : %s",
+                                        ptr->server->name,
+                                        ptr->server->port,
+                                        STRSRVSTATUS(ptr->server))));
+#else
+				LOGIF(LD, (skygw_log_write_flush(
+					LOGFILE_DEBUG,
+					"Backend server %s:%d state : %s",
+					ptr->server->name,
+					ptr->server->port,
+					STRSRVSTATUS(ptr->server))));
+#endif
+                        }
+
+			if (SERVER_IS_DOWN(ptr->server))
+			{
+				/** Increase this server'e error count */
+				ptr->mon_err_count += 1;                                
+			}
+                        else
+                        {
+                                /** Reset this server's error count */
+                                ptr->mon_err_count = 0;
+                        }
+
+			ptr = ptr->next;
+		}
+
 		/* log master detection failure od first master becomes available after failure */
 		if (root_master && 
 			mon_status_changed(root_master) && 
@@ -831,11 +1118,14 @@ int log_no_master = 1;
 			(SERVER_IS_MASTER(root_master->server) || 
 				SERVER_IS_RELAY_SERVER(root_master->server))) 
 		{
-			set_master_heartbeat(handle, root_master);
+			/** Servers with a late probe keep their connection busy */
+			if (!monitor_probe_busy(handle, root_master))
+				set_master_heartbeat(handle, root_master);
 			ptr = handle->databases;
 			
 			while (ptr) {
-				if( (! SERVER_IN_MAINT(ptr->server)) && SERVER_IS_RUNNING(ptr->server))
+				if( (! SERVER_IN_MAINT(ptr->server)) && SERVER_IS_RUNNING(ptr->server) &&
+					!monitor_probe_busy(handle, ptr))
 				{
 					if (ptr->server->node_id != root_master->server->node_id && 
 						(SERVER_IS_SLAVE(ptr->server) || 
@@ -1235,7 +1525,7 @@ static MONITOR_SERVERS *get_replication_tree(MYSQL_MONITOR *handle, int num_serv
 		 * that means SERVER_IS_RUNNING returns 0
 		 * Let's check only for SERVER_IS_DOWN: server is not running
 		 */
-		if (SERVER_IS_DOWN(ptr->server)) {
+		if (!(ptr->pending_status & SERVER_RUNNING)) {
 				ptr = ptr->next;
 				continue;
 		}
@@ -1364,6 +1654,30 @@ monitor_clear_pending_status(MONITOR_SERVERS *ptr, int bit)
 	ptr->pending_status &= ~bit;
 }
 
+/**
+ * Set a status bit in the probe result of the monior server
+ *
+ * @param ptr           The monitored server
+ * @param bit           The bit to set for the server
+ */
+static void
+monitor_set_probe_status(MONITOR_SERVERS *ptr, int bit)
+{
+	ptr->probe_status |= bit;
+}
+
+/**
+ * Clear a status bit in the probe result of the monior server
+ *
+ * @param ptr           The monitored server
+ * @param bit           The bit to clear for the server
+ */
+static void
+monitor_clear_probe_status(MONITOR_SERVERS *ptr, int bit)
+{
+	ptr->probe_status &= ~bit;
+}
+
 /**
  * Set the default id to use in the monitor.
  *
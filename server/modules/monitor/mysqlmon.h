@@ -51,10 +51,25 @@ typedef struct monitor_servers {
 	int		mon_err_count;
 	unsigned int	mon_prev_status;
 	unsigned int	pending_status; /**< Pending Status flag bitmap */	
+	int		probe_state;	/**< State of the probe of this server */
+	size_t		probe_round;	/**< The monitor round the probe was queued in */
+	unsigned int	probe_status;	/**< Status bitmap found by the probe */
+	long		probe_node_id;	/**< server_id found by the probe */
+	long		probe_master_id; /**< Master_Server_Id found by the probe */
+	struct monitor_servers
+			*probe_next;	/**< The next server in the probe queue */
 	struct monitor_servers
 			*next;		/**< The next server in the list */
 } MONITOR_SERVERS;
 
+/**
+ * The states of the probe of a monitored server
+ */
+#define MON_PROBE_IDLE		0	/**< Not queued, no result pending */
+#define MON_PROBE_QUEUED	1	/**< Waiting for a probe thread */
+#define MON_PROBE_RUNNING	2	/**< Being probed by a probe thread */
+#define MON_PROBE_DONE		3	/**< Probed, result not yet applied */
+
 /**
  * The handle for an instance of a MySQL Monitor module
  */
@@ -81,6 +96,13 @@ typedef struct {
 	int	write_timeout;		/**< Timeout in seconds for each attempt to write to the server.
 					 * There are retries and the total effective timeout value is two times the option value.
 					 */
+	int	probe_threads;		/**< Number of threads probing the servers */
+	pthread_t *probe_tids;		/**< The probe threads */
+	pthread_mutex_t probe_lock;	/**< Protects the probe queue and states */
+	pthread_cond_t probe_cond;	/**< Signalled when probes are queued */
+	pthread_cond_t probe_done;	/**< Signalled when a probe completes */
+	MONITOR_SERVERS *probe_queue;	/**< Servers waiting to be probed */
+	int	n_late_probes;		/**< Probes that missed the round deadline */
 } MYSQL_MONITOR;
 
 #define MONITOR_RUNNING		1
@@ -90,5 +112,6 @@ typedef struct {
 #define MONITOR_INTERVAL 10000 // in milliseconds
 #define MONITOR_DEFAULT_ID 1UL // unsigned long value
 #define MONITOR_MAX_NUM_SLAVES 20 //number of MySQL slave servers associated to a MySQL master server
+#define MONITOR_DEFAULT_PROBE_THREADS 4 //number of threads probing the servers in parallel
 
 #endif
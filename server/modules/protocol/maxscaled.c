@@ -87,7 +87,8 @@ static GWPROTOCOL MyObject = {
 	maxscaled_close,		/**< Close			 */
 	maxscaled_listen,		/**< Create a listener		 */
 	NULL,				/**< Authentication		 */
-	NULL				/**< Session			 */
+	NULL,				/**< Session			 */
+	NULL				/**< Reset			 */
 	};
 
 /**
@@ -67,6 +67,7 @@ static int gw_MySQLWrite_backend(DCB *dcb, GWBUF *queue);
 static int gw_error_backend_event(DCB *dcb);
 static int gw_backend_close(DCB *dcb);
 static int gw_backend_hangup(DCB *dcb);
+static int gw_backend_reset(DCB *dcb, SESSION *session);
 static int backend_write_delayqueue(DCB *dcb);
 static void backend_set_delayqueue(DCB *dcb, GWBUF *queue);
 static int gw_change_user(DCB *backend_dcb, SERVER *server, SESSION *in_session, GWBUF *queue);
@@ -92,7 +93,8 @@ static GWPROTOCOL MyObject = {
 	gw_backend_close,			/* Close			 */
 	NULL,					/* Listen			 */
 	gw_change_user,				/* Authentication		 */
-        NULL                                    /* Session                       */
+        NULL,                                   /* Session                       */
+        gw_backend_reset                        /* Reset                         */
 };
 
 /*
@@ -166,6 +168,12 @@ static int gw_read_backend_event(DCB *dcb) {
         int            rc = 0;
 
         CHK_DCB(dcb);        
+
+        /*< data from an idle pooled connection is an error or EOF */
+        if (dcb_persistent_discard(dcb))
+        {
+                return 0;
+        }
 	CHK_SESSION(dcb->session);
                 
         /*< return only with complete session */
@@ -492,6 +500,7 @@ static int gw_read_backend_event(DCB *dcb) {
                 {
                         ss_dassert(read_buffer != NULL || dcb->dcb_readqueue != NULL);
                 }
+                dcb_latency_reply(dcb);
 		
 		if(dcb->dcb_readqueue)
 		{
@@ -690,6 +699,20 @@ gw_MySQLWrite_backend(DCB *dcb, GWBUF *queue)
 	MySQLProtocol *backend_protocol = dcb->protocol;
         int rc = 0; 
 
+        /**
+         * Don't pass the client's COM_QUIT to a server that has a connection
+         * pool. gw_backend_close sends COM_QUIT if the connection is closed
+         * instead of being pooled.
+         */
+        if (dcb->state == DCB_STATE_POLLING &&
+                dcb->server != NULL &&
+                dcb->server->persistpoolmax > 0 &&
+                GWBUF_LENGTH(queue) > 4 &&
+                MYSQL_IS_COM_QUIT(((uint8_t *)GWBUF_DATA(queue))))
+        {
+                gwbuf_free(queue);
+                return 1;
+        }
         spinlock_acquire(&dcb->authlock);
         /**
          * Pick action according to state of protocol. 
@@ -740,6 +763,7 @@ gw_MySQLWrite_backend(DCB *dcb, GWBUF *queue)
                                 /** Record the command to backend's protocol */
                                 protocol_add_srv_command(backend_protocol, cmd);
                         }
+                        dcb_latency_request(dcb);
                         /** Write to backend */
                         rc = dcb_write(dcb, queue);
                         goto return_rc;
@@ -769,6 +793,7 @@ gw_MySQLWrite_backend(DCB *dcb, GWBUF *queue)
                                 /** Record the command to backend's protocol */
                                 protocol_add_srv_command(backend_protocol, cmd);
                         }
+                        dcb_latency_request(dcb);
                         /*<
                          * Now put the incoming data to the delay queue unless backend is
                          * connected with auth ok
@@ -802,6 +827,11 @@ static int gw_error_backend_event(DCB *dcb)
         session_state_t ses_state;
         
 	CHK_DCB(dcb);
+
+        if (dcb_persistent_discard(dcb))
+        {
+                return 1;
+        }
 	session = dcb->session;
 	CHK_SESSION(session);
         rsession = session->router_session;
@@ -1043,6 +1073,11 @@ gw_backend_hangup(DCB *dcb)
         session_state_t ses_state;
         
         CHK_DCB(dcb);
+
+        if (dcb_persistent_discard(dcb))
+        {
+                return 1;
+        }
         session = dcb->session;
         CHK_SESSION(session);
         
@@ -1140,7 +1175,6 @@ gw_backend_close(DCB *dcb)
         
         CHK_DCB(dcb);
         session = dcb->session;
-        CHK_SESSION(session);
 
 	LOGIF(LD, (skygw_log_write(LOGFILE_DEBUG,
 			"%lu [gw_backend_close]",
@@ -1153,6 +1187,13 @@ gw_backend_close(DCB *dcb)
         mysql_send_com_quit(dcb, 0, quitbuf);
         
         mysql_protocol_done(dcb);
+
+        /** Connections from the connection pool have no session */
+        if (session == NULL)
+        {
+                return 1;
+        }
+        CHK_SESSION(session);
 	/** 
 	 * The lock is needed only to protect the read of session->state and 
 	 * session->client values. Client's state may change by other thread
@@ -1187,6 +1228,69 @@ gw_backend_close(DCB *dcb)
 	return 1;
 }
 
+/**
+ * Reset entry point for the connection pool of the server.
+ *
+ * With a NULL session, checks that the connection is authenticated and that
+ * no replies to session commands are pending so that it can be pooled.
+ *
+ * Otherwise the pooled connection is taken into use by the session. The
+ * COM_CHANGE_USER sent with the credentials of the session clears the state
+ * left by the previous session and selects the default database of the new
+ * one. The reply is read in gw_read_backend_event as the reply to the initial
+ * authentication and writes are kept in the delay queue until then.
+ *
+ * @param dcb		The backend DCB
+ * @param session	The session taking the connection or NULL
+ * @return 1 if the connection can be used, 0 if it must be closed
+ */
+static int gw_backend_reset(
+        DCB     *dcb,
+        SESSION *session)
+{
+        MySQLProtocol *backend_protocol = (MySQLProtocol *)dcb->protocol;
+        MySQLProtocol *client_protocol;
+        MYSQL_session *mses;
+        GWBUF         *buf;
+        int           rc = 0;
+
+        CHK_PROTOCOL(backend_protocol);
+        spinlock_acquire(&dcb->authlock);
+
+        if (backend_protocol->protocol_auth_state != MYSQL_IDLE)
+        {
+                rc = 0;
+        }
+        else if (session == NULL)
+        {
+                rc = protocol_get_srv_command(backend_protocol, false) ==
+                        MYSQL_COM_UNDEFINED;
+        }
+        else if (session->client != NULL &&
+                (client_protocol = (MySQLProtocol *)session->client->protocol) != NULL &&
+                (mses = (MYSQL_session *)session->data) != NULL &&
+                client_protocol->client_capabilities ==
+                backend_protocol->client_capabilities)
+        {
+                backend_protocol->charset = client_protocol->charset;
+                buf = gw_create_change_user_packet(mses, backend_protocol);
+                /** Writes are delayed until the reply has been read */
+                backend_protocol->protocol_auth_state = MYSQL_AUTH_RECV;
+                rc = dcb_write(dcb, buf);
+        }
+        spinlock_release(&dcb->authlock);
+
+        LOGIF(LD, (skygw_log_write(
+                LOGFILE_DEBUG,
+                "%lu [gw_backend_reset] dcb %p fd %d session %p, return %d.",
+                pthread_self(),
+                dcb,
+                dcb->fd,
+                session,
+                rc)));
+        return rc;
+}
+
 /**
  * This routine put into the delay queue the input queue
  * The input is what backend DCB is receiving
@@ -46,6 +46,7 @@
 #include <modinfo.h>
 #include <sys/stat.h>
 #include <modutil.h>
+#include <histogram.h>
 
 MODULE_INFO info = {
 	MODULE_API_PROTOCOL,
@@ -92,7 +93,8 @@ static GWPROTOCOL MyObject = {
 	gw_client_close,			/* Close			 */
 	gw_MySQLListener,			/* Listen			 */
 	NULL,					/* Authentication		 */
-	NULL					/* Session			 */
+	NULL,					/* Session			 */
+	NULL					/* Reset			 */
 };
 
 /**
@@ -834,6 +836,8 @@ int gw_read_client_event(
                 if (session != NULL) 
                 {
                         CHK_SESSION(session);
+                        /** The start of the routing latency of the service */
+                        session->stats.request_read = histogram_usecs();
                 }
                 /* Now, we are assuming in the first buffer there is
                  * the information form mysql command */
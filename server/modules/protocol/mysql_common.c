@@ -44,6 +44,15 @@
 #include <skygw_types.h>
 #include <skygw_utils.h>
 #include <log_manager.h>
+#include <objpool.h>
+
+/**
+ * The protocol objects of the client and the backend modules share a pool,
+ * every thread keeps at most MYSQL_PROTOCOL_POOL_MAX_FREE of them.
+ */
+#define	MYSQL_PROTOCOL_POOL_MAX_FREE	256
+
+static OBJPOOL *protocol_pool = NULL;
 
 /** Defined in log_manager.cc */
 extern int            lm_enabled_logfiles_bitmask;
@@ -79,7 +88,11 @@ MySQLProtocol* mysql_protocol_init(
 {
         MySQLProtocol* p;
         
-	p = (MySQLProtocol *) calloc(1, sizeof(MySQLProtocol));
+	if (protocol_pool == NULL)
+		protocol_pool = objpool_get("MySQLProtocol",
+					sizeof(MySQLProtocol),
+					MYSQL_PROTOCOL_POOL_MAX_FREE);
+	p = protocol_pool ? (MySQLProtocol *)objpool_alloc(protocol_pool) : NULL;
         ss_dassert(p != NULL);
         
         if (p == NULL) {
@@ -106,6 +119,8 @@ MySQLProtocol* mysql_protocol_init(
         /*< Assign fd with protocol */
         p->fd = fd;
 	p->owner_dcb = dcb;
+	/*< The DCB returns the protocol to the pool when it is freed */
+	dcb->protocol_pool = protocol_pool;
         p->protocol_state = MYSQL_PROTOCOL_ACTIVE;
         CHK_PROTOCOL(p);
 return_p:
@@ -1426,6 +1441,7 @@ int gw_find_mysql_user_password_sha1(char *username, uint8_t *gateway_password,
         char *user_password = NULL;
 	MYSQL_USER_HOST key;
 	MYSQL_session *client_data = NULL;
+	bool localhost;
 
 	client_data = (MYSQL_session *) dcb->data;	
 	service = (SERVICE *) dcb->service;
@@ -1446,103 +1462,37 @@ int gw_find_mysql_user_password_sha1(char *username, uint8_t *gateway_password,
 				key.resource != NULL ?" db: " :"",
 				 key.resource != NULL ?key.resource :"")));
 
-	/* look for user@current_ipv4 now */
-        user_password = mysql_users_fetch(service->users, &key);
-
-        if (!user_password) {
-		/* The user is not authenticated @ current IPv4 */
-
-		while (1) {
-			/*
-			 * (1) Check for localhost first: 127.0.0.1 (IPv4 only)
- 			 */
-
-			if ((key.ipv4.sin_addr.s_addr == 0x0100007F) && 
-				!dcb->service->localhost_match_wildcard_host) 
-			{
- 			 	/* Skip the wildcard check and return 1 */
-				LOGIF(LE,
-					(skygw_log_write_flush(
-						LOGFILE_ERROR,
-						"Error : user %s@%s not found, try set "
-						"'localhost_match_wildcard_host=1' in "
-						"service definition of the configuration "
-						"file.",
-						key.user,
-						dcb->remote)));
-
-				break;
-			}
-
-			/*
-			 * (2) check for possible IPv4 class C,B,A networks
-			 */
-
-			/* Class C check */
-			key.ipv4.sin_addr.s_addr &= 0x00FFFFFF;
-			key.netmask -= 8;
-
-			user_password = mysql_users_fetch(service->users, &key);
-
-			if (user_password) {
-				break;
-			}
-
-			/* Class B check */
-			key.ipv4.sin_addr.s_addr &= 0x0000FFFF;
-			key.netmask -= 8;
-
-			user_password = mysql_users_fetch(service->users, &key);
-
-			if (user_password) {
-				break;
-			}
-
-			/* Class A check */
-			key.ipv4.sin_addr.s_addr &= 0x000000FF;
-			key.netmask -= 8;
-
-			user_password = mysql_users_fetch(service->users, &key);
-
-			if (user_password) {
-				break;
-			}
-
-			/*
-			 * (3) Continue check for wildcard host, user@%
-			 */
-
-			memset(&key.ipv4, 0, sizeof(struct sockaddr_in));
-			key.netmask = 0;
+	/*
+	 * Look for the best matching user@host grant: the exact IPv4 address,
+	 * then the IPv4 class C,B,A networks and finally the wildcard host,
+	 * user@%. Connections from localhost (IPv4 only) only match the
+	 * wildcard hosts if localhost_match_wildcard_host is set.
+	 */
+	localhost = (key.ipv4.sin_addr.s_addr == 0x0100007F);
+	user_password = mysql_users_find(service->users,
+					 &key,
+					 !localhost || dcb->service->localhost_match_wildcard_host);
 
-			LOGIF(LD,
+	if (!user_password) {
+		if (localhost && !dcb->service->localhost_match_wildcard_host)
+		{
+			LOGIF(LE,
 				(skygw_log_write_flush(
-					LOGFILE_DEBUG,
-					"%lu [MySQL Client Auth], checking user [%s@%s] with wildcard host [%%]",
-					pthread_self(),
+					LOGFILE_ERROR,
+					"Error : user %s@%s not found, try set "
+					"'localhost_match_wildcard_host=1' in "
+					"service definition of the configuration "
+					"file.",
 					key.user,
 					dcb->remote)));
+		}
+		else
+		{
+			/*
+			 * user@% not found.
+			 */
 
-			user_password = mysql_users_fetch(service->users, &key);
-
-			if (user_password)
-			{
-			    break;
-			}
-
-			/** See if ANYDB == Y */
-			if(key.resource)
-			{
-			    key.resource = NULL;
-			    continue;
-			}
-
-			if (!user_password) {
-				/*
-				 * user@% not found.
- 				 */
-
-			    LOGIF(LD,
+			LOGIF(LD,
 			     (skygw_log_write_flush(
 				    LOGFILE_DEBUG,
 					      "%lu [MySQL Client Auth], user [%s@%s] not existent",
@@ -1550,14 +1500,11 @@ int gw_find_mysql_user_password_sha1(char *username, uint8_t *gateway_password,
 					      key.user,
 					      dcb->remote)));
 
-			    LOGIF(LT,skygw_log_write_flush(
+			LOGIF(LT,skygw_log_write_flush(
 				    LOGFILE_ERROR,
 					     "Authentication Failed: user [%s@%s] not found.",
 					     key.user,
 					     dcb->remote));
-			    break;
-			}
-
 		}
 	}
 
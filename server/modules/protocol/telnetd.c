@@ -96,7 +96,8 @@ static GWPROTOCOL MyObject = {
 	telnetd_close,			/**< Close			 */
 	telnetd_listen,			/**< Create a listener		 */
 	NULL,				/**< Authentication		 */
-	NULL				/**< Session			 */
+	NULL,				/**< Session			 */
+	NULL				/**< Reset			 */
 	};
 
 static void 	telnetd_command(DCB *, unsigned char *cmd);
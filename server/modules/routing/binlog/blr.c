@@ -102,6 +102,8 @@ static ROUTER_OBJECT MyObject = {
 };
 
 static void	stats_func(void *);
+static void	sync_func(void *);
+static unsigned long blr_size_option(char *value);
 
 static bool rses_begin_locked_router_action(ROUTER_SLAVE *);
 static void rses_end_locked_router_action(ROUTER_SLAVE *);
@@ -181,6 +183,7 @@ unsigned char	*defuuid;
 	inst->files = NULL;
 	spinlock_init(&inst->fileslock);
 	spinlock_init(&inst->binlog_lock);
+	spinlock_init(&inst->sync_lock);
 
 	inst->binlog_fd = -1;
 	inst->master_chksum = true;
@@ -192,6 +195,10 @@ unsigned char	*defuuid;
 	inst->short_burst = DEF_SHORT_BURST;
 	inst->long_burst = DEF_LONG_BURST;
 	inst->burst_size = DEF_BURST_SIZE;
+	inst->tail_cache_size = DEF_TAIL_CACHE_SIZE;
+	inst->durability = BLR_SYNC_GROUP;
+	inst->sync_interval = 0;
+	inst->sync_size = 0;
 	inst->retry_backoff = 1;
 	inst->binlogdir = NULL;
 	inst->heartbeat = 300;	// Default is every 5 minutes
@@ -242,6 +249,11 @@ unsigned char	*defuuid;
 	 *	filestem=
 	 *	lowwater=
 	 *	highwater=
+	 *	burstsize=
+	 *	tailcache=
+	 *	durability=
+	 *	syncinterval=
+	 *	syncsize=
 	 */
 	if (options)
 	{
@@ -312,27 +324,35 @@ unsigned char	*defuuid;
 				}
 				else if (strcmp(options[i], "burstsize") == 0)
 				{
-					unsigned long size = atoi(value);
-					char	*ptr = value;
-					while (*ptr && isdigit(*ptr))
-						ptr++;
-					switch (*ptr)
-					{
-					case 'G':
-					case 'g':
-						size = size * 1024 * 1000 * 1000;
-						break;
-					case 'M':
-					case 'm':
-						size = size * 1024 * 1000;
-						break;
-					case 'K':
-					case 'k':
-						size = size * 1024;
-						break;
-					}
-					inst->burst_size = size;
-					
+					inst->burst_size = blr_size_option(value);
+				}
+				else if (strcmp(options[i], "tailcache") == 0)
+				{
+					inst->tail_cache_size = blr_size_option(value);
+				}
+				else if (strcmp(options[i], "durability") == 0)
+				{
+					if (strcasecmp(value, "event") == 0)
+						inst->durability = BLR_SYNC_EVENT;
+					else if (strcasecmp(value, "transaction") == 0)
+						inst->durability = BLR_SYNC_TRANSACTION;
+					else if (strcasecmp(value, "group") == 0)
+						inst->durability = BLR_SYNC_GROUP;
+					else
+						LOGIF(LE, (skygw_log_write(
+							LOGFILE_ERROR,
+							"Warning : Unsupported value %s for "
+							"router option durability, expected "
+							"event, transaction or group.",
+							value)));
+				}
+				else if (strcmp(options[i], "syncinterval") == 0)
+				{
+					inst->sync_interval = atoi(value);
+				}
+				else if (strcmp(options[i], "syncsize") == 0)
+				{
+					inst->sync_size = blr_size_option(value);
 				}
 				else if (strcmp(options[i], "heartbeat") == 0)
 				{
@@ -426,6 +446,11 @@ unsigned char	*defuuid;
 	{
 		sprintf(name, "%s stats", service->name);
 		hktask_add(name, stats_func, inst, BLR_STATS_FREQ);
+		if (inst->durability == BLR_SYNC_GROUP && inst->sync_interval > 0)
+		{
+			sprintf(name, "%s binlog sync", service->name);
+			hktask_add(name, sync_func, inst, BLR_SYNC_FREQ);
+		}
 	}
 
 	/*
@@ -702,6 +727,8 @@ int		minno = 0;
 double		min5, min10, min15, min30;
 char		buf[40];
 struct tm	tm;
+int		cache_cnt;
+unsigned long	cache_bytes;
 
 	spinlock_acquire(&router_inst->lock);
 	session = router_inst->slaves;
@@ -785,6 +812,41 @@ struct tm	tm;
 		   router_inst->stats.n_residuals);
 	dcb_printf(dcb, "\tAverage events per packet			%.1f\n",
 		   (double)router_inst->stats.n_binlogs / router_inst->stats.n_reads);
+	dcb_printf(dcb, "\tBinlog durability:				%s\n",
+		   router_inst->durability == BLR_SYNC_EVENT ? "event" :
+		   (router_inst->durability == BLR_SYNC_TRANSACTION ?
+		   "transaction" : "group"));
+	dcb_printf(dcb, "\tNumber of binlog file writes:			%lu\n",
+		   (unsigned long)router_inst->stats.n_writes);
+	dcb_printf(dcb, "\tNumber of binlog file syncs:			%lu\n",
+		   (unsigned long)router_inst->stats.n_syncs);
+	dcb_printf(dcb, "\tBinlog write and sync latencies:\n");
+	dcb_printf(dcb, "\t\t%-20s %12s %12s\n", "Latency", "Writes", "Syncs");
+	for (j = 0; j < BLR_LATENCY_BUCKETS; j++)
+	{
+		if (j < BLR_LATENCY_BUCKETS - 1)
+			sprintf(buf, "< %lu us", BLR_LATENCY_LIMIT(j));
+		else
+			sprintf(buf, ">= %lu us", BLR_LATENCY_LIMIT(j - 1));
+		dcb_printf(dcb, "\t\t%-20s %12lu %12lu\n", buf,
+			   (unsigned long)router_inst->stats.write_latency[j],
+			   (unsigned long)router_inst->stats.sync_latency[j]);
+	}
+	if (router_inst->cache)
+	{
+		blr_cache_stats(router_inst, &cache_cnt, &cache_bytes);
+		dcb_printf(dcb, "\tEvents in binlog tail cache:			%d\n",
+			   cache_cnt);
+		dcb_printf(dcb, "\tBinlog tail cache size:				%lu of %lu bytes\n",
+			   cache_bytes, router_inst->cache->max_bytes);
+		dcb_printf(dcb, "\tBinlog tail cache hits/misses:			%lu/%lu\n",
+			   (unsigned long)router_inst->stats.n_cachehits,
+			   (unsigned long)router_inst->stats.n_cachemisses);
+		dcb_printf(dcb, "\tBinlog tail cache hit rate:			%.1f%%\n",
+			   router_inst->stats.n_cachehits + router_inst->stats.n_cachemisses ?
+			   (double)router_inst->stats.n_cachehits * 100 /
+			   (router_inst->stats.n_cachehits + router_inst->stats.n_cachemisses) : 0.0);
+	}
 	dcb_printf(dcb, "\tLast event from master at:  			%s",
 				buf);
 	dcb_printf(dcb, "\t					(%d seconds ago)\n",
@@ -1118,6 +1180,39 @@ static uint8_t getCapabilities(ROUTER *inst, void *router_session)
         return 0;
 }
 
+/**
+ * Parse the value of a router option that gives a size, the size may be
+ * qualified with K, M or G.
+ *
+ * @param value	The option value
+ * @return	The size in bytes
+ */
+static unsigned long
+blr_size_option(char *value)
+{
+unsigned long	size = atoi(value);
+char		*ptr = value;
+
+	while (*ptr && isdigit(*ptr))
+		ptr++;
+	switch (*ptr)
+	{
+	case 'G':
+	case 'g':
+		size = size * 1024 * 1000 * 1000;
+		break;
+	case 'M':
+	case 'm':
+		size = size * 1024 * 1000;
+		break;
+	case 'K':
+	case 'k':
+		size = size * 1024;
+		break;
+	}
+	return size;
+}
+
 /**
  * The stats gathering function called from the housekeeper so that we
  * can get timed averages of binlog records shippped
@@ -1150,6 +1245,19 @@ ROUTER_SLAVE	*slave;
 	spinlock_release(&router->lock);
 }
 
+/**
+ * The group commit check called from the housekeeper so that the binlog
+ * file is synced within the sync interval even if the master sends no
+ * more events.
+ *
+ * @param inst	The router instance
+ */
+static void
+sync_func(void *inst)
+{
+	blr_file_flush((ROUTER_INSTANCE *)inst);
+}
+
 /**
  * Return some basic statistics from the router in response to a COM_STATISTICS
  * request.
@@ -58,14 +58,224 @@ extern size_t         log_ses_count[];
 extern __thread log_info_t tls_log_info;
 
 
+static void blr_cache_reset(BLCACHE *cache);
+
 /**
- * Initialise the cache for this instanceof the binlog router. As a side
- * effect also determine the binlog file to read and the position to read
- * from.
+ * Initialise the binlog tail cache for this instance of the binlog router.
+ * The cache is not created if the tailcache router option is set to 0.
  *
  * @param	router		The router instance
  */
 void
 blr_init_cache(ROUTER_INSTANCE *router)
 {
+BLCACHE	*cache;
+
+	router->cache = NULL;
+	if (router->tail_cache_size == 0)
+		return;
+
+	if ((cache = (BLCACHE *)calloc(1, sizeof(BLCACHE))) == NULL ||
+		(cache->records = (BLCACHE_RECORD *)calloc(BLR_CACHE_INITIAL,
+					sizeof(BLCACHE_RECORD))) == NULL)
+	{
+		LOGIF(LE, (skygw_log_write(LOGFILE_ERROR,
+			"%s: Failed to allocate the binlog tail cache, "
+			"slaves will read all events from the binlog files.",
+				router->service->name)));
+		free(cache);
+		return;
+	}
+	cache->size = BLR_CACHE_INITIAL;
+	cache->max_bytes = router->tail_cache_size;
+	spinlock_init(&cache->lock);
+	router->cache = cache;
+}
+
+/**
+ * Empty the binlog tail cache. The events are freed once the slaves that
+ * have been sent clones of them have written them.
+ *
+ * The caller must hold the cache lock.
+ *
+ * @param	cache		The binlog tail cache
+ */
+static void
+blr_cache_reset(BLCACHE *cache)
+{
+	while (cache->cnt > 0)
+	{
+		gwbuf_free(cache->records[cache->first].pkt);
+		cache->records[cache->first].pkt = NULL;
+		cache->first = (cache->first + 1) % cache->size;
+		cache->cnt--;
+	}
+	cache->first = 0;
+	cache->bytes = 0;
+	cache->binlogname[0] = 0;
+}
+
+/**
+ * Double the number of entries in the ring of the binlog tail cache.
+ *
+ * The caller must hold the cache lock.
+ *
+ * @param	cache		The binlog tail cache
+ * @return	Non-zero if the ring was extended
+ */
+static int
+blr_cache_extend(BLCACHE *cache)
+{
+BLCACHE_RECORD	*records;
+int		i;
+
+	if ((records = (BLCACHE_RECORD *)calloc(cache->size * 2,
+				sizeof(BLCACHE_RECORD))) == NULL)
+		return 0;
+	for (i = 0; i < cache->cnt; i++)
+		records[i] = cache->records[(cache->first + i) % cache->size];
+	free(cache->records);
+	cache->records = records;
+	cache->size *= 2;
+	cache->first = 0;
+	return 1;
+}
+
+/**
+ * Add an event that has just been written to the binlog file to the binlog
+ * tail cache. The oldest events are removed from the cache to keep the size
+ * of the cached events within the configured limit.
+ *
+ * The cache only ever holds a contiguous run of events of a single binlog
+ * file, it is emptied when the master moves to a new binlog file.
+ *
+ * @param	router		The router instance
+ * @param	hdr		The replication event header
+ * @param	ptr		The raw replication event data
+ */
+void
+blr_cache_add(ROUTER_INSTANCE *router, REP_HEADER *hdr, uint8_t *ptr)
+{
+BLCACHE		*cache = router->cache;
+BLCACHE_RECORD	*record, *last;
+GWBUF		*pkt;
+unsigned long	position = hdr->next_pos - hdr->event_size;
+
+	if (cache == NULL)
+		return;
+
+	if (hdr->event_size > cache->max_bytes ||
+		(pkt = gwbuf_alloc(hdr->event_size)) == NULL)
+	{
+		/* The event can not be cached, the run of events is broken */
+		spinlock_acquire(&cache->lock);
+		blr_cache_reset(cache);
+		spinlock_release(&cache->lock);
+		return;
+	}
+	memcpy(GWBUF_DATA(pkt), ptr, hdr->event_size);
+
+	spinlock_acquire(&cache->lock);
+	if (cache->cnt > 0)
+	{
+		last = &cache->records[(cache->first + cache->cnt - 1) % cache->size];
+		if (strcmp(cache->binlogname, router->binlog_name) != 0 ||
+			last->hdr.next_pos != position)
+			blr_cache_reset(cache);
+	}
+	if (cache->cnt == 0)
+		strncpy(cache->binlogname, router->binlog_name, BINLOG_FNAMELEN);
+
+	while (cache->cnt > 0 &&
+		(cache->bytes + hdr->event_size > cache->max_bytes ||
+		(cache->cnt == cache->size && !blr_cache_extend(cache))))
+	{
+		record = &cache->records[cache->first];
+		cache->bytes -= record->hdr.event_size;
+		gwbuf_free(record->pkt);
+		record->pkt = NULL;
+		cache->first = (cache->first + 1) % cache->size;
+		cache->cnt--;
+	}
+
+	record = &cache->records[(cache->first + cache->cnt) % cache->size];
+	record->position = position;
+	record->pkt = pkt;
+	record->hdr = *hdr;
+	cache->bytes += hdr->event_size;
+	cache->cnt++;
+	spinlock_release(&cache->lock);
+}
+
+/**
+ * Read a binlog event from the binlog tail cache.
+ *
+ * @param	router		The router instance
+ * @param	binlog		The binlog file of the event
+ * @param	pos		The position of the event in the binlog file
+ * @param	hdr		Binlog header to populate
+ * @return	A clone of the cached event or NULL if the event is not cached
+ */
+GWBUF *
+blr_cache_read(ROUTER_INSTANCE *router, char *binlog, unsigned long pos, REP_HEADER *hdr)
+{
+BLCACHE		*cache = router->cache;
+BLCACHE_RECORD	*record;
+GWBUF		*rval = NULL;
+int		low, high, mid;
+
+	if (cache == NULL)
+		return NULL;
+
+	spinlock_acquire(&cache->lock);
+	if (cache->cnt > 0 && strcmp(cache->binlogname, binlog) == 0)
+	{
+		/* The records are ordered by position, locate the event */
+		low = 0;
+		high = cache->cnt - 1;
+		while (low <= high)
+		{
+			mid = (low + high) / 2;
+			record = &cache->records[(cache->first + mid) % cache->size];
+			if (record->position == pos)
+			{
+				if ((rval = gwbuf_clone(record->pkt)) != NULL)
+					*hdr = record->hdr;
+				break;
+			}
+			if (record->position < pos)
+				low = mid + 1;
+			else
+				high = mid - 1;
+		}
+	}
+	if (rval)
+		router->stats.n_cachehits++;
+	else
+		router->stats.n_cachemisses++;
+	spinlock_release(&cache->lock);
+	return rval;
+}
+
+/**
+ * Return the current size of the binlog tail cache.
+ *
+ * @param	router		The router instance
+ * @param	cnt		Set to the number of cached events
+ * @param	bytes		Set to the size of the cached events
+ */
+void
+blr_cache_stats(ROUTER_INSTANCE *router, int *cnt, unsigned long *bytes)
+{
+BLCACHE	*cache = router->cache;
+
+	*cnt = 0;
+	*bytes = 0;
+	if (cache == NULL)
+		return;
+
+	spinlock_acquire(&cache->lock);
+	*cnt = cache->cnt;
+	*bytes = cache->bytes;
+	spinlock_release(&cache->lock);
 }
@@ -37,6 +37,7 @@
 #include <dirent.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <time.h>
 #include <service.h>
 #include <server.h>
 #include <router.h>
@@ -45,6 +46,7 @@
 #include <blr.h>
 #include <dcb.h>
 #include <spinlock.h>
+#include <hk_heartbeat.h>
 
 #include <skygw_types.h>
 #include <skygw_utils.h>
@@ -59,6 +61,12 @@ static int  blr_file_create(ROUTER_INSTANCE *router, char *file);
 static void blr_file_append(ROUTER_INSTANCE *router, char *file);
 static uint32_t extract_field(uint8_t *src, int bits);
 static void blr_log_header(logfile_id_t file, char *msg, uint8_t *ptr);
+static GWBUF *blr_window_get(BLFILE *file, unsigned long pos,
+				unsigned long len, unsigned long *start);
+static GWBUF *blr_window_fill(BLFILE *file, unsigned long pos,
+				unsigned long filelen, int *n);
+static void blr_window_release(BLFILE *file);
+static void blr_latency_add(uint64_t *histogram, struct timespec *start);
 
 /**
  * Initialise the binlog file for this instance. MaxScale will look
@@ -277,37 +285,139 @@ int		fd;
 int
 blr_write_binlog_record(ROUTER_INSTANCE *router, REP_HEADER *hdr, uint8_t *buf)
 {
-int	n;
+	if (blr_file_write(router, buf, hdr->event_size,
+				hdr->next_pos - hdr->event_size) == 0)
+		return 0;
+	blr_file_written(router, hdr);
+	return hdr->event_size;
+}
+
+/**
+ * Write one or more consecutive binlog events to the current binlog file.
+ * A partially written run of events is removed from the file.
+ *
+ * @param router	The router instance
+ * @param buf		The binlog events
+ * @param len		The length of the events
+ * @param pos		The position of the first event in the file
+ * @return		Non-zero if the events were written
+ */
+int
+blr_file_write(ROUTER_INSTANCE *router, uint8_t *buf, unsigned int len,
+		unsigned long pos)
+{
+struct timespec	start;
+int		n;
 
-	if ((n = pwrite(router->binlog_fd, buf, hdr->event_size,
-				hdr->next_pos - hdr->event_size)) != hdr->event_size)
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if ((n = pwrite(router->binlog_fd, buf, len, pos)) != len)
 	{
 		LOGIF(LE, (skygw_log_write(LOGFILE_ERROR,
-			"%s: Failed to write binlog record at %d of %s, %s. "
+			"%s: Failed to write binlog record at %lu of %s, %s. "
 			"Truncating to previous record.",
-			router->service->name, hdr->next_pos - hdr->event_size,
+			router->service->name, pos,
 			router->binlog_name,
 			strerror(errno))));
 		/* Remove any partual event that was written */
-		ftruncate(router->binlog_fd, hdr->next_pos - hdr->event_size);
+		ftruncate(router->binlog_fd, pos);
 		return 0;
 	}
+	blr_latency_add(router->stats.write_latency, &start);
+	router->stats.n_writes++;
+	__sync_fetch_and_add(&router->unsynced, len);
+	return 1;
+}
+
+/**
+ * Advance the binlog position of the router past an event that has been
+ * written to the binlog file.
+ *
+ * @param router	The router instance
+ * @param hdr		The header of the event
+ */
+void
+blr_file_written(ROUTER_INSTANCE *router, REP_HEADER *hdr)
+{
 	spinlock_acquire(&router->binlog_lock);
 	router->binlog_position = hdr->next_pos;
 	router->last_written = hdr->next_pos - hdr->event_size;
 	spinlock_release(&router->binlog_lock);
-	return n;
 }
 
 /**
- * Flush the content of the binlog file to disk.
+ * Sync the content of the binlog file to disk. The housekeeper may sync the
+ * file while the master thread writes to it, the data written during the
+ * sync stays counted as unsynced. The master thread syncs the file before
+ * it is rotated, so the housekeeper never syncs a closed file.
  *
  * @param	router		The binlog router
  */
 void
-blr_file_flush(ROUTER_INSTANCE *router)
+blr_file_sync(ROUTER_INSTANCE *router)
 {
+struct timespec	start;
+unsigned long	unsynced;
+
+	spinlock_acquire(&router->sync_lock);
+	if ((unsynced = router->unsynced) == 0)
+	{
+		spinlock_release(&router->sync_lock);
+		return;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &start);
 	fsync(router->binlog_fd);
+	blr_latency_add(router->stats.sync_latency, &start);
+	router->stats.n_syncs++;
+	__sync_fetch_and_sub(&router->unsynced, unsynced);
+	router->last_sync = hkheartbeat;
+	spinlock_release(&router->sync_lock);
+}
+
+/**
+ * Flush the content of the binlog file to disk once the events received
+ * from the master have been written. Only the group commit durability
+ * syncs the file here, when enough data or time has passed since the
+ * previous sync. A limit of 0 is not set; with neither limit set the file
+ * is synced after every read. The housekeeper also calls this every
+ * BLR_SYNC_FREQ seconds so that the interval bounds the unsynced time
+ * when no more events arrive.
+ *
+ * @param	router		The binlog router
+ */
+void
+blr_file_flush(ROUTER_INSTANCE *router)
+{
+	if (router->durability != BLR_SYNC_GROUP || router->unsynced == 0)
+		return;
+	if ((router->sync_size == 0 && router->sync_interval == 0) ||
+		(router->sync_size > 0 && router->unsynced >= router->sync_size) ||
+		(router->sync_interval > 0 &&
+		(hkheartbeat - router->last_sync) * 100 >= router->sync_interval))
+		blr_file_sync(router);
+}
+
+/**
+ * Add the time elapsed since the start of an operation to a latency histogram.
+ *
+ * @param histogram	The histogram, of BLR_LATENCY_BUCKETS buckets
+ * @param start		The start of the operation
+ */
+static void
+blr_latency_add(uint64_t *histogram, struct timespec *start)
+{
+struct timespec	end;
+unsigned long	usec;
+int		i;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	usec = (end.tv_sec - start->tv_sec) * 1000000 +
+		(end.tv_nsec - start->tv_nsec) / 1000;
+	for (i = 0; i < BLR_LATENCY_BUCKETS - 1; i++)
+	{
+		if (usec < BLR_LATENCY_LIMIT(i))
+			break;
+	}
+	histogram[i]++;
 }
 
 /**
@@ -343,6 +453,9 @@ BLFILE		*file;
 	strncpy(file->binlogname, binlog,BINLOG_FNAMELEN+1);
 	file->refcnt = 1;
 	file->cache = 0;
+	memset(file->windows, 0, sizeof(file->windows));
+	file->nuse = 0;
+	file->filelen = 0;
 	spinlock_init(&file->lock);
 
 	strncpy(path, router->binlogdir,1024);
@@ -368,6 +481,15 @@ BLFILE		*file;
 /**
  * Read a replication event into a GWBUF structure.
  *
+ * The events are read through the read-ahead windows of the file, an event
+ * that is held in a window is returned as a clone of that part of the window
+ * rather than being read from the file on its own. Only events larger than
+ * the window are read directly into a buffer of their own.
+ *
+ * The length of the binlog file currently being written is the binlog
+ * position of the router, the length of the other files is only refreshed
+ * from the file system once a slave reaches the previously known end.
+ *
  * @param router	The router instance
  * @param file		File record
  * @param pos		Position of binlog record to read
@@ -378,36 +500,50 @@ GWBUF *
 blr_read_binlog(ROUTER_INSTANCE *router, BLFILE *file, unsigned int pos, REP_HEADER *hdr)
 {
 uint8_t		hdbuf[19];
-GWBUF		*result;
+GWBUF		*result, *window;
 unsigned char	*data;
-int		n;
-unsigned long	filelen = 0;
+int		n = 0;
+unsigned long	filelen, winpos;
 struct	stat	statb;
 
 	if (!file)
 	{
 		return NULL;
 	}
-	if (fstat(file->fd, &statb) == 0)
-		filelen = statb.st_size;
-	if (pos >= filelen)
+	if (strcmp(router->binlog_name, file->binlogname) == 0)
 	{
-		LOGIF(LD, (skygw_log_write(LOGFILE_ERROR,
-			"Attempting to read off the end of the binlog file %s, "
-			"event at %lu.", file->binlogname, pos)));
-		return NULL;
+		/* Only the complete events of the current file may be read */
+		if (pos >= router->binlog_position)
+			return NULL;
+		filelen = router->binlog_position;
 	}
-
-	if (strcmp(router->binlog_name, file->binlogname) == 0 &&
-			pos >= router->binlog_position)
+	else
 	{
-		return NULL;
+		if (pos >= file->filelen && fstat(file->fd, &statb) == 0)
+			file->filelen = statb.st_size;
+		filelen = file->filelen;
+		if (pos >= filelen)
+		{
+			LOGIF(LD, (skygw_log_write(LOGFILE_ERROR,
+				"Attempting to read off the end of the binlog file %s, "
+				"event at %lu.", file->binlogname, pos)));
+			return NULL;
+		}
 	}
-		
 
 	/* Read the header information from the file */
-	if ((n = pread(file->fd, hdbuf, 19, pos)) != 19)
+	if ((window = blr_window_get(file, pos, 19, &winpos)) == NULL)
 	{
+		winpos = pos;
+		window = blr_window_fill(file, pos, filelen, &n);
+	}
+	if (window == NULL || pos + 19 > winpos + GWBUF_LENGTH(window))
+	{
+		if (window)
+		{
+			n = winpos + GWBUF_LENGTH(window) - pos;
+			gwbuf_free(window);
+		}
 		switch (n)
 		{
 		case 0:
@@ -436,6 +572,7 @@ struct	stat	statb;
 		}
 		return NULL;
 	}
+	memcpy(hdbuf, (uint8_t *)GWBUF_DATA(window) + (pos - winpos), 19);
 	hdr->timestamp = EXTRACT32(hdbuf);
 	hdr->event_type = hdbuf[4];
 	hdr->serverid = EXTRACT32(&hdbuf[5]);
@@ -450,11 +587,15 @@ struct	stat	statb;
 				"Binlog file is %s, position %d",
 				hdr->event_type,
 				file->binlogname, pos)));
+		gwbuf_free(window);
 		return NULL;
 	}
 
 	if (hdr->next_pos < pos && hdr->event_type != ROTATE_EVENT)
 	{
+		/* Reread the header from the file itself rather than the window */
+		gwbuf_free(window);
+		window = NULL;
 		LOGIF(LE, (skygw_log_write(LOGFILE_ERROR,
 			"Next position in header appears to be incorrect "
 			"rereading event header at pos %ul in file %s, "
@@ -512,6 +653,27 @@ struct	stat	statb;
 				"rereading")));
 		}
 	}
+
+	if (window && hdr->event_size <= BLR_READAHEAD_SIZE &&
+		pos + hdr->event_size > winpos + GWBUF_LENGTH(window))
+	{
+		/* The event runs past the end of the window, read ahead from the event */
+		gwbuf_free(window);
+		winpos = pos;
+		window = blr_window_fill(file, pos, filelen, &n);
+	}
+	if (window)
+	{
+		if (pos + hdr->event_size <= winpos + GWBUF_LENGTH(window))
+		{
+			result = gwbuf_clone_portion(window, pos - winpos,
+							hdr->event_size);
+			gwbuf_free(window);
+			return result;
+		}
+		gwbuf_free(window);
+	}
+
 	if ((result = gwbuf_alloc(hdr->event_size)) == NULL)
 	{
 		LOGIF(LE, (skygw_log_write(LOGFILE_ERROR,
@@ -588,7 +750,118 @@ blr_close_binlog(ROUTER_INSTANCE *router, BLFILE *file)
 	}
 	spinlock_release(&file->lock);
 	if (file->refcnt == 0)
+	{
+		blr_window_release(file);
 		free(file);
+	}
+}
+
+/**
+ * Return a reference to the read-ahead window of a binlog file that holds
+ * the given range of the file.
+ *
+ * @param file	The binlog file
+ * @param pos	The file offset of the range
+ * @param len	The length of the range
+ * @param start	Set to the file offset of the window that is returned
+ * @return	A clone of the window or NULL if no window holds the range
+ */
+static GWBUF *
+blr_window_get(BLFILE *file, unsigned long pos, unsigned long len,
+		unsigned long *start)
+{
+BLWINDOW	*win;
+GWBUF		*rval = NULL;
+int		i;
+
+	spinlock_acquire(&file->lock);
+	for (i = 0; i < BLR_READAHEAD_WINDOWS; i++)
+	{
+		win = &file->windows[i];
+		if (win->buf && pos >= win->pos &&
+			pos + len <= win->pos + GWBUF_LENGTH(win->buf))
+		{
+			if ((rval = gwbuf_clone(win->buf)) != NULL)
+			{
+				win->used = ++file->nuse;
+				*start = win->pos;
+			}
+			break;
+		}
+	}
+	spinlock_release(&file->lock);
+	return rval;
+}
+
+/**
+ * Read a new read-ahead window of a binlog file at the given offset. The
+ * file is read without holding the file lock, the new window then replaces
+ * the least recently used window of the file.
+ *
+ * @param file		The binlog file
+ * @param pos		The file offset to read from
+ * @param filelen	The length of the file that may be read
+ * @param n		Set to the number of bytes read or -1 on error
+ * @return		A reference to the new window or NULL if nothing was read
+ */
+static GWBUF *
+blr_window_fill(BLFILE *file, unsigned long pos, unsigned long filelen, int *n)
+{
+BLWINDOW	*win;
+GWBUF		*window, *old;
+unsigned long	len = filelen - pos;
+int		i;
+
+	if (len > BLR_READAHEAD_SIZE)
+		len = BLR_READAHEAD_SIZE;
+	if ((window = gwbuf_alloc(len)) == NULL)
+	{
+		*n = -1;
+		return NULL;
+	}
+	if ((*n = pread(file->fd, GWBUF_DATA(window), len, pos)) <= 0)
+	{
+		gwbuf_free(window);
+		return NULL;
+	}
+	if (*n < len)
+		GWBUF_RTRIM(window, len - *n);
+
+	spinlock_acquire(&file->lock);
+	win = &file->windows[0];
+	for (i = 1; i < BLR_READAHEAD_WINDOWS; i++)
+	{
+		if (file->windows[i].used < win->used)
+			win = &file->windows[i];
+	}
+	old = win->buf;
+	win->buf = gwbuf_clone(window);
+	win->pos = pos;
+	win->used = ++file->nuse;
+	spinlock_release(&file->lock);
+
+	if (old)
+		gwbuf_free(old);
+	return window;
+}
+
+/**
+ * Release the read-ahead windows of a binlog file. Events that are still
+ * queued for the slaves keep their part of a window until they are sent.
+ *
+ * @param file	The binlog file
+ */
+static void
+blr_window_release(BLFILE *file)
+{
+int	i;
+
+	for (i = 0; i < BLR_READAHEAD_WINDOWS; i++)
+	{
+		if (file->windows[i].buf)
+			gwbuf_free(file->windows[i].buf);
+		file->windows[i].buf = NULL;
+	}
 }
 
 /** 
@@ -644,7 +917,10 @@ blr_file_size(BLFILE *file)
 struct	stat	statb;
 
 	if (fstat(file->fd, &statb) == 0)
+	{
+		file->filelen = statb.st_size;
 		return statb.st_size;
+	}
 	return 0;
 }
 
@@ -73,6 +73,9 @@ static GWBUF *blr_make_binlog_dump(ROUTER_INSTANCE *router);
 void encode_value(unsigned char *data, unsigned int value, int len);
 void blr_handle_binlog_record(ROUTER_INSTANCE *router, GWBUF *pkt);
 static int  blr_rotate_event(ROUTER_INSTANCE *router, uint8_t *pkt, REP_HEADER *hdr);
+static int  blr_buffer_event(ROUTER_INSTANCE *router, REP_HEADER *hdr, uint8_t *ptr);
+static int  blr_write_pending(ROUTER_INSTANCE *router);
+static int  blr_is_commit(ROUTER_INSTANCE *router, REP_HEADER *hdr, uint8_t *ptr);
 void blr_distribute_binlog_record(ROUTER_INSTANCE *router, REP_HEADER *hdr, uint8_t *ptr);
 static void *CreateMySQLAuthData(char *username, char *password, char *database);
 void blr_extract_header(uint8_t *pkt, REP_HEADER *hdr);
@@ -711,6 +714,7 @@ int			no_residual = 1;
 int			preslen = -1;
 int			prev_length = -1;
 int			n_bufs = -1, pn_bufs = -1;
+int			buffered;
 static REP_HEADER	phdr;
 
 	/*
@@ -927,6 +931,7 @@ static REP_HEADER	phdr;
 							router->service->name,
 							router->binlog_name,
 							router->binlog_position)));
+						blr_write_pending(router);
 						blr_master_close(router);
 						blr_master_delayed_connect(router);
 						return;
@@ -1003,7 +1008,10 @@ static REP_HEADER	phdr;
 								// into the binlog file
 						if (hdr.event_type == ROTATE_EVENT)
 							router->rotating = 1;
-						if (blr_write_binlog_record(router, &hdr, ptr) == 0)
+						if ((buffered = blr_buffer_event(router, &hdr, ptr)) == -1 ||
+							(buffered == 0 &&
+							(blr_write_pending(router) == 0 ||
+							blr_write_binlog_record(router, &hdr, ptr) == 0)))
 						{
 							/*
 							 * Failed to write to the
@@ -1017,24 +1025,32 @@ static REP_HEADER	phdr;
 							blr_master_delayed_connect(router);
 							return;
 						}
-						if (hdr.event_type == ROTATE_EVENT)
+						if (buffered == 0)
 						{
-							if (!blr_rotate_event(router, ptr, &hdr))
+							blr_cache_add(router, &hdr, ptr);
+							if (hdr.event_type == ROTATE_EVENT)
 							{
-								/*
-								 * Failed to write to the
-								 * binlog file, destroy the
-								 * buffer chain and close the
-								 * connection with the master
-								 */
-								while ((pkt = gwbuf_consume(pkt,
-									 GWBUF_LENGTH(pkt))) != NULL);
-								blr_master_close(router);
-								blr_master_delayed_connect(router);
-								return;
+								if (!blr_rotate_event(router, ptr, &hdr))
+								{
+									/*
+									 * Failed to write to the
+									 * binlog file, destroy the
+									 * buffer chain and close the
+									 * connection with the master
+									 */
+									while ((pkt = gwbuf_consume(pkt,
+										 GWBUF_LENGTH(pkt))) != NULL);
+									blr_master_close(router);
+									blr_master_delayed_connect(router);
+									return;
+								}
 							}
+							blr_distribute_binlog_record(router, &hdr, ptr);
+							if (router->durability == BLR_SYNC_EVENT ||
+								(router->durability == BLR_SYNC_TRANSACTION &&
+								blr_is_commit(router, &hdr, ptr)))
+								blr_file_sync(router);
 						}
-						blr_distribute_binlog_record(router, &hdr, ptr);
 					}
 					else
 					{
@@ -1053,7 +1069,8 @@ static REP_HEADER	phdr;
 						if (hdr.event_type == ROTATE_EVENT)
 						{
 							router->rotating = 1;
-							if (!blr_rotate_event(router, ptr, &hdr))
+							if (!blr_write_pending(router) ||
+								!blr_rotate_event(router, ptr, &hdr))
 							{
 								/*
 								 * Failed to write to the
@@ -1115,6 +1132,16 @@ static REP_HEADER	phdr;
 	{
 		ss_dassert(pkt_length == 0);
 	}
+	if (blr_write_pending(router) == 0)
+	{
+		/*
+		 * Failed to write to the binlog file, close the
+		 * connection with the master
+		 */
+		blr_master_close(router);
+		blr_master_delayed_connect(router);
+		return;
+	}
 	blr_file_flush(router);
 }
 
@@ -1198,6 +1225,7 @@ char		file[BINLOG_FNAMELEN+1];
 	if (strncmp(router->binlog_name, file, slen) != 0)
 	{
 		router->stats.n_rotates++;
+		blr_file_sync(router);
 		if (blr_file_rotate(router, file, pos) == 0)
 		{
 			router->rotating = 0;
@@ -1208,6 +1236,131 @@ char		file[BINLOG_FNAMELEN+1];
 	return 1;
 }
 
+/**
+ * Add an event received from the master to the events that are written to
+ * the binlog file in a single write. The event is not buffered if the
+ * binlog file is synced after every event, if it is a rotate event or if
+ * it is larger than the buffer; such an event is written on its own once
+ * the buffered events have been written.
+ *
+ * @param router	The router instance
+ * @param hdr		The event header
+ * @param ptr		The event data
+ * @return		1 if the event was buffered, 0 if it was not and
+ *			-1 if writing the buffered events failed
+ */
+static int
+blr_buffer_event(ROUTER_INSTANCE *router, REP_HEADER *hdr, uint8_t *ptr)
+{
+BLWRITEBUF	*wbuf = &router->wbuf;
+REP_HEADER	*last;
+
+	if (router->durability == BLR_SYNC_EVENT ||
+		hdr->event_type == ROTATE_EVENT ||
+		hdr->event_size > BLR_WRITE_BUFFER_SIZE)
+		return 0;
+
+	if (wbuf->data == NULL)
+	{
+		if ((wbuf->data = (uint8_t *)malloc(BLR_WRITE_BUFFER_SIZE)) == NULL ||
+			(wbuf->events = (REP_HEADER *)malloc(BLR_WRITE_BUFFER_EVENTS *
+						sizeof(REP_HEADER))) == NULL)
+		{
+			free(wbuf->data);
+			wbuf->data = NULL;
+			return 0;
+		}
+	}
+
+	if (wbuf->n_events > 0)
+	{
+		/* The buffered events must be consecutive in the file */
+		last = &wbuf->events[wbuf->n_events - 1];
+		if ((last->next_pos != hdr->next_pos - hdr->event_size ||
+			wbuf->len + hdr->event_size > BLR_WRITE_BUFFER_SIZE) &&
+			blr_write_pending(router) == 0)
+			return -1;
+	}
+
+	memcpy(wbuf->data + wbuf->len, ptr, hdr->event_size);
+	wbuf->len += hdr->event_size;
+	wbuf->events[wbuf->n_events++] = *hdr;
+
+	if (router->durability == BLR_SYNC_TRANSACTION &&
+		blr_is_commit(router, hdr, ptr))
+		wbuf->commit = 1;
+
+	if ((wbuf->commit || wbuf->n_events == BLR_WRITE_BUFFER_EVENTS) &&
+		blr_write_pending(router) == 0)
+		return -1;
+	return 1;
+}
+
+/**
+ * Write the buffered events to the binlog file, then add them to the tail
+ * cache and distribute them to the slaves in the order they were received.
+ *
+ * @param router	The router instance
+ * @return		Non-zero if the events were written
+ */
+static int
+blr_write_pending(ROUTER_INSTANCE *router)
+{
+BLWRITEBUF	*wbuf = &router->wbuf;
+uint8_t		*ptr;
+int		i, rval;
+
+	if (wbuf->n_events == 0)
+		return 1;
+
+	if ((rval = blr_file_write(router, wbuf->data, wbuf->len,
+			wbuf->events[0].next_pos - wbuf->events[0].event_size)) != 0)
+	{
+		ptr = wbuf->data;
+		for (i = 0; i < wbuf->n_events; i++)
+		{
+			blr_file_written(router, &wbuf->events[i]);
+			blr_cache_add(router, &wbuf->events[i], ptr);
+			blr_distribute_binlog_record(router, &wbuf->events[i], ptr);
+			ptr += wbuf->events[i].event_size;
+		}
+		if (wbuf->commit)
+			blr_file_sync(router);
+	}
+	wbuf->len = 0;
+	wbuf->n_events = 0;
+	wbuf->commit = 0;
+	return rval;
+}
+
+/**
+ * Check if an event commits a transaction, it is either an XID event or
+ * a query event with the statement COMMIT.
+ *
+ * @param router	The router instance
+ * @param hdr		The event header
+ * @param ptr		The event data
+ * @return		Non-zero if the event is a commit
+ */
+static int
+blr_is_commit(ROUTER_INSTANCE *router, REP_HEADER *hdr, uint8_t *ptr)
+{
+unsigned int	offset, len;
+
+	if (hdr->event_type == XID_EVENT)
+		return 1;
+	if (hdr->event_type != QUERY_EVENT || hdr->event_size < 19 + 13)
+		return 0;
+
+	/*
+	 * The statement follows the fixed part of the query event, the
+	 * status variables and the null terminated default database.
+	 */
+	offset = 19 + 13 + EXTRACT16(ptr + 19 + 11) + ptr[19 + 8] + 1;
+	len = hdr->event_size - (router->master_chksum ? 4 : 0);
+	return offset + 6 == len && strncasecmp((char *)ptr + offset, "COMMIT", 6) == 0;
+}
+
 /**
  * Create the auth data needed to be able to call dcb_connect.
  * 
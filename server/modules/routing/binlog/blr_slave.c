@@ -1425,7 +1425,8 @@ uint8_t		*ptr;
 	}
 	slave->stats.n_bursts++;
 	while (burst-- && burst_size > 0 &&
-		(record = blr_read_binlog(router, slave->file, slave->binlog_pos, &hdr)) != NULL)
+		((record = blr_cache_read(router, slave->binlogfile, slave->binlog_pos, &hdr)) != NULL ||
+		(record = blr_read_binlog(router, slave->file, slave->binlog_pos, &hdr)) != NULL))
 	{
 		head = gwbuf_alloc(5);
 		ptr = GWBUF_DATA(head);
@@ -1738,7 +1739,7 @@ blr_slave_send_fde(ROUTER_INSTANCE *router, ROUTER_SLAVE *slave)
 {
 BLFILE		*file;
 REP_HEADER	hdr;
-GWBUF		*record, *head;
+GWBUF		*record, *copy, *head;
 uint8_t		*ptr;
 uint32_t	chksum;
 
@@ -1750,6 +1751,18 @@ uint32_t	chksum;
 		return;
 	}
 	blr_close_binlog(router, file);
+	/*
+	 * The record shares its data with the read-ahead window of the file,
+	 * take a copy of it before the header is modified.
+	 */
+	if ((copy = gwbuf_alloc(hdr.event_size)) == NULL)
+	{
+		gwbuf_free(record);
+		return;
+	}
+	memcpy(GWBUF_DATA(copy), GWBUF_DATA(record), hdr.event_size);
+	gwbuf_free(record);
+	record = copy;
 	head = gwbuf_alloc(5);
 	ptr = GWBUF_DATA(head);
 	encode_value(ptr, hdr.event_size + 1, 24); // Payload length
@@ -0,0 +1,255 @@
+/*
+ * This file is distributed as part of the MariaDB Corporation MaxScale.  It is free
+ * software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation,
+ * version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Copyright MariaDB Corporation Ab 2013-2014
+ */
+
+/**
+ * Binlog router slave catch-up benchmark
+ *
+ * Generates a binlog file of query events and reads it from the start to the
+ * end the way a slave that catches up does, first with a pread of the header
+ * and a pread of the body of every event and then with blr_read_binlog and
+ * its read-ahead windows. Both methods must return the same events.
+ *
+ * Usage: blrbench [events] [passes]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <service.h>
+#include <router.h>
+#include <spinlock.h>
+#include <blr.h>
+
+#define BENCH_BINLOG	"mysql-bin.000001"
+
+static double
+elapsed(struct timespec *start, struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) +
+		(end->tv_nsec - start->tv_nsec) / 1000000000.0;
+}
+
+static void
+encode32(uint8_t *ptr, uint32_t value)
+{
+	ptr[0] = value & 0xff;
+	ptr[1] = (value >> 8) & 0xff;
+	ptr[2] = (value >> 16) & 0xff;
+	ptr[3] = (value >> 24) & 0xff;
+}
+
+/**
+ * Write a binlog file of query events with sizes from 40 to 1000 bytes.
+ *
+ * @param path		The file to create
+ * @param nevents	Number of events to write
+ * @return		The length of the file or 0 on error
+ */
+static unsigned long
+generate_binlog(char *path, int nevents)
+{
+uint8_t		magic[] = BINLOG_MAGIC;
+uint8_t		event[1000];
+unsigned long	pos = 4;
+int		fd, i, size;
+
+	if ((fd = open(path, O_WRONLY|O_CREAT|O_TRUNC, 0666)) == -1)
+		return 0;
+	write(fd, magic, 4);
+	for (i = 0; i < nevents; i++)
+	{
+		size = 40 + (i * 7919) % (sizeof(event) - 40);
+		memset(event, 'a' + i % 26, size);
+		encode32(&event[0], i);			/* Timestamp */
+		event[4] = QUERY_EVENT;
+		encode32(&event[5], 1);			/* Server id */
+		encode32(&event[9], size);
+		encode32(&event[13], pos + size);	/* Next position */
+		event[17] = 0;
+		event[18] = 0;
+		if (write(fd, event, size) != size)
+		{
+			close(fd);
+			return 0;
+		}
+		pos += size;
+	}
+	close(fd);
+	return pos;
+}
+
+/**
+ * Read an event with a pread of the header and a pread of the body.
+ */
+static GWBUF *
+read_direct(int fd, unsigned long pos, unsigned long filelen, REP_HEADER *hdr)
+{
+uint8_t		hdbuf[19];
+GWBUF		*result;
+struct stat	statb;
+
+	if (fstat(fd, &statb) != 0 || pos >= statb.st_size || pos >= filelen)
+		return NULL;
+	if (pread(fd, hdbuf, 19, pos) != 19)
+		return NULL;
+	hdr->event_size = EXTRACT32(&hdbuf[9]);
+	hdr->next_pos = EXTRACT32(&hdbuf[13]);
+	if ((result = gwbuf_alloc(hdr->event_size)) == NULL)
+		return NULL;
+	memcpy(GWBUF_DATA(result), hdbuf, 19);
+	if (pread(fd, (uint8_t *)GWBUF_DATA(result) + 19, hdr->event_size - 19,
+			pos + 19) != hdr->event_size - 19)
+	{
+		gwbuf_free(result);
+		return NULL;
+	}
+	return result;
+}
+
+int main(int argc, char** argv)
+{
+ROUTER_INSTANCE	router;
+BLFILE		*file;
+REP_HEADER	hdr, hdr2;
+GWBUF		*record, *record2;
+char		dir[] = "/tmp/blrbench.XXXXXX", path[PATH_MAX];
+int		nevents = argc > 1 ? atoi(argv[1]) : 100000;
+int		passes = argc > 2 ? atoi(argv[2]) : 5;
+int		fd, i, n, rval = 0;
+unsigned long	filelen, pos;
+struct timespec	start, end;
+double		t_direct, t_window;
+
+	if (nevents <= 0 || passes <= 0)
+	{
+		printf("Usage: blrbench [events] [passes]\n");
+		return 1;
+	}
+	if (mkdtemp(dir) == NULL)
+	{
+		perror("mkdtemp");
+		return 1;
+	}
+	snprintf(path, PATH_MAX, "%s/%s", dir, BENCH_BINLOG);
+	if ((filelen = generate_binlog(path, nevents)) == 0)
+	{
+		printf("Error: Failed to write the binlog file %s\n", path);
+		return 1;
+	}
+
+	memset(&router, 0, sizeof(router));
+	spinlock_init(&router.fileslock);
+	spinlock_init(&router.binlog_lock);
+	spinlock_init(&router.sync_lock);
+	router.binlogdir = dir;
+	/* The master is writing a later file, the benchmark file is complete */
+	strcpy(router.binlog_name, "mysql-bin.000002");
+	router.binlog_position = 4;
+
+	fd = open(path, O_RDONLY);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < passes; i++)
+	{
+		n = 0;
+		pos = 4;
+		while ((record = read_direct(fd, pos, filelen, &hdr)) != NULL)
+		{
+			pos = hdr.next_pos;
+			gwbuf_free(record);
+			n++;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	t_direct = elapsed(&start, &end);
+	if (n != nevents)
+	{
+		printf("Error: Read %d of %d events with pread\n", n, nevents);
+		rval = 1;
+	}
+
+	if ((file = blr_open_binlog(&router, BENCH_BINLOG)) == NULL)
+	{
+		printf("Error: Failed to open the binlog file %s\n", path);
+		return 1;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < passes; i++)
+	{
+		n = 0;
+		pos = 4;
+		while ((record = blr_read_binlog(&router, file, pos, &hdr)) != NULL)
+		{
+			pos = hdr.next_pos;
+			gwbuf_free(record);
+			n++;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	t_window = elapsed(&start, &end);
+	if (n != nevents)
+	{
+		printf("Error: Read %d of %d events with blr_read_binlog\n",
+			n, nevents);
+		rval = 1;
+	}
+
+	/* Both methods must return every event with the same content */
+	pos = 4;
+	for (i = 0; i < nevents; i++)
+	{
+		record = read_direct(fd, pos, filelen, &hdr);
+		record2 = blr_read_binlog(&router, file, pos, &hdr2);
+		if (record == NULL || record2 == NULL ||
+			hdr.event_size != hdr2.event_size ||
+			GWBUF_LENGTH(record2) != hdr2.event_size ||
+			memcmp(GWBUF_DATA(record), GWBUF_DATA(record2),
+				hdr.event_size) != 0)
+		{
+			printf("Error: Event %d at %lu differs\n", i, pos);
+			rval = 1;
+			break;
+		}
+		pos = hdr.next_pos;
+		gwbuf_free(record);
+		gwbuf_free(record2);
+	}
+	if (rval == 0 && pos != filelen)
+	{
+		printf("Error: Events end at %lu, the file is %lu bytes\n",
+			pos, filelen);
+		rval = 1;
+	}
+	blr_close_binlog(&router, file);
+	close(fd);
+
+	printf("Binlog of %d events, %lu bytes, %d passes\n",
+		nevents, filelen, passes);
+	printf("pread per header and body: %12.0f events/s %8.1f MB/s\n",
+		(double)nevents * passes / t_direct,
+		(double)filelen * passes / t_direct / (1024 * 1024));
+	printf("read-ahead window:         %12.0f events/s %8.1f MB/s\n",
+		(double)nevents * passes / t_window,
+		(double)filelen * passes / t_window / (1024 * 1024));
+
+	unlink(path);
+	rmdir(dir);
+	return rval;
+}
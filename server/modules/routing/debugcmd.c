@@ -70,6 +70,7 @@
 #include <debugcli.h>
 #include <poll.h>
 #include <housekeeper.h>
+#include <histogram.h>
 
 #include <skygw_utils.h>
 #include <log_manager.h>
@@ -106,6 +107,10 @@ static	void	telnetdShowUsers(DCB *);
  * The subcommands of the show command
  */
 struct subcommand showoptions[] = {
+	{ "buffers",	0, dprintBufferPoolStats,
+		"Show the buffer pool statistics",
+		"Show the buffer pool statistics",
+				{0, 0, 0} },
         { "dcbs",	0, dprintAllDCBs,
 		"Show all descriptor control blocks (network connections)",
 		"Show all descriptor control blocks (network connections)",
@@ -142,6 +147,10 @@ struct subcommand showoptions[] = {
 			"Show all filters",
 			"Show all filters",
 				{0, 0, 0} },
+	{ "latency",	0, dprintLatency,
+			"Show the latency percentiles of the services, servers and filters",
+			"Show the latency percentiles of the services, servers and filters",
+				{0, 0, 0} },
 	{ "modules",	0, dprintAllModules,
 			"Show all currently loaded modules",
 			"Show all currently loaded modules",
@@ -1271,9 +1280,9 @@ static void enable_sess_log_action(DCB *dcb, char *arg1, char *arg2)
 	logfile_id_t type;
 	size_t id = 0;
 	int max_len = strlen("message");
-	SESSION* session = get_all_sessions();
+	SESSION* session;
 
-	ss_dassert(arg1 != NULL && arg2 != NULL && session != NULL);
+	ss_dassert(arg1 != NULL && arg2 != NULL);
 
 	if (strncmp(arg1, "debug", max_len) == 0) {
 		type = LOGFILE_DEBUG;
@@ -1290,15 +1299,11 @@ static void enable_sess_log_action(DCB *dcb, char *arg1, char *arg2)
    
 	id = (size_t)strtol(arg2,0,0);
 
-	while(session)
-		{
-			if(session->ses_id == id)
-				{
-					session_enable_log(session,type);
-					return;
-				}
-			session = session->next;
-		}
+	if ((session = session_find_by_id(id)) != NULL)
+	{
+		session_enable_log(session,type);
+		return;
+	}
 
 	dcb_printf(dcb, "Session not found: %s\n", arg2);
 }
@@ -1314,9 +1319,9 @@ static void disable_sess_log_action(DCB *dcb, char *arg1, char *arg2)
 	logfile_id_t type;
 	int id = 0;
 	int max_len = strlen("message");
-	SESSION* session = get_all_sessions();
+	SESSION* session;
 
-	ss_dassert(arg1 != NULL && arg2 != NULL && session != NULL);
+	ss_dassert(arg1 != NULL && arg2 != NULL);
 
 	if (strncmp(arg1, "debug", max_len) == 0) {
 		type = LOGFILE_DEBUG;
@@ -1333,15 +1338,11 @@ static void disable_sess_log_action(DCB *dcb, char *arg1, char *arg2)
       
 	id = (size_t)strtol(arg2,0,0);
 
-	while(session)
-		{
-			if(session->ses_id == id)
-				{
-					session_disable_log(session,type);
-					return;
-				}
-			session = session->next;
-		}
+	if ((session = session_find_by_id(id)) != NULL)
+	{
+		session_disable_log(session,type);
+		return;
+	}
 
 	dcb_printf(dcb, "Session not found: %s\n", arg2);
 }
@@ -54,6 +54,7 @@
 #include <secrets.h>
 #include <users.h>
 #include <dbusers.h>
+#include <histogram.h>
 
 
 MODULE_INFO 	info = {
@@ -718,6 +719,7 @@ static struct uri_table {
 	{ "/variables", maxinfo_variables },
 	{ "/status", maxinfo_status },
 	{ "/event/times", eventTimesGetList },
+	{ "/latency", latencyGetList },
 	{ NULL, NULL }
 };
 
@@ -48,6 +48,8 @@
 #include <log_manager.h>
 #include <resultset.h>
 #include <maxconfig.h>
+#include <query_classifier.h>
+#include <histogram.h>
 
 extern int lm_enabled_logfiles_bitmask;
 extern size_t         log_ses_count[];
@@ -231,6 +233,24 @@ RESULTSET	*set;
 	resultset_free(set);
 }
 
+/**
+ * Fetch the latency histograms of the services, servers and filters
+ *
+ * @param dcb	DCB to which to stream result set
+ * @param tree	Potential like clause (currently unused)
+ */
+static void
+exec_show_latency(DCB *dcb, MAXINFO_TREE *tree)
+{
+RESULTSET	*set;
+
+	if ((set = latencyGetList()) == NULL)
+		return;
+	
+	resultset_stream_mysql(set, dcb);
+	resultset_free(set);
+}
+
 /**
  * The table of show commands that are supported
  */
@@ -248,6 +268,7 @@ static struct {
 	{ "modules", exec_show_modules },
 	{ "monitors", exec_show_monitors },
 	{ "eventTimes", exec_show_eventTimes },
+	{ "latency", exec_show_latency },
 	{ NULL, NULL }
 };
 
@@ -583,6 +604,51 @@ maxinfo_max_event_exec_time()
 	return poll_get_stat(POLL_STAT_MAX_EXECTIME);
 }
 
+/**
+ * Interface to the query classification cache stats for hits
+ */
+static int
+maxinfo_qc_cache_hits()
+{
+	return query_classifier_cache_get_stat(QC_CACHE_STAT_HITS);
+}
+
+/**
+ * Interface to the query classification cache stats for misses
+ */
+static int
+maxinfo_qc_cache_misses()
+{
+	return query_classifier_cache_get_stat(QC_CACHE_STAT_MISSES);
+}
+
+/**
+ * Interface to the query classification cache stats for the hit ratio
+ */
+static int
+maxinfo_qc_cache_hit_ratio()
+{
+	return query_classifier_cache_get_stat(QC_CACHE_STAT_HIT_RATIO);
+}
+
+/**
+ * Interface to the query classification cache stats for entries
+ */
+static int
+maxinfo_qc_cache_entries()
+{
+	return query_classifier_cache_get_stat(QC_CACHE_STAT_ENTRIES);
+}
+
+/**
+ * Interface to the query classification cache stats for evictions
+ */
+static int
+maxinfo_qc_cache_evictions()
+{
+	return query_classifier_cache_get_stat(QC_CACHE_STAT_EVICTIONS);
+}
+
 /**
  * Variables that may be sent in a show status
  */
@@ -613,6 +679,11 @@ static struct {
 	{ "Max_event_queue_length", VT_INT, (STATSFUNC)maxinfo_max_event_queue_length },
 	{ "Max_event_queue_time", VT_INT, (STATSFUNC)maxinfo_max_event_queue_time },
 	{ "Max_event_execution_time", VT_INT, (STATSFUNC)maxinfo_max_event_exec_time },
+	{ "Classifier_cache_hits", VT_INT, (STATSFUNC)maxinfo_qc_cache_hits },
+	{ "Classifier_cache_misses", VT_INT, (STATSFUNC)maxinfo_qc_cache_misses },
+	{ "Classifier_cache_hit_ratio", VT_INT, (STATSFUNC)maxinfo_qc_cache_hit_ratio },
+	{ "Classifier_cache_entries", VT_INT, (STATSFUNC)maxinfo_qc_cache_entries },
+	{ "Classifier_cache_evictions", VT_INT, (STATSFUNC)maxinfo_qc_cache_evictions },
 	{ NULL, 0, 	NULL }
 };
 
@@ -21,6 +21,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <ctype.h>
 
 #include <router.h>
 #include <readwritesplit.h>
@@ -34,6 +35,7 @@
 #include <modinfo.h>
 #include <modutil.h>
 #include <mysql_client_server_protocol.h>
+#include <histogram.h>
 
 MODULE_INFO 	info = {
 	MODULE_API_ROUTER,
@@ -158,6 +160,22 @@ int bref_cmp_current_load(
         const void* bref1,
         const void* bref2);
 
+int bref_cmp_response_time(
+        const void* bref1,
+        const void* bref2);
+
+static backend_ref_t* get_slave_bref_by_resp_time(
+        ROUTER_CLIENT_SES* rses,
+        int                max_rlag);
+
+static void backend_update_resp_time(
+        BACKEND*      b,
+        unsigned long usecs);
+
+static unsigned long backend_get_resp_time(
+        BACKEND*      b,
+        unsigned long now);
+
 /**
  * The order of functions _must_ match with the order the select criteria are
  * listed in select_criteria_t definition in readwritesplit.h
@@ -168,7 +186,8 @@ int (*criteria_cmpfun[LAST_CRITERIA])(const void*, const void*)=
         bref_cmp_global_conn,
         bref_cmp_router_conn,
         bref_cmp_behind_master,
-        bref_cmp_current_load
+        bref_cmp_current_load,
+        bref_cmp_response_time
 };
 
 static bool select_connect_backend_servers(
@@ -263,6 +282,18 @@ static bool sescmd_cursor_next(
 
 static GWBUF* sescmd_cursor_process_replies(GWBUF* replybuf, backend_ref_t* bref,bool*);
 
+static bool sescmd_key_word(
+        char**      ptr,
+        const char* word);
+
+static char* sescmd_history_key(
+        GWBUF*        sescmd_buf,
+        unsigned char packet_type);
+
+static void sescmd_history_compact(
+        ROUTER_CLIENT_SES* rses,
+        char*              key);
+
 static void tracelog_routed_query(
         ROUTER_CLIENT_SES* rses,
         char*              funcname,
@@ -610,6 +641,9 @@ createInstance(SERVICE *service, char **options)
                 router->servers[nservers]->backend_conn_count = 0;
                 router->servers[nservers]->be_valid = false;
                 router->servers[nservers]->weight = 1000;
+                router->servers[nservers]->resp_time = 0;
+                router->servers[nservers]->resp_time_updated = 0;
+                router->servers[nservers]->resp_probe_start = 0;
 #if defined(SS_DEBUG)
                 router->servers[nservers]->be_chk_top = CHK_NUM_BACKEND;
                 router->servers[nservers]->be_chk_tail = CHK_NUM_BACKEND;
@@ -692,6 +726,7 @@ createInstance(SERVICE *service, char **options)
 	 */
 	router->bitmask = 0;
 	router->bitvalue = 0;
+	router->rwsplit_config.compact_sescmd_hist = true;
         
         /** Call this before refreshInstance */
 	if (options)
@@ -1192,6 +1227,19 @@ static bool get_dcb(
         {
 		backend_ref_t* candidate_bref = NULL;
 
+		/**
+		 * The slave with the least response time is chosen per
+		 * statement. If there are no usable slaves the loop below
+		 * falls back to the master.
+		 */
+		if (rses->rses_config.rw_slave_select_criteria == LEAST_RESPONSE_TIME &&
+			(candidate_bref = get_slave_bref_by_resp_time(rses, max_rlag)) != NULL)
+		{
+			*p_dcb = candidate_bref->bref_dcb;
+			succp = true;
+			goto return_succp;
+		}
+
 		for (i=0; i<rses->rses_nbackends; i++)
 		{
 			BACKEND* b = (&backend_ref[i])->bref_backend;
@@ -2503,6 +2551,7 @@ static bool route_single_stmt(
 			 * Add one query response waiter to backend reference
 			 */
 			bref = get_bref_from_dcb(rses, target_dcb);
+			bref->bref_query_start = histogram_usecs();
 			bref_set_state(bref, BREF_QUERY_ACTIVE);
 			bref_set_state(bref, BREF_WAITING_RESULT);
 		}
@@ -2663,6 +2712,34 @@ char		  *weightby;
                 }
 
         }
+	if (router->rwsplit_config.rw_slave_select_criteria == LEAST_RESPONSE_TIME)
+	{
+		dcb_printf(dcb,
+			"\tAverage response times of servers.\n");
+		dcb_printf(dcb,
+			"\t\tServer               Response time (us)\n");
+		for (i = 0; router->servers[i]; i++)
+		{
+			unsigned long resp_time;
+
+			backend = router->servers[i];
+			resp_time = backend_get_resp_time(backend, histogram_usecs());
+			if (resp_time == 0 || resp_time == RESP_TIME_PROBING)
+			{
+				dcb_printf(dcb,
+					"\t\t%-20s %s\n",
+					backend->backend_server->unique_name,
+					resp_time == 0 ? "stale" : "probing");
+			}
+			else
+			{
+				dcb_printf(dcb,
+					"\t\t%-20s %lu\n",
+					backend->backend_server->unique_name,
+					resp_time);
+			}
+		}
+	}
 }
 
 /**
@@ -2817,6 +2894,9 @@ static void clientReply (
          */
 	else if (BREF_IS_QUERY_ACTIVE(bref))
 	{
+                /** The first reply to the query ends the measurement */
+                backend_update_resp_time(bref->bref_backend,
+                                         histogram_usecs() - bref->bref_query_start);
                 bref_clear_state(bref, BREF_QUERY_ACTIVE);
                 /** Set response status as replied */
                 bref_clear_state(bref, BREF_WAITING_RESULT);
@@ -2867,6 +2947,7 @@ static void clientReply (
 			/**
 			 * Add one query response waiter to backend reference
 			 */
+			bref->bref_query_start = histogram_usecs();
 			bref_set_state(bref, BREF_QUERY_ACTIVE);
 			bref_set_state(bref, BREF_WAITING_RESULT);
 		}
@@ -2937,6 +3018,206 @@ int bref_cmp_current_load(
         return ((1000 * s1->stats.n_current_ops) - b1->weight)
 			- ((1000 * s2->stats.n_current_ops) - b2->weight);
 }
+
+/**
+ * Return the average response time of a backend server. If the server has not
+ * replied to a query for RESP_TIME_STALE_USECS the average is stale: 0 is
+ * returned if the server may be probed and RESP_TIME_PROBING if a probe is
+ * already in flight, so that a stale server never beats a measured one more
+ * than once.
+ */
+static unsigned long backend_get_resp_time(
+        BACKEND*      b,
+        unsigned long now)
+{
+        unsigned long probe = b->resp_probe_start;
+
+        /** Another thread may have updated it after now was read */
+        if ((long)(now - b->resp_time_updated) <= RESP_TIME_STALE_USECS)
+        {
+                return b->resp_time;
+        }
+        if (probe != 0 && (long)(now - probe) <= RESP_TIME_STALE_USECS)
+        {
+                return RESP_TIME_PROBING;
+        }
+        return 0;
+}
+
+/**
+ * Claim the probe of a backend server whose average response time is stale.
+ * Only one of the threads that see the server as stale gets the probe.
+ *
+ * @param b	The backend server
+ * @param now	The current time in microseconds
+ *
+ * @return True if the caller may route the probe to the server
+ */
+static bool backend_claim_resp_probe(
+        BACKEND*      b,
+        unsigned long now)
+{
+        unsigned long probe = b->resp_probe_start;
+
+        if (backend_get_resp_time(b, now) != 0)
+        {
+                return false;
+        }
+        return __sync_bool_compare_and_swap(&b->resp_probe_start, probe, now);
+}
+
+/**
+ * Add the response time of a query to the average response time of the
+ * backend server. The first sample after the average has become unknown
+ * replaces it.
+ *
+ * The backends are shared by all sessions of the router and the update is
+ * not locked: of two concurrent updates one may be lost, which only costs
+ * a sample.
+ *
+ * @param b	The backend server
+ * @param usecs	The response time in microseconds
+ */
+static void backend_update_resp_time(
+        BACKEND*      b,
+        unsigned long usecs)
+{
+        unsigned long now = histogram_usecs();
+        unsigned long avg = backend_get_resp_time(b, now);
+
+        if (avg == 0 || avg == RESP_TIME_PROBING)
+        {
+                avg = usecs;
+        }
+        else if (usecs > avg)
+        {
+                avg += (usecs - avg) >> RESP_TIME_EWMA_SHIFT;
+        }
+        else
+        {
+                avg -= (avg - usecs) >> RESP_TIME_EWMA_SHIFT;
+        }
+        /** Zero is reserved for an unknown response time */
+        b->resp_time = avg > 0 ? avg : 1;
+        b->resp_time_updated = now;
+        b->resp_probe_start = 0;
+}
+
+/** Compare average response times of backend servers */
+int bref_cmp_response_time(
+        const void* bref1,
+        const void* bref2)
+{
+        BACKEND*      b1 = ((backend_ref_t *)bref1)->bref_backend;
+        BACKEND*      b2 = ((backend_ref_t *)bref2)->bref_backend;
+        unsigned long now = histogram_usecs();
+        unsigned long t1 = backend_get_resp_time(b1, now);
+        unsigned long t2 = backend_get_resp_time(b2, now);
+
+        if (t1 == t2)
+        {
+                return b1->backend_server->stats.n_current_ops -
+                        b2->backend_server->stats.n_current_ops;
+        }
+        return t1 < t2 ? -1 : 1;
+}
+
+/**
+ * Choose the slave for a statement by the power of two choices: two of the
+ * usable slaves of the session are picked at random and the one with the
+ * smaller average response time is chosen. Always choosing the fastest slave
+ * would send all sessions of all threads to the same server until its
+ * average catches up, the random pair spreads the load while still avoiding
+ * the slow slaves. A slave whose average is stale wins the comparison once
+ * and is measured by that probe statement; until the probe is replied to the
+ * slave loses every comparison.
+ *
+ * @param rses		The router client session
+ * @param max_rlag	Maximum replication lag or MAX_RLAG_UNDEFINED
+ *
+ * @return The backend reference of the chosen slave or NULL if the session
+ * has no usable slaves
+ */
+static backend_ref_t* get_slave_bref_by_resp_time(
+        ROUTER_CLIENT_SES* rses,
+        int                max_rlag)
+{
+        static __thread unsigned int seed = 0;
+        backend_ref_t* backend_ref = rses->rses_backend_ref;
+        backend_ref_t* first = NULL;
+        backend_ref_t* second = NULL;
+        unsigned long  now = histogram_usecs();
+        int            nslaves = 0;
+        int            r1;
+        int            r2;
+        int            i;
+
+        if (seed == 0)
+        {
+                seed = (unsigned int)(histogram_usecs() ^ (unsigned long)pthread_self());
+        }
+        /** Count the usable slaves */
+        for (i=0; i<rses->rses_nbackends; i++)
+        {
+                SERVER* srv = backend_ref[i].bref_backend->backend_server;
+
+                if (BREF_IS_IN_USE(&backend_ref[i]) &&
+                        SERVER_IS_SLAVE(srv) &&
+                        (max_rlag == MAX_RLAG_UNDEFINED ||
+                        (srv->rlag != MAX_RLAG_NOT_AVAILABLE &&
+                        srv->rlag <= max_rlag)))
+                {
+                        nslaves++;
+                }
+        }
+
+        if (nslaves == 0)
+        {
+                return NULL;
+        }
+        /** Pick the r1th and the r2th usable slave, r1 != r2 */
+        r1 = rand_r(&seed) % nslaves;
+        r2 = nslaves > 1 ? (r1 + 1 + rand_r(&seed) % (nslaves - 1)) % nslaves : r1;
+
+        for (i=0; i<rses->rses_nbackends && (first == NULL || second == NULL); i++)
+        {
+                SERVER* srv = backend_ref[i].bref_backend->backend_server;
+
+                if (BREF_IS_IN_USE(&backend_ref[i]) &&
+                        SERVER_IS_SLAVE(srv) &&
+                        (max_rlag == MAX_RLAG_UNDEFINED ||
+                        (srv->rlag != MAX_RLAG_NOT_AVAILABLE &&
+                        srv->rlag <= max_rlag)))
+                {
+                        if (r1 == 0)
+                        {
+                                first = &backend_ref[i];
+                        }
+                        if (r2 == 0)
+                        {
+                                second = &backend_ref[i];
+                        }
+                        r1--;
+                        r2--;
+                }
+        }
+        ss_dassert(first != NULL && second != NULL);
+
+        if (bref_cmp_response_time(first, second) > 0)
+        {
+                backend_ref_t* tmp = first;
+                first = second;
+                second = tmp;
+        }
+        /** Another thread may have claimed the probe of a stale slave */
+        if (backend_get_resp_time(first->bref_backend, now) == 0 &&
+                !backend_claim_resp_probe(first->bref_backend, now) &&
+                first != second)
+        {
+                return second;
+        }
+        return first;
+}
         
 static void bref_clear_state(
         backend_ref_t* bref,
@@ -3133,7 +3414,8 @@ static bool select_connect_backend_servers(
                 if (select_criteria == LEAST_GLOBAL_CONNECTIONS ||
                         select_criteria == LEAST_ROUTER_CONNECTIONS ||
                         select_criteria == LEAST_BEHIND_MASTER ||
-                        select_criteria == LEAST_CURRENT_OPERATIONS)
+                        select_criteria == LEAST_CURRENT_OPERATIONS ||
+                        select_criteria == LEAST_RESPONSE_TIME)
                 {
                         LOGIF(LT, (skygw_log_write(LOGFILE_TRACE, 
                                 "Servers and %s connection counts:",
@@ -3179,6 +3461,17 @@ static bool select_connect_backend_servers(
 							b->backend_server->name,
 							b->backend_server->port,
 							STRSRVSTATUS(b->backend_server))));
+                                                break;
+
+                                        case LEAST_RESPONSE_TIME:
+                                                LOGIF(LT, (skygw_log_write_flush(LOGFILE_TRACE, 
+							"response time : %lu us in \t%s:%d %s",
+							b->resp_time,
+							b->backend_server->name,
+							b->backend_server->port,
+							STRSRVSTATUS(b->backend_server))));
+                                                break;
+
                                         default:
                                                 break;
                                 }
@@ -3675,6 +3968,10 @@ static mysql_sescmd_t* mysql_sescmd_init (
         sescmd->my_sescmd_packet_type = packet_type;
 	sescmd->position = atomic_add(&rses->pos_generator,1);
 
+        if (rses->rses_config.compact_sescmd_hist)
+        {
+                sescmd->my_sescmd_key = sescmd_history_key(sescmd_buf, packet_type);
+        }
         return sescmd;
 }
 
@@ -3684,6 +3981,7 @@ static void mysql_sescmd_done(
 {
 	CHK_RSES_PROP(sescmd->my_sescmd_prop);
 	gwbuf_free(sescmd->my_sescmd_buf);
+	free(sescmd->my_sescmd_key);
         memset(sescmd, 0, sizeof(mysql_sescmd_t));
 }
 
@@ -4245,6 +4543,279 @@ return_rc:
         return rc;
 }
 
+/**
+ * Match a keyword at the start of a lowercase statement and skip the
+ * whitespace after it.
+ */
+static bool sescmd_key_word(
+        char**      ptr,
+        const char* word)
+{
+        size_t len = strlen(word);
+
+        if (strncmp(*ptr, word, len) != 0 || !isspace((*ptr)[len]))
+        {
+                return false;
+        }
+        *ptr += len;
+
+        while (isspace(**ptr))
+        {
+                *ptr += 1;
+        }
+        return true;
+}
+
+/**
+ * Find the session state a session command sets. A later command with the
+ * same key overrides the state completely and supersedes the earlier one in
+ * the session command history.
+ *
+ * COM_INIT_DB and USE have the key "use", SET NAMES has "names" and a SET
+ * of one session or user variable to a literal value has the lowercase name
+ * of the variable. SET CHARACTER SET takes the connection character set from
+ * the default database and must not be moved past a USE, so like global
+ * variables, multiple assignments, values that read variables or call
+ * functions, prepared statements and everything else it has no key and is
+ * always kept.
+ *
+ * @param sescmd_buf	Session command buffer
+ * @param packet_type	Type of MySQL packet
+ *
+ * @return Key allocated with malloc or NULL if the command can't be superseded
+ */
+static char* sescmd_history_key(
+        GWBUF*        sescmd_buf,
+        unsigned char packet_type)
+{
+        char  query[SESCMD_KEY_MAXLEN];
+        char* sql;
+        char* ptr;
+        char* name;
+        char* end;
+        int   len;
+        int   i;
+
+        if (packet_type == MYSQL_COM_INIT_DB)
+        {
+                return strdup("use");
+        }
+
+        if (packet_type != MYSQL_COM_QUERY ||
+            !modutil_extract_SQL(sescmd_buf, &sql, &len) ||
+            len <= 0 ||
+            len >= (int)sizeof(query) ||
+            len > (int)GWBUF_LENGTH(sescmd_buf) - 5)
+        {
+                return NULL;
+        }
+
+        for (i = 0; i < len; i++)
+        {
+                query[i] = tolower(sql[i]);
+        }
+        end = query + len;
+
+        while (end > query && isspace(end[-1]))
+        {
+                end--;
+        }
+
+        if (end > query && end[-1] == ';')
+        {
+                end--;
+
+                while (end > query && isspace(end[-1]))
+                {
+                        end--;
+                }
+        }
+        *end = '\0';
+
+        /** Comments and multi-statements are never superseded */
+        if (strpbrk(query, ";#") || strstr(query, "/*") || strstr(query, "--"))
+        {
+                return NULL;
+        }
+        ptr = query;
+
+        while (isspace(*ptr))
+        {
+                ptr++;
+        }
+
+        if (sescmd_key_word(&ptr, "use"))
+        {
+                return (*ptr != '\0' && strpbrk(ptr, " \t\r\n") == NULL) ?
+                        strdup("use") : NULL;
+        }
+
+        if (!sescmd_key_word(&ptr, "set"))
+        {
+                return NULL;
+        }
+
+        if (sescmd_key_word(&ptr, "names"))
+        {
+                return (*ptr != '\0' && strpbrk(ptr, ",(@") == NULL) ?
+                        strdup("names") : NULL;
+        }
+
+        if ((sescmd_key_word(&ptr, "character") && sescmd_key_word(&ptr, "set")) ||
+            sescmd_key_word(&ptr, "charset"))
+        {
+                return NULL;
+        }
+
+        if (!sescmd_key_word(&ptr, "session"))
+        {
+                sescmd_key_word(&ptr, "local");
+        }
+
+        if (strncmp(ptr, "@@global.", 9) == 0)
+        {
+                return NULL;
+        }
+        else if (strncmp(ptr, "@@session.", 10) == 0)
+        {
+                ptr += 10;
+        }
+        else if (strncmp(ptr, "@@local.", 8) == 0)
+        {
+                ptr += 8;
+        }
+        else if (strncmp(ptr, "@@", 2) == 0)
+        {
+                ptr += 2;
+        }
+        name = ptr;
+
+        if (*ptr == '@')
+        {
+                ptr++;
+        }
+
+        while (isalnum(*ptr) || *ptr == '_' || *ptr == '$')
+        {
+                ptr++;
+        }
+        len = ptr - name;
+
+        if (len == 0 || (len == 1 && *name == '@'))
+        {
+                return NULL;
+        }
+
+        while (isspace(*ptr))
+        {
+                ptr++;
+        }
+
+        if (*ptr == ':')
+        {
+                ptr++;
+        }
+
+        if (*ptr++ != '=')
+        {
+                return NULL;
+        }
+
+        while (isspace(*ptr))
+        {
+                ptr++;
+        }
+
+        if (*ptr == '\0' || strpbrk(ptr, ",(@") != NULL)
+        {
+                return NULL;
+        }
+        return strndup(name, len);
+}
+
+/**
+ * Remove the session commands that a new command with the given key
+ * supersedes from the session command history.
+ *
+ * Only the commands after the last command without a key are candidates,
+ * because a command without a key, a prepared statement for example, may
+ * depend on the state that was in effect when it was executed. SET NAMES and
+ * sql_mode change how the literals of the later commands are interpreted, so
+ * they are barriers as well unless the new command directly supersedes them.
+ * A command is removed only after it has been replied to the client and when
+ * no backend is executing it or has its cursor pointing at it.
+ *
+ * Router session must be locked.
+ *
+ * @param rses	Router client session
+ * @param key	Key of the new session command
+ */
+static void sescmd_history_compact(
+        ROUTER_CLIENT_SES* rses,
+        char*              key)
+{
+        rses_property_t**  pp;
+        rses_property_t**  from;
+        rses_property_t*   prop;
+        mysql_sescmd_t*    sescmd;
+        sescmd_cursor_t*   scur;
+        bool               keep;
+        int                i;
+
+        CHK_CLIENT_RSES(rses);
+        ss_dassert(SPINLOCK_IS_LOCKED(&rses->rses_lock));
+
+        from = &rses->rses_properties[RSES_PROP_TYPE_SESCMD];
+
+        for (pp = from; *pp != NULL; pp = &(*pp)->rses_prop_next)
+        {
+                char* k = (*pp)->rses_prop_data.sescmd.my_sescmd_key;
+
+                if (k == NULL ||
+                    ((strcmp(k, "names") == 0 || strcmp(k, "sql_mode") == 0) &&
+                     ((*pp)->rses_prop_next != NULL || strcmp(k, key) != 0)))
+                {
+                        from = &(*pp)->rses_prop_next;
+                }
+        }
+        pp = from;
+
+        while ((prop = *pp) != NULL)
+        {
+                sescmd = &prop->rses_prop_data.sescmd;
+                keep = !sescmd->my_sescmd_is_replied ||
+                        strcmp(sescmd->my_sescmd_key, key) != 0;
+
+                for (i = 0; !keep && i < rses->rses_nbackends; i++)
+                {
+                        if (!BREF_IS_IN_USE((&rses->rses_backend_ref[i])))
+                        {
+                                continue;
+                        }
+                        scur = &rses->rses_backend_ref[i].bref_sescmd_cur;
+
+                        if (scur->scmd_cur_cmd == sescmd ||
+                            scur->scmd_cur_ptr_property == &prop->rses_prop_next ||
+                            (scur->scmd_cur_ptr_property != NULL &&
+                             *scur->scmd_cur_ptr_property == prop))
+                        {
+                                keep = true;
+                        }
+                }
+
+                if (keep)
+                {
+                        pp = &prop->rses_prop_next;
+                }
+                else
+                {
+                        *pp = prop->rses_prop_next;
+                        rses_property_done(prop);
+                        atomic_add(&rses->rses_nsescmd, -1);
+                }
+        }
+}
+
 /**
  * Execute in backends used by current router session.
  * Save session variable commands to router session property
@@ -4411,6 +4982,13 @@ static bool route_session_write(
          */
         prop = rses_property_init(RSES_PROP_TYPE_SESCMD);
         mysql_sescmd_init(prop, querybuf, packet_type, router_cli_ses);
+
+        /** Drop the older commands this one supersedes */
+        if (prop->rses_prop_data.sescmd.my_sescmd_key != NULL)
+        {
+                sescmd_history_compact(router_cli_ses,
+                                       prop->rses_prop_data.sescmd.my_sescmd_key);
+        }
         
         /** Add sescmd property to router client session */
         rses_property_add(router_cli_ses, prop);
@@ -4559,6 +5137,7 @@ static void rwsplit_process_router_options(
                                         c == LEAST_ROUTER_CONNECTIONS ||
                                         c == LEAST_BEHIND_MASTER ||
                                         c == LEAST_CURRENT_OPERATIONS ||
+                                        c == LEAST_RESPONSE_TIME ||
                                         c == UNDEFINED_CRITERIA);
                                
                                 if (c == UNDEFINED_CRITERIA)
@@ -4568,8 +5147,9 @@ static void rwsplit_process_router_options(
                                                 "slave selection criteria \"%s\". "
                                                 "Allowed values are LEAST_GLOBAL_CONNECTIONS, "
                                                 "LEAST_ROUTER_CONNECTIONS, "
-                                                "LEAST_BEHIND_MASTER,"
-                                                "and LEAST_CURRENT_OPERATIONS.",
+                                                "LEAST_BEHIND_MASTER, "
+                                                "LEAST_CURRENT_OPERATIONS "
+                                                "and LEAST_RESPONSE_TIME.",
                                                 STRCRITERIA(router->rwsplit_config.rw_slave_select_criteria))));
                                 }
                                 else
@@ -4589,6 +5169,10 @@ static void rwsplit_process_router_options(
 			{
 			    router->rwsplit_config.disable_slave_recovery = config_truth_value(value);
 			}
+			else if(strcmp(options[i],"compact_sescmd_history") == 0)
+			{
+			    router->rwsplit_config.compact_sescmd_hist = config_truth_value(value);
+			}
                 }
         } /*< for */
 }
@@ -0,0 +1,256 @@
+/*
+ * This file is distributed as part of MaxScale.  It is free
+ * software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation,
+ * version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Copyright MariaDB Corporation Ab 2015
+ */
+
+/**
+ * Unit test of the session command history compaction of readwritesplit.
+ * The functions are static, so the router source is included here.
+ */
+#include "../readwritesplit.c"
+
+/**
+ * Return the history key of a COM_QUERY, "" if the query has no key
+ */
+static char *
+query_key(char *query, char *keybuf, size_t size)
+{
+GWBUF	*buf = modutil_create_query(query);
+char	*key = sescmd_history_key(buf, MYSQL_COM_QUERY);
+
+	snprintf(keybuf, size, "%s", key ? key : "");
+	free(key);
+	gwbuf_free(buf);
+	return keybuf;
+}
+
+/**
+ * test1	Check the keys of session commands
+ */
+static int
+test1()
+{
+char	keybuf[SESCMD_KEY_MAXLEN];
+GWBUF	*buf;
+char	*key;
+int	i;
+struct {
+	char	*query;
+	char	*key;
+} cases[] = {
+	{ "USE test", "use" },
+	{ "  use   test ;  ", "use" },
+	{ "USE test other", "" },
+	{ "SET NAMES utf8", "names" },
+	{ "set names 'latin1' collate 'latin1_swedish_ci'", "names" },
+	{ "SET NAMES @cs", "" },
+	{ "SET CHARACTER SET utf8", "" },
+	{ "SET CHARSET utf8", "" },
+	{ "SET autocommit=1", "autocommit" },
+	{ "SET SESSION sql_mode = 'ANSI'", "sql_mode" },
+	{ "SET LOCAL sql_mode = 'ANSI'", "sql_mode" },
+	{ "SET @@session.SQL_MODE='ANSI'", "sql_mode" },
+	{ "SET @@local.sql_mode='ANSI'", "sql_mode" },
+	{ "SET @@sql_mode='ANSI'", "sql_mode" },
+	{ "SET @@global.sql_mode='ANSI'", "" },
+	{ "SET GLOBAL sql_mode='ANSI'", "" },
+	{ "SET @MyVar := 5", "@myvar" },
+	{ "SET @a = @b", "" },
+	{ "SET @a = NOW()", "" },
+	{ "SET @a = 1, @b = 2", "" },
+	{ "SET @ = 1", "" },
+	{ "SET autocommit=1; SET autocommit=0", "" },
+	{ "SET autocommit=1 # comment", "" },
+	{ "SET autocommit=1 -- comment", "" },
+	{ "SET /* comment */ autocommit=1", "" },
+	{ "SELECT 1", "" },
+	{ "SETTING autocommit=1", "" }
+};
+
+	ss_dfprintf(stderr, "testsescmdhist : session command keys");
+	for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+	{
+		query_key(cases[i].query, keybuf, sizeof(keybuf));
+		if (strcmp(keybuf, cases[i].key) != 0)
+		{
+			ss_dfprintf(stderr, "\n\"%s\" has key \"%s\", expected \"%s\"",
+				cases[i].query, keybuf, cases[i].key);
+			ss_info_dassert(false, "Wrong session command key");
+		}
+	}
+	/** COM_INIT_DB has the same key as USE */
+	buf = modutil_create_query("test");
+	key = sescmd_history_key(buf, MYSQL_COM_INIT_DB);
+	ss_info_dassert(key != NULL && strcmp(key, "use") == 0,
+			"COM_INIT_DB must have the key of USE");
+	free(key);
+	gwbuf_free(buf);
+	ss_dfprintf(stderr, "\t..done\n");
+
+	return 0;
+}
+
+/**
+ * Add a replied session command to the history the way route_session_write
+ * does
+ */
+static void
+add_sescmd(ROUTER_CLIENT_SES *rses, char *query)
+{
+rses_property_t	*prop = rses_property_init(RSES_PROP_TYPE_SESCMD);
+
+	mysql_sescmd_init(prop, modutil_create_query(query), MYSQL_COM_QUERY, rses);
+	if (prop->rses_prop_data.sescmd.my_sescmd_key != NULL)
+		sescmd_history_compact(rses, prop->rses_prop_data.sescmd.my_sescmd_key);
+	prop->rses_prop_data.sescmd.my_sescmd_is_replied = true;
+	rses_property_add(rses, prop);
+	atomic_add(&rses->rses_nsescmd, 1);
+}
+
+/**
+ * Check that the history contains the given queries in order
+ */
+static bool
+history_is(ROUTER_CLIENT_SES *rses, char **queries, int n)
+{
+rses_property_t	*prop = rses->rses_properties[RSES_PROP_TYPE_SESCMD];
+char		*sql;
+int		len, i;
+
+	for (i = 0; i < n; i++, prop = prop->rses_prop_next)
+	{
+		if (prop == NULL ||
+			!modutil_extract_SQL(prop->rses_prop_data.sescmd.my_sescmd_buf,
+				&sql, &len) ||
+			len != strlen(queries[i]) ||
+			strncmp(sql, queries[i], len) != 0)
+			return false;
+	}
+	return prop == NULL && rses->rses_nsescmd == n;
+}
+
+/**
+ * Free the history of a test session
+ */
+static void
+free_history(ROUTER_CLIENT_SES *rses)
+{
+rses_property_t	*prop;
+
+	while ((prop = rses->rses_properties[RSES_PROP_TYPE_SESCMD]) != NULL)
+	{
+		rses->rses_properties[RSES_PROP_TYPE_SESCMD] = prop->rses_prop_next;
+		rses_property_done(prop);
+	}
+	rses->rses_nsescmd = 0;
+}
+
+/**
+ * test2	Check that superseded commands are removed from the history and
+ *		that commands without a key, SET NAMES and sql_mode act as
+ *		barriers
+ */
+static int
+test2()
+{
+ROUTER_CLIENT_SES	rses;
+char			*expect1[] = { "SET @a = 2", "USE db2", "SET autocommit=0" };
+char			*expect2[] = { "USE db1", "SET CHARACTER SET utf8", "USE db2" };
+char			*expect3[] = { "SET @@global.x=1", "SET @y=1", "SET @x=2",
+					"SET @@global.x=2" };
+char			*expect4[] = { "SET NAMES latin1", "SET @x='a'",
+					"SET NAMES utf8" };
+char			*expect5[] = { "SET sql_mode='ANSI'", "SET @x='a'",
+					"SET sql_mode='NO_BACKSLASH_ESCAPES'",
+					"SET @x='b'" };
+char			*expect6[] = { "SET @x='a'", "SET NAMES utf8" };
+
+	ss_dfprintf(stderr, "testsescmdhist : history compaction");
+	memset(&rses, 0, sizeof(rses));
+#if defined(SS_DEBUG)
+	rses.rses_chk_top = CHK_NUM_ROUTER_SES;
+	rses.rses_chk_tail = CHK_NUM_ROUTER_SES;
+#endif
+	spinlock_init(&rses.rses_lock);
+	rses.rses_config.compact_sescmd_hist = true;
+	spinlock_acquire(&rses.rses_lock);
+
+	add_sescmd(&rses, "USE db1");
+	add_sescmd(&rses, "SET @a = 1");
+	add_sescmd(&rses, "SET autocommit=1");
+	add_sescmd(&rses, "SET @a = 2");
+	add_sescmd(&rses, "USE db2");
+	add_sescmd(&rses, "SET autocommit=0");
+	ss_info_dassert(history_is(&rses, expect1, 3),
+			"Superseded commands must be removed");
+	free_history(&rses);
+
+	/** SET CHARACTER SET depends on the database and keeps the USE before it */
+	add_sescmd(&rses, "USE db1");
+	add_sescmd(&rses, "SET CHARACTER SET utf8");
+	add_sescmd(&rses, "USE db2");
+	ss_info_dassert(history_is(&rses, expect2, 3),
+			"Commands before a command without a key must be kept");
+	free_history(&rses);
+
+	add_sescmd(&rses, "SET @@global.x=1");
+	add_sescmd(&rses, "SET @x=1");
+	add_sescmd(&rses, "SET @y=1");
+	add_sescmd(&rses, "SET @x=2");
+	add_sescmd(&rses, "SET @@global.x=2");
+	ss_info_dassert(history_is(&rses, expect3, 4),
+			"Global variables must not be superseded");
+	free_history(&rses);
+
+	/** The literal of SET @x was interpreted with the first character set */
+	add_sescmd(&rses, "SET NAMES latin1");
+	add_sescmd(&rses, "SET @x='a'");
+	add_sescmd(&rses, "SET NAMES utf8");
+	ss_info_dassert(history_is(&rses, expect4, 3),
+			"SET NAMES must be kept before later commands");
+	free_history(&rses);
+
+	add_sescmd(&rses, "SET sql_mode='ANSI'");
+	add_sescmd(&rses, "SET @x='a'");
+	add_sescmd(&rses, "SET sql_mode='NO_BACKSLASH_ESCAPES'");
+	add_sescmd(&rses, "SET @x='b'");
+	ss_info_dassert(history_is(&rses, expect5, 4),
+			"sql_mode must be kept before later commands");
+	free_history(&rses);
+
+	/** Without commands in between SET NAMES is superseded */
+	add_sescmd(&rses, "SET @x='a'");
+	add_sescmd(&rses, "SET NAMES latin1");
+	add_sescmd(&rses, "SET NAMES utf8");
+	ss_info_dassert(history_is(&rses, expect6, 2),
+			"SET NAMES must supersede the previous one");
+	free_history(&rses);
+
+	spinlock_release(&rses.rses_lock);
+	ss_dfprintf(stderr, "\t..done\n");
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+int	result = 0;
+
+	result += test1();
+	result += test2();
+
+	exit(result);
+}
@@ -208,6 +208,15 @@ static ROUTER_INSTANCE* instances;
 
 static int hashkeyfun(void* key);
 static int hashcmpfun (void *, void *);
+static HASHTABLE* dbhash_alloc();
+static bool shard_map_attach(ROUTER_INSTANCE* inst, ROUTER_CLIENT_SES* rses);
+static void shard_map_detach(ROUTER_CLIENT_SES* rses);
+static void shard_map_release(shard_map_t* map);
+static void shard_map_update_session(ROUTER_INSTANCE* inst, ROUTER_CLIENT_SES* rses);
+static void shard_map_request_refresh(ROUTER_INSTANCE* inst);
+static void shard_map_refresh(void* data);
+static GWBUF* create_init_db_packet(char* db);
+static void store_query(ROUTER_CLIENT_SES* rses, GWBUF* querybuf);
 
 static int hashkeyfun(void* key)
 {
@@ -235,6 +244,304 @@ static int hashcmpfun(
 
 
 
+/**
+ * Allocate a hashtable for mapping database names to server names.
+ * @return The new hashtable
+ */
+static HASHTABLE* dbhash_alloc()
+{
+    HASHTABLE* hash = hashtable_alloc_concurrent(100, hashkeyfun, hashcmpfun);
+
+    if(hash)
+    {
+	hashtable_memory_fns(hash,(HASHMEMORYFN)strdup,
+			     (HASHMEMORYFN)strdup,
+			     (HASHMEMORYFN)free,
+			     (HASHMEMORYFN)free);
+    }
+    return hash;
+}
+
+/**
+ * Start using the shared shard map of the router instance in a session. The
+ * session takes a reference to the map and routes with its hashtable.
+ * @param inst Router instance
+ * @param rses Router client session
+ * @return True if the instance had a shard map
+ */
+static bool shard_map_attach(ROUTER_INSTANCE* inst, ROUTER_CLIENT_SES* rses)
+{
+    shard_map_t* map;
+
+    spinlock_acquire(&inst->map_lock);
+    if((map = inst->shard_map) != NULL)
+    {
+	atomic_add(&map->refcount,1);
+    }
+    spinlock_release(&inst->map_lock);
+
+    rses->shard_map = map;
+
+    if(map)
+    {
+	rses->dbhash = map->hash;
+    }
+    return map != NULL;
+}
+
+/**
+ * Stop using the shared shard map in a session. The session gets an empty
+ * private hashtable which it fills by mapping the databases itself.
+ * @param rses Router client session
+ */
+static void shard_map_detach(ROUTER_CLIENT_SES* rses)
+{
+    if(rses->shard_map)
+    {
+	shard_map_release(rses->shard_map);
+	rses->shard_map = NULL;
+	rses->dbhash = dbhash_alloc();
+    }
+}
+
+/**
+ * Release a reference to a shard map and free the map if it was the last one.
+ * @param map Shard map
+ */
+static void shard_map_release(shard_map_t* map)
+{
+    if(atomic_add(&map->refcount,-1) == 1)
+    {
+	hashtable_free(map->hash);
+	free(map);
+    }
+}
+
+/**
+ * Move a session to the latest shard map if a newer one has been published.
+ * The version is compared without locking, the lock is only taken to swap
+ * the maps.
+ * @param inst Router instance
+ * @param rses Router client session
+ */
+static void shard_map_update_session(ROUTER_INSTANCE* inst, ROUTER_CLIENT_SES* rses)
+{
+    shard_map_t* old = rses->shard_map;
+
+    if(old && old->version != inst->map_version)
+    {
+	if(shard_map_attach(inst,rses))
+	{
+	    skygw_log_write(LOGFILE_TRACE,"schemarouter: Session %p moved from shard map "
+		    "version %d to version %d.",
+		    rses->rses_client_dcb->session,old->version,rses->shard_map->version);
+	}
+	shard_map_release(old);
+    }
+}
+
+/**
+ * Schedule an immediate refresh of the shared shard map. This is done when
+ * a session doesn't find a database in the map. Refreshes are not attempted
+ * more often than every SHARD_MAP_MIN_REFRESH seconds, whether the previous
+ * attempt succeeded or not, so that an unreachable server doesn't keep the
+ * housekeeper busy with back-to-back refreshes.
+ * @param inst Router instance
+ */
+static void shard_map_request_refresh(ROUTER_INSTANCE* inst)
+{
+    char name[512];
+    time_t now = time(NULL);
+    bool schedule = false;
+
+    if(inst->refresh_interval <= 0)
+    {
+	return;
+    }
+
+    spinlock_acquire(&inst->map_lock);
+    if(now - inst->last_refresh_attempt >= SHARD_MAP_MIN_REFRESH)
+    {
+	inst->last_refresh_attempt = now;
+	schedule = true;
+    }
+    spinlock_release(&inst->map_lock);
+
+    if(schedule)
+    {
+	snprintf(name,sizeof(name),"%s shard map refresh",inst->service->name);
+	hktask_oneshot(name,shard_map_refresh,inst,0);
+    }
+}
+
+/**
+ * Housekeeper task that generates a new shard map with SHOW DATABASES on each
+ * running server and publishes it for the sessions. The service user is used
+ * for connecting to the servers, like when loading the users of the service.
+ * If a server is not running or can't be queried the map would be partial
+ * and the old map is kept.
+ * @param data Router instance
+ */
+static void shard_map_refresh(void* data)
+{
+    ROUTER_INSTANCE* inst = (ROUTER_INSTANCE*)data;
+    SERVICE* service = inst->service;
+    HASHTABLE* hash;
+    shard_map_t *map, *old;
+    MYSQL* con;
+    MYSQL_RES* result;
+    MYSQL_ROW row;
+    char *user, *passwd, *dpwd;
+    unsigned int timeout = SHARD_MAP_TIMEOUT;
+    bool failed = false;
+    int nqueried = 0;
+    int i;
+
+    if(service->svc_do_shutdown || serviceGetUser(service,&user,&passwd) == 0)
+    {
+	return;
+    }
+    if((hash = dbhash_alloc()) == NULL)
+    {
+	return;
+    }
+    dpwd = decryptPassword(passwd);
+
+    for(i = 0;inst->servers[i] && !failed;i++)
+    {
+	SERVER* server = inst->servers[i]->backend_server;
+
+	if(!SERVER_IS_RUNNING(server))
+	{
+	    LOGIF(LE, (skygw_log_write_flush(
+		    LOGFILE_ERROR,
+		    "Warning : Schemarouter: Server '%s' of service '%s' is "
+		    "not running, keeping the old shard map.",
+		    server->unique_name,
+		    service->name)));
+	    failed = true;
+	    break;
+	}
+	if((con = mysql_init(NULL)) == NULL)
+	{
+	    failed = true;
+	    break;
+	}
+	mysql_options(con,MYSQL_OPT_CONNECT_TIMEOUT,(void *)&timeout);
+	mysql_options(con,MYSQL_OPT_READ_TIMEOUT,(void *)&timeout);
+	mysql_options(con,MYSQL_OPT_WRITE_TIMEOUT,(void *)&timeout);
+
+	if(mysql_options(con,MYSQL_OPT_USE_REMOTE_CONNECTION,NULL) ||
+	   mysql_real_connect(con,server->name,user,dpwd,NULL,
+			      server->port,NULL,0) == NULL ||
+	   mysql_query(con,"SHOW DATABASES") != 0 ||
+	   (result = mysql_store_result(con)) == NULL)
+	{
+	    LOGIF(LE, (skygw_log_write_flush(
+		    LOGFILE_ERROR,
+		    "Error : Schemarouter: Failed to refresh the shard map "
+		    "of service '%s' from server '%s': %s",
+		    service->name,
+		    server->unique_name,
+		    mysql_error(con))));
+	    failed = true;
+	}
+	else
+	{
+	    while((row = mysql_fetch_row(result)))
+	    {
+		if(row[0] && hashtable_add(hash,row[0],server->unique_name))
+		{
+		    skygw_log_write(LOGFILE_TRACE,"schemarouter: <%s, %s>",
+			    server->unique_name,row[0]);
+		}
+	    }
+	    mysql_free_result(result);
+	    nqueried++;
+	}
+	mysql_close(con);
+    }
+    free(dpwd);
+
+    if(failed || nqueried == 0 ||
+       (map = (shard_map_t*)calloc(1,sizeof(shard_map_t))) == NULL)
+    {
+	hashtable_free(hash);
+	return;
+    }
+    map->hash = hash;
+    map->updated = time(NULL);
+    map->refcount = 1;
+
+    spinlock_acquire(&inst->map_lock);
+    old = inst->shard_map;
+    map->version = inst->map_version + 1;
+    inst->shard_map = map;
+    inst->map_version = map->version;
+    spinlock_release(&inst->map_lock);
+
+    if(old)
+    {
+	shard_map_release(old);
+    }
+    atomic_add(&inst->stats.shmap_refresh,1);
+    skygw_log_write(LOGFILE_TRACE,"schemarouter: Published shard map version %d "
+	    "for service '%s'.",map->version,service->name);
+}
+
+/**
+ * Create a COM_INIT_DB packet.
+ * @param db Database name
+ * @return The packet or NULL if the allocation failed
+ */
+static GWBUF* create_init_db_packet(char* db)
+{
+    unsigned int qlen = strlen(db);
+    GWBUF* buffer = gwbuf_alloc(qlen + 5);
+
+    if(buffer)
+    {
+	gw_mysql_set_byte3((unsigned char*)buffer->start,qlen+1);
+	gwbuf_set_type(buffer,GWBUF_TYPE_MYSQL);
+	*((unsigned char*)buffer->start + 3) = 0x0;
+	*((unsigned char*)buffer->start + 4) = 0x2;
+	memcpy(buffer->start+5,db,qlen);
+    }
+    return buffer;
+}
+
+/**
+ * Store a query until the session is ready to route it. The router session
+ * lock must be held by the caller.
+ * @param rses Router client session
+ * @param querybuf Query to store
+ */
+static void store_query(ROUTER_CLIENT_SES* rses, GWBUF* querybuf)
+{
+    char* querystr = modutil_get_SQL(querybuf);
+    GWBUF* ptr = rses->queue;
+
+    skygw_log_write(LOGFILE_DEBUG|LOGFILE_TRACE,"schemarouter: Storing query for session %p: %s",
+	     rses->rses_client_dcb->session,
+	     querystr);
+    free(querystr);
+    querybuf = gwbuf_make_contiguous(querybuf);
+
+    while(ptr && ptr->next)
+    {
+	ptr = ptr->next;
+    }
+
+    if(ptr == NULL)
+    {
+	rses->queue = querybuf;
+    }
+    else
+    {
+	ptr->next = querybuf;
+    }
+}
+
 /**
  * Convert a length encoded string into a C string.
  * @param data Pointer to the first byte of the string
@@ -476,6 +783,12 @@ char* get_shard_target_name(ROUTER_INSTANCE* router, ROUTER_CLIENT_SES* client,
 				}
                             }
 			}
+			else if(client->shard_map)
+			{
+			    /** The database may have been created after the
+			     * shared map was generated */
+			    shard_map_request_refresh(router);
+			}
 			free(dbnms[i]);
 		}
 		free(dbnms);
@@ -719,6 +1032,8 @@ createInstance(SERVICE *service, char **options)
 	router->stats.ses_longest = 0;
 	router->stats.ses_shortest = (double)((unsigned long)(~0));
         spinlock_init(&router->lock);
+        spinlock_init(&router->map_lock);
+        router->refresh_interval = SHARD_MAP_REFRESH_INTERVAL;
         
         /** Calculate number of servers */
         server = service->dbref;
@@ -753,6 +1068,17 @@ createInstance(SERVICE *service, char **options)
 	    {
 		router->schemarouter_config.disable_sescmd_hist = config_truth_value(value);
 	    }
+	    else if(strcmp(options[i],"refresh_interval") == 0)
+	    {
+		router->refresh_interval = atoi(value);
+		if(router->refresh_interval < 0)
+		{
+		    skygw_log_write(LOGFILE_ERROR,"Error: Invalid value for Schemarouter "
+			    "router option refresh_interval: %s",value);
+		    failure = true;
+		    break;
+		}
+	    }
 	    else
 	    {
 		skygw_log_write(LOGFILE_ERROR,"Error: Unknown router options for Schemarouter: %s",options[i]);
@@ -842,6 +1168,18 @@ createInstance(SERVICE *service, char **options)
         router->next = instances;
         instances = router;
         spinlock_release(&instlock);
+
+	/**
+	 * Generate the shared shard map in the housekeeper. The first map is
+	 * generated right away and then refreshed periodically.
+	 */
+	if(router->refresh_interval > 0)
+	{
+	    char taskname[512];
+	    snprintf(taskname,sizeof(taskname),"%s shard map",service->name);
+	    hktask_add(taskname,shard_map_refresh,router,router->refresh_interval);
+	    shard_map_request_refresh(router);
+	}
 	goto retblock;
 	
 clean_up:
@@ -1009,12 +1347,6 @@ static void* newSession(
 					router_nservers,
 					session,
 					router);
-        
-        client_rses->dbhash = hashtable_alloc(100, hashkeyfun, hashcmpfun);
-        hashtable_memory_fns(client_rses->dbhash,(HASHMEMORYFN)strdup,
-                                 (HASHMEMORYFN)strdup,
-                                 (HASHMEMORYFN)free,
-                                 (HASHMEMORYFN)free);
 
         rses_end_locked_router_action(client_rses);
         
@@ -1047,7 +1379,48 @@ static void* newSession(
             /* Store the database the client is connecting to */
             strncpy(client_rses->connect_db,db,MYSQL_DATABASE_MAXLEN+1);
         }
-        
+
+        /**
+         * Start routing with the shared shard map if one is available.
+         * Otherwise the databases are mapped by this session when the
+         * first query arrives.
+         */
+        if(shard_map_attach(router,client_rses))
+        {
+            atomic_add(&router->stats.shmap_cache_hit,1);
+            client_rses->init = INIT_READY;
+
+            if(using_db)
+            {
+                char* target;
+                DCB* dcb = NULL;
+                GWBUF* buffer;
+
+                if((target = hashtable_fetch(client_rses->dbhash,db)) &&
+                   get_shard_dcb(&dcb,client_rses,target) &&
+                   (buffer = create_init_db_packet(db)))
+                {
+                    client_rses->init = INIT_USE_DB;
+                    dcb->func.write(dcb,buffer);
+                    skygw_log_write(LOGFILE_DEBUG,"schemarouter: USE '%s' sent to %s for session %p",
+                                    db,target,session);
+                }
+                else
+                {
+                    /** Not in the shared map, map the databases for this
+                     * session and request a refresh for the next ones. */
+                    shard_map_detach(client_rses);
+                    shard_map_request_refresh(router);
+                    client_rses->init = INIT_UNINT|INIT_USE_DB;
+                }
+            }
+        }
+        else
+        {
+            atomic_add(&router->stats.shmap_cache_miss,1);
+            client_rses->dbhash = dbhash_alloc();
+            shard_map_request_refresh(router);
+        }
              
         rses_end_locked_router_action(client_rses);
 
@@ -1245,7 +1618,14 @@ static void freeSession(
          * all the memory and other resources associated
          * to the client session.
          */
-        hashtable_free(router_cli_ses->dbhash);
+        if(router_cli_ses->shard_map)
+        {
+            shard_map_release(router_cli_ses->shard_map);
+        }
+        else
+        {
+            hashtable_free(router_cli_ses->dbhash);
+        }
         free(router_cli_ses->rses_backend_ref);
 	free(router_cli_ses);
         return;
@@ -1859,6 +2239,9 @@ static int routeQuery(
 
         if(!(rses_is_closed = router_cli_ses->rses_closed))
         {
+	    /** Pick up a newer shared shard map */
+	    shard_map_update_session(inst,router_cli_ses);
+
 	    if(router_cli_ses->init & INIT_UNINT)
 	    {
 		/* Generate database list */
@@ -1866,31 +2249,9 @@ static int routeQuery(
 
 	    }
 
-	    if(router_cli_ses->init & INIT_MAPPING)
+	    if(router_cli_ses->init & (INIT_MAPPING|INIT_USE_DB))
 	    {
-
-		char* querystr = modutil_get_SQL(querybuf);
-		skygw_log_write(LOGFILE_DEBUG|LOGFILE_TRACE,"schemarouter: Storing query for session %p: %s",
-			 router_cli_ses->rses_client_dcb->session,
-			 querystr);
-		free(querystr);
-		querybuf = gwbuf_make_contiguous(querybuf);
-		GWBUF* ptr = router_cli_ses->queue;
-
-		while(ptr && ptr->next)
-		{
-		    ptr = ptr->next;
-		}
-
-		if(ptr == NULL)
-		{
-		    router_cli_ses->queue = querybuf;
-		}
-		else
-		{
-		    ptr->next = querybuf;
-
-		}
+		store_query(router_cli_ses,querybuf);
 		rses_end_locked_router_action(router_cli_ses);
 		return 1;
 	    }
@@ -2015,6 +2376,10 @@ static int routeQuery(
 						     router_cli_ses->dbhash,
 						     querybuf)))
 	    {
+		if(router_cli_ses->shard_map)
+		{
+		    shard_map_request_refresh(inst);
+		}
 		extract_database(querybuf,db);
 		snprintf(errbuf,25+MYSQL_DATABASE_MAXLEN,"Unknown database: %s",db);
 		for(i = 0;i<router_cli_ses->rses_nbackends;i++)
@@ -2034,6 +2399,21 @@ static int routeQuery(
 
 	if(QUERY_IS_TYPE(qtype, QUERY_TYPE_SHOW_DATABASES))
 	{
+		/**
+		 * The shared map contains the databases visible to the service
+		 * user. Map the databases with the client's own privileges and
+		 * answer once the mapping is done.
+		 */
+		if(router_cli_ses->shard_map &&
+		   rses_begin_locked_router_action(router_cli_ses))
+		{
+		    shard_map_detach(router_cli_ses);
+		    gen_databaselist(inst,router_cli_ses);
+		    store_query(router_cli_ses,querybuf);
+		    rses_end_locked_router_action(router_cli_ses);
+		    return 1;
+		}
+
 		/**
 		 * Generate custom response that contains all the databases 
 		 */
@@ -2393,6 +2773,35 @@ diagnostic(ROUTER *instance, DCB *dcb)
 	dcb_printf(dcb,"Session command history: disabled\n");
     }
 
+    /** Shared shard map statistics */
+    dcb_printf(dcb,"\n\33[1;4mShard Map\33[0m\n");
+    if(router->refresh_interval > 0)
+    {
+	dcb_printf(dcb,"Shard map refresh interval: %d seconds\n",
+		   router->refresh_interval);
+	spinlock_acquire(&router->map_lock);
+	if(router->shard_map)
+	{
+	    dcb_printf(dcb,"Shard map version: %d\n",router->shard_map->version);
+	    dcb_printf(dcb,"Shard map age: %.0f seconds\n",
+		       difftime(time(NULL),router->shard_map->updated));
+	}
+	else
+	{
+	    dcb_printf(dcb,"Shard map version: not generated\n");
+	}
+	spinlock_release(&router->map_lock);
+	dcb_printf(dcb,"Shard map refreshes: %d\n",router->stats.shmap_refresh);
+	dcb_printf(dcb,"Sessions using the shard map: %d\n",
+		   router->stats.shmap_cache_hit);
+	dcb_printf(dcb,"Sessions mapping the databases: %d\n",
+		   router->stats.shmap_cache_miss);
+    }
+    else
+    {
+	dcb_printf(dcb,"Shared shard map: disabled\n");
+    }
+
     /** Session time statistics */
 
     if(router->stats.sessions > 0)
@@ -2577,11 +2986,8 @@ static void clientReply (
                     /* Send a COM_INIT_DB packet to the server with the right database
                      * and set it as the client's active database */   
                     
-                    unsigned int qlen;
-                    GWBUF* buffer;
-                    
-                    qlen = strlen(router_cli_ses->connect_db);
-                    buffer = gwbuf_alloc(qlen + 5);                    
+                    GWBUF* buffer = create_init_db_packet(router_cli_ses->connect_db);
+
                     if(buffer == NULL)
                     {
                         skygw_log_write_flush(LOGFILE_ERROR,"Error : Buffer allocation failed.");
@@ -2592,11 +2998,6 @@ static void clientReply (
                         return;
                     }
 
-                    gw_mysql_set_byte3((unsigned char*)buffer->start,qlen+1);
-                    gwbuf_set_type(buffer,GWBUF_TYPE_MYSQL);
-                    *((unsigned char*)buffer->start + 3) = 0x0;
-                    *((unsigned char*)buffer->start + 4) = 0x2;
-                    memcpy(buffer->start+5,router_cli_ses->connect_db,qlen);
                     DCB* dcb = NULL;
                     
                     if(get_shard_dcb(&dcb,router_cli_ses,target))
@@ -4227,6 +4628,13 @@ static bool handle_error_new_connection(
             goto return_succp;
         }
         
+        /** The shared map is read-only, remap with a private hashtable */
+        if(rses->shard_map)
+        {
+            shard_map_detach(rses);
+            shard_map_request_refresh(inst);
+        }
+
         rses->init |= INIT_MAPPING;
 
         for(i = 0;i<rses->rses_nbackends;i++)
@@ -25,6 +25,8 @@
 #include <time.h>
 #include <stddef.h>
 #include <regex.h>
+#include <ctype.h>
+#include <strings.h>
 #include "skygw_debug.h"
 #include <skygw_types.h>
 #include <sys/time.h>
@@ -602,6 +604,176 @@ bool mlist_cursor_move_to_first(
 /** End of mlist */
 
 
+/**
+ * Per-thread cache of a formatted timestamp. The parts of the timestamp
+ * before and after the milliseconds are formatted only when the second
+ * changes.
+ */
+typedef struct ts_cache_st {
+        time_t tc_sec;        /**< The second the cached parts are for */
+        size_t tc_prefix_len;
+        size_t tc_suffix_len;
+        char   tc_prefix[TS_CACHE_STRLEN];
+        char   tc_suffix[TS_CACHE_STRLEN];
+} ts_cache_t;
+
+static __thread ts_cache_t ts_cache[TS_FORMAT_COUNT];
+
+/**
+ * Format the parts of a timestamp that change at most once per second.
+ */
+static void ts_cache_refresh(
+        ts_format_t fmt,
+        ts_cache_t* tc,
+        time_t      sec)
+{
+        struct tm tm;
+
+        localtime_r(&sec, &tm);
+
+        switch (fmt) {
+        case TS_FORMAT_LOG:
+                tc->tc_prefix_len = snprintf(tc->tc_prefix,
+                                             sizeof(tc->tc_prefix),
+                                             timestamp_formatstr,
+                                             tm.tm_year+1900,
+                                             tm.tm_mon+1,
+                                             tm.tm_mday,
+                                             tm.tm_hour,
+                                             tm.tm_min,
+                                             tm.tm_sec);
+                tc->tc_suffix_len = 0;
+                break;
+
+        case TS_FORMAT_LOG_HP:
+                tc->tc_prefix_len = snprintf(tc->tc_prefix,
+                                             sizeof(tc->tc_prefix),
+                                             "%04d-%02d-%02d %02d:%02d:%02d.",
+                                             tm.tm_year+1900,
+                                             tm.tm_mon+1,
+                                             tm.tm_mday,
+                                             tm.tm_hour,
+                                             tm.tm_min,
+                                             tm.tm_sec);
+                tc->tc_suffix_len = snprintf(tc->tc_suffix,
+                                             sizeof(tc->tc_suffix),
+                                             "   ");
+                break;
+
+        case TS_FORMAT_QLA:
+                tc->tc_prefix_len = snprintf(tc->tc_prefix,
+                                             sizeof(tc->tc_prefix),
+                                             "%02d:%02d:%02d.",
+                                             tm.tm_hour,
+                                             tm.tm_min,
+                                             tm.tm_sec);
+                tc->tc_suffix_len = snprintf(tc->tc_suffix,
+                                             sizeof(tc->tc_suffix),
+                                             " %d/%02d/%d, ",
+                                             tm.tm_mday,
+                                             tm.tm_mon+1,
+                                             tm.tm_year+1900);
+                break;
+
+        default:
+                ss_dassert(false);
+                tc->tc_prefix_len = 0;
+                tc->tc_suffix_len = 0;
+                break;
+        }
+        tc->tc_sec = sec;
+}
+
+/**
+ * @node Write a timestamp of given format by using at most tslen characters.
+ *
+ * Parameters:
+ * @param fmt - in, use
+ *          Format of the timestamp
+ *
+ * @param tv - in, use
+ *          Time to print or NULL for current time
+ *
+ * @param p_ts - out
+ *          Write position in memory
+ *
+ * @param tslen - in, use
+ *          Size of the write position, including terminating '\0'
+ *
+ * @return Length of string written to p_ts, excluding terminating '\0'.
+ *
+ * @details The calendar time is converted and formatted only when the
+ * second changes and otherwise copied from a per-thread cache. Only the
+ * milliseconds are formatted on every call.
+ */
+size_t snprint_timestamp_cached(
+        ts_format_t     fmt,
+        struct timeval* tv,
+        char*           p_ts,
+        size_t          tslen)
+{
+        struct timeval now;
+        ts_cache_t*    tc;
+        char           buf[TS_CACHE_STRLEN*2+3];
+        size_t         len;
+        int            msec;
+
+        if (p_ts == NULL || tslen == 0 || (unsigned)fmt >= TS_FORMAT_COUNT)
+        {
+                return 0;
+        }
+
+        if (tv == NULL)
+        {
+                gettimeofday(&now, NULL);
+                tv = &now;
+        }
+        tc = &ts_cache[fmt];
+
+        if (tc->tc_sec != tv->tv_sec || tc->tc_prefix_len == 0)
+        {
+                ts_cache_refresh(fmt, tc, tv->tv_sec);
+        }
+        memcpy(buf, tc->tc_prefix, tc->tc_prefix_len);
+        len = tc->tc_prefix_len;
+        msec = tv->tv_usec / 1000;
+
+        if (fmt == TS_FORMAT_LOG_HP)
+        {
+                /** Zero padded, as in %03d */
+                buf[len++] = '0' + msec / 100;
+                buf[len++] = '0' + msec / 10 % 10;
+                buf[len++] = '0' + msec % 10;
+        }
+        else if (fmt == TS_FORMAT_QLA)
+        {
+                /** Left-justified and space padded, as in %-3d */
+                size_t start = len;
+
+                if (msec >= 100)
+                {
+                        buf[len++] = '0' + msec / 100;
+                }
+                if (msec >= 10)
+                {
+                        buf[len++] = '0' + msec / 10 % 10;
+                }
+                buf[len++] = '0' + msec % 10;
+
+                while (len - start < 3)
+                {
+                        buf[len++] = ' ';
+                }
+        }
+        memcpy(buf + len, tc->tc_suffix, tc->tc_suffix_len);
+        len += tc->tc_suffix_len;
+
+        len = MIN(len, tslen - 1);
+        memcpy(p_ts, buf, len);
+        p_ts[len] = '\0';
+        return len;
+}
+
 size_t get_timestamp_len(void)
 {
         return timestamp_len;
@@ -623,38 +795,17 @@ size_t get_timestamp_len_hp(void)
  * @return Length of string written to p_ts. Length includes terminating '\0'.
  *
  * 
- * @details (write detailed description here)
+ * @details Uses the per-thread timestamp cache.
  *
  */
 size_t snprint_timestamp(
         char* p_ts,
         size_t   tslen)
 {
-        time_t       t;
-        struct tm    tm;
-	size_t          rval;
-        struct timeval tv;
-        if (p_ts == NULL) {
-		rval = 0;
-                goto retblock;
-        }
-
-        /** Generate timestamp */
-
-        t = time(NULL);
-        tm = *(localtime(&t));
-        snprintf(p_ts,
-                 MIN(tslen,timestamp_len),
-                 timestamp_formatstr,
-                 tm.tm_year+1900,
-                 tm.tm_mon+1,
-                 tm.tm_mday,
-                 tm.tm_hour,
-                 tm.tm_min,
-                 tm.tm_sec);
-	rval = strlen(p_ts)*sizeof(char);
-retblock:
-        return rval;
+        return snprint_timestamp_cached(TS_FORMAT_LOG,
+                                        NULL,
+                                        p_ts,
+                                        MIN(tslen,timestamp_len));
 }
 
 
@@ -670,41 +821,17 @@ retblock:
  * @return Length of string written to p_ts. Length includes terminating '\0'.
  *
  *
- * @details (write detailed description here)
+ * @details Uses the per-thread timestamp cache.
  *
  */
 size_t snprint_timestamp_hp(
         char* p_ts,
         size_t   tslen)
 {
-        time_t       t;
-        struct tm    tm;
-	size_t          rval;
-        struct timeval tv;
-        int usec;
-        if (p_ts == NULL) {
-		rval = 0;
-                goto retblock;
-        }
-
-        /** Generate timestamp */
-
-        gettimeofday(&tv,NULL);
-        tm = *(localtime(&tv.tv_sec));
-        usec = tv.tv_usec/1000;
-        snprintf(p_ts,
-                 MIN(tslen,timestamp_len_hp),
-                 timestamp_formatstr_hp,
-                 tm.tm_year+1900,
-                 tm.tm_mon+1,
-                 tm.tm_mday,
-                 tm.tm_hour,
-                 tm.tm_min,
-                 tm.tm_sec,
-                 usec);
-	rval = strlen(p_ts)*sizeof(char);
-retblock:
-        return rval;
+        return snprint_timestamp_cached(TS_FORMAT_LOG_HP,
+                                        NULL,
+                                        p_ts,
+                                        MIN(tslen,timestamp_len_hp));
 }
 
 
@@ -1882,6 +2009,84 @@ return_rc:
         return rc;
 }
 
+/**
+ * Write a vector of buffers to a file with as few system calls as possible.
+ *
+ * @param file		File to write to
+ * @param iov		Buffers to write, modified if the write is partial
+ * @param iovcnt	Number of buffers
+ * @param flush		Whether the file is synced to disk after the write
+ *
+ * @return 0 on success, errno of the failed write otherwise
+ */
+int skygw_file_writev(
+        skygw_file_t* file,
+        struct iovec* iov,
+        int           iovcnt,
+        bool          flush)
+{
+        int    rc = 0;
+#if !defined(LAPTOP_TEST)
+        ssize_t nwritten;
+        int    fd;
+        static int writecount;
+#else
+	struct timespec ts1;
+	ts1.tv_sec = 0;
+	ts1.tv_nsec = DISKWRITE_LATENCY*1000000;
+#endif
+
+        CHK_FILE(file);
+#if defined(LAPTOP_TEST)
+	nanosleep(&ts1, NULL);
+#else
+        fd = fileno(file->sf_file);
+
+        while (iovcnt > 0)
+        {
+                nwritten = writev(fd, iov, iovcnt);
+
+                if (nwritten == -1)
+                {
+                        if (errno == EINTR)
+                        {
+                                continue;
+                        }
+                        rc = errno;
+                        perror("Logfile write.\n");
+                        fprintf(stderr,
+                                "* Writing %d buffers to %s failed.\n",
+                                iovcnt,
+                                file->sf_fname);
+                        goto return_rc;
+                }
+                /** Skip the buffers that were written completely */
+                while (iovcnt > 0 && (size_t)nwritten >= iov->iov_len)
+                {
+                        nwritten -= iov->iov_len;
+                        iov += 1;
+                        iovcnt -= 1;
+                }
+
+                if (iovcnt > 0)
+                {
+                        iov->iov_base = (char *)iov->iov_base + nwritten;
+                        iov->iov_len -= nwritten;
+                }
+        }
+        writecount += 1;
+
+        if (flush || writecount == FSYNCLIMIT)
+	{
+                fsync(fd);
+                writecount = 0;
+        }
+#endif
+        CHK_FILE(file);
+return_rc:
+        return rc;
+}
+
 skygw_file_t* skygw_file_alloc(
         char* fname)
 {
@@ -2199,3 +2404,236 @@ int simple_str_hash(char* key)
 
   return hash;
 }
+
+/**
+ * Check if a character can be part of an unquoted identifier or keyword.
+ */
+static bool is_identifier_char(
+        char c)
+{
+        return isalnum((unsigned char)c) || c == '_' || c == '$' ||
+                (unsigned char)c >= 0x80;
+}
+
+/**
+ * Skip a quoted string or identifier. Backslash escapes and doubled quote
+ * characters are handled, the latter being the only escape in identifiers.
+ * 
+ * @param p     Pointer to the opening quote character
+ * @param end   End of the query
+ * 
+ * @return Pointer to the character after the closing quote or end if the
+ * string is not terminated
+ */
+static const char* skip_quoted(
+        const char* p,
+        const char* end)
+{
+        char q = *p++;
+        
+        while (p < end)
+        {
+                if (*p == '\\' && q != '`' && p + 1 < end)
+                {
+                        p += 2;
+                }
+                else if (*p == q)
+                {
+                        if (p + 1 < end && p[1] == q)
+                        {
+                                p += 2;
+                        }
+                        else
+                        {
+                                return p + 1;
+                        }
+                }
+                else
+                {
+                        p++;
+                }
+        }
+        return end;
+}
+
+/**
+ * Replace the literals of a query with question marks in a single pass over
+ * the query text. String literals keep their quotes and their content is
+ * replaced, numbers, hexadecimal and bit values and NULL values are replaced
+ * as a whole. Comments, quoted identifiers and white space are copied as such.
+ * 
+ * @param query Query text, not necessarily null-terminated
+ * @param len   Length of the query
+ * @param dest  Buffer for the result, at least CANONICAL_BUFSIZE(len) bytes
+ * 
+ * @return Length of the canonical query, excluding the terminating null byte
+ */
+size_t skygw_canonicalize_query(
+        const char* query,
+        size_t      len,
+        char*       dest)
+{
+        const char* p = query;
+        const char* end = query + len;
+        const char* word = NULL; /*< The previous keyword or identifier */
+        size_t      wordlen = 0;
+        char*       d = dest;
+        
+        while (p < end)
+        {
+                const char* start = p;
+                char        c = *p;
+                
+                if (c == '\'' || c == '"')
+                {
+                        p = skip_quoted(p, end);
+                        *d++ = c;
+                        *d++ = '?';
+                        
+                        if (p > start + 1 && p[-1] == c)
+                        {
+                                *d++ = c;
+                        }
+                        word = NULL;
+                }
+                else if (c == '`')
+                {
+                        p = skip_quoted(p, end);
+                        memcpy(d, start, p - start);
+                        d += p - start;
+                        word = NULL;
+                }
+                else if (c == '#' || 
+                        (c == '-' && p + 1 < end && p[1] == '-' &&
+                         (p + 2 == end || isspace((unsigned char)p[2]))))
+                {
+                        while (p < end && *p != '\n')
+                        {
+                                p++;
+                        }
+                        memcpy(d, start, p - start);
+                        d += p - start;
+                }
+                else if (c == '/' && p + 1 < end && p[1] == '*')
+                {
+                        p += 2;
+                        
+                        while (p < end && !(*p == '*' && p + 1 < end && p[1] == '/'))
+                        {
+                                p++;
+                        }
+                        p = (p < end ? p + 2 : end);
+                        memcpy(d, start, p - start);
+                        d += p - start;
+                }
+                else if (isdigit((unsigned char)c) ||
+                        (c == '.' && p + 1 < end && isdigit((unsigned char)p[1])))
+                {
+                        if (c == '0' && p + 1 < end && strchr("xXbB", p[1]) != NULL)
+                        {
+                                p += 2;
+                                
+                                while (p < end && isxdigit((unsigned char)*p))
+                                {
+                                        p++;
+                                }
+                        }
+                        else
+                        {
+                                while (p < end && isdigit((unsigned char)*p))
+                                {
+                                        p++;
+                                }
+                                if (p < end && *p == '.')
+                                {
+                                        p++;
+
+                                        while (p < end && isdigit((unsigned char)*p))
+                                        {
+                                                p++;
+                                        }
+                                }
+                                if (p < end && (*p == 'e' || *p == 'E'))
+                                {
+                                        const char* e = p + 1;
+                                        
+                                        if (e < end && (*e == '+' || *e == '-'))
+                                        {
+                                                e++;
+                                        }
+                                        if (e < end && isdigit((unsigned char)*e))
+                                        {
+                                                p = e;
+                                                
+                                                while (p < end && isdigit((unsigned char)*p))
+                                                {
+                                                        p++;
+                                                }
+                                        }
+                                }
+                        }
+                        
+                        if (p < end && is_identifier_char(*p))
+                        {
+                                /** An identifier that begins with digits */
+                                while (p < end && is_identifier_char(*p))
+                                {
+                                        p++;
+                                }
+                                memcpy(d, start, p - start);
+                                d += p - start;
+                                word = start;
+                                wordlen = p - start;
+                        }
+                        else
+                        {
+                                *d++ = '?';
+                                word = NULL;
+                        }
+                }
+                else if (is_identifier_char(c))
+                {
+                        while (p < end && is_identifier_char(*p))
+                        {
+                                p++;
+                        }
+                        if (p - start == 1 && p < end && *p == '\'' &&
+                                strchr("xXbB", c) != NULL)
+                        {
+                                /** X'4D' or B'101' */
+                                p = skip_quoted(p, end);
+                                *d++ = '?';
+                                word = NULL;
+                        }
+                        else if (p - start == 4 && 
+                                strncasecmp(start, "null", 4) == 0 &&
+                                !(word != NULL && wordlen == 2 && 
+                                  strncasecmp(word, "is", 2) == 0) &&
+                                !(word != NULL && wordlen == 3 && 
+                                  strncasecmp(word, "not", 3) == 0))
+                        {
+                                *d++ = '?';
+                                word = NULL;
+                        }
+                        else
+                        {
+                                memcpy(d, start, p - start);
+                                d += p - start;
+                                word = start;
+                                wordlen = p - start;
+                        }
+                }
+                else
+                {
+                        *d++ = c;
+                        p++;
+                        
+                        if (!isspace((unsigned char)c))
+                        {
+                                word = NULL;
+                        }
+                }
+        }
+        *d = '\0';
+        return d - dest;
+}
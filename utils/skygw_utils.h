@@ -10,6 +10,8 @@
 #endif
 #define FSYNCLIMIT 10
 
+#include <sys/time.h>
+#include <sys/uio.h>
 #include "skygw_types.h"
 #include "skygw_debug.h"
 
@@ -90,6 +92,20 @@ static const char*  timestamp_formatstr_hp = "%04d-%02d-%02d %02d:%02d:%02d.%03d
 /** One for terminating '\0' */
 static const size_t    timestamp_len_hp       =    (4+1 +2+1 +2+1 +2+1 +2+1 +2+1+3+3  +1) * sizeof(char);
 
+/**
+ * Timestamp formats of the per-thread timestamp cache, see
+ * snprint_timestamp_cached.
+ */
+typedef enum {
+        TS_FORMAT_LOG = 0, /**< "2015-01-31 23:59:59   " */
+        TS_FORMAT_LOG_HP,  /**< "2015-01-31 23:59:59.999   " */
+        TS_FORMAT_QLA,     /**< "23:59:59.999 31/01/2015, " */
+        TS_FORMAT_COUNT
+} ts_format_t;
+
+/** Buffer size that holds a timestamp of any format and terminating '\0' */
+#define TS_CACHE_STRLEN 64
+
 /** Single-linked list for storing test cases */
 
 struct slist_node_st {
@@ -225,6 +241,11 @@ int skygw_file_write(
         void*         data,
         size_t        nbytes,
         bool          flush);
+int skygw_file_writev(
+        skygw_file_t* file,
+        struct iovec* iov,
+        int           iovcnt,
+        bool          flush);
 /** Skygw file routines */
 
 EXTERN_C_BLOCK_BEGIN
@@ -275,6 +296,14 @@ char* replace_literal(char* haystack,
 bool is_valid_posix_path(char* path);
 bool strip_escape_chars(char*);
 int simple_str_hash(char* key);
+size_t skygw_canonicalize_query(const char* query, size_t len, char* dest);
+size_t snprint_timestamp_cached(ts_format_t   fmt,
+                                struct timeval* tv,
+                                char*         p_ts,
+                                size_t        tslen);
+
+/** Size of the buffer needed for the canonical form of a query of length len */
+#define CANONICAL_BUFSIZE(len) (2 * (len) + 1)
 
 
 EXTERN_C_BLOCK_END